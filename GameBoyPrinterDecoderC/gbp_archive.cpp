@@ -0,0 +1,564 @@
+/*************************************************************************
+ *
+ * Gameboy Printer Capture Archive
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ * Copyright (C) 2020 Brian Khuu
+ *
+ * PURPOSE: This module stores captured packets in an indexed binary file, so any print can be read back with one seek
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gameboy_printer_protocol.h"
+#include "gbp_pkt.h"
+#include "gbp_tiles.h"
+#include "gbp_cache.h"
+#include "gbp_archive.h"
+
+/*******************************************************************************
+ * Utilities
+*******************************************************************************/
+
+static void gbp_archive_put16(uint8_t *buf, const uint16_t val)
+{
+    buf[0] = (uint8_t)(val >> 0);
+    buf[1] = (uint8_t)(val >> 8);
+}
+
+static void gbp_archive_put32(uint8_t *buf, const uint32_t val)
+{
+    buf[0] = (uint8_t)(val >>  0);
+    buf[1] = (uint8_t)(val >>  8);
+    buf[2] = (uint8_t)(val >> 16);
+    buf[3] = (uint8_t)(val >> 24);
+}
+
+static uint16_t gbp_archive_get16(const uint8_t *buf)
+{
+    return (uint16_t)(buf[0] | (buf[1] << 8));
+}
+
+static uint32_t gbp_archive_get32(const uint8_t *buf)
+{
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+// Tiles a DATA payload decompresses to, using the same decompressor state across records as the decoder
+// Returns the tile count, tiles past `tilesMax` are counted but not copied
+static uint32_t gbp_archive_tiles(gbp_pkt_t *pkt, gbp_pkt_tileAcc_t *tileAcc, const gbp_archive_record_t *record, const uint8_t *payload, uint8_t *tiles, const uint32_t tilesMax)
+{
+    uint32_t tileCount = 0;
+    pkt->compression = record->compression;
+    while (gbp_pkt_decompressor(pkt, payload, record->dataLength, tileAcc))
+    {
+        if (!gbp_pkt_tileAccu_tileReadyCheck(tileAcc))
+            continue;
+        if (tiles && (tileCount < tilesMax))
+            memcpy(&tiles[tileCount * GBP_TILE_SIZE_IN_BYTE], tileAcc->tile, GBP_TILE_SIZE_IN_BYTE);
+        tileCount++;
+    }
+    return tileCount;
+}
+
+/*******************************************************************************
+ * Index
+*******************************************************************************/
+
+static void gbp_archive_index_init(gbp_archive_index_t *index, const uint32_t dataOffset)
+{
+    memset(index, 0, sizeof(*index));
+    gbp_pkt_init(&index->pkt);
+    index->dataOffset = dataOffset;
+}
+
+static void gbp_archive_index_free(gbp_archive_index_t *index)
+{
+    free(index->entry);
+    index->entry = NULL;
+    index->entryCount = 0;
+    index->entrySize = 0;
+}
+
+// `tiles` is the tile count of a DATA record, `nextOffset` is where the record after this one starts
+static bool gbp_archive_index_record(gbp_archive_index_t *index, const gbp_archive_record_t *record, const uint8_t *payload, const uint32_t offset, const uint32_t nextOffset, const uint32_t tiles)
+{
+    if (record->command == GBP_COMMAND_DATA)
+    {
+        index->tiles += tiles;
+        return true;
+    }
+
+    if ((record->command != GBP_COMMAND_INIT) && (record->command != GBP_COMMAND_PRINT))
+        return true;
+
+    if (index->entryCount >= index->entrySize)
+    {
+        const size_t entrySize = index->entrySize ? (index->entrySize * 2) : 64;
+        gbp_archive_entry_t *entry = (gbp_archive_entry_t *) realloc(index->entry, entrySize * sizeof(gbp_archive_entry_t));
+        if (!entry)
+            return false;
+        index->entry = entry;
+        index->entrySize = entrySize;
+    }
+
+    gbp_archive_entry_t *entry = &index->entry[index->entryCount++];
+    memset(entry, 0, sizeof(*entry));
+    entry->recordOffset = offset;
+    entry->dataOffset   = offset;
+    entry->command      = record->command;
+    if (record->command == GBP_COMMAND_PRINT)
+    {
+        entry->dataOffset = index->dataOffset;
+        if (record->dataLength >= GBP_PRINT_INSTRUCT_PAYLOAD_SIZE)
+        {
+            entry->sheets   = payload[GBP_PRINT_INSTRUCT_INDEX_NUM_OF_SHEETS];
+            entry->linefeed = payload[GBP_PRINT_INSTRUCT_INDEX_NUM_OF_LINEFEED];
+            entry->pallet   = payload[GBP_PRINT_INSTRUCT_INDEX_PALETTE_VALUE];
+            entry->density  = payload[GBP_PRINT_INSTRUCT_INDEX_PRINT_DENSITY];
+        }
+        entry->rows = (uint16_t)(index->tiles / GBP_TILES_PER_LINE);
+        index->tiles = 0;
+        index->dataOffset = nextOffset;
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * Writer
+*******************************************************************************/
+
+static bool gbp_archive_write(gbp_archive_writer_t *w, const void *data, const size_t size)
+{
+    if (w->error || (fwrite(data, 1, size, w->f) != size))
+    {
+        w->error = true;
+        return false;
+    }
+    w->offset += (uint32_t) size;
+    return true;
+}
+
+bool gbp_archive_writer_open(gbp_archive_writer_t *w, FILE *f, const bool dedup)
+{
+    memset(w, 0, sizeof(*w));
+    w->f = f;
+    w->dedup = dedup;
+    w->payload = (uint8_t *) malloc(GBP_ARCHIVE_PAYLOAD_MAX);
+    w->tiles   = (uint8_t *) malloc(GBP_ARCHIVE_RECORD_TILES_MAX * GBP_TILE_SIZE_IN_BYTE);
+    w->encoded = (uint8_t *) malloc(GBP_ARCHIVE_PAYLOAD_MAX);
+    if (!w->payload || !w->tiles || !w->encoded)
+    {
+        w->error = true;
+        return false;
+    }
+    gbp_cache_reset(&w->cache);
+    gbp_archive_index_init(&w->index, GBP_ARCHIVE_HEADER_SIZE);
+
+    // Index offset is patched on close
+    uint8_t header[GBP_ARCHIVE_HEADER_SIZE] = {0};
+    memcpy(header, GBP_ARCHIVE_MAGIC, 4);
+    header[4] = GBP_ARCHIVE_VERSION;
+    header[5] = dedup ? GBP_ARCHIVE_FLAG_DEDUP : 0;
+    return gbp_archive_write(w, header, sizeof(header));
+}
+
+// Tokens for the tiles of a DATA record. Returns the encoded size, or 0 to store the record as is
+static size_t gbp_archive_writer_dedup(gbp_archive_writer_t *w, const uint32_t tileCount, const size_t sizeMax)
+{
+    memcpy(&w->cacheUndo, &w->cache, sizeof(w->cache));
+    size_t size = 0;
+    for (uint32_t t = 0; t < tileCount; t++)
+    {
+        const uint8_t *tile = &w->tiles[t * GBP_TILE_SIZE_IN_BYTE];
+        bool hit = false;
+        const uint16_t slot = gbp_cache_add(&w->cache, tile, &hit);
+        if ((size + 2 + (hit ? 0 : GBP_TILE_SIZE_IN_BYTE)) >= sizeMax)
+        {
+            // No smaller than the original payload
+            memcpy(&w->cache, &w->cacheUndo, sizeof(w->cache));
+            return 0;
+        }
+        gbp_archive_put16(&w->encoded[size], hit ? slot : GBP_ARCHIVE_TILE_LITERAL);
+        size += 2;
+        if (!hit)
+        {
+            memcpy(&w->encoded[size], tile, GBP_TILE_SIZE_IN_BYTE);
+            size += GBP_TILE_SIZE_IN_BYTE;
+        }
+    }
+    return size;
+}
+
+static bool gbp_archive_writer_record(gbp_archive_writer_t *w)
+{
+    gbp_archive_record_t record = w->record;
+    record.dataLength = (uint16_t) w->payloadCount; ///< Less than announced if the capture was cut short
+    const uint8_t *payload = w->payload;
+    const uint32_t offset = w->offset;
+
+    uint32_t tileCount = 0;
+    if (record.command == GBP_COMMAND_DATA)
+    {
+        // Only records that start and end on a tile boundary can be deduped
+        const bool aligned = (w->index.tileAcc.count == 0);
+        tileCount = gbp_archive_tiles(&w->index.pkt, &w->index.tileAcc, &record, payload, w->tiles, GBP_ARCHIVE_RECORD_TILES_MAX);
+        if (w->dedup && aligned && (w->index.tileAcc.count == 0) && (tileCount > 0) && (tileCount <= GBP_ARCHIVE_RECORD_TILES_MAX))
+        {
+            const size_t encodedSize = gbp_archive_writer_dedup(w, tileCount, record.dataLength);
+            if (encodedSize > 0)
+            {
+                record.compression = GBP_ARCHIVE_COMPRESSION_DEDUP;
+                record.dataLength  = (uint16_t) encodedSize;
+                payload = w->encoded;
+            }
+        }
+    }
+
+    uint8_t header[GBP_ARCHIVE_RECORD_HEADER_SIZE];
+    header[0] = record.command;
+    header[1] = record.compression;
+    gbp_archive_put16(&header[2], record.dataLength);
+    header[4] = record.printerID;
+    header[5] = record.status;
+    gbp_archive_write(w, header, sizeof(header));
+    gbp_archive_write(w, payload, record.dataLength);
+
+    if (!gbp_archive_index_record(&w->index, &w->record, w->payload, offset, w->offset, tileCount))
+        w->error = true;
+    if (record.command == GBP_COMMAND_PRINT)
+        gbp_cache_reset(&w->cache);
+    return !w->error;
+}
+
+// Add a packet event from gbp_pkt_processByte(), gbp_pkt_processBuffer() or gbp_pkt_processBuffer_full()
+bool gbp_archive_writer_packet(gbp_archive_writer_t *w, const gbp_pkt_t *pkt, const uint8_t buff[], const size_t buffSize)
+{
+    switch (pkt->received)
+    {
+        case GBP_REC_GOT_PACKET:
+            w->record.command     = pkt->command;
+            w->record.compression = pkt->compression;
+            w->record.dataLength  = pkt->dataLength;
+            w->record.printerID   = pkt->printerID;
+            w->record.status      = pkt->status;
+            w->payloadCount       = 0;
+            if (gbp_pkt_payloadStreamed(pkt))
+            {
+                // Payload streamed in the following events
+                w->recordOpen = true;
+                return true;
+            }
+            memcpy(w->payload, buff, buffSize);
+            w->payloadCount = buffSize;
+            return gbp_archive_writer_record(w);
+
+        case GBP_REC_GOT_PAYLOAD_PARTAL:
+        case GBP_REC_GOT_PACKET_END:
+            if (!w->recordOpen)
+                return false;
+            if ((w->payloadCount + buffSize) <= GBP_ARCHIVE_PAYLOAD_MAX)
+            {
+                memcpy(&w->payload[w->payloadCount], buff, buffSize);
+                w->payloadCount += buffSize;
+            }
+            if (pkt->received == GBP_REC_GOT_PAYLOAD_PARTAL)
+                return true;
+            w->recordOpen = false;
+            w->record.printerID = pkt->printerID;
+            w->record.status    = pkt->status;
+            return gbp_archive_writer_record(w);
+
+        default:
+            return true;
+    }
+}
+
+// Writes the index (A packet still being received is dropped)
+bool gbp_archive_writer_close(gbp_archive_writer_t *w)
+{
+    const uint32_t indexOffset = w->offset;
+    uint8_t header[GBP_ARCHIVE_RECORD_HEADER_SIZE] = {GBP_ARCHIVE_RECORD_INDEX, 0};
+    gbp_archive_put32(&header[2], (uint32_t) w->index.entryCount);
+    gbp_archive_write(w, header, sizeof(header));
+    for (size_t i = 0; i < w->index.entryCount; i++)
+    {
+        const gbp_archive_entry_t *entry = &w->index.entry[i];
+        uint8_t buf[GBP_ARCHIVE_ENTRY_SIZE] = {0};
+        gbp_archive_put32(&buf[0], entry->recordOffset);
+        gbp_archive_put32(&buf[4], entry->dataOffset);
+        buf[8]  = entry->command;
+        buf[9]  = entry->sheets;
+        buf[10] = entry->linefeed;
+        buf[11] = entry->pallet;
+        buf[12] = entry->density;
+        gbp_archive_put16(&buf[14], entry->rows);
+        gbp_archive_write(w, buf, sizeof(buf));
+    }
+
+    // Not seekable, so readers scan for the index instead
+    uint8_t offset[4];
+    gbp_archive_put32(offset, indexOffset);
+    if (!w->error && (fseek(w->f, GBP_ARCHIVE_INDEX_OFFSET_POS, SEEK_SET) == 0))
+    {
+        if (fwrite(offset, 1, sizeof(offset), w->f) != sizeof(offset))
+            w->error = true;
+        fseek(w->f, 0, SEEK_END);
+    }
+    if (fflush(w->f) != 0)
+        w->error = true;
+
+    gbp_archive_index_free(&w->index);
+    free(w->payload);
+    free(w->tiles);
+    free(w->encoded);
+    w->payload = NULL;
+    w->tiles   = NULL;
+    w->encoded = NULL;
+    return !w->error;
+}
+
+/*******************************************************************************
+ * Reader
+*******************************************************************************/
+
+// True if a seekable file starts with an archive header (Read position is left at the start)
+bool gbp_archive_probe(FILE *f)
+{
+    const long start = ftell(f);
+    if (start < 0)
+        return false;
+    char magic[4] = {0};
+    const bool found = (fread(magic, 1, sizeof(magic), f) == sizeof(magic)) && (memcmp(magic, GBP_ARCHIVE_MAGIC, 4) == 0);
+    fseek(f, start, SEEK_SET);
+    return found;
+}
+
+static bool gbp_archive_reader_header(gbp_archive_reader_t *r, gbp_archive_record_t *record, uint32_t *entryCount)
+{
+    uint8_t header[GBP_ARCHIVE_RECORD_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), r->f) != sizeof(header))
+        return false;
+    record->command     = header[0];
+    record->compression = header[1];
+    record->dataLength  = gbp_archive_get16(&header[2]);
+    record->printerID   = header[4];
+    record->status      = header[5];
+    if (entryCount)
+        *entryCount = gbp_archive_get32(&header[2]);
+    return true;
+}
+
+static bool gbp_archive_reader_index(gbp_archive_reader_t *r)
+{
+    gbp_archive_record_t record;
+    uint32_t entryCount = 0;
+    if ((fseek(r->f, r->indexOffset, SEEK_SET) != 0) || !gbp_archive_reader_header(r, &record, &entryCount) || (record.command != GBP_ARCHIVE_RECORD_INDEX))
+        return false;
+    r->entry = (gbp_archive_entry_t *) calloc(entryCount ? entryCount : 1, sizeof(gbp_archive_entry_t));
+    if (!r->entry)
+        return false;
+    for (uint32_t i = 0; i < entryCount; i++)
+    {
+        uint8_t buf[GBP_ARCHIVE_ENTRY_SIZE];
+        if (fread(buf, 1, sizeof(buf), r->f) != sizeof(buf))
+            return false;
+        gbp_archive_entry_t *entry = &r->entry[i];
+        entry->recordOffset = gbp_archive_get32(&buf[0]);
+        entry->dataOffset   = gbp_archive_get32(&buf[4]);
+        entry->command      = buf[8];
+        entry->sheets       = buf[9];
+        entry->linefeed     = buf[10];
+        entry->pallet       = buf[11];
+        entry->density      = buf[12];
+        entry->rows         = gbp_archive_get16(&buf[14]);
+        r->entryCount++;
+    }
+    return true;
+}
+
+// Index record was never linked from the header, so walk the records to it, rebuilding the index on the way
+static bool gbp_archive_reader_scan(gbp_archive_reader_t *r)
+{
+    gbp_archive_index_t index;
+    gbp_archive_index_init(&index, GBP_ARCHIVE_HEADER_SIZE);
+    bool ok = (fseek(r->f, GBP_ARCHIVE_HEADER_SIZE, SEEK_SET) == 0);
+    uint32_t offset = GBP_ARCHIVE_HEADER_SIZE;
+    gbp_archive_record_t record;
+    while (ok && gbp_archive_reader_header(r, &record, NULL))
+    {
+        if (record.command == GBP_ARCHIVE_RECORD_INDEX)
+            break;
+        if (fread(r->payload, 1, record.dataLength, r->f) != record.dataLength)
+            break; ///< Cut short
+        const uint32_t nextOffset = offset + GBP_ARCHIVE_RECORD_HEADER_SIZE + record.dataLength;
+        uint32_t tiles = 0;
+        if ((record.command == GBP_COMMAND_DATA) && (record.compression == GBP_ARCHIVE_COMPRESSION_DEDUP))
+        {
+            for (uint32_t i = 0; (i + 2) <= record.dataLength; tiles++)
+                i += 2 + ((gbp_archive_get16(&r->payload[i]) == GBP_ARCHIVE_TILE_LITERAL) ? GBP_TILE_SIZE_IN_BYTE : 0);
+        }
+        else if (record.command == GBP_COMMAND_DATA)
+        {
+            tiles = gbp_archive_tiles(&index.pkt, &index.tileAcc, &record, r->payload, NULL, 0);
+        }
+        ok = gbp_archive_index_record(&index, &record, r->payload, offset, nextOffset, tiles);
+        offset = nextOffset;
+    }
+    r->entry = index.entry;
+    r->entryCount = index.entryCount;
+    return ok;
+}
+
+bool gbp_archive_reader_open(gbp_archive_reader_t *r, FILE *f)
+{
+    memset(r, 0, sizeof(*r));
+    r->f = f;
+    r->payload = (uint8_t *) malloc(GBP_ARCHIVE_PAYLOAD_MAX);
+    r->packet  = (uint8_t *) malloc(GBP_ARCHIVE_PACKET_MAX);
+    if (!r->payload || !r->packet)
+        return false;
+
+    uint8_t header[GBP_ARCHIVE_HEADER_SIZE];
+    if ((fseek(f, 0, SEEK_SET) != 0) || (fread(header, 1, sizeof(header), f) != sizeof(header)))
+        return false;
+    if ((memcmp(header, GBP_ARCHIVE_MAGIC, 4) != 0) || (header[4] != GBP_ARCHIVE_VERSION))
+        return false;
+    r->version     = header[4];
+    r->flags       = header[5];
+    r->indexOffset = gbp_archive_get32(&header[GBP_ARCHIVE_INDEX_OFFSET_POS]);
+    if ((r->indexOffset == 0) || !gbp_archive_reader_index(r))
+    {
+        free(r->entry);
+        r->entry = NULL;
+        r->entryCount = 0;
+        if (!gbp_archive_reader_scan(r))
+            return false;
+    }
+    return gbp_archive_reader_seek(r, GBP_ARCHIVE_HEADER_SIZE);
+}
+
+void gbp_archive_reader_free(gbp_archive_reader_t *r)
+{
+    free(r->entry);
+    free(r->payload);
+    free(r->packet);
+    r->entry   = NULL;
+    r->payload = NULL;
+    r->packet  = NULL;
+    r->entryCount = 0;
+}
+
+// Continue reading from a record offset (e.g. gbp_archive_entry_t.dataOffset)
+bool gbp_archive_reader_seek(gbp_archive_reader_t *r, const uint32_t offset)
+{
+    gbp_cache_reset(&r->cache);
+    r->offset = offset;
+    return fseek(r->f, offset, SEEK_SET) == 0;
+}
+
+// Next record, rebuilt into the packet the gameboy sent (sync word to printer reply, deduped tiles restored)
+// Returns NULL at the end of the records
+const uint8_t *gbp_archive_reader_next(gbp_archive_reader_t *r, gbp_archive_record_t *record, size_t *packetSize)
+{
+    gbp_archive_record_t rec;
+    if (!gbp_archive_reader_header(r, &rec, NULL) || (rec.command == GBP_ARCHIVE_RECORD_INDEX))
+        return NULL;
+    if (fread(r->payload, 1, rec.dataLength, r->f) != rec.dataLength)
+        return NULL;
+    r->offset += GBP_ARCHIVE_RECORD_HEADER_SIZE + rec.dataLength;
+
+    uint8_t *packet = r->packet;
+    size_t size = 6;
+    if (rec.compression == GBP_ARCHIVE_COMPRESSION_DEDUP)
+    {
+        for (uint32_t i = 0; (i + 2) <= rec.dataLength; )
+        {
+            const uint16_t token = gbp_archive_get16(&r->payload[i]);
+            i += 2;
+            const uint8_t *tile = NULL;
+            if (token == GBP_ARCHIVE_TILE_LITERAL)
+            {
+                if ((i + GBP_TILE_SIZE_IN_BYTE) > rec.dataLength)
+                    return NULL;
+                tile = &r->payload[i];
+                gbp_cache_add(&r->cache, tile, NULL);
+                i += GBP_TILE_SIZE_IN_BYTE;
+            }
+            else
+            {
+                const gbp_cache_entry_t *entry = gbp_cache_get(&r->cache, token);
+                if (!entry)
+                    return NULL; ///< Reference to a tile never stored
+                tile = entry->tile;
+            }
+            if ((size + GBP_TILE_SIZE_IN_BYTE) > (GBP_ARCHIVE_PACKET_MAX - 4))
+                return NULL;
+            memcpy(&packet[size], tile, GBP_TILE_SIZE_IN_BYTE);
+            size += GBP_TILE_SIZE_IN_BYTE;
+        }
+        rec.compression = 0;
+        rec.dataLength  = (uint16_t)(size - 6);
+    }
+    else
+    {
+        memcpy(&packet[size], r->payload, rec.dataLength);
+        size += rec.dataLength;
+    }
+
+    packet[0] = 0x88;
+    packet[1] = 0x33;
+    packet[2] = rec.command;
+    packet[3] = rec.compression;
+    gbp_archive_put16(&packet[4], rec.dataLength);
+    uint16_t checksum = 0;
+    for (size_t i = 2; i < size; i++)
+    {
+        checksum += packet[i];
+    }
+    gbp_archive_put16(&packet[size], checksum);
+    packet[size + 2] = rec.printerID;
+    packet[size + 3] = rec.status;
+    size += 4;
+
+    if (rec.command == GBP_COMMAND_PRINT)
+        gbp_cache_reset(&r->cache);
+    if (record)
+        *record = rec;
+    if (packetSize)
+        *packetSize = size;
+    return packet;
+}
+
+// Index entry of a print, counting from 0
+const gbp_archive_entry_t *gbp_archive_reader_print(gbp_archive_reader_t *r, const size_t printNumber)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < r->entryCount; i++)
+    {
+        if (r->entry[i].command != GBP_COMMAND_PRINT)
+            continue;
+        if (count++ == printNumber)
+            return &r->entry[i];
+    }
+    return NULL;
+}
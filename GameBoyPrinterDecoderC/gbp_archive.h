@@ -0,0 +1,153 @@
+/*************************************************************************
+ *
+ * Gameboy Printer Capture Archive
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ * Copyright (C) 2020 Brian Khuu
+ *
+ * PURPOSE: This module stores captured packets in an indexed binary file, so any print can be read back with one seek
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GBP_ARCHIVE_H
+#define GBP_ARCHIVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+    Archive Layout (All values little endian, needs gbp_pkt.h and gbp_cache.h)
+
+    ```
+    Header : "GBPA" [VERSION:1] [FLAGS:1] [RESERVED:2] [INDEX OFFSET:4]
+    Record : [COMMAND:1] [COMPRESSION:1] [LENGTH:2] [PRINTER ID:1] [STATUS:1] [PAYLOAD:LENGTH]
+    ...
+    Index  : [0xFF] [0x00] [ENTRY COUNT:4] then for every INIT and PRINT record:
+             [RECORD OFFSET:4] [DATA OFFSET:4] [COMMAND:1] [SHEETS:1] [LINEFEED:1] [PALLET:1] [DENSITY:1] [RESERVED:1] [ROWS:2]
+    ```
+
+    A record is a packet without its sync word and checksum. The DATA OFFSET of a PRINT entry is the
+    first record after the previous PRINT, so reading from there up to its RECORD OFFSET gives
+    everything the print needs. ROWS is the number of tile rows sent for it.
+
+    INDEX OFFSET is 0 if the header could not be patched (e.g. written to a pipe). The records are
+    then scanned up to the index record instead.
+
+    Dedup (GBP_ARCHIVE_FLAG_DEDUP): DATA records holding whole tiles are stored with compression
+    GBP_ARCHIVE_COMPRESSION_DEDUP. Each tile is a 2 byte token: either GBP_ARCHIVE_TILE_LITERAL followed by
+    the tile, or the gbp_cache_slot() of a tile already in the cache. Writer and reader both reset
+    their cache after every PRINT record, so a print can still be read on its own.
+*/
+
+#define GBP_ARCHIVE_MAGIC             "GBPA"
+#define GBP_ARCHIVE_VERSION           1
+#define GBP_ARCHIVE_HEADER_SIZE       12
+#define GBP_ARCHIVE_INDEX_OFFSET_POS  8    ///< Position of [INDEX OFFSET] in the header
+#define GBP_ARCHIVE_RECORD_HEADER_SIZE 6
+#define GBP_ARCHIVE_ENTRY_SIZE        16
+#define GBP_ARCHIVE_RECORD_INDEX      0xFF ///< Command of the index record
+#define GBP_ARCHIVE_FLAG_DEDUP        0x01
+#define GBP_ARCHIVE_COMPRESSION_DEDUP 0x80
+#define GBP_ARCHIVE_TILE_LITERAL      0xFFFF
+#define GBP_ARCHIVE_PAYLOAD_MAX       0xFFFF
+#define GBP_ARCHIVE_RECORD_TILES_MAX  (GBP_ARCHIVE_PAYLOAD_MAX / GBP_TILE_SIZE_IN_BYTE) ///< Larger DATA records are never deduped
+#define GBP_ARCHIVE_PACKET_MAX        (2 + 4 + GBP_ARCHIVE_PAYLOAD_MAX + 2 + 2) ///< Sync word, header, payload, checksum, printer reply
+
+typedef struct
+{
+    uint8_t command;
+    uint8_t compression;
+    uint16_t dataLength;
+    uint8_t printerID;
+    uint8_t status;
+} gbp_archive_record_t;
+
+typedef struct
+{
+    uint32_t recordOffset;
+    uint32_t dataOffset;
+    uint8_t command;  ///< GBP_COMMAND_INIT or GBP_COMMAND_PRINT
+    uint8_t sheets;   ///< Print instruction (PRINT only)
+    uint8_t linefeed;
+    uint8_t pallet;
+    uint8_t density;
+    uint16_t rows;
+} gbp_archive_entry_t;
+
+// Builds the index from the records (Used by the writer, and by the reader if the index is missing)
+typedef struct
+{
+    gbp_pkt_t pkt;
+    gbp_pkt_tileAcc_t tileAcc;
+    uint32_t tiles;      ///< Tiles since the last print
+    uint32_t dataOffset; ///< First record after the last print
+    gbp_archive_entry_t *entry;
+    size_t entryCount;
+    size_t entrySize;
+} gbp_archive_index_t;
+
+typedef struct
+{
+    FILE *f;
+    bool dedup;
+    bool error;
+    uint32_t offset; ///< Write position
+
+    // Packet being received
+    gbp_archive_record_t record;
+    bool recordOpen;
+    uint8_t *payload;
+    size_t payloadCount;
+
+    // Dedup
+    uint8_t *tiles;   ///< Tiles of the current DATA record
+    uint8_t *encoded; ///< Tokens of the current DATA record
+    gbp_cache_t cache;
+    gbp_cache_t cacheUndo; ///< Cache before the current record, in case it is stored as is
+
+    gbp_archive_index_t index;
+} gbp_archive_writer_t;
+
+typedef struct
+{
+    FILE *f;
+    uint8_t version;
+    uint8_t flags;
+    uint32_t indexOffset;
+    uint32_t offset; ///< Read position
+    gbp_archive_entry_t *entry;
+    size_t entryCount;
+    gbp_cache_t cache;
+    uint8_t *payload;
+    uint8_t *packet; ///< Last record as the bytes sent over the link cable
+} gbp_archive_reader_t;
+
+/* Writer */
+bool gbp_archive_writer_open(gbp_archive_writer_t *w, FILE *f, const bool dedup);
+bool gbp_archive_writer_packet(gbp_archive_writer_t *w, const gbp_pkt_t *pkt, const uint8_t buff[], const size_t buffSize);
+bool gbp_archive_writer_close(gbp_archive_writer_t *w);
+
+/* Reader */
+bool gbp_archive_probe(FILE *f);
+bool gbp_archive_reader_open(gbp_archive_reader_t *r, FILE *f);
+void gbp_archive_reader_free(gbp_archive_reader_t *r);
+bool gbp_archive_reader_seek(gbp_archive_reader_t *r, const uint32_t offset);
+const uint8_t *gbp_archive_reader_next(gbp_archive_reader_t *r, gbp_archive_record_t *record, size_t *packetSize);
+const gbp_archive_entry_t *gbp_archive_reader_print(gbp_archive_reader_t *r, const size_t printNumber);
+
+#endif
@@ -3,68 +3,88 @@
 #include <stdbool.h>
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "gbp_tiles.h"
-#include "gbp_bmp.h"
+#include "gbp_out.h"
 #include "./image/bmp_FixedWidthStream.h"
 
-bool gbp_bmp_isopen(gbp_bmp_t * gbp_bmp)
+static bool gbp_bmp_begin(gbp_out_t * out)
 {
-    return (gbp_bmp->f != 0) ? true : false;
+    // Header is written once the image height is known
+    unsigned char header[BMP_PIXEL_START_OFFSET] = {0};
+    return gbp_out_write(out, header, sizeof(header));
 }
 
-void gbp_bmp_open(gbp_bmp_t * gbp_bmp, const char *outputFilename, const uint16_t fixed_width_size)
+static void gbp_bmp_expandLutUpdate(gbp_bmp_t * gbp_bmp, const uint8_t pallet, const uint32_t palletColor[4])
 {
-    if (gbp_bmp->f != 0)
+    const bool tonesChanged = gbp_out_tonesUpdate(&gbp_bmp->expandTones, pallet);
+    if (gbp_bmp->expandValid && !tonesChanged && (memcmp(gbp_bmp->expandPallet, palletColor, sizeof(gbp_bmp->expandPallet)) == 0))
+        return;
+
+    for (int b = 0; b < 256; b++)
     {
-        fclose(gbp_bmp->f);
-        gbp_bmp->f = 0;
+        const uint8_t tones = gbp_bmp->expandTones.lut[b];
+        for (int i = 0; i < 4; i++)
+        {
+            const uint32_t encodedColor = palletColor[0b11 & (tones >> GBP_TILE_2BIT_LINEPACK_BITOFFSET(i))];
+            gbp_bmp->expandLut[b][i * 3 + 0] = (unsigned char)(encodedColor >>  0);
+            gbp_bmp->expandLut[b][i * 3 + 1] = (unsigned char)(encodedColor >>  8);
+            gbp_bmp->expandLut[b][i * 3 + 2] = (unsigned char)(encodedColor >> 16);
+        }
     }
 
-    // Open file
-    char filenameBuff[400] = {0};
-    snprintf(filenameBuff, sizeof(filenameBuff), "%s%X.bmp", outputFilename, gbp_bmp->fileCounter);
-    gbp_bmp->f = fopen(filenameBuff, "wb");
-
-    // Skip over bmp header...
-    fseek(gbp_bmp->f, BMP_PIXEL_START_OFFSET, SEEK_SET);
-
-    // Update
-    gbp_bmp->bmpSizeWidth  = fixed_width_size;
-    gbp_bmp->bmpSizeHeight = 0;
-    gbp_bmp->fileCounter++;
+    memcpy(gbp_bmp->expandPallet, palletColor, sizeof(gbp_bmp->expandPallet));
+    gbp_bmp->expandValid = true;
 }
 
-void gbp_bmp_add(gbp_bmp_t * gbp_bmp, const uint8_t * bmpLineBuffer, const uint16_t sizex, const uint16_t sizey, const uint32_t palletColor[4])
+static bool gbp_bmp_add(gbp_out_t * out, const uint8_t * bmpLineBuffer, const uint16_t sizey, const uint8_t pallet, const uint32_t palletColor[4])
 {
-    // Fixed width
-    if (sizex != gbp_bmp->bmpSizeWidth)
-        return;
+    gbp_bmp_t * gbp_bmp = &out->bmp;
+    const uint16_t sizex = out->width;
+    if (sizey > GBP_BMP_HEIGHT)
+        return false;
 
+    gbp_bmp_expandLutUpdate(gbp_bmp, pallet, palletColor);
+
+    const uint16_t packedRowSize = GBP_TILE_2BIT_LINEPACK_ROWSIZE_B(sizex);
+    const long bmpRowSize = BMP_PIXEL_BUFF_SIZE(sizex, 1);
     for (uint16_t y = 0; y < sizey; y++)
     {
-        for (uint16_t x = 0; x < sizex; x++)
+        // Whole packed bytes are expanded 4 pixels at a time
+        const uint8_t *packed = &bmpLineBuffer[y * packedRowSize];
+        unsigned char *bgr = &gbp_bmp->bmpBuffer[y * bmpRowSize];
+        for (uint16_t i = 0; i < packedRowSize; i++)
+        {
+            memcpy(&bgr[i * 4 * 3], gbp_bmp->expandLut[packed[i]], 4 * 3);
+        }
+
+        // Scalar fallback for any pixels left over at the end of the row
+        for (uint16_t x = packedRowSize * GBP_TILE_2BIT_LINEPACK_IN_BYTE_COUNT; x < sizex; x++)
         {
-            const int pixel = 0b11 & (bmpLineBuffer[(y * GBP_TILE_2BIT_LINEPACK_ROWSIZE_B(sizex)) + GBP_TILE_2BIT_LINEPACK_INDEX(x)] >> GBP_TILE_2BIT_LINEPACK_BITOFFSET(x));
+            const int pixel = 0b11 & (gbp_bmp->expandTones.lut[bmpLineBuffer[(y * packedRowSize) + GBP_TILE_2BIT_LINEPACK_INDEX(x)]] >> GBP_TILE_2BIT_LINEPACK_BITOFFSET(x));
             const unsigned long encodedColor = palletColor[pixel & 0b11];
-            //printf("bmp_set %d, %d\r\n", x, y);
             bmp_set(gbp_bmp->bmpBuffer, sizex, x, y, encodedColor);
         }
     }
 
-    fwrite(gbp_bmp->bmpBuffer, BMP_PIXEL_BUFF_SIZE(sizex, sizey), 1, gbp_bmp->f);
-    gbp_bmp->bmpSizeHeight += sizey;
+    return gbp_out_write(out, gbp_bmp->bmpBuffer, BMP_PIXEL_BUFF_SIZE(sizex, sizey));
 }
 
-void gbp_bmp_render(gbp_bmp_t * gbp_bmp)
+static bool gbp_bmp_end(gbp_out_t * out)
 {
-    // Rewind and write header with the now known image size
-    fseek(gbp_bmp->f, 0, SEEK_SET);
-    bmp_header(gbp_bmp->bmpBuffer, gbp_bmp->bmpSizeWidth, gbp_bmp->bmpSizeHeight);
-    fwrite(gbp_bmp->bmpBuffer, BMP_PIXEL_START_OFFSET, 1, gbp_bmp->f);
-
-    // Close File
-    fclose(gbp_bmp->f);
-    gbp_bmp->f = 0;
+    // Patch in the header with the now known image size
+    unsigned char header[BMP_PIXEL_START_OFFSET];
+    bmp_header(header, out->width, out->height);
+    return gbp_out_patch(out, 0, header, sizeof(header));
 }
+
+const gbp_out_backend_t gbp_bmp_backend =
+{
+    "bmp", "bmp", true,
+    gbp_bmp_begin,
+    gbp_bmp_add,
+    gbp_bmp_end,
+    NULL
+};
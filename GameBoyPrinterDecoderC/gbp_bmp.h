@@ -1,3 +1,6 @@
+#ifndef GBP_BMP_H
+#define GBP_BMP_H
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -10,17 +13,17 @@
 #define GBP_BMP_WIDTH  (GBP_TILE_PIXEL_WIDTH  * GBP_TILES_PER_LINE)
 #define GBP_BMP_HEIGHT (GBP_TILE_PIXEL_HEIGHT * GBP_BMP_MAX_TILE_HEIGHT)
 
+// BMP backend state (See gbp_bmp_backend in gbp_out.h)
 typedef struct
 {
-    FILE *f;
-    int fileCounter;
-    uint16_t bmpSizeWidth;  // x
-    uint16_t bmpSizeHeight; // y
     unsigned char bmpBuffer[BMP_PIXEL_BUFF_SIZE(GBP_BMP_WIDTH, GBP_BMP_HEIGHT)];
-} gbp_bmp_t;
 
+    // Packed 2bit byte (4 pixels) to BGR lookup, with the print palette of the strip composed in.
+    // Rebuilt when either changes (Games rarely change palette, so typically once per image)
+    bool expandValid;
+    uint32_t expandPallet[4];
+    gbp_out_tones_t expandTones;
+    unsigned char expandLut[256][4 * 3];
+} gbp_bmp_t;
 
-bool gbp_bmp_isopen(gbp_bmp_t * gbp_bmp);
-void gbp_bmp_open(gbp_bmp_t * gbp_bmp, const char *outputFilename, const uint16_t fixed_width_size);
-void gbp_bmp_add(gbp_bmp_t * gbp_bmp, const uint8_t * bmpLineBuffer, const uint16_t sizex, const uint16_t sizey, const uint32_t palletColor[4]);
-void gbp_bmp_render(gbp_bmp_t * gbp_bmp);
+#endif
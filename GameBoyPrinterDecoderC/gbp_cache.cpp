@@ -0,0 +1,93 @@
+/*************************************************************************
+ *
+ * Gameboy Printer Tile Cache
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ * Copyright (C) 2020 Brian Khuu
+ *
+ * PURPOSE: This module maps tile contents to their decoded 2bit lines, so repeated tiles are copied instead of decoded
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "gameboy_printer_protocol.h"
+#include "gbp_tiles.h"
+#include "gbp_cache.h"
+
+void gbp_cache_reset(gbp_cache_t *cache)
+{
+    cache->hits      = 0;
+    cache->misses    = 0;
+    cache->evictions = 0;
+    memset(cache->valid, 0, sizeof(cache->valid));
+}
+
+// Slot of a tile. This is part of the dedup format, so changing it breaks existing references
+uint16_t gbp_cache_slot(const uint8_t tileBuff[GBP_TILE_SIZE_IN_BYTE])
+{
+    // Both halves of the tile through one 64bit multiply each (Byte order fixed so slots match on any host)
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        lo |= (uint64_t)tileBuff[i] << (8 * i);
+        hi |= (uint64_t)tileBuff[i + 8] << (8 * i);
+    }
+    const uint64_t mix = (lo * 0x9E3779B97F4A7C15ull) ^ (hi * 0xC2B2AE3D27D4EB4Full);
+    const uint32_t hash = (uint32_t)(mix >> 32);
+    return (uint16_t)((hash ^ (hash >> 16)) & (GBP_CACHE_SLOT_COUNT - 1));
+}
+
+// Look up a tile, decoding it into its slot if it is not there yet. Returns the slot
+uint16_t gbp_cache_add(gbp_cache_t *cache, const uint8_t tileBuff[GBP_TILE_SIZE_IN_BYTE], bool *hit)
+{
+    const uint16_t slot = gbp_cache_slot(tileBuff);
+    gbp_cache_entry_t *entry = &cache->entry[slot];
+    const bool found = cache->valid[slot] && (memcmp(entry->tile, tileBuff, GBP_TILE_SIZE_IN_BYTE) == 0);
+    if (found)
+    {
+        cache->hits++;
+    }
+    else
+    {
+        if (cache->valid[slot])
+            cache->evictions++;
+        cache->misses++;
+        memcpy(entry->tile, tileBuff, GBP_TILE_SIZE_IN_BYTE);
+        gbp_tiles_tile_decode(tileBuff, entry->decoded);
+        cache->valid[slot] = true;
+    }
+    if (hit)
+        *hit = found;
+    return slot;
+}
+
+// Decoded lines of a tile (For gbp_tiles_line_addDecoded() or gbp_tiles_stream_addDecoded())
+const uint8_t *gbp_cache_decode(gbp_cache_t *cache, const uint8_t tileBuff[GBP_TILE_SIZE_IN_BYTE])
+{
+    return cache->entry[gbp_cache_add(cache, tileBuff, NULL)].decoded;
+}
+
+// Tile held by a slot, to resolve a dedup reference. NULL if nothing was added there yet
+const gbp_cache_entry_t *gbp_cache_get(gbp_cache_t *cache, const uint16_t slot)
+{
+    if ((slot >= GBP_CACHE_SLOT_COUNT) || !cache->valid[slot])
+        return NULL;
+    cache->hits++;
+    return &cache->entry[slot];
+}
@@ -0,0 +1,66 @@
+/*************************************************************************
+ *
+ * Gameboy Printer Tile Cache
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ * Copyright (C) 2020 Brian Khuu
+ *
+ * PURPOSE: This module maps tile contents to their decoded 2bit lines, so repeated tiles are copied instead of decoded
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GBP_CACHE_H
+#define GBP_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    Direct mapped: each tile hashes to exactly one slot, which holds the last tile seen there.
+
+    Dedup: The slot can also stand in for the tile when storing prints. A writer emits the tile
+    the first time (miss) and only its slot after that (hit). A reader that adds every tile it
+    reads to its own cache of the same size ends up with the same slots, so it can resolve
+    those references without any index being stored.
+*/
+
+#ifndef GBP_CACHE_SLOT_BITS
+#define GBP_CACHE_SLOT_BITS 10
+#endif
+#define GBP_CACHE_SLOT_COUNT (1 << GBP_CACHE_SLOT_BITS)
+
+typedef struct
+{
+    uint8_t tile[GBP_TILE_SIZE_IN_BYTE];      ///< Key (Raw tile as sent by the gameboy)
+    uint8_t decoded[GBP_TILE_DECODED_SIZE_B]; ///< As per gbp_tiles_tile_decode()
+} gbp_cache_entry_t;
+
+typedef struct
+{
+    uint32_t hits;
+    uint32_t misses;    ///< Tiles decoded (Unique tiles if there were no evictions)
+    uint32_t evictions; ///< Misses that replaced another tile
+    bool valid[GBP_CACHE_SLOT_COUNT];
+    gbp_cache_entry_t entry[GBP_CACHE_SLOT_COUNT];
+} gbp_cache_t;
+
+void gbp_cache_reset(gbp_cache_t *cache);
+uint16_t gbp_cache_slot(const uint8_t tileBuff[GBP_TILE_SIZE_IN_BYTE]);
+uint16_t gbp_cache_add(gbp_cache_t *cache, const uint8_t tileBuff[GBP_TILE_SIZE_IN_BYTE], bool *hit);
+const uint8_t *gbp_cache_decode(gbp_cache_t *cache, const uint8_t tileBuff[GBP_TILE_SIZE_IN_BYTE]);
+const gbp_cache_entry_t *gbp_cache_get(gbp_cache_t *cache, const uint16_t slot);
+
+#endif
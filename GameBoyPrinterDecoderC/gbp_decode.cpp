@@ -0,0 +1,174 @@
+/*************************************************************************
+ *
+ * Gameboy Printer Input Decoding
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ * Copyright (C) 2020 Brian Khuu
+ *
+ * PURPOSE: This module turns the emulator output (hex text, SLIP frames or raw packets) into prints and tiles
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "gameboy_printer_protocol.h"
+#include "gbp_pkt.h"
+#include "gbp_frame.h"
+#include "gbp_decode.h"
+
+/*******************************************************************************
+ * Hex Text
+*******************************************************************************/
+
+// -1 for anything that is not a hex digit
+static int8_t gbp_decode_hexNibble[256];
+
+// Call once before any decoding is started (Jobs then only read the table)
+void gbp_decode_hexTableInit(void)
+{
+    memset(gbp_decode_hexNibble, -1, sizeof(gbp_decode_hexNibble));
+    for (int i = 0; i < 10; i++)
+        gbp_decode_hexNibble['0' + i] = i;
+    for (int i = 0; i < 6; i++)
+    {
+        gbp_decode_hexNibble['a' + i] = 10 + i;
+        gbp_decode_hexNibble['A' + i] = 10 + i;
+    }
+}
+
+// Parse hex text into bytes. `out[]` must hold at least `(inSize / 2) + 1` bytes, or be `in` (Never writes ahead of what it has read).
+// Returns number of bytes written to `out[]`
+size_t gbp_decode_hexParse(gbp_decode_hex_t *hex, const uint8_t *in, size_t inSize, uint8_t *out)
+{
+    if (hex->eof)
+        return 0;
+
+    // Dev Note: `char ch = fgetc()` used to stop the parser at a 0xFF char on signed char hosts. Kept for identical output.
+    const uint8_t *eofMark = (const uint8_t *) memchr(in, 0xFF, inSize);
+    if (eofMark)
+    {
+        inSize = eofMark - in;
+        hex->eof = true;
+    }
+
+    size_t outSize = 0;
+    const uint8_t *end = in + inSize;
+    while (in < end)
+    {
+        // Discarding line
+        if (hex->skipLine)
+        {
+            const uint8_t *eol = (const uint8_t *) memchr(in, '\n', end - in);
+            if (!eol)
+                break;
+            hex->skipLine = false;
+            in = eol + 1;
+            continue;
+        }
+
+        const uint8_t ch = *in++;
+
+        // Skip Comments
+        if (ch == '/')
+        {
+            // Might be `//` or `/*`
+            hex->skipLine = true;
+            continue;
+        }
+
+        // Hex Byte Parsing
+        // Dev Note: A non hex char between two nibbles drops the first nibble. This also covers the `0x` prefix.
+        const int8_t nib = gbp_decode_hexNibble[ch];
+        if (nib == -1)
+        {
+            hex->lowNibFound = false;
+        }
+        else if (!hex->lowNibFound)
+        {
+            // Fast path for a plain hex pair
+            if ((in < end) && (gbp_decode_hexNibble[*in] != -1))
+            {
+                out[outSize++] = (uint8_t)((nib << 4) | gbp_decode_hexNibble[*in]);
+                in++;
+                continue;
+            }
+            hex->lowNibFound = true;
+            hex->byte = nib << 4;
+        }
+        else
+        {
+            hex->lowNibFound = false;
+            out[outSize++] = hex->byte | nib;
+        }
+    }
+
+    return outSize;
+}
+
+/*******************************************************************************
+ * SLIP Frames
+*******************************************************************************/
+
+// SLIP framed raw packets or rows
+void gbp_decode_frameByte(gbp_frame_rx_t *rx, const uint8_t b, const gbp_decode_handler_t *handler, void *userData)
+{
+    if (!gbp_frame_rx_byte(rx, b))
+        return;
+    const uint8_t *frameData = &rx->buffer[GBP_FRAME_HEADER_SIZE];
+    if (gbp_frame_rx_isRawPacket(rx))
+        handler->packet(userData, frameData, rx->size - GBP_FRAME_HEADER_SIZE);
+    else if (gbp_frame_rx_isRasterRow(rx))
+        handler->rasterRow(userData, &frameData[1]); ///< Already decoded on the emulator (GBP_OUTPUT_RASTER_ROWS)
+    else if (gbp_frame_rx_isRasterPrint(rx))
+        handler->print(userData, frameData);
+}
+
+/*******************************************************************************
+ * Packets
+*******************************************************************************/
+
+// Packet event of gbp_pkt_processBuffer_full(). Print instructions go to `print`, and DATA payloads
+// (compressed or not) to `tile` one tile at a time
+void gbp_decode_packetEvent(gbp_pkt_t *pkt, uint8_t buffer[], const uint16_t bufferSize, gbp_pkt_tileAcc_t *tileAcc, const gbp_decode_handler_t *handler, void *userData)
+{
+    if (pkt->received == GBP_REC_GOT_PACKET)
+    {
+        if (pkt->command == GBP_COMMAND_PRINT)
+            handler->print(userData, buffer);
+        if ((pkt->command != GBP_COMMAND_DATA) || gbp_pkt_payloadStreamed(pkt))
+            return;
+    }
+
+    // Support compression payload
+    while (gbp_pkt_decompressor(pkt, buffer, bufferSize, tileAcc))
+    {
+        if (gbp_pkt_tileAccu_tileReadyCheck(tileAcc))
+            handler->tile(userData, tileAcc->tile);
+    }
+}
+
+/*******************************************************************************
+ * Prints
+*******************************************************************************/
+
+// If lower margin is zero, then the next print continues the same image
+bool gbp_decode_printCutsPaper(const uint8_t printInstruction[GBP_PRINT_INSTRUCT_PAYLOAD_SIZE])
+{
+    return (printInstruction[GBP_PRINT_INSTRUCT_INDEX_NUM_OF_LINEFEED] & 0xF) != 0;
+}
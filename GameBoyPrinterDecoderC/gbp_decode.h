@@ -0,0 +1,70 @@
+/*************************************************************************
+ *
+ * Gameboy Printer Input Decoding
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ * Copyright (C) 2020 Brian Khuu
+ *
+ * PURPOSE: This module turns the emulator output (hex text, SLIP frames or raw packets) into prints and tiles
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GBP_DECODE_H
+#define GBP_DECODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+    Shared by gpbdecoder and the WebAssembly build (gbp_wasm.h), so both split the
+    same input into the same prints. Needs gameboy_printer_protocol.h, gbp_pkt.h and gbp_frame.h
+
+    Every input ends up as calls to a gbp_decode_handler_t:
+    * Hex text    : gbp_decode_hexParse() then gbp_pkt_processBuffer_full() with gbp_decode_packetEvent()
+    * SLIP frames : gbp_decode_frameByte(), raw packet frames go to `packet` for the packet parser
+*/
+
+typedef struct
+{
+    void (*packet)(void *userData, const uint8_t *data, const size_t dataSize);                      ///< Raw packet bytes of a frame
+    void (*rasterRow)(void *userData, const uint8_t *row);                                           ///< Row already decoded on the emulator (GBP_OUTPUT_RASTER_ROWS)
+    void (*print)(void *userData, const uint8_t printInstruction[GBP_PRINT_INSTRUCT_PAYLOAD_SIZE]);
+    void (*tile)(void *userData, const uint8_t tile[GBP_TILE_SIZE_IN_BYTE]);                         ///< Tile of a DATA payload, after decompression
+} gbp_decode_handler_t;
+
+/* Hex Text (GBP_OUTPUT_RAW_PACKETS) */
+typedef struct
+{
+    bool skipLine;
+    bool lowNibFound;
+    bool eof; ///< 0xFF char seen, nothing after it is parsed
+    uint8_t byte;
+} gbp_decode_hex_t;
+
+void gbp_decode_hexTableInit(void);
+size_t gbp_decode_hexParse(gbp_decode_hex_t *hex, const uint8_t *in, size_t inSize, uint8_t *out);
+
+/* SLIP Frames (GBP_OUTPUT_BINARY_FRAMES, GBP_OUTPUT_RASTER_ROWS) */
+void gbp_decode_frameByte(gbp_frame_rx_t *rx, const uint8_t b, const gbp_decode_handler_t *handler, void *userData);
+
+/* Packets */
+void gbp_decode_packetEvent(gbp_pkt_t *pkt, uint8_t buffer[], const uint16_t bufferSize, gbp_pkt_tileAcc_t *tileAcc, const gbp_decode_handler_t *handler, void *userData);
+
+/* Prints */
+bool gbp_decode_printCutsPaper(const uint8_t printInstruction[GBP_PRINT_INSTRUCT_PAYLOAD_SIZE]);
+
+#endif
@@ -0,0 +1,328 @@
+/*************************************************************************
+ *
+ * Gameboy Printer Image Output
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ * Copyright (C) 2020 Brian Khuu
+ *
+ * PURPOSE: This module writes decoded print strips out via a pluggable image format backend
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gbp_tiles.h"
+#include "gbp_out.h"
+
+/*******************************************************************************
+ * Raw 2bpp Backend
+*******************************************************************************/
+
+// Scanlines as decoded, so nothing to patch. Only the tones are remapped if the strip has a palette
+static bool gbp_raw_add(gbp_out_t * out, const uint8_t * bmpLineBuffer, const uint16_t sizey, const uint8_t pallet, const uint32_t palletColor[4])
+{
+    (void) palletColor;
+    const size_t packedRowSize = GBP_TILE_2BIT_LINEPACK_ROWSIZE_B(out->width);
+    gbp_out_tonesUpdate(&out->raw, pallet);
+    if (!out->raw.remap)
+        return gbp_out_write(out, bmpLineBuffer, packedRowSize * sizey);
+
+    // Dev Note: Remapped a row of tiles at a time, to keep to one write per strip
+    uint8_t lines[GBP_TILE_PIXEL_HEIGHT * GBP_TILES_ROW_SIZE_B];
+    if (packedRowSize > GBP_TILES_ROW_SIZE_B)
+        return false;
+    for (uint16_t y = 0; y < sizey; y += GBP_TILE_PIXEL_HEIGHT)
+    {
+        const size_t size = packedRowSize * (((sizey - y) < GBP_TILE_PIXEL_HEIGHT) ? (sizey - y) : GBP_TILE_PIXEL_HEIGHT);
+        const uint8_t *packed = &bmpLineBuffer[y * packedRowSize];
+        for (size_t i = 0; i < size; i++)
+        {
+            lines[i] = out->raw.lut[packed[i]];
+        }
+        if (!gbp_out_write(out, lines, size))
+            return false;
+    }
+    return true;
+}
+
+static bool gbp_raw_none(gbp_out_t * out)
+{
+    (void) out;
+    return true;
+}
+
+static const gbp_out_backend_t gbp_raw_backend =
+{
+    "2bpp", "2bpp", false,
+    gbp_raw_none,
+    gbp_raw_add,
+    gbp_raw_none,
+    NULL
+};
+
+/*******************************************************************************
+ * Format
+*******************************************************************************/
+
+const gbp_out_backend_t *gbp_out_backend(const gbp_out_format_t format)
+{
+    switch (format)
+    {
+        case GBP_OUT_FORMAT_BMP     : return &gbp_bmp_backend;
+        case GBP_OUT_FORMAT_PNG     : return &gbp_png_backend;
+        case GBP_OUT_FORMAT_RAW2BPP : return &gbp_raw_backend;
+        default: return NULL;
+    }
+}
+
+bool gbp_out_formatParse(const char *name, gbp_out_format_t *format)
+{
+    if (!name)
+        return false;
+    for (int i = 0; i < GBP_OUT_FORMAT_COUNT; i++)
+    {
+        if (strcmp(name, gbp_out_backend((gbp_out_format_t) i)->name) == 0)
+        {
+            *format = (gbp_out_format_t) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*******************************************************************************
+ * Print Palette
+*******************************************************************************/
+
+// Packed byte (4 tones) to the same byte with the print palette applied, for backends to compose with their own lookup
+// Returns true if the lookup was rebuilt, so anything composed from it has to be rebuilt too
+bool gbp_out_tonesUpdate(gbp_out_tones_t * tones, const uint8_t pallet)
+{
+    if (tones->valid && (tones->pallet == pallet))
+        return false;
+
+    tones->remap = gbp_tiles_harmoniseLut(pallet, tones->lut);
+    if (!tones->remap)
+    {
+        for (int b = 0; b < 256; b++)
+        {
+            tones->lut[b] = (uint8_t) b;
+        }
+    }
+    tones->pallet = pallet;
+    tones->valid = true;
+    return true;
+}
+
+/*******************************************************************************
+ * Write Buffer
+*******************************************************************************/
+
+static bool gbp_out_flush(gbp_out_t * out)
+{
+    if (out->buffCount == 0)
+        return true;
+    if (fwrite(out->buff, 1, out->buffCount, out->f) != out->buffCount)
+        out->error = true;
+    out->flushedCount += out->buffCount;
+    out->buffCount = 0;
+    return !out->error;
+}
+
+bool gbp_out_write(gbp_out_t * out, const void *data, const size_t size)
+{
+    if (!out->hold && (out->buffCount + size > GBP_OUT_WRITE_BUFF_SIZE))
+    {
+        if (!gbp_out_flush(out))
+            return false;
+    }
+
+    if (out->buffCount + size > out->buffSize)
+    {
+        // Held image outgrew the buffer
+        size_t newSize = out->buffSize * 2;
+        while (newSize < out->buffCount + size)
+            newSize *= 2;
+        uint8_t *newBuff = (uint8_t *) realloc(out->buff, newSize);
+        if (!newBuff)
+        {
+            out->error = true;
+            return false;
+        }
+        out->buff = newBuff;
+        out->buffSize = newSize;
+    }
+
+    memcpy(&out->buff[out->buffCount], data, size);
+    out->buffCount += size;
+    return true;
+}
+
+// Overwrite bytes already written to this image (e.g. a header once the image height is known)
+bool gbp_out_patch(gbp_out_t * out, const size_t offset, const void *data, const size_t size)
+{
+    if (offset >= out->flushedCount)
+    {
+        // Still in the buffer
+        if (offset - out->flushedCount + size > out->buffCount)
+            return false;
+        memcpy(&out->buff[offset - out->flushedCount], data, size);
+        return true;
+    }
+
+    // Already in the file, so it must be seekable
+    if (out->hold || !gbp_out_flush(out))
+        return false;
+    if (fseek(out->f, out->fileStart + (long) offset, SEEK_SET) != 0)
+        return false;
+    if (fwrite(data, 1, size, out->f) != size)
+        out->error = true;
+    if (fseek(out->f, 0, SEEK_END) != 0)
+        out->error = true;
+    return !out->error;
+}
+
+/*******************************************************************************
+ * Image
+*******************************************************************************/
+
+bool gbp_out_init(gbp_out_t * out, const gbp_out_format_t format)
+{
+    memset(out, 0, sizeof(*out));
+    out->backend = gbp_out_backend(format);
+    if (!out->backend)
+        return false;
+    out->buff = (uint8_t *) malloc(GBP_OUT_WRITE_BUFF_SIZE);
+    if (!out->buff)
+        return false;
+    out->buffSize = GBP_OUT_WRITE_BUFF_SIZE;
+    return true;
+}
+
+void gbp_out_free(gbp_out_t * out)
+{
+    if (gbp_out_isopen(out))
+        gbp_out_render(out);
+    if (out->backend && out->backend->free)
+        out->backend->free(out);
+    free(out->buff);
+    out->buff = NULL;
+    out->buffSize = 0;
+}
+
+bool gbp_out_isopen(gbp_out_t * out)
+{
+    return (out->f != 0) ? true : false;
+}
+
+bool gbp_out_open(gbp_out_t * out, const char *outputFilename, const uint16_t fixed_width_size)
+{
+    // Open file
+    if (strcmp(outputFilename, GBP_OUT_STDOUT) == 0)
+        return gbp_out_openFile(out, stdout, false, fixed_width_size);
+
+    char filenameBuff[400] = {0};
+    snprintf(filenameBuff, sizeof(filenameBuff), "%s%X.%s", outputFilename, out->fileCounter, out->backend->ext);
+    FILE *f = fopen(filenameBuff, "wb");
+    if (!f)
+    {
+        out->fileCounter++;
+        return false;
+    }
+    return gbp_out_openFile(out, f, true, fixed_width_size);
+}
+
+bool gbp_out_openFile(gbp_out_t * out, FILE *f, const bool closeFile, const uint16_t fixed_width_size)
+{
+    if (gbp_out_isopen(out))
+        gbp_out_render(out);
+
+    out->f = f;
+    out->closeFile = closeFile;
+    out->fileCounter++;
+
+    // Headers can only be patched in place if the output is seekable (Not a pipe)
+    out->fileStart = ftell(out->f);
+    out->hold = out->backend->patchesHeader && ((out->fileStart < 0) || (fseek(out->f, out->fileStart, SEEK_SET) != 0));
+
+    // Update
+    out->buffCount = 0;
+    out->flushedCount = 0;
+    out->error = false;
+    out->width  = fixed_width_size;
+    out->height = 0;
+    return out->backend->begin(out);
+}
+
+// Strip that already has the tones of its print
+bool gbp_out_add(gbp_out_t * out, const uint8_t *packedLines, const uint16_t sizex, const uint16_t sizey, const uint32_t palletColor[4])
+{
+    return gbp_out_addTones(out, packedLines, sizex, sizey, GBP_OUT_PALLET_NONE, palletColor);
+}
+
+// Strip as decoded, with the print palette (e.g. gbp_tile_t.rowPallet or from gbp_tiles_stream_get()) applied as it is converted
+bool gbp_out_addTones(gbp_out_t * out, const uint8_t *packedLines, const uint16_t sizex, const uint16_t sizey, const uint8_t pallet, const uint32_t palletColor[4])
+{
+    // Fixed width
+    if (!gbp_out_isopen(out) || (sizex != out->width))
+        return false;
+    if (!out->backend->add(out, packedLines, sizey, pallet, palletColor))
+    {
+        out->error = true;
+        return false;
+    }
+    out->height += sizey;
+    return true;
+}
+
+// Blank paper (tone 0) lines, e.g. the margins of a print. Nothing to decode, so the same zero strip is added over and over
+bool gbp_out_addBlank(gbp_out_t * out, const uint16_t sizex, const uint32_t sizey, const uint32_t palletColor[4])
+{
+    static const uint8_t blank[GBP_TILE_PIXEL_HEIGHT * GBP_TILES_ROW_SIZE_B] = {0};
+    if (GBP_TILE_2BIT_LINEPACK_ROWSIZE_B(sizex) > GBP_TILES_ROW_SIZE_B)
+        return false;
+
+    for (uint32_t y = 0; y < sizey; y += GBP_TILE_PIXEL_HEIGHT)
+    {
+        const uint16_t lines = (sizey - y < GBP_TILE_PIXEL_HEIGHT) ? (uint16_t) (sizey - y) : GBP_TILE_PIXEL_HEIGHT;
+        if (!gbp_out_add(out, blank, sizex, lines, palletColor))
+            return false;
+    }
+    return true;
+}
+
+bool gbp_out_render(gbp_out_t * out)
+{
+    if (!gbp_out_isopen(out))
+        return false;
+
+    if (!out->backend->end(out))
+        out->error = true;
+    gbp_out_flush(out);
+
+    // Close File
+    if (out->closeFile)
+        fclose(out->f);
+    else
+        fflush(out->f);
+    out->f = 0;
+    return !out->error;
+}
@@ -0,0 +1,128 @@
+/*************************************************************************
+ *
+ * Gameboy Printer Image Output
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ * Copyright (C) 2020 Brian Khuu
+ *
+ * PURPOSE: This module writes decoded print strips out via a pluggable image format backend
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GBP_OUT_H
+#define GBP_OUT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+    Each image is written through one large buffer instead of one write per strip.
+
+    Formats with the image height in the header (bmp, png) write a placeholder
+    header first and patch it once the image is finished. On a seekable file the
+    buffer is flushed whenever it fills up and the header is patched in place.
+    On a pipe (e.g. stdout) the whole image is held in the buffer until it is finished.
+*/
+
+#define GBP_OUT_WRITE_BUFF_SIZE (256 * 1024) ///< Flush threshold of the write buffer
+#define GBP_OUT_STDOUT          "-"          ///< Output filename for stdout
+#define GBP_OUT_PALLET_NONE     0xE4         ///< Print palette that leaves every tone as is
+
+typedef enum
+{
+    GBP_OUT_FORMAT_BMP = 0, ///< 24bit BMP (Pallet applied)
+    GBP_OUT_FORMAT_PNG,     ///< 2bit indexed PNG (Pallet in PLTE)
+    GBP_OUT_FORMAT_RAW2BPP, ///< Packed 2bit tones as per gbp_tile_t, GBP_TILES_ROW_SIZE_B bytes per scanline
+    GBP_OUT_FORMAT_COUNT
+} gbp_out_format_t;
+
+typedef struct gbp_out_s gbp_out_t;
+
+// Image format backend. Strips are packed 2bit scanlines as in gbp_tile_t.bmpLineBuffer, with the
+// print palette of the strip still to be applied to their tones (See gbp_out_tones_t)
+typedef struct
+{
+    const char *name; ///< Format name on the command line
+    const char *ext;  ///< Output filename extension
+    bool patchesHeader; ///< Header is only complete once the image height is known (See gbp_out_patch())
+    bool (*begin)(gbp_out_t *out);
+    bool (*add)(gbp_out_t *out, const uint8_t *packedLines, const uint16_t lineCount, const uint8_t pallet, const uint32_t palletColor[4]);
+    bool (*end)(gbp_out_t *out);
+    void (*free)(gbp_out_t *out); ///< Optional
+} gbp_out_backend_t;
+
+// Print palette of a strip as a packed byte lookup (See gbp_tiles_harmoniseLut()), kept until the palette changes
+typedef struct
+{
+    bool valid;
+    bool remap;     ///< False if every tone maps to itself
+    uint8_t pallet;
+    uint8_t lut[256];
+} gbp_out_tones_t;
+
+#include "gbp_bmp.h"
+#include "gbp_png.h"
+
+struct gbp_out_s
+{
+    const gbp_out_backend_t *backend;
+    FILE *f;
+    bool closeFile; ///< False for stdout
+    int fileCounter;
+    uint16_t width;  ///< Pixels per scanline
+    uint32_t height; ///< Scanlines so far
+
+    // Write Buffer
+    uint8_t *buff;
+    size_t buffCount;
+    size_t buffSize;
+    size_t flushedCount; ///< Bytes of this image already written to file
+    long fileStart;      ///< File position of this image
+    bool hold;           ///< Output is not seekable, so the image is held until it is finished
+    bool error;
+
+    // Backend State
+    gbp_out_tones_t raw; ///< Raw 2bpp tone lookup
+    gbp_bmp_t bmp;
+    gbp_png_t png;
+};
+
+extern const gbp_out_backend_t gbp_bmp_backend;
+extern const gbp_out_backend_t gbp_png_backend;
+
+/* Format */
+const gbp_out_backend_t *gbp_out_backend(const gbp_out_format_t format);
+bool gbp_out_formatParse(const char *name, gbp_out_format_t *format);
+
+/* Image */
+bool gbp_out_init(gbp_out_t *out, const gbp_out_format_t format);
+void gbp_out_free(gbp_out_t *out);
+bool gbp_out_isopen(gbp_out_t *out);
+bool gbp_out_open(gbp_out_t *out, const char *outputFilename, const uint16_t fixed_width_size);
+bool gbp_out_openFile(gbp_out_t *out, FILE *f, const bool closeFile, const uint16_t fixed_width_size);
+bool gbp_out_add(gbp_out_t *out, const uint8_t *packedLines, const uint16_t sizex, const uint16_t sizey, const uint32_t palletColor[4]);
+bool gbp_out_addTones(gbp_out_t *out, const uint8_t *packedLines, const uint16_t sizex, const uint16_t sizey, const uint8_t pallet, const uint32_t palletColor[4]);
+bool gbp_out_addBlank(gbp_out_t *out, const uint16_t sizex, const uint32_t sizey, const uint32_t palletColor[4]);
+bool gbp_out_render(gbp_out_t *out);
+
+/* Backend Helpers */
+bool gbp_out_tonesUpdate(gbp_out_tones_t *tones, const uint8_t pallet);
+bool gbp_out_write(gbp_out_t *out, const void *data, const size_t size);
+bool gbp_out_patch(gbp_out_t *out, const size_t offset, const void *data, const size_t size);
+
+#endif
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+
+#include "gbp_tiles.h"
+#include "gbp_out.h"
+
+/*
+    Indexed 2bit PNG (Color type 3, bit depth 2)
+    [SIGNATURE][IHDR][PLTE][IDAT]...[IDAT][IEND]
+    IHDR and PLTE have a fixed size, so they are written as placeholders and patched once the image height and pallet are final.
+*/
+
+#define GBP_PNG_SIGNATURE_SIZE 8
+#define GBP_PNG_CHUNK_OVERHEAD 12 ///< [LENGTH:4][TYPE:4][DATA][CRC:4]
+#define GBP_PNG_IHDR_SIZE      13
+#define GBP_PNG_PLTE_SIZE      (4 * 3)
+#define GBP_PNG_IHDR_OFFSET    GBP_PNG_SIGNATURE_SIZE
+#define GBP_PNG_PLTE_OFFSET    (GBP_PNG_IHDR_OFFSET + GBP_PNG_CHUNK_OVERHEAD + GBP_PNG_IHDR_SIZE)
+#define GBP_PNG_HEADER_SIZE    (GBP_PNG_PLTE_OFFSET + GBP_PNG_CHUNK_OVERHEAD + GBP_PNG_PLTE_SIZE)
+
+/*
+    Pixel order lookup
+    gbp_tile_t packs the leftmost pixel in the lowest bits of a byte, PNG wants it in the highest bits.
+    Built at compile time, so jobs writing images in parallel (-B -j) only ever read it.
+*/
+#define GBP_PNG_ORDER2(N) (N), (N) + 0x40, (N) + 0x80, (N) + 0xC0 ///< Leftmost pixel to the highest bits
+#define GBP_PNG_ORDER4(N) GBP_PNG_ORDER2(N), GBP_PNG_ORDER2((N) + 0x10), GBP_PNG_ORDER2((N) + 0x20), GBP_PNG_ORDER2((N) + 0x30)
+#define GBP_PNG_ORDER6(N) GBP_PNG_ORDER4(N), GBP_PNG_ORDER4((N) + 0x04), GBP_PNG_ORDER4((N) + 0x08), GBP_PNG_ORDER4((N) + 0x0C)
+static const uint8_t gbp_png_pixelOrderLut[256] = {
+    GBP_PNG_ORDER6(0x00), GBP_PNG_ORDER6(0x01), GBP_PNG_ORDER6(0x02), GBP_PNG_ORDER6(0x03)
+};
+
+static void gbp_png_put32(uint8_t *buf, const uint32_t val)
+{
+    buf[0] = (uint8_t)(val >> 24);
+    buf[1] = (uint8_t)(val >> 16);
+    buf[2] = (uint8_t)(val >>  8);
+    buf[3] = (uint8_t)(val >>  0);
+}
+
+// Build a whole chunk in `chunk[]` which must hold `size + GBP_PNG_CHUNK_OVERHEAD` bytes
+static size_t gbp_png_chunk(uint8_t *chunk, const char type[4], const uint8_t *data, const uint32_t size)
+{
+    gbp_png_put32(&chunk[0], size);
+    memcpy(&chunk[4], type, 4);
+    if (size > 0)
+        memcpy(&chunk[8], data, size);
+    gbp_png_put32(&chunk[8 + size], (uint32_t) crc32(0, &chunk[4], 4 + size));
+    return size + GBP_PNG_CHUNK_OVERHEAD;
+}
+
+// Unlike the header, IDAT is never patched, so the chunk framing is written around the data in place
+static bool gbp_png_writeIdat(gbp_out_t * out, const uint8_t *data, const uint32_t size)
+{
+    uint8_t head[8];
+    uint8_t tail[4];
+    gbp_png_put32(&head[0], size);
+    memcpy(&head[4], "IDAT", 4);
+    gbp_png_put32(&tail[0], (uint32_t) crc32(crc32(0, &head[4], 4), data, size));
+    return gbp_out_write(out, head, sizeof(head)) && gbp_out_write(out, data, size) && gbp_out_write(out, tail, sizeof(tail));
+}
+
+// Feed scanlines to deflate, each full output buffer becomes one IDAT chunk
+static bool gbp_png_deflate(gbp_out_t * out, const uint8_t *data, const size_t size, const int flush)
+{
+    gbp_png_t * png = &out->png;
+    png->zs.next_in = (Bytef *) data;
+    png->zs.avail_in = (uInt) size;
+    while (1)
+    {
+        const int ret = deflate(&png->zs, flush);
+        if ((ret != Z_OK) && (ret != Z_STREAM_END) && (ret != Z_BUF_ERROR))
+            return false;
+        if ((png->zs.avail_out == 0) || ((flush == Z_FINISH) && (png->zs.avail_out != sizeof(png->zbuff))))
+        {
+            if (!gbp_png_writeIdat(out, png->zbuff, sizeof(png->zbuff) - png->zs.avail_out))
+                return false;
+            png->zs.next_out = png->zbuff;
+            png->zs.avail_out = sizeof(png->zbuff);
+        }
+        if (flush == Z_FINISH)
+        {
+            if (ret == Z_STREAM_END)
+                return true;
+        }
+        else if (png->zs.avail_in == 0)
+        {
+            return true;
+        }
+    }
+}
+
+static bool gbp_png_begin(gbp_out_t * out)
+{
+    gbp_png_t * png = &out->png;
+    if ((size_t) GBP_TILE_2BIT_LINEPACK_ROWSIZE_B(out->width) + 1 > sizeof(png->line))
+        return false;
+
+    if (!png->zsInit)
+    {
+        memset(&png->zs, 0, sizeof(png->zs));
+        if (deflateInit(&png->zs, Z_BEST_COMPRESSION) != Z_OK)
+            return false;
+        png->zsInit = true;
+    }
+    else if (deflateReset(&png->zs) != Z_OK)
+    {
+        return false;
+    }
+    png->zs.next_out = png->zbuff;
+    png->zs.avail_out = sizeof(png->zbuff);
+
+    // IHDR and PLTE are written once the image height is known
+    static const uint8_t signature[GBP_PNG_SIGNATURE_SIZE] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    uint8_t header[GBP_PNG_HEADER_SIZE] = {0};
+    memcpy(header, signature, sizeof(signature));
+    return gbp_out_write(out, header, sizeof(header));
+}
+
+static bool gbp_png_add(gbp_out_t * out, const uint8_t * bmpLineBuffer, const uint16_t sizey, const uint8_t pallet, const uint32_t palletColor[4])
+{
+    gbp_png_t * png = &out->png;
+    const uint16_t packedRowSize = GBP_TILE_2BIT_LINEPACK_ROWSIZE_B(out->width);
+    memcpy(png->pallet, palletColor, sizeof(png->pallet));
+    if (gbp_out_tonesUpdate(&png->tones, pallet))
+    {
+        for (int b = 0; b < 256; b++)
+        {
+            png->orderLut[b] = gbp_png_pixelOrderLut[png->tones.lut[b]];
+        }
+    }
+    for (uint16_t y = 0; y < sizey; y++)
+    {
+        // Filter type 0 (None) followed by the scanline in PNG pixel order
+        const uint8_t *packed = &bmpLineBuffer[y * packedRowSize];
+        png->line[0] = 0;
+        for (uint16_t i = 0; i < packedRowSize; i++)
+        {
+            png->line[1 + i] = png->orderLut[packed[i]];
+        }
+        if (!gbp_png_deflate(out, png->line, 1 + packedRowSize, Z_NO_FLUSH))
+            return false;
+    }
+    return true;
+}
+
+static bool gbp_png_end(gbp_out_t * out)
+{
+    gbp_png_t * png = &out->png;
+    if (!gbp_png_deflate(out, NULL, 0, Z_FINISH))
+        return false;
+
+    uint8_t chunk[GBP_PNG_CHUNK_OVERHEAD + GBP_PNG_IHDR_SIZE];
+    if (!gbp_out_write(out, chunk, gbp_png_chunk(chunk, "IEND", NULL, 0)))
+        return false;
+
+    // Patch in IHDR with the now known image size
+    uint8_t ihdr[GBP_PNG_IHDR_SIZE];
+    gbp_png_put32(&ihdr[0], out->width);
+    gbp_png_put32(&ihdr[4], out->height);
+    ihdr[8]  = 2; ///< Bit depth
+    ihdr[9]  = 3; ///< Color type (Indexed)
+    ihdr[10] = 0; ///< Compression (Deflate)
+    ihdr[11] = 0; ///< Filter (Adaptive)
+    ihdr[12] = 0; ///< Interlace (None)
+    if (!gbp_out_patch(out, GBP_PNG_IHDR_OFFSET, chunk, gbp_png_chunk(chunk, "IHDR", ihdr, sizeof(ihdr))))
+        return false;
+
+    // Patch in PLTE with the pallet (Encoded as 0xRRGGBB, same as BMP)
+    uint8_t plte[GBP_PNG_PLTE_SIZE];
+    for (int i = 0; i < 4; i++)
+    {
+        plte[i * 3 + 0] = (uint8_t)(png->pallet[i] >> 16);
+        plte[i * 3 + 1] = (uint8_t)(png->pallet[i] >>  8);
+        plte[i * 3 + 2] = (uint8_t)(png->pallet[i] >>  0);
+    }
+    return gbp_out_patch(out, GBP_PNG_PLTE_OFFSET, chunk, gbp_png_chunk(chunk, "PLTE", plte, sizeof(plte)));
+}
+
+static void gbp_png_free(gbp_out_t * out)
+{
+    if (out->png.zsInit)
+    {
+        deflateEnd(&out->png.zs);
+        out->png.zsInit = false;
+    }
+}
+
+const gbp_out_backend_t gbp_png_backend =
+{
+    "png", "png", true,
+    gbp_png_begin,
+    gbp_png_add,
+    gbp_png_end,
+    gbp_png_free
+};
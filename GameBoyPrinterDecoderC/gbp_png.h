@@ -0,0 +1,26 @@
+#ifndef GBP_PNG_H
+#define GBP_PNG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <zlib.h>
+
+
+// Image Rendering
+#define GBP_PNG_ZBUFF_SIZE (64 * 1024) ///< Deflate output per IDAT chunk
+#define GBP_PNG_LINE_MAX_SIZE (1 + GBP_TILE_2BIT_LINEPACK_ROWSIZE_B(GBP_TILE_PIXEL_WIDTH * GBP_TILES_PER_LINE)) ///< Filter byte + packed scanline
+
+// PNG backend state (See gbp_png_backend in gbp_out.h)
+// Scanlines are deflated as they arrive, only IHDR and PLTE are patched at the end
+typedef struct
+{
+    z_stream zs;
+    bool zsInit;
+    uint32_t pallet[4]; ///< Last pallet used, written to PLTE
+    gbp_out_tones_t tones;
+    uint8_t orderLut[256]; ///< Print palette of the strip composed with gbp_png_pixelOrderLut
+    uint8_t line[GBP_PNG_LINE_MAX_SIZE];
+    uint8_t zbuff[GBP_PNG_ZBUFF_SIZE];
+} gbp_png_t;
+
+#endif
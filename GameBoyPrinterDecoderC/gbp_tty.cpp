@@ -0,0 +1,208 @@
+/*************************************************************************
+ *
+ * Gameboy Printer Serial Port Input
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ * Copyright (C) 2020 Brian Khuu
+ *
+ * PURPOSE: This module reads the emulator serial port directly (raw mode, non blocking), so prints are decoded while they arrive
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "gbp_tty.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GBP_TTY_USE_TERMIOS
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+#ifdef GBP_TTY_USE_TERMIOS
+typedef struct
+{
+    uint32_t baud;
+    speed_t speed;
+} gbp_tty_speed_t;
+
+static const gbp_tty_speed_t gbp_tty_speeds[] =
+{
+    {9600,    B9600},
+    {19200,   B19200},
+    {38400,   B38400},
+    {57600,   B57600},
+    {115200,  B115200},
+    {230400,  B230400},
+#ifdef B460800
+    {460800,  B460800},
+#endif
+#ifdef B500000
+    {500000,  B500000},
+#endif
+#ifdef B921600
+    {921600,  B921600},
+#endif
+#ifdef B1000000
+    {1000000, B1000000},
+#endif
+#ifdef B2000000
+    {2000000, B2000000},
+#endif
+};
+
+static bool gbp_tty_speed(const uint32_t baud, speed_t *speed)
+{
+    for (size_t i = 0; i < sizeof(gbp_tty_speeds) / sizeof(gbp_tty_speeds[0]); i++)
+    {
+        if (gbp_tty_speeds[i].baud == baud)
+        {
+            *speed = gbp_tty_speeds[i].speed;
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
+bool gbp_tty_supported(void)
+{
+#ifdef GBP_TTY_USE_TERMIOS
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool gbp_tty_baudSupported(const uint32_t baud)
+{
+#ifdef GBP_TTY_USE_TERMIOS
+    speed_t speed;
+    return gbp_tty_speed(baud, &speed);
+#else
+    (void)baud;
+    return false;
+#endif
+}
+
+void gbp_tty_init(gbp_tty_t *tty)
+{
+    tty->fd    = -1;
+    tty->opens = 0;
+    tty->bytes = 0;
+}
+
+bool gbp_tty_isopen(const gbp_tty_t *tty)
+{
+    return tty->fd >= 0;
+}
+
+bool gbp_tty_open(gbp_tty_t *tty, const char *path, const uint32_t baud)
+{
+#ifdef GBP_TTY_USE_TERMIOS
+    speed_t speed;
+    if (gbp_tty_isopen(tty) || !gbp_tty_speed(baud, &speed))
+        return false;
+
+    // Dev Note: O_NONBLOCK so a port without carrier detect does not hang the open
+    const int fd = open(path, O_RDONLY | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0)
+        return false;
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0)
+    {
+        const int err = errno;
+        close(fd);
+        errno = err;
+        return false;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN]  = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(fd, TCSANOW, &tio) != 0)
+    {
+        const int err = errno;
+        close(fd);
+        errno = err;
+        return false;
+    }
+
+    tty->fd = fd;
+    tty->opens++;
+    return true;
+#else
+    (void)tty;
+    (void)path;
+    (void)baud;
+    return false;
+#endif
+}
+
+long gbp_tty_read(gbp_tty_t *tty, uint8_t *buff, const size_t buffSize, const int timeoutMs)
+{
+#ifdef GBP_TTY_USE_TERMIOS
+    if (!gbp_tty_isopen(tty))
+        return -1;
+
+    struct pollfd pfd = {tty->fd, POLLIN, 0};
+    const int ready = poll(&pfd, 1, timeoutMs);
+    if (ready < 0)
+    {
+        if (errno == EINTR)
+            return 0;
+        gbp_tty_close(tty);
+        return -1;
+    }
+    if (ready == 0)
+        return 0;
+
+    const ssize_t n = read(tty->fd, buff, buffSize);
+    if (n > 0)
+    {
+        tty->bytes += n;
+        return n;
+    }
+    if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)))
+        return 0;
+
+    // Readable without data (n == 0) or an error (e.g. EIO) is a port that went away
+    gbp_tty_close(tty);
+    return -1;
+#else
+    (void)tty;
+    (void)buff;
+    (void)buffSize;
+    (void)timeoutMs;
+    return -1;
+#endif
+}
+
+void gbp_tty_close(gbp_tty_t *tty)
+{
+#ifdef GBP_TTY_USE_TERMIOS
+    if (gbp_tty_isopen(tty))
+        close(tty->fd);
+#endif
+    tty->fd = -1;
+}
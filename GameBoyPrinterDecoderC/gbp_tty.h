@@ -0,0 +1,63 @@
+/*************************************************************************
+ *
+ * Gameboy Printer Serial Port Input
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ * Copyright (C) 2020 Brian Khuu
+ *
+ * PURPOSE: This module reads the emulator serial port directly (raw mode, non blocking), so prints are decoded while they arrive
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GBP_TTY_H
+#define GBP_TTY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+    Serial port (tty) input, e.g. /dev/ttyUSB0 of the emulator. POSIX only (termios).
+
+    The port is set to raw mode (no line editing, echo or character translation) at the
+    requested baud rate and read without blocking, so each read returns whatever has
+    arrived so far (up to the buffer size) as soon as it arrives.
+
+    `gbp_tty_read()` reports a port that went away (e.g. USB serial reset or unplugged)
+    so the caller can close it and open it again once the device is back.
+    When `gbp_tty_open()` fails errno is kept, so ENOTTY tells a path that is not a serial port
+    apart from one that is not there yet.
+*/
+
+#define GBP_TTY_DEFAULT_BAUD 115200 ///< Serial.begin() of GameBoyPrinterEmulator.ino
+
+typedef struct
+{
+    int fd;         ///< -1 if closed
+    uint32_t opens; ///< Times the port was opened (Reconnects are opens - 1)
+    uint64_t bytes; ///< Bytes read over all opens
+} gbp_tty_t;
+
+bool gbp_tty_supported(void);
+bool gbp_tty_baudSupported(const uint32_t baud);
+void gbp_tty_init(gbp_tty_t *tty);
+bool gbp_tty_open(gbp_tty_t *tty, const char *path, const uint32_t baud);
+bool gbp_tty_isopen(const gbp_tty_t *tty);
+// Returns bytes read, 0 if nothing arrived within timeoutMs (or on a signal), -1 if the port went away (It is then closed)
+long gbp_tty_read(gbp_tty_t *tty, uint8_t *buff, const size_t buffSize, const int timeoutMs);
+void gbp_tty_close(gbp_tty_t *tty);
+
+#endif
@@ -0,0 +1,289 @@
+/*************************************************************************
+ *
+ * Gameboy Printer WebAssembly Decoder
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ * Copyright (C) 2020 Brian Khuu
+ *
+ * PURPOSE: This module exposes the decoder core (gbp_pkt, gbp_tiles) as a flat C API for a WebAssembly build
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gameboy_printer_protocol.h"
+#include "gbp_pkt.h"
+#include "gbp_tiles.h"
+#include "gbp_frame.h"
+#include "gbp_decode.h"
+#include "gbp_wasm.h"
+
+#define GBP_WASM_ROW_SIZE_B (GBP_TILE_PIXEL_HEIGHT * GBP_TILES_ROW_SIZE_B) ///< One row of packed 2bit tones
+
+typedef struct
+{
+    uint32_t rowFirst;
+    uint32_t rowCount;
+    bool done;
+} gbp_wasm_image_t;
+
+typedef struct
+{
+    gbp_pkt_t pkt;
+    uint8_t pktBuff[GBP_PKT_FULL_PAYLOAD_BUFF_SIZE_IN_BYTE];
+    uint16_t pktBuffSize;
+    gbp_pkt_tileAcc_t tileAcc;
+    gbp_tiles_rowRing_t rowRing; ///< Tiles into rows
+    gbp_frame_rx_t frameRx;
+
+    gbp_decode_hex_t hex;
+
+    uint32_t pallet[GBP_TILE_MAX_TONES]; ///< 0xRRGGBB
+
+    // Every row so far, as packed 2bit tones before their print palette
+    uint8_t *rows;
+    size_t rowCount;
+    size_t rowSize;
+    uint8_t *rowPallet; ///< Print palette of each row, applied in gbp_wasm_rgba()
+    size_t rowPalletSize;
+    size_t rowPrinted;  ///< Rows before this one have had their print (Rows after it are not in an image yet)
+
+    gbp_wasm_image_t *image;
+    size_t imageCount;
+    size_t imageSize;
+    bool imageOpen; ///< Last image still gets rows
+
+    uint8_t *rgba;
+    size_t rgbaSize;
+    bool error; ///< Out of memory
+} gbp_wasm_t;
+
+static gbp_wasm_t gbp_wasm;
+static uint8_t gbp_wasm_inputBuff[GBP_WASM_INPUT_SIZE];
+
+// Grow `*buff` to hold at least `count` items, doubling so appending stays cheap
+static bool gbp_wasm_reserve(void **buff, size_t *size, const size_t count, const size_t itemSize)
+{
+    if (count <= *size)
+        return true;
+    size_t newSize = (*size > 0) ? *size : 16;
+    while (newSize < count)
+        newSize *= 2;
+    void *newBuff = realloc(*buff, newSize * itemSize);
+    if (!newBuff)
+    {
+        gbp_wasm.error = true;
+        return false;
+    }
+    *buff = newBuff;
+    *size = newSize;
+    return true;
+}
+
+// Row waits after the last print for its own, so it is not in an image yet
+static void gbp_wasm_addRow(const uint8_t *row)
+{
+    if (!gbp_wasm_reserve((void **) &gbp_wasm.rows, &gbp_wasm.rowSize, gbp_wasm.rowCount + 1, GBP_WASM_ROW_SIZE_B))
+        return;
+    if (!gbp_wasm_reserve((void **) &gbp_wasm.rowPallet, &gbp_wasm.rowPalletSize, gbp_wasm.rowCount + 1, 1))
+        return;
+    memcpy(&gbp_wasm.rows[gbp_wasm.rowCount * GBP_WASM_ROW_SIZE_B], row, GBP_WASM_ROW_SIZE_B);
+    gbp_wasm.rowCount++;
+}
+
+// Every row since the last print gets the palette of this one, and is moved into the current image
+// Dev Note: Every row is kept anyway, so unlike `gpbdecoder -s` no row is ever given a predicted palette
+static void gbp_wasm_gotPrint(void *userData, const uint8_t printInstruction[GBP_PRINT_INSTRUCT_PAYLOAD_SIZE])
+{
+    (void)userData;
+    if (gbp_wasm.rowPrinted < gbp_wasm.rowCount)
+    {
+        if (!gbp_wasm.imageOpen)
+        {
+            if (!gbp_wasm_reserve((void **) &gbp_wasm.image, &gbp_wasm.imageSize, gbp_wasm.imageCount + 1, sizeof(gbp_wasm_image_t)))
+                return;
+            gbp_wasm_image_t *image = &gbp_wasm.image[gbp_wasm.imageCount++];
+            image->rowFirst = (uint32_t) gbp_wasm.rowPrinted;
+            image->rowCount = 0;
+            image->done = false;
+            gbp_wasm.imageOpen = true;
+        }
+        memset(&gbp_wasm.rowPallet[gbp_wasm.rowPrinted], printInstruction[GBP_PRINT_INSTRUCT_INDEX_PALETTE_VALUE], gbp_wasm.rowCount - gbp_wasm.rowPrinted);
+        gbp_wasm.image[gbp_wasm.imageCount - 1].rowCount += (uint32_t) (gbp_wasm.rowCount - gbp_wasm.rowPrinted);
+        gbp_wasm.rowPrinted = gbp_wasm.rowCount;
+    }
+
+    if (gbp_decode_printCutsPaper(printInstruction) && gbp_wasm.imageOpen)
+    {
+        gbp_wasm.image[gbp_wasm.imageCount - 1].done = true;
+        gbp_wasm.imageOpen = false;
+    }
+}
+
+static void gbp_wasm_gotRasterRow(void *userData, const uint8_t *row)
+{
+    (void)userData;
+    gbp_wasm_addRow(row);
+}
+
+static void gbp_wasm_gotTile(void *userData, const uint8_t tile[GBP_TILE_SIZE_IN_BYTE])
+{
+    (void)userData;
+    if (!gbp_tiles_rowRing_decoder(&gbp_wasm.rowRing, tile))
+        return;
+    gbp_wasm_addRow(gbp_tiles_rowRing_get(&gbp_wasm.rowRing, NULL));
+    gbp_tiles_rowRing_release(&gbp_wasm.rowRing);
+}
+
+static void gbp_wasm_gotBuffer(void *userData, const uint8_t *data, const size_t dataSize);
+
+// Same handling as gpbdecoder (See gbp_decode.h)
+static const gbp_decode_handler_t gbp_wasm_handler = {
+    gbp_wasm_gotBuffer,
+    gbp_wasm_gotRasterRow,
+    gbp_wasm_gotPrint,
+    gbp_wasm_gotTile,
+};
+
+static void gbp_wasm_gotPacketEvent(gbp_pkt_t *_pkt, uint8_t buffer[], const uint16_t bufferSize, void *userData)
+{
+    gbp_decode_packetEvent(_pkt, buffer, bufferSize, &gbp_wasm.tileAcc, &gbp_wasm_handler, userData);
+}
+
+static void gbp_wasm_gotBuffer(void *userData, const uint8_t *data, const size_t dataSize)
+{
+    gbp_pkt_processBuffer_full(&gbp_wasm.pkt, data, dataSize, gbp_wasm.pktBuff, &gbp_wasm.pktBuffSize, gbp_wasm_gotPacketEvent, userData);
+}
+
+/*****************************************************************************/
+
+bool gbp_wasm_init(void)
+{
+    free(gbp_wasm.rows);
+    free(gbp_wasm.rowPallet);
+    free(gbp_wasm.image);
+    free(gbp_wasm.rgba);
+    memset(&gbp_wasm, 0, sizeof(gbp_wasm));
+
+    gbp_decode_hexTableInit();
+    gbp_pkt_init(&gbp_wasm.pkt);
+    gbp_tiles_rowRing_reset(&gbp_wasm.rowRing);
+    gbp_frame_rx_reset(&gbp_wasm.frameRx);
+    gbp_wasm_setPallet(0xFFFFFF, 0xAAAAAA, 0x555555, 0x000000);
+    return true;
+}
+
+uint8_t *gbp_wasm_input(void)
+{
+    return gbp_wasm_inputBuff;
+}
+
+size_t gbp_wasm_inputSize(void)
+{
+    return sizeof(gbp_wasm_inputBuff);
+}
+
+// Decode `size` bytes from gbp_wasm_input(). Returns false if out of memory.
+bool gbp_wasm_write(const size_t size, const int inputType)
+{
+    const size_t inSize = (size < sizeof(gbp_wasm_inputBuff)) ? size : sizeof(gbp_wasm_inputBuff);
+    switch (inputType)
+    {
+        case GBP_WASM_INPUT_HEX:
+            gbp_wasm_gotBuffer(NULL, gbp_wasm_inputBuff, gbp_decode_hexParse(&gbp_wasm.hex, gbp_wasm_inputBuff, inSize, gbp_wasm_inputBuff));
+            break;
+        case GBP_WASM_INPUT_FRAMES:
+            for (size_t i = 0; i < inSize; i++)
+                gbp_decode_frameByte(&gbp_wasm.frameRx, gbp_wasm_inputBuff[i], &gbp_wasm_handler, NULL);
+            break;
+        case GBP_WASM_INPUT_PACKETS:
+            gbp_wasm_gotBuffer(NULL, gbp_wasm_inputBuff, inSize);
+            break;
+        default:
+            break;
+    }
+    return !gbp_wasm.error;
+}
+
+// Colors of each tone as 0xRRGGBB. Only used by gbp_wasm_rgba(), so it can be changed at any time.
+void gbp_wasm_setPallet(const uint32_t color0, const uint32_t color1, const uint32_t color2, const uint32_t color3)
+{
+    gbp_wasm.pallet[0] = color0;
+    gbp_wasm.pallet[1] = color1;
+    gbp_wasm.pallet[2] = color2;
+    gbp_wasm.pallet[3] = color3;
+}
+
+uint32_t gbp_wasm_imageCount(void)
+{
+    return (uint32_t) gbp_wasm.imageCount;
+}
+
+uint32_t gbp_wasm_imageRows(const uint32_t image)
+{
+    return (image < gbp_wasm.imageCount) ? gbp_wasm.image[image].rowCount : 0;
+}
+
+// Image was cut, no more rows will be added to it
+bool gbp_wasm_imageDone(const uint32_t image)
+{
+    return (image < gbp_wasm.imageCount) ? gbp_wasm.image[image].done : false;
+}
+
+// Render rows of an image into the shared RGBA buffer, GBP_WASM_RGBA_ROW_SIZE bytes per row.
+// Returns NULL if the rows do not exist (yet).
+const uint8_t *gbp_wasm_rgba(const uint32_t image, const uint32_t rowFirst, const uint32_t rowCount)
+{
+    if ((image >= gbp_wasm.imageCount) || (rowCount == 0))
+        return NULL;
+    const gbp_wasm_image_t *img = &gbp_wasm.image[image];
+    if ((rowFirst >= img->rowCount) || (rowCount > (img->rowCount - rowFirst)))
+        return NULL;
+    if (!gbp_wasm_reserve((void **) &gbp_wasm.rgba, &gbp_wasm.rgbaSize, rowCount, GBP_WASM_RGBA_ROW_SIZE))
+        return NULL;
+
+    // Each packed byte is 4 pixels, leftmost pixel in the lowest bits
+    const uint8_t *in = &gbp_wasm.rows[(img->rowFirst + rowFirst) * GBP_WASM_ROW_SIZE_B];
+    uint8_t *out = gbp_wasm.rgba;
+    for (size_t r = 0; r < rowCount; r++)
+    {
+        // Print palette of the row picks the color of each decoded tone (Palette 0x00 is the same as 0xE4)
+        uint8_t rowPallet = gbp_wasm.rowPallet[img->rowFirst + rowFirst + r];
+        rowPallet = (rowPallet == 0x00) ? 0xE4 : rowPallet;
+        uint32_t color[GBP_TILE_MAX_TONES];
+        for (int t = 0; t < GBP_TILE_MAX_TONES; t++)
+            color[t] = gbp_wasm.pallet[(rowPallet >> (t * 2)) & 0b11];
+
+        for (size_t i = 0; i < GBP_WASM_ROW_SIZE_B; i++)
+        {
+            const uint8_t packed = *in++;
+            for (int p = 0; p < GBP_TILE_2BIT_LINEPACK_IN_BYTE_COUNT; p++)
+            {
+                const uint32_t c = color[(packed >> GBP_TILE_2BIT_LINEPACK_BITOFFSET(p)) & 0b11];
+                out[0] = (c >> 16) & 0xFF;
+                out[1] = (c >> 8) & 0xFF;
+                out[2] = (c >> 0) & 0xFF;
+                out[3] = 0xFF;
+                out += 4;
+            }
+        }
+    }
+    return gbp_wasm.rgba;
+}
@@ -0,0 +1,77 @@
+/*************************************************************************
+ *
+ * Gameboy Printer WebAssembly Decoder
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ * Copyright (C) 2020 Brian Khuu
+ *
+ * PURPOSE: This module exposes the decoder core (gbp_pkt, gbp_tiles) as a flat C API for a WebAssembly build
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GBP_WASM_H
+#define GBP_WASM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+    Built with `make wasm` into ../GameBoyPrinterDecoderJS/gbp_decoder_wasm.js (See gbp_wasm_decoder.js). Needs gbp_tiles.h
+
+    Same input handling as gpbdecoder (See gbp_decode.h), but every row is kept until its print arrives, so
+    prints longer than a real printer are not cut short.
+
+    There is a single decoder instance, so no context is passed around. All buffers live in linear memory:
+
+    1. Copy up to gbp_wasm_inputSize() bytes to gbp_wasm_input() then call gbp_wasm_write()
+    2. Images are split on prints with a lower margin, as in gpbdecoder. Rows only show up in an image
+       once their print arrives, with the palette of that print.
+    3. gbp_wasm_rgba() fills the shared RGBA buffer with rows of an image (GBP_WASM_RGBA_ROW_SIZE bytes each)
+       and returns it. Pointers are only valid until the next call, since memory may grow.
+*/
+
+#define GBP_WASM_INPUT_SIZE    (64 * 1024)
+#define GBP_WASM_IMAGE_WIDTH   (GBP_TILE_PIXEL_WIDTH * GBP_TILES_PER_LINE)
+#define GBP_WASM_RGBA_ROW_SIZE (GBP_WASM_IMAGE_WIDTH * GBP_TILE_PIXEL_HEIGHT * 4) ///< One 8 pixel high row
+
+typedef enum
+{
+    GBP_WASM_INPUT_HEX = 0, ///< Hex text dump (GBP_OUTPUT_RAW_PACKETS), same rules as gpbdecoder
+    GBP_WASM_INPUT_FRAMES,  ///< SLIP framed binary (GBP_OUTPUT_BINARY_FRAMES, GBP_OUTPUT_RASTER_ROWS)
+    GBP_WASM_INPUT_PACKETS, ///< Raw packet bytes
+} gbp_wasm_input_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool gbp_wasm_init(void);
+uint8_t *gbp_wasm_input(void);
+size_t gbp_wasm_inputSize(void);
+bool gbp_wasm_write(const size_t size, const int inputType);
+void gbp_wasm_setPallet(const uint32_t color0, const uint32_t color1, const uint32_t color2, const uint32_t color3);
+
+uint32_t gbp_wasm_imageCount(void);
+uint32_t gbp_wasm_imageRows(const uint32_t image);
+bool gbp_wasm_imageDone(const uint32_t image);
+const uint8_t *gbp_wasm_rgba(const uint32_t image, const uint32_t rowFirst, const uint32_t rowCount);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,513 @@
+/*************************************************************************
+ *
+ * Gameboy Printer C Decoder Benchmark
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ *
+ * PURPOSE: Time each decoder stage on its own over a set of capture files
+ *          so that changes to the decoder can be compared between releases
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "gameboy_printer_protocol.h"
+#include "gbp_pkt.h"
+#include "gbp_tiles.h"
+#include "gbp_cache.h"
+#include "gbp_out.h"
+#include "gbp_frame.h"
+#include "gbp_decode.h"
+#include "gbp_wasm.h"
+
+
+/* The official name of this program (e.g., no 'g' prefix).  */
+#define PROGRAM_NAME "gpbbench"
+
+#define GBPBENCH_DEFAULT_MIN_MS 200 ///< Each stage is repeated over the corpus until it has run for this long
+
+/*******************************************************************************
+ * Stage Inputs
+*******************************************************************************/
+
+// Dev Note: A first pass decodes the corpus normally and saves the input of
+//           every stage call, so each stage can then be timed on its own.
+
+// Payload chunk handed to the decompressor, with the state it was called with
+typedef struct
+{
+  gbp_pkt_t pkt;
+  gbp_pkt_tileAcc_t tileAcc;
+  uint8_t buff[GBP_PKT_PAYLOAD_BUFF_SIZE_IN_BYTE];
+  uint8_t buffSize;
+} gbpbench_payload_t;
+
+// Print instruction, with the decoded rows it was called with
+typedef struct
+{
+  gbp_tile_t tiles;
+  uint8_t instruction[GBP_PRINT_INSTRUCT_PAYLOAD_SIZE];
+  size_t tileIndex; ///< Tiles decoded before this print
+} gbpbench_print_t;
+
+typedef struct
+{
+  std::vector<uint8_t> stream;  ///< Raw packet bytes, as the hex parser of gpbdecoder gives them
+  std::vector<gbpbench_payload_t> payloads;
+  std::vector<uint8_t> tiles;   ///< Every tile from the decompressor, GBP_TILE_SIZE_IN_BYTE each
+  std::vector<gbpbench_print_t> prints;
+  std::vector<gbp_tile_t> printed; ///< Rows after gbp_tiles_print(), as given to gbp_out_addTones()
+} gbpbench_file_t;
+
+typedef struct
+{
+  const char *name;
+  uint64_t bytes; ///< Bytes processed per pass over the corpus
+  uint64_t passes;
+  double seconds;
+} gbpbench_result_t;
+
+static uint32_t palletColor[4] = {0xFFFFFF, 0xAAAAAA, 0x555555, 0x000000};
+
+/*******************************************************************************
+ * Corpus
+*******************************************************************************/
+
+// Same parser as gpbdecoder so the packet parser is given the same bytes
+static bool gbpbench_loadHex(const char *path, std::vector<uint8_t> &out)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+
+  gbp_decode_hex_t hex = {0};
+  static uint8_t in[64 * 1024];
+  size_t inSize = 0;
+  while (!hex.eof && ((inSize = fread(in, 1, sizeof(in), f)) > 0))
+  {
+    const size_t outSize = gbp_decode_hexParse(&hex, in, inSize, in);
+    out.insert(out.end(), in, in + outSize);
+  }
+  fclose(f);
+  return true;
+}
+
+// Decode the file normally, keeping the input of each stage
+static void gbpbench_record(gbpbench_file_t *file)
+{
+  static gbp_pkt_t pkt;
+  static gbp_pkt_tileAcc_t tileAcc;
+  static gbp_tile_t tiles;
+  uint8_t buff[GBP_PKT_PAYLOAD_BUFF_SIZE_IN_BYTE];
+  uint8_t buffSize = 0;
+
+  gbp_pkt_init(&pkt);
+  memset(&tileAcc, 0, sizeof(tileAcc));
+  memset(&tiles, 0, sizeof(tiles));
+
+  for (size_t i = 0; i < file->stream.size(); i++)
+  {
+    if (!gbp_pkt_processByte(&pkt, file->stream[i], buff, &buffSize, sizeof(buff)))
+      continue;
+
+    if (pkt.received == GBP_REC_GOT_PACKET)
+    {
+      if (pkt.command != GBP_COMMAND_PRINT)
+        continue;
+      // Same as gbpdecoder_gotPrint()
+      static gbpbench_print_t print;
+      print.tiles = tiles;
+      memcpy(print.instruction, buff, sizeof(print.instruction));
+      print.tileIndex = file->tiles.size() / GBP_TILE_SIZE_IN_BYTE;
+      file->prints.push_back(print);
+      gbp_tiles_print(&tiles, buff[GBP_PRINT_INSTRUCT_INDEX_NUM_OF_SHEETS], buff[GBP_PRINT_INSTRUCT_INDEX_NUM_OF_LINEFEED], buff[GBP_PRINT_INSTRUCT_INDEX_PALETTE_VALUE], buff[GBP_PRINT_INSTRUCT_INDEX_PRINT_DENSITY]);
+      file->printed.push_back(tiles);
+      gbp_tiles_reset(&tiles);
+      continue;
+    }
+
+    static gbpbench_payload_t payload;
+    payload.pkt = pkt;
+    payload.tileAcc = tileAcc;
+    memcpy(payload.buff, buff, buffSize);
+    payload.buffSize = buffSize;
+    file->payloads.push_back(payload);
+
+    while (gbp_pkt_decompressor(&pkt, buff, buffSize, &tileAcc))
+    {
+      if (gbp_pkt_tileAccu_tileReadyCheck(&tileAcc))
+      {
+        file->tiles.insert(file->tiles.end(), tileAcc.tile, tileAcc.tile + GBP_TILE_SIZE_IN_BYTE);
+        gbp_tiles_line_decoder(&tiles, tileAcc.tile);
+      }
+    }
+  }
+}
+
+/*******************************************************************************
+ * Stages
+*******************************************************************************/
+
+static uint64_t gbpbench_nowNs(void)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t gbpbench_stage_processByte(std::vector<gbpbench_file_t> &corpus)
+{
+  static gbp_pkt_t pkt;
+  uint8_t buff[GBP_PKT_PAYLOAD_BUFF_SIZE_IN_BYTE];
+  uint8_t buffSize = 0;
+  uint64_t events = 0;
+  for (size_t f = 0; f < corpus.size(); f++)
+  {
+    gbp_pkt_init(&pkt);
+    const uint8_t *stream = corpus[f].stream.data();
+    const size_t streamSize = corpus[f].stream.size();
+    for (size_t i = 0; i < streamSize; i++)
+    {
+      events += gbp_pkt_processByte(&pkt, stream[i], buff, &buffSize, sizeof(buff)) ? 1 : 0;
+    }
+  }
+  return events;
+}
+
+// Whole stream at once, with a packet buffer of bufferMax (Or a whole payload if 0)
+static uint64_t gbpbench_stage_processBuffer(std::vector<gbpbench_file_t> &corpus, const size_t bufferMax)
+{
+  static gbp_pkt_t pkt;
+  static uint8_t buff[GBP_PKT_FULL_PAYLOAD_BUFF_SIZE_IN_BYTE];
+  uint8_t buffSize = 0;
+  uint16_t fullBuffSize = 0;
+  uint64_t events = 0;
+  for (size_t f = 0; f < corpus.size(); f++)
+  {
+    gbp_pkt_init(&pkt);
+    const uint8_t *stream = corpus[f].stream.data();
+    const size_t streamSize = corpus[f].stream.size();
+    if (bufferMax)
+      events += gbp_pkt_processBuffer(&pkt, stream, streamSize, buff, &buffSize, bufferMax, NULL, NULL);
+    else
+      events += gbp_pkt_processBuffer_full(&pkt, stream, streamSize, buff, &fullBuffSize, NULL, NULL);
+  }
+  return events;
+}
+
+static uint64_t gbpbench_stage_decompressor(std::vector<gbpbench_file_t> &corpus)
+{
+  static gbp_pkt_t pkt;
+  static gbp_pkt_tileAcc_t tileAcc;
+  uint64_t tiles = 0;
+  for (size_t f = 0; f < corpus.size(); f++)
+  {
+    for (size_t p = 0; p < corpus[f].payloads.size(); p++)
+    {
+      const gbpbench_payload_t *payload = &corpus[f].payloads[p];
+      pkt = payload->pkt;
+      tileAcc = payload->tileAcc;
+      while (gbp_pkt_decompressor(&pkt, payload->buff, payload->buffSize, &tileAcc))
+      {
+        tiles += gbp_pkt_tileAccu_tileReadyCheck(&tileAcc) ? 1 : 0;
+      }
+    }
+  }
+  return tiles;
+}
+
+static uint64_t gbpbench_stage_lineDecoder(std::vector<gbpbench_file_t> &corpus)
+{
+  static gbp_tile_t tiles;
+  uint64_t lines = 0;
+  for (size_t f = 0; f < corpus.size(); f++)
+  {
+    const gbpbench_file_t *file = &corpus[f];
+    const size_t tileCount = file->tiles.size() / GBP_TILE_SIZE_IN_BYTE;
+    size_t nextPrint = 0;
+    gbp_tiles_reset(&tiles);
+    for (size_t t = 0; t < tileCount; t++)
+    {
+      // Decoded rows are cleared on print
+      while ((nextPrint < file->prints.size()) && (file->prints[nextPrint].tileIndex <= t))
+      {
+        gbp_tiles_reset(&tiles);
+        nextPrint++;
+      }
+      lines += gbp_tiles_line_decoder(&tiles, &file->tiles[t * GBP_TILE_SIZE_IN_BYTE]) ? 1 : 0;
+    }
+  }
+  return lines;
+}
+
+// Same as gbpbench_stage_lineDecoder(), with repeated tiles copied from the tile cache
+static uint64_t gbpbench_stage_cacheDecoder(std::vector<gbpbench_file_t> &corpus, gbp_cache_t *cache, uint64_t *hits, uint64_t *misses)
+{
+  static gbp_tile_t tiles;
+  uint64_t lines = 0;
+  *hits = 0;
+  *misses = 0;
+  for (size_t f = 0; f < corpus.size(); f++)
+  {
+    const gbpbench_file_t *file = &corpus[f];
+    const size_t tileCount = file->tiles.size() / GBP_TILE_SIZE_IN_BYTE;
+    size_t nextPrint = 0;
+    gbp_tiles_reset(&tiles);
+    gbp_cache_reset(cache);
+    for (size_t t = 0; t < tileCount; t++)
+    {
+      while ((nextPrint < file->prints.size()) && (file->prints[nextPrint].tileIndex <= t))
+      {
+        gbp_tiles_reset(&tiles);
+        nextPrint++;
+      }
+      lines += gbp_tiles_line_addDecoded(&tiles, gbp_cache_decode(cache, &file->tiles[t * GBP_TILE_SIZE_IN_BYTE])) ? 1 : 0;
+    }
+    *hits += cache->hits;
+    *misses += cache->misses;
+  }
+  return lines;
+}
+
+// Only the calls are timed here, since each print needs a fresh copy of its rows
+static uint64_t gbpbench_stage_print(std::vector<gbpbench_file_t> &corpus)
+{
+  static gbp_tile_t tiles;
+  uint64_t ns = 0;
+  for (size_t f = 0; f < corpus.size(); f++)
+  {
+    for (size_t p = 0; p < corpus[f].prints.size(); p++)
+    {
+      const gbpbench_print_t *print = &corpus[f].prints[p];
+      tiles = print->tiles;
+      const uint64_t t0 = gbpbench_nowNs();
+      gbp_tiles_print(&tiles, print->instruction[GBP_PRINT_INSTRUCT_INDEX_NUM_OF_SHEETS], print->instruction[GBP_PRINT_INSTRUCT_INDEX_NUM_OF_LINEFEED], print->instruction[GBP_PRINT_INSTRUCT_INDEX_PALETTE_VALUE], print->instruction[GBP_PRINT_INSTRUCT_INDEX_PRINT_DENSITY]);
+      ns += gbpbench_nowNs() - t0;
+    }
+  }
+  return ns;
+}
+
+static uint64_t gbpbench_stage_out(std::vector<gbpbench_file_t> &corpus, gbp_out_t *out, FILE *devNull)
+{
+  // Same as the streaming image writer in gbpdecoder_gotPrint(), one image per print
+  uint64_t rows = 0;
+  for (size_t f = 0; f < corpus.size(); f++)
+  {
+    for (size_t p = 0; p < corpus[f].printed.size(); p++)
+    {
+      const gbp_tile_t *tiles = &corpus[f].printed[p];
+      gbp_out_openFile(out, devNull, false, GBP_TILE_PIXEL_WIDTH*GBP_TILES_PER_LINE);
+      for (int j = 0; j < tiles->tileRowOffset; j++)
+      {
+        const long int tileHeightIncrement = GBP_TILE_PIXEL_HEIGHT*GBP_BMP_MAX_TILE_HEIGHT;
+        gbp_out_addTones(out, (const uint8_t *) &tiles->bmpLineBuffer[tileHeightIncrement*j][0], (GBP_TILE_PIXEL_WIDTH*GBP_TILES_PER_LINE), tileHeightIncrement, tiles->rowPallet[j*GBP_BMP_MAX_TILE_HEIGHT], palletColor);
+        rows++;
+      }
+      gbp_out_render(out);
+    }
+  }
+  return rows;
+}
+
+// Whole decoder core as called from the browser (See gbp_wasm.h), packets in and every row out as RGBA
+static uint64_t gbpbench_stage_wasm(std::vector<gbpbench_file_t> &corpus)
+{
+  uint64_t rgbaBytes = 0;
+  for (size_t f = 0; f < corpus.size(); f++)
+  {
+    const std::vector<uint8_t> *stream = &corpus[f].stream;
+    gbp_wasm_init();
+    for (size_t i = 0; i < stream->size(); i += gbp_wasm_inputSize())
+    {
+      const size_t size = ((stream->size() - i) < gbp_wasm_inputSize()) ? (stream->size() - i) : gbp_wasm_inputSize();
+      memcpy(gbp_wasm_input(), &(*stream)[i], size);
+      gbp_wasm_write(size, GBP_WASM_INPUT_PACKETS);
+    }
+    for (uint32_t image = 0; image < gbp_wasm_imageCount(); image++)
+    {
+      const uint32_t rows = gbp_wasm_imageRows(image);
+      rgbaBytes += gbp_wasm_rgba(image, 0, rows) ? (rows * GBP_WASM_RGBA_ROW_SIZE) : 0;
+    }
+  }
+  return rgbaBytes;
+}
+
+/*******************************************************************************
+ * Main
+*******************************************************************************/
+
+void gpbbench_help(void)
+{
+  printf (
+      "Usage: gpbbench [OPTION]... FILE...\n"
+      "Time each decoder stage over a corpus of hex capture files\n"
+      "\n"
+      "-t, MS               minimum run time of each stage in ms (default: %d)\n"
+      "-h, --help           display this help and exit\n"
+      "\n"
+      "Output is csv (lines starting with # are comments)\n"
+      "  stage,bytes,passes,seconds,mb_per_s,prints_per_s\n"
+      "  bytes is per pass over the corpus (parser input, payload, tiles, rows harmonised, packed rows written out)\n",
+      GBPBENCH_DEFAULT_MIN_MS
+    );
+}
+
+int main(int argc, char **argv)
+{
+  uint64_t minNs = (uint64_t)GBPBENCH_DEFAULT_MIN_MS * 1000000;
+  std::vector<gbpbench_file_t> corpus;
+
+  gbp_decode_hexTableInit();
+  for (int i = 1; i < argc; i++)
+  {
+    if ((strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "--help") == 0))
+    {
+      gpbbench_help();
+      return 0;
+    }
+    if ((strcmp(argv[i], "-t") == 0) && ((i + 1) < argc))
+    {
+      minNs = strtoull(argv[++i], NULL, 10) * 1000000;
+      continue;
+    }
+    corpus.emplace_back();
+    if (!gbpbench_loadHex(argv[i], corpus.back().stream))
+    {
+      printf("file `%s' not found\n", argv[i]);
+      return 1;
+    }
+  }
+
+  if (corpus.empty())
+  {
+    gpbbench_help();
+    return 1;
+  }
+
+  // Per pass byte counts for each stage
+  uint64_t streamBytes = 0;
+  uint64_t payloadBytes = 0;
+  uint64_t tileBytes = 0;
+  uint64_t harmoniseBytes = 0;
+  uint64_t outBytes = 0;
+  uint64_t prints = 0;
+  for (size_t f = 0; f < corpus.size(); f++)
+  {
+    gbpbench_file_t *file = &corpus[f];
+    gbpbench_record(file);
+    streamBytes += file->stream.size();
+    for (size_t p = 0; p < file->payloads.size(); p++)
+      payloadBytes += file->payloads[p].buffSize;
+    tileBytes += file->tiles.size();
+    for (size_t p = 0; p < file->prints.size(); p++)
+    {
+      const gbp_tile_t *tiles = &file->prints[p].tiles;
+      const int rows = tiles->tileRowOffset - tiles->tileRowOffsetHarmonised;
+      harmoniseBytes += (rows > 0) ? (rows * GBP_TILE_PIXEL_HEIGHT * GBP_TILES_ROW_SIZE_B) : 0;
+      outBytes += GBP_TILE_PIXEL_HEIGHT * GBP_TILES_ROW_SIZE_B * file->printed[p].tileRowOffset;
+    }
+    prints += file->prints.size();
+  }
+
+  // Images are written out but not kept
+  static gbp_out_t gbp_out[GBP_OUT_FORMAT_COUNT];
+  for (int i = 0; i < GBP_OUT_FORMAT_COUNT; i++)
+  {
+    gbp_out_init(&gbp_out[i], (gbp_out_format_t) i);
+  }
+  static gbp_cache_t cache; ///< Reset for each file, as in gpbdecoder
+  uint64_t cacheHits = 0;
+  uint64_t cacheMisses = 0;
+  FILE *devNull = fopen("/dev/null", "wb");
+  if (!devNull)
+  {
+    printf("cannot open /dev/null\n");
+    return 1;
+  }
+
+  gbpbench_result_t results[] =
+  {
+    {"gbp_pkt_processByte",    streamBytes,    0, 0},
+    {"gbp_pkt_decompressor",   payloadBytes,   0, 0},
+    {"gbp_tiles_line_decoder", tileBytes,      0, 0},
+    {"gbp_tiles_print",        harmoniseBytes, 0, 0},
+    {"gbp_out_add bmp",        outBytes,       0, 0},
+    {"gbp_out_add png",        outBytes,       0, 0},
+    {"gbp_out_add 2bpp",       outBytes,       0, 0},
+    {"gbp_cache_decode",       tileBytes,      0, 0},
+    {"gbp_wasm_write",         streamBytes,    0, 0},
+    {"gbp_pkt_processBuffer",  streamBytes,    0, 0},
+    {"gbp_pkt_processBuffer_full", streamBytes, 0, 0},
+  };
+  volatile uint64_t sink = 0; ///< Keeps the stage results alive
+
+  for (size_t s = 0; s < sizeof(results)/sizeof(results[0]); s++)
+  {
+    uint64_t ns = 0;
+    while (ns < minNs)
+    {
+      const uint64_t t0 = gbpbench_nowNs();
+      uint64_t stageNs = 0;
+      switch (s)
+      {
+        case 0: sink += gbpbench_stage_processByte(corpus); break;
+        case 1: sink += gbpbench_stage_decompressor(corpus); break;
+        case 2: sink += gbpbench_stage_lineDecoder(corpus); break;
+        case 3: stageNs = gbpbench_stage_print(corpus); break;
+        case 4: sink += gbpbench_stage_out(corpus, &gbp_out[GBP_OUT_FORMAT_BMP], devNull); break;
+        case 5: sink += gbpbench_stage_out(corpus, &gbp_out[GBP_OUT_FORMAT_PNG], devNull); break;
+        case 6: sink += gbpbench_stage_out(corpus, &gbp_out[GBP_OUT_FORMAT_RAW2BPP], devNull); break;
+        case 7: sink += gbpbench_stage_cacheDecoder(corpus, &cache, &cacheHits, &cacheMisses); break;
+        case 8: sink += gbpbench_stage_wasm(corpus); break;
+        case 9: sink += gbpbench_stage_processBuffer(corpus, GBP_PKT_PAYLOAD_BUFF_SIZE_IN_BYTE); break;
+        case 10: sink += gbpbench_stage_processBuffer(corpus, 0); break;
+      }
+      ns += (s == 3) ? stageNs : (gbpbench_nowNs() - t0);
+      results[s].passes++;
+      if ((s == 3) && (stageNs == 0) && (results[s].passes >= 1000))
+        break; ///< Nothing to print in corpus
+    }
+    results[s].seconds = ns / 1e9;
+  }
+  for (int i = 0; i < GBP_OUT_FORMAT_COUNT; i++)
+  {
+    gbp_out_free(&gbp_out[i]);
+  }
+  fclose(devNull);
+
+  printf("# " PROGRAM_NAME ": %zu files, %llu bytes, %llu prints\n", corpus.size(), (unsigned long long) streamBytes, (unsigned long long) prints);
+  printf("# gbp_cache_decode: %llu hits, %llu misses per pass\n", (unsigned long long) cacheHits, (unsigned long long) cacheMisses);
+  printf("stage,bytes,passes,seconds,mb_per_s,prints_per_s\n");
+  for (size_t s = 0; s < sizeof(results)/sizeof(results[0]); s++)
+  {
+    const gbpbench_result_t *r = &results[s];
+    const double perPass = (r->passes > 0) ? (r->seconds / r->passes) : 0;
+    printf("%s,%llu,%llu,%.6f,%.2f,%.1f\n",
+        r->name,
+        (unsigned long long) r->bytes,
+        (unsigned long long) r->passes,
+        r->seconds,
+        (perPass > 0) ? ((r->bytes / perPass) / 1e6) : 0,
+        (perPass > 0) ? (prints / perPass) : 0);
+  }
+  return 0;
+}
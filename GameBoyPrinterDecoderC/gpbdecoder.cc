@@ -29,11 +29,29 @@
 #include <sys/types.h>
 
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <signal.h>
+#include <errno.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GBPDECODER_USE_MMAP
+#include <sys/mman.h>
+#endif
+#include <sys/stat.h>
 
 #include "gameboy_printer_protocol.h"
 #include "gbp_pkt.h"
 #include "gbp_tiles.h"
-#include "gbp_bmp.h"
+#include "gbp_cache.h"
+#include "gbp_archive.h"
+#include "gbp_out.h"
+#include "gbp_frame.h"
+#include "gbp_tty.h"
+#include "gbp_decode.h"
 
 
 /* The official name of this program (e.g., no 'g' prefix).  */
@@ -43,15 +61,37 @@
 
 static bool verbose_flag = false;
 static bool display_flag = false;
+static bool binary_flag = false;
+static bool stream_flag = false;
+static bool cache_flag = false;
+static bool dedup_flag = false;
+static bool list_flag = false;
+static bool paper_flag = false;
+static int printParameter = -1; ///< Only this print of an archive input (-n)
+static uint16_t streamHoldRows = 0; ///< Rows held back for the palette of their print (-s)
+
+#define GBPDECODER_HEX_CHUNK_SIZE (64*1024) ///< Input chars parsed per span handed to the packet parser
+#define GBPDECODER_FEED_LINES (GBP_TILE_PIXEL_HEIGHT) ///< Scanlines of blank paper per feed of a print margin (-P), rounded to one tile row
 
 /******************************************************************************/
 
 // Input/Output file
 const char * ifilename = NULL;
 const char * ofilename = NULL;
-FILE * ifilePtr = NULL;
-char ofilenameBuf[255] = {0};
-char ofilenameExt[50]  = {0};
+const char * formatParameter = NULL;
+
+// Capture Archive Output
+const char * archiveParameter = NULL;
+
+// Batch Mode
+const char * batchParameter = NULL;
+int batchJobs = 0; ///< 0 for one worker per online cpu
+
+// Serial Port Input
+const char * serialParameter = NULL;
+uint32_t serialBaud = GBP_TTY_DEFAULT_BAUD;
+#define GBPDECODER_SERIAL_RETRY_MS 250 ///< Time between attempts to open the serial port again
+static volatile sig_atomic_t serialStop = 0;
 
 /******************************************************************************/
 
@@ -61,18 +101,54 @@ uint32_t palletColor[4] = {0};
 
 /******************************************************************************/
 
-// Other Variables
-uint8_t pktCounter = 0; // Dev Varible
-gbp_pkt_t gbp_pktBuff = {GBP_REC_NONE, 0};
-uint8_t gbp_pktbuff[GBP_PKT_PAYLOAD_BUFF_SIZE_IN_BYTE] = {0};
-uint8_t gbp_pktbuffSize = 0;
-gbp_pkt_tileAcc_t tileBuff = {0};
-gbp_tile_t gbp_tiles = {0};
-gbp_bmp_t  gbp_bmp = {0};
+// Per input file decoder state (one per job, so files can be decoded in parallel)
+typedef struct
+{
+  // Input/Output file
+  FILE * ifilePtr;
+  FILE * log; ///< Console output for this job
+  char ofilenameBuf[255];
+  char ofilenameExt[50];
+
+  // Other Variables
+  uint8_t pktCounter; // Dev Varible
+  gbp_pkt_t gbp_pktBuff;
+  uint8_t gbp_pktbuff[GBP_PKT_FULL_PAYLOAD_BUFF_SIZE_IN_BYTE]; ///< Whole payloads, so a DATA packet is one event
+  uint16_t gbp_pktbuffSize;
+  gbp_pkt_tileAcc_t tileBuff;
+  gbp_tile_t *gbp_tiles;                 ///< Whole print (Not allocated in stream mode)
+  gbp_tiles_stream_t gbp_stream;         ///< Used instead of gbp_tiles in stream mode (-s)
+  gbp_tiles_streamRow_t *gbp_streamRows; ///< Ring of gbp_stream, only the rows held back plus the one being decoded
+  gbp_cache_t gbp_cache;         ///< Repeated tiles are copied instead of decoded (-c)
+  gbp_archive_writer_t *archive; ///< Packets are written here instead of being rendered (-a)
+  gbp_out_t  gbp_out;
+  bool outFailed;       ///< Output of the current image could not be opened, not tried again until its paper cut
+  uint32_t outErrors;   ///< Images that could not be written
+  gbp_frame_rx_t gbp_frameRx;
+
+  // Hex Ingestion Buffers
+  uint8_t hexIn[GBPDECODER_HEX_CHUNK_SIZE];
+  uint8_t hexOut[(GBPDECODER_HEX_CHUNK_SIZE / 2) + 1];
+} gbpdecoder_ctx_t;
 
 /******************************************************************************/
 
-static void gbpdecoder_gotByte(const uint8_t byte);
+static void gbpdecoder_gotBuffer(void *userData, const uint8_t *data, const size_t dataSize);
+static void gbpdecoder_gotPacketEvent(gbp_pkt_t *_pkt, uint8_t buffer[], const uint16_t bufferSize, void *userData);
+static void gbpdecoder_gotPrint(void *userData, const uint8_t printInstruction[GBP_PRINT_INSTRUCT_PAYLOAD_SIZE]);
+static void gbpdecoder_gotRasterRow(void *userData, const uint8_t *row);
+static void gbpdecoder_gotTile(void *userData, const uint8_t tile[GBP_TILE_SIZE_IN_BYTE]);
+static void gbpdecoder_streamRows(gbpdecoder_ctx_t *ctx);
+static bool gbpdecoder_outOpen(gbpdecoder_ctx_t *ctx);
+static void gbpdecoder_outCut(gbpdecoder_ctx_t *ctx);
+
+// Every input ends up here (See gbp_decode.h), userData is the job's gbpdecoder_ctx_t
+static const gbp_decode_handler_t gbpdecoder_handler = {
+  gbpdecoder_gotBuffer,
+  gbpdecoder_gotRasterRow,
+  gbpdecoder_gotPrint,
+  gbpdecoder_gotTile,
+};
 
 /*******************************************************************************
  * Utilites
@@ -194,6 +270,575 @@ int palletColorParse(uint32_t *palletColor, const int palletColorSize, const cha
   return palletCounter;
 }
 
+/*******************************************************************************
+ * Hex Ingestion
+*******************************************************************************/
+
+static void gbpdecoder_hexParseFile(gbpdecoder_ctx_t *ctx, FILE *f)
+{
+  uint8_t *out = ctx->hexOut;
+  gbp_decode_hex_t hex = {0};
+
+#ifdef GBPDECODER_USE_MMAP
+  // Map regular files in one go
+  struct stat st;
+  if ((fstat(fileno(f), &st) == 0) && S_ISREG(st.st_mode) && (st.st_size > 0))
+  {
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+    if (map != MAP_FAILED)
+    {
+      madvise(map, st.st_size, MADV_SEQUENTIAL);
+      const uint8_t *data = (const uint8_t *) map;
+      size_t remaining = st.st_size;
+      while ((remaining > 0) && !hex.eof)
+      {
+        const size_t inSize = (remaining < GBPDECODER_HEX_CHUNK_SIZE) ? remaining : GBPDECODER_HEX_CHUNK_SIZE;
+        const size_t outSize = gbp_decode_hexParse(&hex, data, inSize, out);
+        if (outSize > 0)
+          gbpdecoder_gotBuffer(ctx, out, outSize);
+        data += inSize;
+        remaining -= inSize;
+      }
+      munmap(map, st.st_size);
+      return;
+    }
+  }
+#endif
+
+  // stdin, pipes or mmap not available
+  uint8_t *in = ctx->hexIn;
+  size_t inSize = 0;
+  while (!hex.eof && ((inSize = fread(in, 1, sizeof(ctx->hexIn), f)) > 0))
+  {
+    const size_t outSize = gbp_decode_hexParse(&hex, in, inSize, out);
+    if (outSize > 0)
+      gbpdecoder_gotBuffer(ctx, out, outSize);
+  }
+}
+
+/*******************************************************************************
+ * Decoder Jobs
+*******************************************************************************/
+
+// Returns false if the tile buffers could not be allocated (Released again at the end of gbpdecoder_decode())
+static bool gbpdecoder_ctxInit(gbpdecoder_ctx_t *ctx, FILE *ifilePtr, FILE *log, const char *outputName)
+{
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->ifilePtr = ifilePtr;
+  ctx->log      = log;
+  filenameExtractPathAndExtention(outputName, ctx->ofilenameBuf, sizeof(ctx->ofilenameBuf), ctx->ofilenameExt, sizeof(ctx->ofilenameExt));
+  gbp_pkt_init(&ctx->gbp_pktBuff);
+
+  // Output format is -f, otherwise named by the output filename extension (bmp by default)
+  gbp_out_format_t format = GBP_OUT_FORMAT_BMP;
+  if (!gbp_out_formatParse(formatParameter, &format))
+    gbp_out_formatParse(ctx->ofilenameExt, &format);
+  gbp_out_init(&ctx->gbp_out, format);
+  gbp_cache_reset(&ctx->gbp_cache);
+
+  // Dev Note: Only the buffer of the mode in use is allocated, so stream mode memory is set by -s ROWS
+  if (stream_flag)
+  {
+    ctx->gbp_streamRows = (gbp_tiles_streamRow_t *) malloc(GBP_TILES_STREAM_ROWS(streamHoldRows) * sizeof(gbp_tiles_streamRow_t));
+    if (!ctx->gbp_streamRows)
+      return false;
+    gbp_tiles_stream_init(&ctx->gbp_stream, ctx->gbp_streamRows, GBP_TILES_STREAM_ROWS(streamHoldRows));
+  }
+  else
+  {
+    ctx->gbp_tiles = (gbp_tile_t *) malloc(sizeof(gbp_tile_t));
+    if (!ctx->gbp_tiles)
+      return false;
+    gbp_tiles_reset(ctx->gbp_tiles);
+  }
+  return true;
+}
+
+static void gbpdecoder_archiveList(gbpdecoder_ctx_t *ctx, gbp_archive_reader_t *reader)
+{
+  fprintf(ctx->log, "// archive version %u%s, %u entries\n", (unsigned) reader->version, (reader->flags & GBP_ARCHIVE_FLAG_DEDUP) ? " (dedup)" : "", (unsigned) reader->entryCount);
+  unsigned printNumber = 0;
+  for (size_t i = 0; i < reader->entryCount; i++)
+  {
+    const gbp_archive_entry_t *entry = &reader->entry[i];
+    if (entry->command != GBP_COMMAND_PRINT)
+    {
+      fprintf(ctx->log, "// %s | record: 0x%08X\n", gbpCommand_toStr(entry->command), (unsigned) entry->recordOffset);
+      continue;
+    }
+    fprintf(ctx->log, "// %s | record: 0x%08X, data: 0x%08X | print: %u, sheets: %u, linefeed: 0x%02X, pallet: 0x%02X, density: 0x%02X, rows: %u\n",
+        gbpCommand_toStr(entry->command),
+        (unsigned) entry->recordOffset,
+        (unsigned) entry->dataOffset,
+        printNumber++,
+        (unsigned) entry->sheets,
+        (unsigned) entry->linefeed,
+        (unsigned) entry->pallet,
+        (unsigned) entry->density,
+        (unsigned) entry->rows
+      );
+  }
+}
+
+// Records are fed back to the packet parser as the bytes the gameboy sent
+static void gbpdecoder_archiveRead(gbpdecoder_ctx_t *ctx)
+{
+  gbp_archive_reader_t *reader = (gbp_archive_reader_t *) malloc(sizeof(gbp_archive_reader_t));
+  if (!reader || !gbp_archive_reader_open(reader, ctx->ifilePtr))
+  {
+    fprintf(ctx->log, "archive cannot be read\n");
+  }
+  else if (list_flag)
+  {
+    gbpdecoder_archiveList(ctx, reader);
+  }
+  else
+  {
+    uint32_t end = UINT32_MAX;
+    if (printParameter >= 0)
+    {
+      // One seek to the start of the print, then read up to its print record
+      const gbp_archive_entry_t *entry = gbp_archive_reader_print(reader, printParameter);
+      if (!entry)
+      {
+        fprintf(ctx->log, "print %d not in archive\n", printParameter);
+        end = 0;
+      }
+      else
+      {
+        gbp_archive_reader_seek(reader, entry->dataOffset);
+        end = entry->recordOffset;
+        ctx->gbp_out.fileCounter = printParameter; ///< Image named after the print
+      }
+    }
+    const uint8_t *packet = NULL;
+    size_t packetSize = 0;
+    while ((reader->offset <= end) && ((packet = gbp_archive_reader_next(reader, NULL, &packetSize)) != NULL))
+    {
+      gbpdecoder_gotBuffer(ctx, packet, packetSize);
+    }
+  }
+  if (reader)
+    gbp_archive_reader_free(reader);
+  free(reader);
+}
+
+static void gbpdecoder_serialSignal(int sig)
+{
+  (void)sig;
+  serialStop = 1;
+}
+
+// Serial port input until SIGINT or SIGTERM. Every image is written out as soon as its print cuts the paper
+// Dev Note: When the port goes away (e.g. the emulator resets) it is opened again once it is back, and
+//           decoding starts over. Rows without their print are dropped, and an unfinished image is written out.
+static void gbpdecoder_serialRead(gbpdecoder_ctx_t *ctx)
+{
+  gbp_tty_t tty;
+  gbp_tty_init(&tty);
+  gbp_decode_hex_t hex = {0};
+  int imagesReported = ctx->gbp_out.fileCounter;
+  bool waiting = false; ///< Port not available was reported
+
+  signal(SIGINT, gbpdecoder_serialSignal);
+  signal(SIGTERM, gbpdecoder_serialSignal);
+
+  while (!serialStop)
+  {
+    if (!gbp_tty_isopen(&tty))
+    {
+      if (!gbp_tty_open(&tty, serialParameter, serialBaud))
+      {
+        if (errno == ENOTTY)
+        {
+          fprintf(ctx->log, "serial `%s' is not a serial port\n", serialParameter);
+          break;
+        }
+        if (!waiting)
+        {
+          fprintf(ctx->log, "serial `%s' not available, waiting\n", serialParameter);
+          waiting = true;
+        }
+        usleep(GBPDECODER_SERIAL_RETRY_MS * 1000);
+        continue;
+      }
+      waiting = false;
+      fprintf(ctx->log, "serial `%s' open at %u baud\n", serialParameter, (unsigned) serialBaud);
+      memset(&hex, 0, sizeof(hex));
+      gbp_pkt_init(&ctx->gbp_pktBuff);
+      gbp_frame_rx_reset(&ctx->gbp_frameRx);
+      ctx->tileBuff.count = 0;
+      if (ctx->gbp_tiles)
+        gbp_tiles_reset(ctx->gbp_tiles);
+      if (stream_flag)
+        gbp_tiles_stream_reset(&ctx->gbp_stream);
+      gbpdecoder_outCut(ctx);
+    }
+
+    const long inSize = gbp_tty_read(&tty, ctx->hexIn, sizeof(ctx->hexIn), GBPDECODER_SERIAL_RETRY_MS);
+    if (inSize < 0)
+    {
+      fprintf(ctx->log, "serial `%s' closed, waiting for it to reconnect\n", serialParameter);
+      waiting = true;
+      continue;
+    }
+
+    if (binary_flag)
+    {
+      for (long i = 0; i < inSize; i++)
+        gbp_decode_frameByte(&ctx->gbp_frameRx, ctx->hexIn[i], &gbpdecoder_handler, ctx);
+    }
+    else if (inSize > 0)
+    {
+      // Dev Note: A 0xFF char ends a hex file, but on a live port it is just line noise (e.g. on reset)
+      for (long i = 0; i < inSize; i++)
+      {
+        if (ctx->hexIn[i] == 0xFF)
+          ctx->hexIn[i] = ' ';
+      }
+      const size_t outSize = gbp_decode_hexParse(&hex, ctx->hexIn, inSize, ctx->hexOut);
+      if (outSize > 0)
+        gbpdecoder_gotBuffer(ctx, ctx->hexOut, outSize);
+    }
+
+    // Images that were finished by this read
+    const int imagesDone = ctx->gbp_out.fileCounter - (gbp_out_isopen(&ctx->gbp_out) ? 1 : 0);
+    for (; imagesReported < imagesDone; imagesReported++)
+    {
+      fprintf(ctx->log, "image %d written\n", imagesReported);
+    }
+    fflush(ctx->log);
+  }
+
+  gbp_tty_close(&tty);
+  fprintf(ctx->log, "serial `%s' closed after %llu bytes, %u reconnects\n", serialParameter,
+      (unsigned long long) tty.bytes, (unsigned) ((tty.opens > 0) ? (tty.opens - 1) : 0));
+}
+
+static void gbpdecoder_decode(gbpdecoder_ctx_t *ctx)
+{
+  if (serialParameter)
+  {
+    gbpdecoder_serialRead(ctx);
+  }
+  else if (gbp_archive_probe(ctx->ifilePtr))
+  {
+    gbpdecoder_archiveRead(ctx);
+  }
+  else if (list_flag || (printParameter >= 0))
+  {
+    fprintf(ctx->log, "input is not an archive\n");
+  }
+  else if (binary_flag)
+  {
+    // SLIP framed raw packets
+    int b = 0;
+    gbp_frame_rx_reset(&ctx->gbp_frameRx);
+    while ((b = fgetc(ctx->ifilePtr)) != EOF)
+    {
+      gbp_decode_frameByte(&ctx->gbp_frameRx, (uint8_t)b, &gbpdecoder_handler, ctx);
+    }
+  }
+  else
+  {
+    gbpdecoder_hexParseFile(ctx, ctx->ifilePtr);
+  }
+
+  // Print without a paper cut at end of input is finished with what was printed so far
+  gbp_out_free(&ctx->gbp_out);
+  free(ctx->gbp_tiles);
+  free(ctx->gbp_streamRows);
+  ctx->gbp_tiles      = NULL;
+  ctx->gbp_streamRows = NULL;
+
+  if (stream_flag && (verbose_flag || (ctx->gbp_stream.rowsMispredicted > 0)))
+  {
+    fprintf(ctx->log, "stream: %u rows rendered before their print, %u of them with the wrong palette\n",
+        (unsigned) ctx->gbp_stream.rowsPredicted, (unsigned) ctx->gbp_stream.rowsMispredicted);
+  }
+
+  if (cache_flag && verbose_flag)
+  {
+    fprintf(ctx->log, "tile cache: %u hits, %u misses, %u evictions\n",
+        (unsigned) ctx->gbp_cache.hits, (unsigned) ctx->gbp_cache.misses, (unsigned) ctx->gbp_cache.evictions);
+  }
+}
+
+/******************************************************************************/
+
+typedef struct
+{
+  char **files;
+  size_t fileCount;
+  size_t nextFile;
+  const char *outputDir;
+  uint32_t outErrors; ///< Images that could not be written, over all jobs
+  pthread_mutex_t lock;
+} gbpdecoder_batch_t;
+
+static int gbpdecoder_batchCompare(const void *a, const void *b)
+{
+  return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static bool gbpdecoder_batchAdd(gbpdecoder_batch_t *batch, const char *path)
+{
+  char **files = (char **) realloc(batch->files, (batch->fileCount + 1) * sizeof(char *));
+  if (!files)
+    return false;
+  batch->files = files;
+  batch->files[batch->fileCount] = strdup(path);
+  if (!batch->files[batch->fileCount])
+    return false;
+  batch->fileCount++;
+  return true;
+}
+
+// Batch input is either a directory (all `*.txt` files, or `*.bin` with --binary) or a list file with one path per line
+static bool gbpdecoder_batchCollect(gbpdecoder_batch_t *batch, const char *batchPath)
+{
+  struct stat st;
+  if (stat(batchPath, &st) != 0)
+    return false;
+
+  if (S_ISDIR(st.st_mode))
+  {
+    const char *ext = binary_flag ? ".bin" : ".txt";
+    const size_t extLen = strlen(ext);
+    DIR *dir = opendir(batchPath);
+    if (!dir)
+      return false;
+    struct dirent *entry = NULL;
+    while ((entry = readdir(dir)) != NULL)
+    {
+      const size_t nameLen = strlen(entry->d_name);
+      if ((entry->d_name[0] == '.') || (nameLen <= extLen) || (strcmp(&entry->d_name[nameLen - extLen], ext) != 0))
+        continue;
+      char path[PATH_MAX];
+      snprintf(path, sizeof(path), "%s/%s", batchPath, entry->d_name);
+      if ((stat(path, &st) != 0) || !S_ISREG(st.st_mode))
+        continue;
+      if (!gbpdecoder_batchAdd(batch, path))
+      {
+        closedir(dir);
+        return false;
+      }
+    }
+    closedir(dir);
+    // readdir() order is filesystem dependent
+    qsort(batch->files, batch->fileCount, sizeof(char *), gbpdecoder_batchCompare);
+    return true;
+  }
+
+  FILE *listFile = fopen(batchPath, "r");
+  if (!listFile)
+    return false;
+  char line[PATH_MAX];
+  while (fgets(line, sizeof(line), listFile))
+  {
+    line[strcspn(line, "\r\n")] = '\0';
+    if ((line[0] == '\0') || (line[0] == '#'))
+      continue;
+    if (!gbpdecoder_batchAdd(batch, line))
+    {
+      fclose(listFile);
+      return false;
+    }
+  }
+  fclose(listFile);
+  return true;
+}
+
+// Output is named after the input file (in the output directory if one was given)
+static void gbpdecoder_batchOutputName(const gbpdecoder_batch_t *batch, const char *inputName, char *outputName, const size_t outputSize)
+{
+  if (batch->outputDir)
+  {
+    const char *baseName = strrchr(inputName, '/');
+    snprintf(outputName, outputSize, "%s/%s", batch->outputDir, baseName ? baseName + 1 : inputName);
+  }
+  else
+  {
+    snprintf(outputName, outputSize, "%s", inputName);
+  }
+}
+
+typedef struct
+{
+  char *stem;        ///< Output name without extension, as the job will use it
+  const char *input;
+} gbpdecoder_batchName_t;
+
+static int gbpdecoder_batchNameCompare(const void *a, const void *b)
+{
+  return strcmp(((const gbpdecoder_batchName_t *)a)->stem, ((const gbpdecoder_batchName_t *)b)->stem);
+}
+
+// Inputs that would write the same images (e.g. `a/x.txt' and `b/x.txt' with -o, or `x.txt' and `x.bin')
+// Dev Note: Checked before any job starts, as such jobs could be writing the same file at the same time
+static bool gbpdecoder_batchCheckNames(const gbpdecoder_batch_t *batch)
+{
+  gbpdecoder_batchName_t *names = (gbpdecoder_batchName_t *) calloc(batch->fileCount, sizeof(gbpdecoder_batchName_t));
+  if (!names && (batch->fileCount > 0))
+    return false;
+
+  bool unique = true;
+  for (size_t i = 0; i < batch->fileCount; i++)
+  {
+    char outputName[PATH_MAX];
+    char stem[sizeof(((gbpdecoder_ctx_t *) NULL)->ofilenameBuf)];
+    gbpdecoder_batchOutputName(batch, batch->files[i], outputName, sizeof(outputName));
+    filenameExtractPathAndExtention(outputName, stem, sizeof(stem), NULL, 0);
+    names[i].stem = strdup(stem);
+    names[i].input = batch->files[i];
+    if (!names[i].stem)
+      unique = false;
+  }
+
+  if (unique)
+  {
+    qsort(names, batch->fileCount, sizeof(gbpdecoder_batchName_t), gbpdecoder_batchNameCompare);
+    for (size_t i = 1; i < batch->fileCount; i++)
+    {
+      if (strcmp(names[i - 1].stem, names[i].stem) == 0)
+      {
+        printf("batch: `%s' and `%s' would both be written to `%s'\n", names[i - 1].input, names[i].input, names[i].stem);
+        unique = false;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < batch->fileCount; i++)
+  {
+    free(names[i].stem);
+  }
+  free(names);
+  return unique;
+}
+
+static void *gbpdecoder_batchWorker(void *arg)
+{
+  gbpdecoder_batch_t *batch = (gbpdecoder_batch_t *) arg;
+  gbpdecoder_ctx_t *ctx = (gbpdecoder_ctx_t *) malloc(sizeof(gbpdecoder_ctx_t));
+  if (!ctx)
+    return NULL;
+
+  while (1)
+  {
+    pthread_mutex_lock(&batch->lock);
+    const size_t fileIndex = batch->nextFile++;
+    pthread_mutex_unlock(&batch->lock);
+    if (fileIndex >= batch->fileCount)
+      break;
+    const char *inputName = batch->files[fileIndex];
+
+    char outputName[PATH_MAX];
+    gbpdecoder_batchOutputName(batch, inputName, outputName, sizeof(outputName));
+
+    // Job console output is collected and printed in one go so jobs do not interleave
+    char *logBuf = NULL;
+    size_t logSize = 0;
+    FILE *log = open_memstream(&logBuf, &logSize);
+    if (!log)
+      log = stdout;
+
+    FILE *ifilePtr = fopen(inputName, binary_flag ? "rb" : "r");
+    if (ifilePtr && !gbpdecoder_ctxInit(ctx, ifilePtr, log, outputName))
+    {
+      fprintf(log, "file `%s' skipped, out of memory\n", inputName);
+      fclose(ifilePtr);
+    }
+    else if (ifilePtr)
+    {
+      fprintf(log, "file input `%s' open\n", inputName);
+      fprintf(log, "file requested output `%s' (%s)\n", ctx->ofilenameBuf, ctx->ofilenameExt);
+      gbpdecoder_decode(ctx);
+      fclose(ifilePtr);
+      pthread_mutex_lock(&batch->lock);
+      batch->outErrors += ctx->outErrors;
+      pthread_mutex_unlock(&batch->lock);
+    }
+    else
+    {
+      fprintf(log, "file `%s' not found\n", inputName);
+    }
+
+    if (log != stdout)
+    {
+      fclose(log);
+      pthread_mutex_lock(&batch->lock);
+      fwrite(logBuf, 1, logSize, stdout);
+      fflush(stdout);
+      pthread_mutex_unlock(&batch->lock);
+      free(logBuf);
+    }
+  }
+
+  free(ctx);
+  return NULL;
+}
+
+static int gbpdecoder_batch(const char *batchPath, const char *outputDir, int jobs)
+{
+  gbpdecoder_batch_t batch = {0};
+  batch.outputDir = outputDir;
+  pthread_mutex_init(&batch.lock, NULL);
+
+  if (!gbpdecoder_batchCollect(&batch, batchPath))
+  {
+    printf("batch `%s' could not be read\n", batchPath);
+    return 1;
+  }
+
+  if (!gbpdecoder_batchCheckNames(&batch))
+  {
+    printf("batch `%s' not decoded, output names must be unique\n", batchPath);
+    for (size_t i = 0; i < batch.fileCount; i++)
+    {
+      free(batch.files[i]);
+    }
+    free(batch.files);
+    pthread_mutex_destroy(&batch.lock);
+    return 1;
+  }
+
+  if (jobs <= 0)
+  {
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = (cpus > 0) ? (int) cpus : 1;
+  }
+  if ((size_t) jobs > batch.fileCount)
+    jobs = (batch.fileCount > 0) ? (int) batch.fileCount : 1;
+  printf("batch `%s': %zu files, %d jobs\n", batchPath, batch.fileCount, jobs);
+  fflush(stdout);
+
+  pthread_t *workers = (pthread_t *) calloc(jobs, sizeof(pthread_t));
+  int workerCount = 0;
+  for (workerCount = 0; workers && (workerCount < jobs); workerCount++)
+  {
+    if (pthread_create(&workers[workerCount], NULL, gbpdecoder_batchWorker, &batch) != 0)
+      break;
+  }
+  if (workerCount == 0)
+  {
+    // No threads available, decode on this thread
+    gbpdecoder_batchWorker(&batch);
+  }
+  for (int i = 0; i < workerCount; i++)
+  {
+    pthread_join(workers[i], NULL);
+  }
+  free(workers);
+
+  for (size_t i = 0; i < batch.fileCount; i++)
+  {
+    free(batch.files[i]);
+  }
+  free(batch.files);
+  pthread_mutex_destroy(&batch.lock);
+  return (batch.outErrors > 0) ? 1 : 0;
+}
+
 /*******************************************************************************
  * Main Test Routine
 *******************************************************************************/
@@ -201,20 +846,45 @@ void gpbdecoder_help(void)
 {
   printf (
       "Usage: gpbdecoder [OPTION]...\n"
-      "This program allows for decoding raw hex packets into bmp\n"
+      "This program allows for decoding raw hex packets into bmp, png or raw 2bpp images\n"
       "\n"
       "With no FILE, read standard input.\n"
       "\n"
       "-i, --input=FILE     input hexfile in ascii format\n"
-      "-o, --output=OUTFILE output bmp filename\n"
+      "-o, --output=OUTFILE output image filename, `-' for stdout (console messages then go to stderr)\n"
+      "-f, --format=FORMAT  output format: bmp, png or 2bpp (default: from the output filename extension, else bmp)\n"
       "-p, --pallet=PALLET  pallet color in web color format\n"
       "-h, --help           display this help and exit\n"
       "-d, --display        preview image via vt100 output\n"
+      "-s, --stream=ROWS    render rows as they are decoded, with memory for ROWS rows waiting for the palette of\n"
+      "                     their print (0 to %d). Rows beyond that use the palette of the previous print\n"
+      "-c, --cache          copy repeated tiles from a tile cache instead of decoding them (hit counts with -v)\n"
+      "-a, --archive=FILE   write the packets to an indexed binary archive instead of rendering them (`-' for stdout)\n"
+      "-D, --dedup          store repeated tiles in the archive as references to earlier ones (with -a)\n"
+      "-l, --list           list the INIT and PRINT records of an archive input without decoding it\n"
+      "-n, --print=N        only read print N (counting from 0) of an archive input, to render it or with -a to extract it\n"
+      "-b, --binary         input is SLIP framed binary packets or rows (GBP_OUTPUT_BINARY_FRAMES, GBP_OUTPUT_RASTER_ROWS)\n"
+      "-P, --paper          render prints as on paper: rows repeated for each sheet, with the feeds before and after\n"
+      "                     each print as blank margins of %d scanlines\n"
       "-v, --verbose        verbose print\n"
+      "-B, --batch=PATH     decode every *.txt (*.bin with -b) file in a directory, or each file listed in PATH\n"
+      "                     output is named after each input file, -o sets the output directory\n"
+      "                     (nothing is decoded if two inputs would get the same output name)\n"
+      "-j, --jobs=N         number of batch worker threads (default: one per cpu)\n"
+      "-S, --serial=DEVICE  read the emulator serial port directly (e.g. /dev/ttyUSB0) until interrupted, writing each\n"
+      "                     image as soon as its print cuts the paper. The port is opened again after a device reset\n"
+      "-r, --baud=RATE      serial port baud rate (default: %d)\n"
       "\n"
       "Examples:\n"
       "  cat ./test/test.txt | gpbdecoder -p \"#ffffff#ffad63#833100#000000\" -o ./test/test.bmp    stdin based input, with a defined output filename\n"
       "-p \"#dbf4b4#abc396#7b9278#4c625a#FFFFFF00\" -i ./test/test.txt                              input file used. Output file has similar name to input file\n"
+      "  gpbdecoder -B ../research/Captures/2020-08-10_RaphaelBOICHOT -o /tmp/render -j 4              batch decode a directory of captures\n"
+      "  gpbdecoder -i ./test/test.txt -f 2bpp -o - | xxd                                            raw 2bpp rows to stdout for a pipeline\n"
+      "  gpbdecoder -i ./banner.txt -s 2 -f png                                                      long print with bounded memory\n"
+      "  gpbdecoder -S /dev/ttyUSB0 -f png -o ./prints/print                                         live capture, one png per print\n",
+      GBP_TILES_STREAM_HOLD_MAX,
+      GBPDECODER_FEED_LINES,
+      GBP_TTY_DEFAULT_BAUD
     );
 }
 
@@ -235,13 +905,26 @@ main (int argc, char **argv)
         We distinguish them by their indices. */
     {"input",   required_argument, NULL, 'i'},
     {"output",  required_argument, NULL, 'o'},
+    {"format",  required_argument, NULL, 'f'},
+    {"stream",  required_argument, NULL, 's'},
+    {"cache",   no_argument,       NULL, 'c'},
+    {"archive", required_argument, NULL, 'a'},
+    {"dedup",   no_argument,       NULL, 'D'},
+    {"list",    no_argument,       NULL, 'l'},
+    {"print",   required_argument, NULL, 'n'},
     {"pallet",  required_argument, NULL, 'p'},
+    {"paper",   no_argument,       NULL, 'P'},
     {"verbose", no_argument,       NULL, 'v'},
+    {"binary",  no_argument,       NULL, 'b'},
+    {"batch",   required_argument, NULL, 'B'},
+    {"jobs",    required_argument, NULL, 'j'},
+    {"serial",  required_argument, NULL, 'S'},
+    {"baud",    required_argument, NULL, 'r'},
     {"help",    no_argument,       NULL, 'h'},
     {NULL, 0, NULL, 0}
   };
 
-  while ((c = getopt_long (argc, argv, "o:i:p:vd", long_options, NULL))
+  while ((c = getopt_long (argc, argv, "o:f:s:ca:Dln:i:p:PvdbB:j:S:r:", long_options, NULL))
          != -1)
   {
     switch (c)
@@ -254,10 +937,45 @@ main (int argc, char **argv)
           ofilename = optarg;
           break;
 
+        case 'f':
+          formatParameter = optarg;
+          break;
+
+        case 's':
+          stream_flag = true;
+          streamHoldRows = (uint16_t) atoi(optarg);
+          if (streamHoldRows > GBP_TILES_STREAM_HOLD_MAX)
+            streamHoldRows = GBP_TILES_STREAM_HOLD_MAX;
+          break;
+
+        case 'c':
+          cache_flag = true;
+          break;
+
+        case 'a':
+          archiveParameter = optarg;
+          break;
+
+        case 'D':
+          dedup_flag = true;
+          break;
+
+        case 'l':
+          list_flag = true;
+          break;
+
+        case 'n':
+          printParameter = atoi(optarg);
+          break;
+
         case 'p':
           palletParameter = optarg;
           break;
 
+        case 'P':
+          paper_flag = true;
+          break;
+
         case 'v':
           verbose_flag = true;
           break;
@@ -266,6 +984,26 @@ main (int argc, char **argv)
           display_flag = true;
           break;
 
+        case 'b':
+          binary_flag = true;
+          break;
+
+        case 'B':
+          batchParameter = optarg;
+          break;
+
+        case 'j':
+          batchJobs = atoi(optarg);
+          break;
+
+        case 'S':
+          serialParameter = optarg;
+          break;
+
+        case 'r':
+          serialBaud = (uint32_t) strtoul(optarg, NULL, 10);
+          break;
+
         case 'h':
           gpbdecoder_help();
           return 0;
@@ -273,41 +1011,102 @@ main (int argc, char **argv)
     }
   }
 
-  /* Input File */
-  if (ifilename)
+  static gbpdecoder_ctx_t gbp_ctx;
+  FILE * ifilePtr = NULL;
+
+  /* Output Format */
+  gbp_out_format_t format;
+  if (formatParameter && !gbp_out_formatParse(formatParameter, &format))
+  {
+    printf("format `%s' not supported\n", formatParameter);
+    gpbdecoder_help();
+    return 1;
+  }
+
+  // Preview, copies and margins need the whole print
+  if (display_flag || paper_flag)
+    stream_flag = false;
+
+  // One archive per run
+  if (batchParameter && archiveParameter)
+  {
+    printf("batch archive output not supported\n");
+    return 1;
+  }
+
+  // Serial port is the input, instead of a file or stdin
+  if (serialParameter)
   {
-    ifilePtr = fopen(ifilename, "r+");
-    if (ifilePtr == NULL)
+    if (batchParameter || ifilename)
+    {
+      printf("serial input cannot be combined with -i or -B\n");
+      return 1;
+    }
+    if (!gbp_tty_supported() || !gbp_tty_baudSupported(serialBaud))
     {
-      printf("file not found\n");
-      gpbdecoder_help();
-      return 0;
+      printf("serial input at %u baud not supported\n", (unsigned) serialBaud);
+      return 1;
     }
-    printf("file input `%s' open\n", ifilename);
   }
-  else
+
+  // Console messages must not end up in an image on stdout
+  FILE * console = stdout;
+  if ((ofilename && (strcmp(ofilename, GBP_OUT_STDOUT) == 0)) || (archiveParameter && (strcmp(archiveParameter, GBP_OUT_STDOUT) == 0)))
   {
-    // Input file not found, use stdin
-    ifilePtr = stdin;
-    printf("file input stdin\n");
+    if (batchParameter)
+    {
+      printf("batch output to stdout not supported\n");
+      return 1;
+    }
+    console = stderr;
   }
 
-  /* Output File */
-  if (!ofilename)
+  if (!batchParameter)
   {
-    // Default output filename if not defined
-    if (ifilename)
+    /* Input File */
+    if (serialParameter)
+    {
+      fprintf(console, "serial input `%s'\n", serialParameter);
+    }
+    else if (ifilename)
     {
-      // Use input filename (We will strip out any extention and add our own anyway)
-      ofilename = ifilename;
+      ifilePtr = fopen(ifilename, binary_flag ? "rb" : "r+");
+      if (ifilePtr == NULL)
+      {
+        fprintf(console, "file not found\n");
+        gpbdecoder_help();
+        return 0;
+      }
+      fprintf(console, "file input `%s' open\n", ifilename);
     }
     else
     {
-      ofilename = "gbpOut.bmp";
+      // Input file not found, use stdin
+      ifilePtr = stdin;
+      fprintf(console, "file input stdin\n");
     }
+
+    /* Output File */
+    if (!ofilename)
+    {
+      // Default output filename if not defined
+      if (ifilename)
+      {
+        // Use input filename (We will strip out any extention and add our own anyway)
+        ofilename = ifilename;
+      }
+      else
+      {
+        ofilename = "gbpOut.bmp";
+      }
+    }
+    if (!gbpdecoder_ctxInit(&gbp_ctx, ifilePtr, console, ofilename))
+    {
+      fprintf(console, "out of memory\n");
+      return 1;
+    }
+    fprintf(console, "file requested output `%s' (%s)\n", gbp_ctx.ofilenameBuf, gbp_ctx.ofilenameExt);
   }
-  filenameExtractPathAndExtention(ofilename, ofilenameBuf, sizeof(ofilenameBuf), ofilenameExt, sizeof(ofilenameExt));
-  printf("file requested output `%s' (%s)\n", ofilenameBuf, ofilenameExt);
 
   /* Custom Pallet */
   if (palletColorParse(palletColor, sizeof(palletColor)/sizeof(palletColor[0]), palletParameter) == 0)
@@ -317,208 +1116,275 @@ main (int argc, char **argv)
     palletColor[2] = 0x555555;
     palletColor[3] = 0x000000;
   }
-  printf("Pallet: 0x%06X, 0x%06X, 0x%06X, 0x%06X\n", palletColor[0], palletColor[1], palletColor[2], palletColor[3]);
+  fprintf(console, "Pallet: 0x%06X, 0x%06X, 0x%06X, 0x%06X\n", palletColor[0], palletColor[1], palletColor[2], palletColor[3]);
 
   /****************************************************************************/
-  gbp_pkt_init(&gbp_pktBuff);
+  gbp_decode_hexTableInit();
 
-  char ch = 0;
-  bool skipLine = false;
-  int  lowNibFound = 0;
-  uint8_t byte = 0;
-  unsigned int bytec = 0;
-  while ((ch = fgetc(ifilePtr)) != EOF)
+  if (batchParameter)
   {
-    // Skip Comments
-    if (ch == '/')
+    // -o is the output directory in batch mode
+    return gbpdecoder_batch(batchParameter, ofilename, batchJobs);
+  }
+
+  /* Capture Archive */
+  static gbp_archive_writer_t archive;
+  FILE * afilePtr = NULL;
+  if (archiveParameter)
+  {
+    afilePtr = (strcmp(archiveParameter, GBP_OUT_STDOUT) == 0) ? stdout : fopen(archiveParameter, "wb");
+    if (!afilePtr || !gbp_archive_writer_open(&archive, afilePtr, dedup_flag))
     {
-      // Might be `//` or `/*`
-      skipLine = true;
-      continue;
+      fprintf(console, "archive `%s' cannot be written\n", archiveParameter);
+      return 1;
     }
-    else if (skipLine)
+    fprintf(console, "file output archive `%s'%s\n", archiveParameter, dedup_flag ? " (dedup)" : "");
+    gbp_ctx.archive = &archive;
+  }
+
+  gbpdecoder_decode(&gbp_ctx);
+
+  if (archiveParameter)
+  {
+    const bool ok = gbp_archive_writer_close(&archive);
+    if (afilePtr != stdout)
+      fclose(afilePtr);
+    if (!ok)
     {
-      // Discarding line
-      if (ch == '\n')
-        skipLine = false;
-      continue;
+      fprintf(console, "archive `%s' write failed\n", archiveParameter);
+      return 1;
     }
+  }
 
-    // Parse Nibble
-    char nib = -1;
-    if (('0' <= ch) && (ch <= '9'))
-      nib = ch - '0';
-    else if (('a' <= ch) && (ch <= 'f'))
-      nib = ch - 'a' + 10;
-    else if (('A' <= ch) && (ch <= 'F'))
-      nib = ch - 'A' + 10;
+  // Some images could not be written
+  return (gbp_ctx.outErrors > 0) ? 1 : 0;
+}
+
+
+void gbpdecoder_gotBuffer(void *userData, const uint8_t *data, const size_t dataSize)
+{
+  gbpdecoder_ctx_t *ctx = (gbpdecoder_ctx_t *) userData;
+  gbp_pkt_processBuffer_full(&ctx->gbp_pktBuff, data, dataSize, ctx->gbp_pktbuff, &ctx->gbp_pktbuffSize, gbpdecoder_gotPacketEvent, ctx);
+}
+
+// Row of tiles already decoded by the emulator, same layout as a row of gbp_tiles.bmpLineBuffer
+void gbpdecoder_gotRasterRow(void *userData, const uint8_t *row)
+{
+  gbpdecoder_ctx_t *ctx = (gbpdecoder_ctx_t *) userData;
+  if (stream_flag)
+  {
+    gbp_tiles_stream_addRow(&ctx->gbp_stream, row);
+    gbpdecoder_streamRows(ctx);
+    return;
+  }
+  if (ctx->gbp_tiles->tileRowOffset >= GBP_TILES_PER_ROW)
+    return;
+  memcpy(&ctx->gbp_tiles->bmpLineBuffer[GBP_TILE_PIXEL_HEIGHT * ctx->gbp_tiles->tileRowOffset][0], row, GBP_TILE_PIXEL_HEIGHT * GBP_TILES_ROW_SIZE_B);
+  ctx->gbp_tiles->tileLineOffset = 0;
+  ctx->gbp_tiles->tileRowOffset++;
+}
+
+// Print instruction received, so decoded rows so far are written out
+void gbpdecoder_gotPrint(void *userData, const uint8_t printInstruction[GBP_PRINT_INSTRUCT_PAYLOAD_SIZE])
+{
+  gbpdecoder_ctx_t *ctx = (gbpdecoder_ctx_t *) userData;
+  const bool cutPaper = gbp_decode_printCutsPaper(printInstruction);
+  if (stream_flag)
+  {
+    // Row Stream (See gbp_tiles_stream_t)
+    // Dev Note: Rows still waiting for this print get its palette and are written out now
+    gbp_tiles_stream_print(&ctx->gbp_stream, printInstruction[GBP_PRINT_INSTRUCT_INDEX_PALETTE_VALUE]);
+    gbpdecoder_streamRows(ctx);
 
-    /* Parse As Byte */
-    bool byteFound = false;
-    // Hex Parse Edge Cases
-    if (lowNibFound)
+    // Print finished and cut requested
+    if (cutPaper)
     {
-      // '0x' found. Ignore
-      if ((byte == 0) && (ch == 'x'))
-        lowNibFound = false;
-      // Not a hex digit pair. Ignore
-      if (nib == -1)
-        lowNibFound = false;
+      gbpdecoder_outCut(ctx);
     }
-    // Hex Byte Parsing
-    if (nib != -1)
+    return;
+  }
+
+  gbp_tiles_print(ctx->gbp_tiles,
+      printInstruction[GBP_PRINT_INSTRUCT_INDEX_NUM_OF_SHEETS],
+      printInstruction[GBP_PRINT_INSTRUCT_INDEX_NUM_OF_LINEFEED],
+      printInstruction[GBP_PRINT_INSTRUCT_INDEX_PALETTE_VALUE],
+      printInstruction[GBP_PRINT_INSTRUCT_INDEX_PRINT_DENSITY]);
+
+  if (display_flag)
+  {
+    if (cutPaper)
     {
-      if (!lowNibFound)
+      // Display Preview
+      gbp_out_tones_t tones = {0};
+      for (int j = 0; j < (GBP_TILE_PIXEL_HEIGHT * ctx->gbp_tiles->tileRowOffset); j++)
       {
-        lowNibFound = true;
-        byte = nib << 4;
+        gbp_out_tonesUpdate(&tones, ctx->gbp_tiles->rowPallet[j / GBP_TILE_PIXEL_HEIGHT]);
+        for (int i = 0; i < (GBP_TILE_PIXEL_WIDTH * GBP_TILES_PER_LINE); i++)
+        {
+          const int pixel = 0b11 & (tones.lut[ctx->gbp_tiles->bmpLineBuffer[j][GBP_TILE_2BIT_LINEPACK_INDEX(i)]] >> GBP_TILE_2BIT_LINEPACK_BITOFFSET(i));
+          int b = 0;
+          switch (pixel)
+          {
+            default:
+            case 3: b = 0; break;
+            case 2: b = 64; break;
+            case 1: b = 130; break;
+            case 0: b = 255; break;
+          }
+          fprintf(ctx->log, "\x1B[48;2;%d;%d;%dm \x1B[0m", b, b, b);
+        }
+        fprintf(ctx->log, "\r\n");
       }
-      else
+      gbp_tiles_reset(ctx->gbp_tiles);
+    }
+  }
+  else
+  {
+    // Streaming Image Writer (See gbp_out.h)
+    // Dev Note: Done this way to allow for streaming writes to file without holding the whole image
+
+    // Open New File
+    gbpdecoder_outOpen(ctx);
+
+    // Write Decode Data Buffer Into Image
+    // Dev Note: Rows get their print palette as they are converted (See gbp_out_addTones()).
+    //           With -P every sheet goes through gbp_out_addTones() again, so N sheets cost N times
+    //           the conversion and encoding of one (e.g. N times the deflate work for png)
+    const int sheets = paper_flag ? ctx->gbp_tiles->printSheets : 1;
+    if (paper_flag)
+      gbp_out_addBlank(&ctx->gbp_out, (GBP_TILE_PIXEL_WIDTH*GBP_TILES_PER_LINE), GBPDECODER_FEED_LINES * ctx->gbp_tiles->printFeedBefore, palletColor);
+    for (int sheet = 0; sheet < sheets; sheet++)
+    {
+      for (int j = 0; j < ctx->gbp_tiles->tileRowOffset; j++)
       {
-        lowNibFound = false;
-        byte |= nib << 0;
-        byteFound = true;
+        const long int tileHeightIncrement = GBP_TILE_PIXEL_HEIGHT*GBP_BMP_MAX_TILE_HEIGHT;
+        gbp_out_addTones(&ctx->gbp_out, (const uint8_t *) &ctx->gbp_tiles->bmpLineBuffer[tileHeightIncrement*j][0], (GBP_TILE_PIXEL_WIDTH*GBP_TILES_PER_LINE), tileHeightIncrement, ctx->gbp_tiles->rowPallet[j*GBP_BMP_MAX_TILE_HEIGHT], palletColor);
       }
     }
+    if (paper_flag)
+      gbp_out_addBlank(&ctx->gbp_out, (GBP_TILE_PIXEL_WIDTH*GBP_TILES_PER_LINE), GBPDECODER_FEED_LINES * ctx->gbp_tiles->printFeedAfter, palletColor);
+    gbp_tiles_reset(ctx->gbp_tiles); ///< Written to file, clear decoded tile line buffer
 
-    // Byte Was Found, decoding...
-    if (byteFound)
+    // Print finished and cut requested
+    if (cutPaper)
     {
-      bytec++;
-      gbpdecoder_gotByte(byte);
+      gbpdecoder_outCut(ctx);
     }
   }
+}
 
-  return 0;
+// Write out every row that has its palette (Stream mode)
+// Dev Note: Rows get their print palette as they are converted, same as in gbpdecoder_gotPrint()
+void gbpdecoder_streamRows(gbpdecoder_ctx_t *ctx)
+{
+  const uint8_t *row = NULL;
+  uint8_t pallet = GBP_OUT_PALLET_NONE;
+  while ((row = gbp_tiles_stream_get(&ctx->gbp_stream, &pallet)) != NULL)
+  {
+    gbpdecoder_outOpen(ctx);
+    gbp_out_addTones(&ctx->gbp_out, row, (GBP_TILE_PIXEL_WIDTH*GBP_TILES_PER_LINE), GBP_TILE_PIXEL_HEIGHT, pallet, palletColor);
+    gbp_tiles_stream_release(&ctx->gbp_stream);
+  }
 }
 
+// Output for the rows of the current image, opened on its first row
+// Dev Note: Opened once per image. If that fails its rows are dropped until the paper cut, instead of
+//           trying again (and using up another file number) on every row or print
+bool gbpdecoder_outOpen(gbpdecoder_ctx_t *ctx)
+{
+  if (gbp_out_isopen(&ctx->gbp_out))
+    return true;
+  if (ctx->outFailed)
+    return false;
+  if (gbp_out_open(&ctx->gbp_out, ctx->ofilenameBuf, GBP_TILE_PIXEL_WIDTH*GBP_TILES_PER_LINE))
+    return true;
+  fprintf(ctx->log, "output `%s' could not be written\n", ctx->ofilenameBuf);
+  ctx->outFailed = true;
+  ctx->outErrors++;
+  return false;
+}
 
-void gbpdecoder_gotByte(const uint8_t byte)
+// Paper cut, so the current image is finished and the next print starts a new one
+void gbpdecoder_outCut(gbpdecoder_ctx_t *ctx)
 {
-  if (gbp_pkt_processByte(&gbp_pktBuff, byte, gbp_pktbuff, &gbp_pktbuffSize, sizeof(gbp_pktbuff)))
+  gbp_out_render(&ctx->gbp_out);
+  ctx->outFailed = false;
+}
+
+void gbpdecoder_gotPacketEvent(gbp_pkt_t *_pkt, uint8_t buffer[], const uint16_t bufferSize, void *userData)
+{
+  // Dev Note: _pkt, buffer and bufferSize are this job's ctx->gbp_pktBuff, ctx->gbp_pktbuff and ctx->gbp_pktbuffSize
+  (void)_pkt;
+  (void)buffer;
+  (void)bufferSize;
+  gbpdecoder_ctx_t *ctx = (gbpdecoder_ctx_t *) userData;
+  if (ctx->archive)
   {
-    if (gbp_pktBuff.received == GBP_REC_GOT_PACKET)
+    gbp_archive_writer_packet(ctx->archive, &ctx->gbp_pktBuff, ctx->gbp_pktbuff, ctx->gbp_pktbuffSize);
+    return;
+  }
+  if (ctx->gbp_pktBuff.received == GBP_REC_GOT_PACKET)
+  {
+    ctx->pktCounter++;
+    if (verbose_flag)
     {
-      pktCounter++;
-      if (verbose_flag)
-      {
-        printf("// %s | compression: %1u, dlength: %3u, printerID: 0x%02X, status: %u | %d | ",
-            gbpCommand_toStr(gbp_pktBuff.command),
-            (unsigned) gbp_pktBuff.compression,
-            (unsigned) gbp_pktBuff.dataLength,
-            (unsigned) gbp_pktBuff.printerID,
-            (unsigned) gbp_pktBuff.status,
-            (unsigned) pktCounter
-          );
-        for (int i = 0 ; i < gbp_pktbuffSize ; i++)
-        {
-          printf("%02X ", gbp_pktbuff[i]);
-        }
-        printf("\r\n");
-      }
-      if (gbp_pktBuff.command == GBP_COMMAND_PRINT)
+      fprintf(ctx->log, "// %s | compression: %1u, dlength: %3u, printerID: 0x%02X, status: %u | %d | ",
+          gbpCommand_toStr(ctx->gbp_pktBuff.command),
+          (unsigned) ctx->gbp_pktBuff.compression,
+          (unsigned) ctx->gbp_pktBuff.dataLength,
+          (unsigned) ctx->gbp_pktBuff.printerID,
+          (unsigned) ctx->gbp_pktBuff.status,
+          (unsigned) ctx->pktCounter
+        );
+      // Tile data payloads are not logged
+      for (int i = 0 ; (i < ctx->gbp_pktbuffSize) && (ctx->gbp_pktbuffSize < GBP_PKT_PAYLOAD_BUFF_SIZE_IN_BYTE) ; i++)
       {
-        const bool cutPaper = ((gbp_pktbuff[GBP_PRINT_INSTRUCT_INDEX_NUM_OF_LINEFEED]&0xF) != 0) ? true : false;  ///< if lower margin is zero, then new pic
-        gbp_tiles_print(&gbp_tiles,
-            gbp_pktbuff[GBP_PRINT_INSTRUCT_INDEX_NUM_OF_SHEETS],
-            gbp_pktbuff[GBP_PRINT_INSTRUCT_INDEX_NUM_OF_LINEFEED],
-            gbp_pktbuff[GBP_PRINT_INSTRUCT_INDEX_PALETTE_VALUE],
-            gbp_pktbuff[GBP_PRINT_INSTRUCT_INDEX_PRINT_DENSITY]);
-
-        if (display_flag)
-        {
-          if (cutPaper)
-          {
-            // Display Preview
-            for (int j = 0; j < (GBP_TILE_PIXEL_HEIGHT * gbp_tiles.tileRowOffset); j++)
-            {
-              for (int i = 0; i < (GBP_TILE_PIXEL_WIDTH * GBP_TILES_PER_LINE); i++)
-              {
-                const int pixel = 0b11 & (gbp_tiles.bmpLineBuffer[j][GBP_TILE_2BIT_LINEPACK_INDEX(i)] >> GBP_TILE_2BIT_LINEPACK_BITOFFSET(i));
-                int b = 0;
-                switch (pixel)
-                {
-                  default:
-                  case 3: b = 0; break;
-                  case 2: b = 64; break;
-                  case 1: b = 130; break;
-                  case 0: b = 255; break;
-                }
-                printf("\x1B[48;2;%d;%d;%dm \x1B[0m", b, b, b);
-              }
-              printf("\r\n");
-            }
-            gbp_tiles_reset(&gbp_tiles);
-          }
-        }
-        else
-        {
-          // Streaming BMP Writer
-          // Dev Note: Done this way to allow for streaming writes to file without a large buffer
-
-          // Open New File
-          if (!gbp_bmp_isopen(&gbp_bmp))
-          {
-            gbp_bmp_open(&gbp_bmp, ofilenameBuf, GBP_TILE_PIXEL_WIDTH*GBP_TILES_PER_LINE);
-          }
-
-          // Write Decode Data Buffer Into BMP
-          for (int j = 0; j < gbp_tiles.tileRowOffset; j++)
-          {
-            const long int tileHeightIncrement = GBP_TILE_PIXEL_HEIGHT*GBP_BMP_MAX_TILE_HEIGHT;
-            gbp_bmp_add(&gbp_bmp, (const uint8_t *) &gbp_tiles.bmpLineBuffer[tileHeightIncrement*j][0], (GBP_TILE_PIXEL_WIDTH*GBP_TILES_PER_LINE), tileHeightIncrement, palletColor);
-          }
-          gbp_tiles_reset(&gbp_tiles); ///< Written to file, clear decoded tile line buffer
-
-          // Print finished and cut requested
-          if (cutPaper)
-          {
-            gbp_bmp_render(&gbp_bmp);
-          }
-        }
+        fprintf(ctx->log, "%02X ", ctx->gbp_pktbuff[i]);
       }
+      fprintf(ctx->log, "\r\n");
     }
-    else
-    {
-      // Support compression payload
-      while (gbp_pkt_decompressor(&gbp_pktBuff, gbp_pktbuff, gbp_pktbuffSize, &tileBuff))
-      {
-        if (gbp_pkt_tileAccu_tileReadyCheck(&tileBuff))
-        {
-          // Got tile
+  }
+  gbp_decode_packetEvent(&ctx->gbp_pktBuff, ctx->gbp_pktbuff, ctx->gbp_pktbuffSize, &ctx->tileBuff, &gbpdecoder_handler, ctx);
+}
+
+// Got tile
+void gbpdecoder_gotTile(void *userData, const uint8_t tile[GBP_TILE_SIZE_IN_BYTE])
+{
+  gbpdecoder_ctx_t *ctx = (gbpdecoder_ctx_t *) userData;
 #if 0     // Output Tile As Hex For Debugging purpose
-          for (int i = 0 ; i < GBP_TILE_SIZE_IN_BYTE ; i++)
-          {
-            printf("%02X ", tileBuff.tile[i]);
-          }
-          printf("\r\n");
+  for (int i = 0 ; i < GBP_TILE_SIZE_IN_BYTE ; i++)
+  {
+    fprintf(ctx->log, "%02X ", tile[i]);
+  }
+  fprintf(ctx->log, "\r\n");
 #endif
-          if (gbp_tiles_line_decoder(&gbp_tiles, tileBuff.tile))
-          {
-            // Line Obtained
+  const uint8_t *decoded = cache_flag ? gbp_cache_decode(&ctx->gbp_cache, tile) : NULL;
+  if (stream_flag)
+  {
+    if (decoded ? gbp_tiles_stream_addDecoded(&ctx->gbp_stream, decoded) : gbp_tiles_stream_decoder(&ctx->gbp_stream, tile))
+      gbpdecoder_streamRows(ctx);
+  }
+  else if (decoded ? gbp_tiles_line_addDecoded(ctx->gbp_tiles, decoded) : gbp_tiles_line_decoder(ctx->gbp_tiles, tile))
+  {
+    // Line Obtained
 #if 0       // Per Line Decoded (Pre Pallet Harmonisation)
-            for (int j = 0; j < GBP_TILE_PIXEL_HEIGHT; j++)
-            {
-              for (int i = 0; i < (GBP_TILE_PIXEL_WIDTH * GBP_TILES_PER_LINE); i++)
-              {
-                int pixel = 0b11 & (gbp_tiles.bmpLineBuffer[j+(gbp_tiles.tileRowOffset-1)*8][GBP_TILE_2BIT_LINEPACK_INDEX(i)] >> GBP_TILE_2BIT_LINEPACK_BITOFFSET(i));;
-                int b = 0;
-                switch (pixel)
-                {
-                  case 0: b = 0; break;
-                  case 1: b = 64; break;
-                  case 2: b = 130; break;
-                  case 3: b = 255; break;
-                }
-                printf("\x1B[48;2;%d;%d;%dm \x1B[0m", b, b, b);
-              }
-              printf("\r\n");
-            }
-#endif
-          }
+    for (int j = 0; j < GBP_TILE_PIXEL_HEIGHT; j++)
+    {
+      for (int i = 0; i < (GBP_TILE_PIXEL_WIDTH * GBP_TILES_PER_LINE); i++)
+      {
+        int pixel = 0b11 & (ctx->gbp_tiles->bmpLineBuffer[j+(ctx->gbp_tiles->tileRowOffset-1)*8][GBP_TILE_2BIT_LINEPACK_INDEX(i)] >> GBP_TILE_2BIT_LINEPACK_BITOFFSET(i));;
+        int b = 0;
+        switch (pixel)
+        {
+          case 0: b = 0; break;
+          case 1: b = 64; break;
+          case 2: b = 130; break;
+          case 3: b = 255; break;
         }
+        fprintf(ctx->log, "\x1B[48;2;%d;%d;%dm \x1B[0m", b, b, b);
       }
+      fprintf(ctx->log, "\r\n");
     }
+#endif
   }
 }
-
@@ -33,6 +33,14 @@ function refresh()
 
     try {
 
+        // C decoder core, if gbp_decoder_wasm.js was built (See gbp_wasm_decoder.js)
+        if ((typeof gbpWasm !== "undefined") && gbpWasm)
+        {
+            var e = document.getElementById("palette");
+            gbpWasmRender(gbpWasmDecode(data.value, paletteColors(e.options[e.selectedIndex].value)));
+            return;
+        }
+
         var rawBytes = toByteArray(data.value);
         // console.log(rawBytes);
 
@@ -242,13 +250,10 @@ function decode(rawBytes)
     return pixels;
 }
 
-// This paints the tile with a specified offset and pixel width
-function paint(canvas, pixels, pixel_width, pixel_height, tile_x_offset, tile_y_offset)
+// Colors of each tone (plus transparent for blank margin tiles) of a palette from the "palette" select
+function paletteColors(palette)
 {
-
-    var e = document.getElementById("palette");
-    var palette = e.options[e.selectedIndex].value;
-
+    var colors;
     switch (palette)
     {
         case "grayscale":
@@ -281,6 +286,17 @@ function paint(canvas, pixels, pixel_width, pixel_height, tile_x_offset, tile_y_
         default:
             colors = new Array("#ffffff", "#aaaaaa", "#555555", "#000000", "#FFFFFF00");
     }
+    return colors;
+}
+
+// This paints the tile with a specified offset and pixel width
+function paint(canvas, pixels, pixel_width, pixel_height, tile_x_offset, tile_y_offset)
+{
+
+    var e = document.getElementById("palette");
+    var palette = e.options[e.selectedIndex].value;
+
+    colors = paletteColors(palette);
     tile_offset = tile_x_offset * tile_y_offset;
     pixel_x_offset = TILE_PIXEL_WIDTH * tile_x_offset * pixel_width;
     pixel_y_offset = TILE_PIXEL_HEIGHT * tile_y_offset * pixel_height;
@@ -0,0 +1,168 @@
+/*
+Gameboy Printer Live Render
+
+Feeds the serial stream to the streaming decoder (gbp_stream_worker.js) and shows each image while it prints.
+Decoding and painting both happen in the worker on an OffscreenCanvas, the page only adds a canvas element
+per image and adjusts its visible height as rows arrive.
+
+The worker is started from a blob so this also works when the page is opened as a local file.
+If no worker can be started the decoder runs on the page instead.
+
+The worker decodes with gbp_decoder_wasm.js when it has been built (See gbp_wasm_decoder.js). On the page it always
+uses the javascript decoder, since the single C decoder instance there belongs to refresh().
+
+*/
+
+var LIVE_CANVAS_SCALE = 3; // Same 480 pixel width as newCanvas()
+
+function GbpStream(container)
+{
+    this.container = container;
+    this.binary = false;
+    this.images = {};
+    this.port = this.startWorker();
+
+    var stream = this;
+    this.port.onmessage = function (event)
+    {
+        stream.onMessage(event.data);
+    };
+}
+
+GbpStream.isSupported = function ()
+{
+    return (typeof OffscreenCanvas !== 'undefined') && ('transferControlToOffscreen' in document.createElement('canvas'));
+};
+
+GbpStream.prototype.startWorker = function ()
+{
+    try
+    {
+        var source = gbpStreamWorker.toString() + '\ngbpStreamWorker(self);\n';
+        var url = URL.createObjectURL(new Blob([source], {type: 'text/javascript'}));
+        var worker = new Worker(url);
+        URL.revokeObjectURL(url);
+        // Relative urls do not work from a blob worker, so the C decoder is found from the page
+        worker.postMessage({type: 'wasm', url: new URL('./gbp_decoder_wasm.js', document.baseURI).href});
+        return worker;
+    } catch (error)
+    {
+        console.log('Streaming decoder runs without a worker: ' + error.message);
+        var channel = new MessageChannel();
+        gbpStreamWorker(channel.port2);
+        return channel.port1;
+    }
+};
+
+// bytes: Uint8Array as read from the serial port
+GbpStream.prototype.write = function (bytes)
+{
+    // The view is copied rather than transferred, the caller may still be using it
+    this.port.postMessage({type: 'data', bytes: bytes});
+};
+
+GbpStream.prototype.reset = function ()
+{
+    this.port.postMessage({type: 'reset'});
+    this.container.innerHTML = '';
+    this.images = {};
+    this.binary = false;
+};
+
+// colors: palette as returned by paletteColors()
+GbpStream.prototype.setPalette = function (colors)
+{
+    var rgba = colors.slice(0, 4).map(function (color)
+    {
+        var hex = color.replace('#', '');
+        return [
+            parseInt(hex.substr(0, 2), 16),
+            parseInt(hex.substr(2, 2), 16),
+            parseInt(hex.substr(4, 2), 16),
+            (hex.length >= 8) ? parseInt(hex.substr(6, 2), 16) : 255
+        ];
+    });
+    this.port.postMessage({type: 'palette', colors: rgba});
+};
+
+GbpStream.prototype.onMessage = function (msg)
+{
+    // Images of a stream before reset() may still report in
+    var image = this.images[msg.id];
+
+    switch (msg.type)
+    {
+        case 'image':
+            this.newImage(msg.id);
+            break;
+        case 'rows':
+            if (image)
+                image.wrapper.style.height = (msg.rows * TILE_PIXEL_HEIGHT * LIVE_CANVAS_SCALE) + 'px';
+            break;
+        case 'done':
+            if (image)
+                image.wrapper.style.height = '';
+            break;
+        case 'binary':
+            this.binary = true;
+            break;
+        case 'blob':
+            this.saveBlob(msg.blob, msg.fileType);
+            break;
+        default:
+            break;
+    }
+};
+
+GbpStream.prototype.newImage = function (id)
+{
+    var container = document.createElement('div');
+    var wrapper = document.createElement('div');
+    var canvas = document.createElement('canvas');
+    container.className = 'image-container';
+    wrapper.style.overflow = 'hidden';
+    wrapper.style.height = '0px';
+    canvas.style.display = 'block';
+    canvas.style.width = (TILE_PIXEL_WIDTH * TILES_PER_LINE * LIVE_CANVAS_SCALE) + 'px';
+    canvas.style.imageRendering = 'pixelated';
+
+    wrapper.appendChild(canvas);
+    container.appendChild(wrapper);
+
+    var stream = this;
+    ['png', 'jpg'].forEach(function (fileType)
+    {
+        var button = document.createElement('button');
+        button.innerText = 'Download ' + fileType.toUpperCase();
+        button.addEventListener('click', function ()
+        {
+            stream.port.postMessage({type: 'download', id: id, fileType: fileType, scale: LIVE_CANVAS_SCALE});
+        });
+        container.appendChild(button);
+    });
+
+    this.container.appendChild(container);
+    this.images[id] = {wrapper: wrapper};
+
+    var offscreen = canvas.transferControlToOffscreen();
+    this.port.postMessage({type: 'canvas', id: id, canvas: offscreen}, [offscreen]);
+};
+
+GbpStream.prototype.saveBlob = function (blob, fileType)
+{
+    var currentdate = new Date();
+    var filename = "Game Boy Photo "
+        + currentdate.getFullYear()
+        + addZero((currentdate.getMonth() + 1))
+        + addZero(currentdate.getDate()) + " - "
+        + addZero(currentdate.getHours()) + ""
+        + addZero(currentdate.getMinutes()) + ""
+        + addZero(currentdate.getSeconds());
+
+    var url = URL.createObjectURL(blob);
+    var download = document.getElementById("download");
+    download.setAttribute("href", url);
+    download.setAttribute("download", filename + '.' + fileType);
+    download.click();
+    setTimeout(function () { URL.revokeObjectURL(url); }, 0);
+};
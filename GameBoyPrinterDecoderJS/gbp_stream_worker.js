@@ -0,0 +1,703 @@
+/*
+Gameboy Printer Streaming Decoder (Web Worker)
+
+Parses the serial stream as it arrives and paints every finished row of 20 tiles into an OffscreenCanvas.
+Accepts both the hex text dump (GBP_OUTPUT_RAW_PACKETS) and the SLIP framed binary output of the emulator
+(See /GameBoyPrinterEmulator/gbp_frame.h). The stream switches to binary on the first SLIP END byte,
+which never appears in the text dump.
+
+Palette: Rows are painted with the palette of the last print (predicted palette) as soon as they are complete.
+Once their own PRINT packet arrives they are only repainted if the palette turned out to be different.
+
+Images: As in transformToClassic(), a PRINT with a lower margin ends the image.
+
+C decoder: If the page sends the url of gbp_decoder_wasm.js (built with `make wasm`, see gbp_wasm.h) and it loads,
+the bytes go to gbp_wasm_write() instead and rows are painted from gbp_wasm_rgba(). Rows then only show up once their
+print arrives, always with its palette. The javascript parser below is kept for when it is not there.
+
+Messages from the page:
+    {type: 'wasm', url}       Load the C decoder from this url (Sent before any data)
+    {type: 'data', bytes: Uint8Array}
+    {type: 'canvas', id, canvas: OffscreenCanvas}  Canvas for an image announced by {type: 'image'}
+    {type: 'palette', colors: [[r, g, b, a] x 4]}
+    {type: 'download', id, fileType: 'png' | 'jpg', scale}
+    {type: 'reset'}
+
+Messages to the page:
+    {type: 'image', id}       New image started, please send a canvas for it
+    {type: 'rows', id, rows}  Row count of the image (canvas may be taller than this until the image is done)
+    {type: 'done', id, rows}  Image finished, canvas is now trimmed to its rows
+    {type: 'binary'}          Stream is SLIP framed binary
+    {type: 'blob', id, fileType, blob}
+*/
+
+function gbpStreamWorker(port)
+{
+    // Packet Constants
+    var COMMAND_PRINT = 0x02;
+    var COMMAND_DATA = 0x04;
+
+    // Tile Constants
+    var TILE_PIXEL_WIDTH = 8;
+    var TILE_PIXEL_HEIGHT = 8;
+    var TILES_PER_LINE = 20; // Gameboy Printer Tile Constant
+    var TILE_SIZE_IN_BYTE = 16;
+    var ROW_PIXEL_WIDTH = TILE_PIXEL_WIDTH * TILES_PER_LINE;
+    var ROW_SIZE_IN_BYTE = TILE_SIZE_IN_BYTE * TILES_PER_LINE;
+    var CANVAS_ROWS_MIN = 18; // One gameboy camera photo
+
+    // Frame Constants (gbp_frame.h)
+    var SLIP_END = 0xC0;
+    var SLIP_ESC = 0xDB;
+    var SLIP_ESC_END = 0xDC;
+    var SLIP_ESC_ESC = 0xDD;
+    var FRAME_TYPE_RAW_PACKET = 0xA1;
+    var FRAME_TYPE_RASTER_ROW = 0xA2;
+    var FRAME_TYPE_RASTER_PRINT = 0xA3;
+    var FRAME_HEADER_SIZE = 2;
+    var FRAME_MAX_SIZE = FRAME_HEADER_SIZE + 10 + 640;
+    var FRAME_RASTER_ROW_SIZE = 1 + TILE_PIXEL_HEIGHT * (ROW_PIXEL_WIDTH / 4);
+    var FRAME_RASTER_PRINT_SIZE = 4;
+
+    // Packet parser states
+    var STATE_AWAIT_MAGIC_BYTES = 0;
+    var STATE_AWAIT_HEADER = 1;
+    var STATE_AWAIT_DATA = 2;
+    var STATE_AWAIT_TRAILER = 3;
+    var PACKET_HEADER_SIZE = 4;  // [COMM][COMP][LEN0][LEN1]
+    var PACKET_TRAILER_SIZE = 4; // [CSUM0][CSUM1][ID][STATUS]
+
+    // C decoder input types (gbp_wasm_input_t)
+    var WASM_INPUT_HEX = 0;
+    var WASM_INPUT_FRAMES = 1;
+
+    var colors = [[255, 255, 255, 255], [170, 170, 170, 255], [85, 85, 85, 255], [0, 0, 0, 255]];
+    var rowImage = new ImageData(ROW_PIXEL_WIDTH, TILE_PIXEL_HEIGHT); // Reused for every row painted
+
+    var binary;
+    var text;
+    var frame;
+    var packet;
+    var tileRow;
+    var predictedPalette;
+    var images;
+    var image;
+    var imageCount;
+
+    var wasm = null;        // C decoder module, once loaded
+    var wasmPending = null; // Input held back while the C decoder loads
+    var wasmImageBase = 0;  // Image id of C decoder image 0 (Its image numbers start over on reset)
+
+    function reset()
+    {
+        binary = false;
+        text = {lineStart: true, comment: false, digits: 0, value: 0, valid: true};
+        frame = {buffer: new Uint8Array(FRAME_MAX_SIZE), size: 0, escape: false, overflow: false};
+        packet = {state: STATE_AWAIT_MAGIC_BYTES, count: 0, header: new Uint8Array(PACKET_HEADER_SIZE),
+                  command: 0, compression: 0, dataLength: 0, print: new Uint8Array(4),
+                  rleMode: 0, rleLength: 0};
+        tileRow = {buffer: new Uint8Array(ROW_SIZE_IN_BYTE), count: 0};
+        predictedPalette = 0xE4;
+        images = {};
+        image = null;
+
+        if (wasmPending)
+            wasmPending = [];
+        if (wasm)
+        {
+            wasm._gbp_wasm_init();
+            wasmSetPalette();
+            wasmImageBase = imageCount;
+        }
+    }
+
+    /**************************************************************************
+     * Input
+     */
+
+    function write(bytes)
+    {
+        if (wasmPending)
+        {
+            wasmPending.push(bytes);
+            return;
+        }
+        if (wasm)
+        {
+            wasmWrite(bytes);
+            return;
+        }
+
+        for (var i = 0; i < bytes.length; i++)
+        {
+            var b = bytes[i];
+            if (!binary && (b === SLIP_END))
+            {
+                binary = true;
+                port.postMessage({type: 'binary'});
+            }
+
+            if (binary)
+                frameByte(b);
+            else
+                textByte(b);
+        }
+    }
+
+    // Same as toByteArray(): lines starting with '//' are comments, everything else is space separated hex bytes
+    // (Also accepts the `0x88, 0x33,` style of the older captures like parseInt() does)
+    function textByte(c)
+    {
+        var isNewline = (c === 0x0A) || (c === 0x0D);
+        var isSpace = isNewline || (c === 0x20) || (c === 0x09) || (c === 0x2C); // ','
+
+        if (!isSpace && text.lineStart && (c === 0x2F)) // '/'
+            text.comment = true;
+        text.lineStart = isNewline;
+
+        if (text.comment)
+        {
+            text.comment = !isNewline;
+            return;
+        }
+
+        if (isSpace)
+        {
+            if (text.valid && (text.digits > 0) && (text.digits <= 2))
+                packetByte(text.value);
+            text.digits = 0;
+            text.value = 0;
+            text.valid = true;
+            return;
+        }
+
+        if ((text.digits === 1) && (text.value === 0) && ((c === 0x78) || (c === 0x58))) // '0x' prefix
+        {
+            text.digits = 0;
+            return;
+        }
+
+        var nibble = hexNibble(c);
+        if (nibble < 0)
+            text.valid = false;
+        text.value = (text.value << 4) | nibble;
+        text.digits++;
+    }
+
+    function hexNibble(c)
+    {
+        if ((c >= 0x30) && (c <= 0x39)) return c - 0x30;      // 0-9
+        if ((c >= 0x41) && (c <= 0x46)) return c - 0x41 + 10; // A-F
+        if ((c >= 0x61) && (c <= 0x66)) return c - 0x61 + 10; // a-f
+        return -1;
+    }
+
+    // Same as gbp_frame_rx_byte()
+    function frameByte(b)
+    {
+        if (b === SLIP_END)
+        {
+            if ((frame.size > 0) && !frame.overflow)
+                frameReceived(frame.buffer.subarray(0, frame.size));
+            frame.size = 0;
+            frame.escape = false;
+            frame.overflow = false;
+            return;
+        }
+
+        var data = b;
+        if (frame.escape)
+        {
+            frame.escape = false;
+            if (b === SLIP_ESC_END)
+                data = SLIP_END;
+            else if (b === SLIP_ESC_ESC)
+                data = SLIP_ESC;
+            else
+                frame.overflow = true; // Protocol violation, discard frame
+        }
+        else if (b === SLIP_ESC)
+        {
+            frame.escape = true;
+            return;
+        }
+
+        if (frame.size >= frame.buffer.length)
+        {
+            frame.overflow = true;
+            return;
+        }
+        frame.buffer[frame.size++] = data;
+    }
+
+    // Text between frames does not have a valid frame header and is dropped here
+    function frameReceived(buff)
+    {
+        var payload = buff.subarray(FRAME_HEADER_SIZE);
+        switch (buff[0])
+        {
+            case FRAME_TYPE_RAW_PACKET:
+                if ((payload.length < 10) || (payload[0] !== 0x88) || (payload[1] !== 0x33))
+                    return;
+                packet.state = STATE_AWAIT_MAGIC_BYTES;
+                packet.count = 0;
+                for (var i = 0; i < payload.length; i++)
+                    packetByte(payload[i]);
+                break;
+            case FRAME_TYPE_RASTER_ROW:
+                if (payload.length === FRAME_RASTER_ROW_SIZE)
+                    addRasterRow(payload.subarray(1));
+                break;
+            case FRAME_TYPE_RASTER_PRINT:
+                if (payload.length === FRAME_RASTER_PRINT_SIZE)
+                    print(payload[1], payload[2]);
+                break;
+            default:
+                break;
+        }
+    }
+
+    /**************************************************************************
+     * Packets
+     */
+
+    // Same as parsePackets(), except DATA is decompressed as it arrives rather than once the packet is complete
+    function packetByte(b)
+    {
+        switch (packet.state)
+        {
+            case STATE_AWAIT_MAGIC_BYTES:
+                if ((packet.count === 0) && (b === 0x88))
+                {
+                    packet.count = 1;
+                }
+                else if ((packet.count === 1) && (b === 0x33))
+                {
+                    packet.count = 0;
+                    packet.state = STATE_AWAIT_HEADER;
+                }
+                else
+                {
+                    packet.count = (b === 0x88) ? 1 : 0;
+                }
+                return;
+
+            case STATE_AWAIT_HEADER:
+                packet.header[packet.count++] = b;
+                if (packet.count < PACKET_HEADER_SIZE)
+                    return;
+                packet.command = packet.header[0];
+                packet.compression = packet.header[1];
+                packet.dataLength = packet.header[2] | (packet.header[3] << 8);
+                packet.rleMode = 0;
+                packet.rleLength = 0;
+                packet.count = 0;
+                packet.state = (packet.dataLength > 0) ? STATE_AWAIT_DATA : STATE_AWAIT_TRAILER;
+                return;
+
+            case STATE_AWAIT_DATA:
+                if (packet.command === COMMAND_DATA)
+                {
+                    if (packet.compression)
+                        unpackByte(b);
+                    else
+                        addTileByte(b);
+                }
+                else if ((packet.command === COMMAND_PRINT) && (packet.count < packet.print.length))
+                {
+                    packet.print[packet.count] = b;
+                }
+
+                packet.count++;
+                if (packet.count >= packet.dataLength)
+                {
+                    packet.count = 0;
+                    packet.state = STATE_AWAIT_TRAILER;
+                }
+                return;
+
+            case STATE_AWAIT_TRAILER:
+                packet.count++;
+                if (packet.count < PACKET_TRAILER_SIZE)
+                    return;
+                if ((packet.command === COMMAND_PRINT) && (packet.dataLength >= 3))
+                    print(packet.print[1], packet.print[2]);
+                packet.count = 0;
+                packet.state = STATE_AWAIT_MAGIC_BYTES;
+                return;
+        }
+    }
+
+    // Same as unpack(), one byte at a time
+    function unpackByte(b)
+    {
+        if (packet.rleLength === 0)
+        {
+            // noinspection JSBitwiseOperatorUsage
+            if (b & 0x80)
+            {
+                packet.rleMode = 1;
+                packet.rleLength = (b & 0x7f) + 2;
+            }
+            else
+            {
+                packet.rleMode = 0;
+                packet.rleLength = b + 1;
+            }
+            return;
+        }
+
+        if (packet.rleMode)
+        {
+            for (; packet.rleLength > 0; packet.rleLength--)
+                addTileByte(b);
+        }
+        else
+        {
+            packet.rleLength--;
+            addTileByte(b);
+        }
+    }
+
+    function addTileByte(b)
+    {
+        tileRow.buffer[tileRow.count++] = b;
+        if (tileRow.count < ROW_SIZE_IN_BYTE)
+            return;
+        tileRow.count = 0;
+
+        // Gameboy tile decoder as per decode()
+        var tones = new Uint8Array(ROW_PIXEL_WIDTH * TILE_PIXEL_HEIGHT);
+        for (var t = 0; t < TILES_PER_LINE; t++)
+        {
+            for (var j = 0; j < TILE_PIXEL_HEIGHT; j++)
+            {
+                var loByte = tileRow.buffer[(t * TILE_SIZE_IN_BYTE) + (j * 2)];
+                var hiByte = tileRow.buffer[(t * TILE_SIZE_IN_BYTE) + (j * 2) + 1];
+                var offset = (j * ROW_PIXEL_WIDTH) + (t * TILE_PIXEL_WIDTH);
+                for (var i = 0; i < TILE_PIXEL_WIDTH; i++)
+                {
+                    var hiBit = (hiByte >> (7 - i)) & 1;
+                    var loBit = (loByte >> (7 - i)) & 1;
+                    tones[offset + i] = (hiBit << 1) | loBit;
+                }
+            }
+        }
+        addRow(tones);
+    }
+
+    // Raster row frame: 2bits per pixel, leftmost pixel in the lowest bits (gbp_tile_t)
+    function addRasterRow(scanlines)
+    {
+        var tones = new Uint8Array(ROW_PIXEL_WIDTH * TILE_PIXEL_HEIGHT);
+        for (var p = 0; p < tones.length; p++)
+            tones[p] = (scanlines[p >> 2] >> ((p & 3) * 2)) & 0x03;
+        addRow(tones);
+    }
+
+    /**************************************************************************
+     * Images
+     */
+
+    function addRow(tones)
+    {
+        if (!image)
+        {
+            image = {id: imageCount++, rows: [], rowCount: 0, printed: 0, canvas: null, ctx: null, capacity: 0};
+            images[image.id] = image;
+            port.postMessage({type: 'image', id: image.id});
+        }
+
+        image.rows.push({tones: tones, palette: predictedPalette});
+        image.rowCount = image.rows.length;
+        if (image.canvas)
+        {
+            if (image.rows.length > image.capacity)
+                resizeCanvas(image, Math.max(CANVAS_ROWS_MIN, image.capacity * 2));
+            else
+                paintRow(image, image.rows.length - 1);
+        }
+        port.postMessage({type: 'rows', id: image.id, rows: image.rows.length});
+    }
+
+    function print(margins, palette)
+    {
+        palette = (palette === 0x00) ? 0xE4 : palette;
+        predictedPalette = palette;
+
+        if (!image)
+            return;
+
+        for (; image.printed < image.rows.length; image.printed++)
+        {
+            var row = image.rows[image.printed];
+            if (row.palette === palette)
+                continue;
+            row.palette = palette;
+            if (image.canvas)
+                paintRow(image, image.printed);
+        }
+
+        if ((margins & 0x0F) !== 0)
+        {
+            if (image.canvas)
+                resizeCanvas(image, image.rows.length);
+            port.postMessage({type: 'done', id: image.id, rows: image.rows.length});
+            image.done = true;
+            image = null;
+        }
+    }
+
+    // Setting the size clears the canvas, so every row is painted again.
+    // The canvas grows by doubling so this only happens a handful of times for a long print.
+    function resizeCanvas(img, capacity)
+    {
+        img.capacity = capacity;
+        img.canvas.width = ROW_PIXEL_WIDTH;
+        img.canvas.height = capacity * TILE_PIXEL_HEIGHT;
+        paintRows(img, 0, img.rowCount);
+    }
+
+    function paintRows(img, first, count)
+    {
+        if (img.wasmImage !== undefined)
+        {
+            wasmPaintRows(img, first, count);
+            return;
+        }
+        for (var r = first; r < (first + count); r++)
+            paintRow(img, r);
+    }
+
+    function paintRow(img, index)
+    {
+        var row = img.rows[index];
+        var data = rowImage.data;
+        for (var p = 0; p < row.tones.length; p++)
+        {
+            var color = colors[(row.palette >> (row.tones[p] * 2)) & 0x03];
+            data[(p * 4) + 0] = color[0];
+            data[(p * 4) + 1] = color[1];
+            data[(p * 4) + 2] = color[2];
+            data[(p * 4) + 3] = color[3];
+        }
+        img.ctx.putImageData(rowImage, 0, index * TILE_PIXEL_HEIGHT);
+    }
+
+    function attachCanvas(id, canvas)
+    {
+        var img = images[id];
+        if (!img)
+            return;
+        img.canvas = canvas;
+        img.ctx = canvas.getContext('2d');
+        resizeCanvas(img, img.done ? img.rowCount : Math.max(CANVAS_ROWS_MIN, img.rowCount));
+    }
+
+    function setPalette(newColors)
+    {
+        colors = newColors;
+        if (wasm)
+            wasmSetPalette();
+        Object.keys(images).forEach(function (id)
+        {
+            var img = images[id];
+            if (!img.canvas)
+                return;
+            paintRows(img, 0, img.rowCount);
+        });
+    }
+
+    // Same size as the images rendered by newCanvas(), with a white background for jpg
+    function download(id, fileType, scale)
+    {
+        var img = images[id];
+        if (!img || !img.canvas)
+            return;
+        var rows = img.rowCount;
+        var out = new OffscreenCanvas(ROW_PIXEL_WIDTH * scale, rows * TILE_PIXEL_HEIGHT * scale);
+        var ctx = out.getContext('2d');
+        ctx.imageSmoothingEnabled = false;
+        if (fileType === 'jpg')
+        {
+            ctx.fillStyle = '#FFFFFFFF';
+            ctx.fillRect(0, 0, out.width, out.height);
+        }
+        ctx.drawImage(img.canvas, 0, 0, ROW_PIXEL_WIDTH, rows * TILE_PIXEL_HEIGHT, 0, 0, out.width, out.height);
+        out.convertToBlob({type: (fileType === 'jpg') ? 'image/jpeg' : 'image/png', quality: 1}).then(function (blob)
+        {
+            port.postMessage({type: 'blob', id: id, fileType: fileType, blob: blob});
+        });
+    }
+
+    /**************************************************************************
+     * C Decoder (gbp_wasm.h)
+     */
+
+    function loadWasm(url)
+    {
+        try
+        {
+            importScripts(url);
+        } catch (error)
+        {
+            console.log('gbp_decoder_wasm.js not built, streaming with the javascript decoder');
+            return;
+        }
+
+        wasmPending = [];
+        GbpDecoderWasm().then(function (module)
+        {
+            wasm = module;
+            wasm._gbp_wasm_init();
+            wasmSetPalette();
+            wasmImageBase = imageCount;
+            wasmResume();
+        }, function (error)
+        {
+            console.log('C decoder failed to start, streaming with the javascript decoder: ' + error);
+            wasmResume();
+        });
+    }
+
+    function wasmResume()
+    {
+        var pending = wasmPending;
+        wasmPending = null;
+        pending.forEach(write);
+    }
+
+    // Same switch to binary on the first SLIP END byte as write()
+    function wasmWrite(bytes)
+    {
+        if (!binary)
+        {
+            var end = bytes.indexOf(SLIP_END);
+            wasmInput((end < 0) ? bytes : bytes.subarray(0, end), WASM_INPUT_HEX);
+            if (end >= 0)
+            {
+                binary = true;
+                port.postMessage({type: 'binary'});
+                wasmInput(bytes.subarray(end), WASM_INPUT_FRAMES);
+            }
+        }
+        else
+        {
+            wasmInput(bytes, WASM_INPUT_FRAMES);
+        }
+        wasmUpdate();
+    }
+
+    function wasmInput(bytes, inputType)
+    {
+        var inputSize = wasm._gbp_wasm_inputSize();
+        for (var i = 0; i < bytes.length; i += inputSize)
+        {
+            var chunk = bytes.subarray(i, i + inputSize);
+            // Dev Note: HEAPU8 is replaced when memory grows, so it is fetched again after every call
+            wasm.HEAPU8.set(chunk, wasm._gbp_wasm_input());
+            if (!wasm._gbp_wasm_write(chunk.length, inputType))
+                console.log('C decoder out of memory');
+        }
+    }
+
+    // Announce and paint what the C decoder added, same messages as addRow() and print()
+    function wasmUpdate()
+    {
+        for (var n = 0; n < wasm._gbp_wasm_imageCount(); n++)
+        {
+            var img = images[wasmImageBase + n];
+            if (!img)
+            {
+                img = {id: wasmImageBase + n, wasmImage: n, rowCount: 0, canvas: null, ctx: null, capacity: 0};
+                images[img.id] = img;
+                imageCount = img.id + 1;
+                port.postMessage({type: 'image', id: img.id});
+            }
+            if (img.done)
+                continue;
+
+            var rows = wasm._gbp_wasm_imageRows(n);
+            if (rows !== img.rowCount)
+            {
+                var first = img.rowCount;
+                img.rowCount = rows;
+                if (img.canvas)
+                {
+                    if (rows > img.capacity)
+                        resizeCanvas(img, Math.max(CANVAS_ROWS_MIN, img.capacity * 2, rows));
+                    else
+                        paintRows(img, first, rows - first);
+                }
+                port.postMessage({type: 'rows', id: img.id, rows: rows});
+            }
+
+            if (wasm._gbp_wasm_imageDone(n))
+            {
+                if (img.canvas)
+                    resizeCanvas(img, img.rowCount);
+                port.postMessage({type: 'done', id: img.id, rows: img.rowCount});
+                img.done = true;
+            }
+        }
+    }
+
+    // Dev Note: gbp_wasm_setPallet() has no alpha, same as gbpWasmDecode()
+    function wasmSetPalette()
+    {
+        var rgb = colors.map(function (color)
+        {
+            return (color[0] << 16) | (color[1] << 8) | color[2];
+        });
+        wasm._gbp_wasm_setPallet(rgb[0], rgb[1], rgb[2], rgb[3]);
+    }
+
+    function wasmPaintRows(img, first, count)
+    {
+        if (count <= 0)
+            return;
+        var rgba = wasm._gbp_wasm_rgba(img.wasmImage, first, count);
+        if (!rgba)
+            return;
+        var size = count * TILE_PIXEL_HEIGHT * ROW_PIXEL_WIDTH * 4;
+        var pixels = new Uint8ClampedArray(wasm.HEAPU8.subarray(rgba, rgba + size)); // Copy out of linear memory
+        img.ctx.putImageData(new ImageData(pixels, ROW_PIXEL_WIDTH, count * TILE_PIXEL_HEIGHT), 0, first * TILE_PIXEL_HEIGHT);
+    }
+
+    port.onmessage = function (event)
+    {
+        var msg = event.data;
+        switch (msg.type)
+        {
+            case 'wasm':
+                loadWasm(msg.url);
+                break;
+            case 'data':
+                write(msg.bytes);
+                break;
+            case 'canvas':
+                attachCanvas(msg.id, msg.canvas);
+                break;
+            case 'palette':
+                setPalette(msg.colors);
+                break;
+            case 'download':
+                download(msg.id, msg.fileType, msg.scale || 1);
+                break;
+            case 'reset':
+                reset();
+                break;
+            default:
+                break;
+        }
+    };
+
+    imageCount = 0; // Not reset, so the page can tell images from before a reset apart
+    reset();
+}
+
+// Loaded directly as a worker script (e.g. when served over http)
+if ((typeof WorkerGlobalScope !== 'undefined') && (self instanceof WorkerGlobalScope))
+{
+    gbpStreamWorker(self);
+}
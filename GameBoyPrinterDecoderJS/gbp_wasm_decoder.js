@@ -0,0 +1,95 @@
+/*
+Gameboy Printer WebAssembly Decoder
+
+Loads gbp_decoder_wasm.js (the C decoder core, built with `make wasm` in /GameBoyPrinterDecoderC, see gbp_wasm.h)
+if it is there. refresh() then decodes with it instead of the javascript decoder in rawFunctions.js.
+Without it the page works as before.
+
+*/
+
+// Input types (gbp_wasm_input_t)
+GBP_WASM_INPUT_HEX = 0;
+GBP_WASM_INPUT_FRAMES = 1;
+GBP_WASM_INPUT_PACKETS = 2;
+
+var gbpWasm = null; // Module once loaded
+
+document.addEventListener('DOMContentLoaded', function ()
+{
+    var script = document.createElement('script');
+    script.src = './gbp_decoder_wasm.js';
+    script.onload = function ()
+    {
+        GbpDecoderWasm().then(function (module)
+        {
+            gbpWasm = module;
+            refresh();
+        });
+    };
+    script.onerror = function ()
+    {
+        console.log('gbp_decoder_wasm.js not built, using the javascript decoder');
+    };
+    document.head.appendChild(script);
+});
+
+// colors: palette as returned by paletteColors()
+// Returns the images as [{rows, imageData}], with one ImageData at 1 pixel per dot
+function gbpWasmDecode(text, colors, inputType)
+{
+    var m = gbpWasm;
+    var rgb = colors.slice(0, 4).map(function (color)
+    {
+        return parseInt(color.replace('#', '').substr(0, 6), 16);
+    });
+
+    m._gbp_wasm_init();
+    m._gbp_wasm_setPallet(rgb[0], rgb[1], rgb[2], rgb[3]);
+
+    var bytes = (typeof text === 'string') ? new TextEncoder().encode(text) : text;
+    var inputSize = m._gbp_wasm_inputSize();
+    for (var i = 0; i < bytes.length; i += inputSize)
+    {
+        var chunk = bytes.subarray(i, i + inputSize);
+        // Dev Note: HEAPU8 is replaced when memory grows, so it is fetched again after every call
+        m.HEAPU8.set(chunk, m._gbp_wasm_input());
+        if (!m._gbp_wasm_write(chunk.length, inputType || GBP_WASM_INPUT_HEX))
+            throw new Error('Out of memory while decoding');
+    }
+
+    var width = TILE_PIXEL_WIDTH * TILES_PER_LINE;
+    var images = [];
+    for (var n = 0; n < m._gbp_wasm_imageCount(); n++)
+    {
+        var rows = m._gbp_wasm_imageRows(n);
+        var rgba = m._gbp_wasm_rgba(n, 0, rows);
+        if (!rgba)
+            continue;
+        var size = rows * TILE_PIXEL_HEIGHT * width * 4;
+        var pixels = new Uint8ClampedArray(m.HEAPU8.subarray(rgba, rgba + size)); // Copy out of linear memory
+        images.push({rows: rows, imageData: new ImageData(pixels, width, rows * TILE_PIXEL_HEIGHT)});
+    }
+    return images;
+}
+
+// Same output as renderImage(), from whole images instead of tiles
+function gbpWasmRender(images)
+{
+    document.getElementById('images').innerHTML = '';
+
+    images.forEach(function (image)
+    {
+        var canvas = newCanvas();
+        var scale = canvas.width / image.imageData.width;
+        canvas.height = image.imageData.height * scale;
+
+        var dots = document.createElement('canvas');
+        dots.width = image.imageData.width;
+        dots.height = image.imageData.height;
+        dots.getContext('2d').putImageData(image.imageData, 0, 0);
+
+        var ctx = canvas.getContext('2d');
+        ctx.imageSmoothingEnabled = false;
+        ctx.drawImage(dots, 0, 0, canvas.width, canvas.height);
+    });
+}
@@ -58,7 +58,8 @@ class WebSerialPort {
     // add an incoming data event:
     // TODO: data should probably be an ArrayBuffer or Stream
     this.incoming = {
-      data: null
+      data: null,
+      bytes: null
     }
     // incoming serial data event:
     this.dataEvent = new CustomEvent('data', {
@@ -144,6 +145,7 @@ class WebSerialPort {
           // convert the input to a text string:
           // TODO: make it possible to receive as binary:
           this.incoming.data = new TextDecoder().decode(value);
+          this.incoming.bytes = value;
 
           // fire the event:
           parent.dispatchEvent(this.dataEvent);
@@ -183,6 +185,7 @@ let webserial;
 let serialButton = document.getElementById("selectSerial");
 let readContainer = document.getElementById('data_text');
 let autoClear = true;
+let liveDecoder = null;
 
 function setup() {
     webserial = new WebSerialPort();
@@ -190,6 +193,12 @@ function setup() {
         webserial.on('data', serialRead);
         serialButton.addEventListener("click", openClosePort);
     }
+    if (typeof GbpStream !== 'undefined' && GbpStream.isSupported()) {
+        liveDecoder = new GbpStream(document.getElementById('live_images'));
+        let palette = document.getElementById('palette');
+        liveDecoder.setPalette(paletteColors(palette.value));
+        palette.addEventListener('change', () => liveDecoder.setPalette(paletteColors(palette.value)));
+    }
 }
 
 async function openClosePort() {
@@ -209,6 +218,17 @@ function serialRead(event) {
     if ((autoClear && !new_data.includes('650B')) || new_data.includes('GAMEBOY PRINTER')) {
         readContainer.value = '';
         autoClear = false;
+        if (liveDecoder) {
+            liveDecoder.reset();
+        }
+    }
+
+    if (liveDecoder) {
+        liveDecoder.write(event.detail.bytes);
+        // Binary frames can only be decoded live
+        if (liveDecoder.binary) {
+            return;
+        }
     }
 
     readContainer.value += new_data;
@@ -34,25 +34,64 @@ WebUSB WebUSBSerial(1, "herrzatacke.github.io/gb-printer-web/#/webusb");
 
 #define GAME_BOY_PRINTER_MODE      true   // to use with https://github.com/Mraulio/GBCamera-Android-Manager and https://github.com/Raphael-Boichot/PC-to-Game-Boy-Printer-interface
 #define GBP_OUTPUT_RAW_PACKETS     true   // by default, packets are parsed. if enabled, output will change to raw data packets for parsing and decompressing later
+#define GBP_OUTPUT_BINARY_FRAMES   false  // raw packet mode only. if enabled, raw packets are sent as SLIP framed binary instead of hex text (decode with `gpbdecoder -b`)
+#define GBP_USE_SPOOL              false  // raw packet mode only. captured packets are spooled to an SD card and sent as fast as the host takes them, so prints survive a slow or disconnected host. needs more ram than a nano has (Mega, SAMD21, SAMD51, ESP32)
 #define GBP_USE_PARSE_DECOMPRESSOR false  // embedded decompressor can be enabled for use with parse mode but it requires fast hardware (SAMD21, SAMD51, ESP8266, ESP32)
+#define GBP_OUTPUT_RASTER_ROWS     false  // parse mode with decompressor only. if enabled, tiles are decoded into 8 pixel high rows and sent as SLIP framed 2bpp binary instead of hex tiles (decode with `gpbdecoder -b`)
+#define GBP_USE_ADAPTIVE_BUSY      false  // if enabled, the printer only reports busy after a print for as long as the host is still taking in the buffered data (shortest print time on fast hosts, no overflow on slow ones)
+#define GBP_USE_HARDWARE_SPI_SLAVE false  // AVR only. capture link bytes with the SPI peripheral in slave mode (one interrupt per byte instead of per bit). uses different pins, see below
 
 #include <stdint.h>  // uint8_t
 #include <stddef.h>  // size_t
 
-#include "gameboy_printer_protocol.h"
+#include "src/gbp_core/gameboy_printer_protocol.h"
 #include "gbp_serial_io.h"
 
 #if GBP_OUTPUT_RAW_PACKETS
 #define GBP_FEATURE_PACKET_CAPTURE_MODE
+#if GBP_OUTPUT_BINARY_FRAMES
+#define GBP_FEATURE_PACKET_CAPTURE_BINARY_FRAMES
+#endif
+#if GBP_USE_SPOOL
+#define GBP_FEATURE_PACKET_CAPTURE_SPOOL
+#endif
 #else
 #define GBP_FEATURE_PARSE_PACKET_MODE
 #if GBP_USE_PARSE_DECOMPRESSOR
 #define GBP_FEATURE_PARSE_PACKET_USE_DECOMPRESSOR
+#if GBP_OUTPUT_RASTER_ROWS
+#define GBP_FEATURE_PARSE_PACKET_RASTER_ROWS
+#endif
 #endif
 #endif
 
 #ifdef GBP_FEATURE_PARSE_PACKET_MODE
-#include "gbp_pkt.h"
+#include "src/gbp_core/gbp_pkt.h"
+#endif
+
+#ifdef GBP_FEATURE_PARSE_PACKET_RASTER_ROWS
+#include "src/gbp_core/gbp_tiles.h"
+#endif
+
+#if defined(GBP_FEATURE_PACKET_CAPTURE_MODE) || defined(GBP_FEATURE_PARSE_PACKET_RASTER_ROWS) || defined(GBP_FEATURE_SERIAL_IO_STATS)
+#include "src/gbp_core/gbp_frame.h"
+#endif
+
+#ifdef GBP_FEATURE_PACKET_CAPTURE_SPOOL
+#include <SPI.h>
+#include <SD.h>
+#include "gbp_spool.h"
+#endif
+
+#if GBP_USE_HARDWARE_SPI_SLAVE
+#define GBP_FEATURE_HARDWARE_SPI_SLAVE
+#ifndef __AVR__
+#error "GBP_USE_HARDWARE_SPI_SLAVE is only supported on AVR boards (e.g. Arduino Nano/Uno/Mega) so far"
+#endif
+#endif
+
+#if defined(FEATURE_CHECKSUM_SUPPORTED) && defined(GBP_FEATURE_PARSE_PACKET_MODE)
+#error "FEATURE_CHECKSUM_SUPPORTED (see gbp_serial_io.h) stages whole packets before they are parsed, which do not fit in the parse mode buffer"
 #endif
 
 
@@ -76,6 +115,21 @@ WebUSB WebUSBSerial(1, "herrzatacke.github.io/gb-printer-web/#/webusb");
 #define GBP_SC_PIN       14       // Pin 5            : ESP-pin 5 CLK  (Serial Clock)  -> Arduino 14
 #define GBP_GND_PIN               // Pin 6            : GND (Attach to GND Pin)
 #define LED_STATUS_PIN    2       // Internal LED blink on packet reception
+#elif defined(GBP_FEATURE_HARDWARE_SPI_SLAVE)
+// Pin Setup for Arduinos (AVR) using the SPI peripheral in slave mode
+// Note: Built in LED is on SCK, so use an external LED on LED_STATUS_PIN if needed
+//                  | Arduino Pin | Gameboy Link Pin  |
+#define GBP_VCC_PIN               // Pin 1            : 5.0V (Unused)
+#define GBP_SO_PIN       MOSI     // Pin 2            : Serial OUTPUT -> SPI MOSI (Nano/Uno: 11)
+#define GBP_SI_PIN       MISO     // Pin 3            : Serial INPUT  -> SPI MISO (Nano/Uno: 12)
+#define GBP_SD_PIN                // Pin 4            : Serial Data  (Unused)
+#define GBP_SC_PIN       SCK      // Pin 5            : Serial Clock  -> SPI SCK  (Nano/Uno: 13)
+#define GBP_GND_PIN               // Pin 6            : GND (Attach to GND Pin)
+#define GBP_SS_PIN       SS       // SPI Slave Select must be tied to GND (Nano/Uno: 10)
+#define LED_STATUS_PIN    9       // External LED blink on packet reception
+#ifdef GBP_FEATURE_PACKET_CAPTURE_SPOOL
+#error "GBP_USE_SPOOL needs the SPI bus for the SD card, so cannot be used with GBP_USE_HARDWARE_SPI_SLAVE"
+#endif
 #else
 // Pin Setup for Arduinos
 //                  | Arduino Pin | Gameboy Link Pin  |
@@ -89,17 +143,39 @@ WebUSB WebUSBSerial(1, "herrzatacke.github.io/gb-printer-web/#/webusb");
 #endif
 // clang-format on
 
+#ifdef GBP_FEATURE_PACKET_CAPTURE_SPOOL
+// SD card on the default SPI bus
+#define GBP_SPOOL_SD_CS_PIN   SS
+#define GBP_SPOOL_FILE        "GBPSPOOL.BIN"
+#define GBP_SPOOL_BLOCK_COUNT 2048  // 1MiB (Oldest blocks are dropped if the host has not taken them yet)
+#ifdef ESP32
+#define GBP_SPOOL_FILE_MODE "w+"
+#else
+#define GBP_SPOOL_FILE_MODE (O_READ | O_WRITE | O_CREAT | O_TRUNC)  // Not FILE_WRITE, as that appends on every write
+#endif
+#endif
+
 /*******************************************************************************
 *******************************************************************************/
 
 // Dev Note: Gamboy camera sends data payload of 640 bytes usually
 
-#ifdef GBP_FEATURE_PARSE_PACKET_MODE
+#ifdef GBP_SERIAL_IO_BUFFER_SIZE_POW2
+#define GBP_BUFFER_SIZE GBP_SERIAL_IO_BUFFER_SIZE_POW2  // Compile time specialised buffer size (See gbp_serial_io.h)
+#elif defined(GBP_FEATURE_PARSE_PACKET_MODE)
 #define GBP_BUFFER_SIZE 400
+#elif defined(FEATURE_CHECKSUM_SUPPORTED)
+#define GBP_BUFFER_SIZE 1024  // Whole packets are staged before the host sees them, so leave room for the host to lag behind a data packet
 #else
 #define GBP_BUFFER_SIZE 650
 #endif
 
+#if GBP_USE_ADAPTIVE_BUSY
+// Hold busy once the buffer is this full, until it is back down to the low watermark
+#define GBP_FLOW_LOW_WATERMARK  (GBP_BUFFER_SIZE / 4)
+#define GBP_FLOW_HIGH_WATERMARK ((GBP_BUFFER_SIZE * 3) / 4)
+#endif
+
 /* Serial IO */
 // This circular buffer contains a stream of raw packets from the gameboy
 uint8_t gbp_serialIO_raw_buffer[GBP_BUFFER_SIZE] = { 0 };
@@ -112,6 +188,18 @@ uint8_t gbp_pktbuffSize                                = 0;
 #ifdef GBP_FEATURE_PARSE_PACKET_USE_DECOMPRESSOR
 gbp_pkt_tileAcc_t tileBuff = { 0 };
 #endif
+#ifdef GBP_FEATURE_PARSE_PACKET_RASTER_ROWS
+/* Decoded Rows (Only a few rows kept, as each is sent once complete) */
+gbp_tiles_rowRing_t gbp_rowRing;
+uint8_t gbp_rasterFrameCount = 0;
+#endif
+#endif
+
+#ifdef GBP_FEATURE_PACKET_CAPTURE_SPOOL
+/* Spool (Capture -> Serial IO Buffer -> Spool -> Host) */
+gbp_spool_t gbp_spool;
+File gbp_spoolFile;
+bool gbp_spoolCompletedPending = false;
 #endif
 
 #ifdef GBP_FEATURE_PACKET_CAPTURE_MODE
@@ -119,12 +207,167 @@ inline void gbp_packet_capture_loop();
 #endif
 #ifdef GBP_FEATURE_PARSE_PACKET_MODE
 inline void gbp_parse_packet_loop();
+void gbp_parse_packet_event(gbp_pkt_t *_pkt, uint8_t buffer[], const uint8_t bufferSize, void *userData);
+#endif
+
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+// ISR duration is sampled with the cheapest clock available (Cycle counter on ESP, otherwise micros())
+#if defined(ESP8266) || defined(ESP32)
+#define GBP_STATS_ISR_CLOCK()      ESP.getCycleCount()
+#define GBP_STATS_ISR_CLOCK_UNIT   "cycles"
+#else
+#define GBP_STATS_ISR_CLOCK()      micros()
+#define GBP_STATS_ISR_CLOCK_UNIT   "us"
+#endif
+#define GBP_STATS_ISR_BEGIN()      const uint32_t isrStart = GBP_STATS_ISR_CLOCK()
+#define GBP_STATS_ISR_END()        gbp_serial_io_stats_isr(&gbp_serial_io_default, GBP_STATS_ISR_CLOCK() - isrStart)
+#else
+#define GBP_STATS_ISR_BEGIN()
+#define GBP_STATS_ISR_END()
 #endif
 
 /*******************************************************************************
   Utility Functions
 *******************************************************************************/
 
+#if defined(GBP_FEATURE_PACKET_CAPTURE_BINARY_FRAMES) || defined(GBP_FEATURE_PARSE_PACKET_RASTER_ROWS) || defined(GBP_FEATURE_SERIAL_IO_STATS)
+// Write frame content with SLIP escaping (See gbp_frame.h)
+// Dev Note: Runs of plain bytes go out in one Serial.write(), only escape bytes are written separately
+void gbp_frame_serial_write(const uint8_t *data, const size_t size)
+{
+  size_t runStart = 0;
+  for (size_t i = 0; i < size; i++)
+  {
+    if ((data[i] == GBP_FRAME_SLIP_END) || (data[i] == GBP_FRAME_SLIP_ESC))
+    {
+      uint8_t escaped[2];
+      Serial.write(&data[runStart], i - runStart);
+      Serial.write(escaped, gbp_frame_slip_escape(escaped, data[i]));
+      runStart = i + 1;
+    }
+  }
+  Serial.write(&data[runStart], size - runStart);
+}
+#endif
+
+#ifdef GBP_FEATURE_PARSE_PACKET_RASTER_ROWS
+// Send a whole [END][TYPE][SEQ][...][END] frame
+void gbp_frame_serial_send(const uint8_t type, const uint8_t *data, const size_t size)
+{
+  const uint8_t frameHeader[GBP_FRAME_HEADER_SIZE] = { type, gbp_rasterFrameCount++ };
+  Serial.write((uint8_t)GBP_FRAME_SLIP_END);
+  gbp_frame_serial_write(frameHeader, sizeof(frameHeader));
+  gbp_frame_serial_write(data, size);
+  Serial.write((uint8_t)GBP_FRAME_SLIP_END);
+}
+#endif
+
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+// Human readable counters for the diagnostics console
+void gbp_stats_print(void)
+{
+  const gbp_serial_io_stats_t *stats = &gbp_serial_io_default.pktIO.stats;
+  uint32_t packetTotal = 0;
+  for (int i = 0; i < GBP_STATUS_KIND_COUNT; i++)
+  {
+    packetTotal += stats->packets[i];
+  }
+  Serial.print("bytes: ");
+  Serial.print(stats->bytesEnqueued);
+  Serial.print(", enqueue failed: ");
+  Serial.print(stats->enqueueFailures);
+  Serial.print(", resyncs: ");
+  Serial.print(stats->preambleResyncs);
+  Serial.print(", checksum failed: ");
+  Serial.println(stats->checksumFailures);
+  Serial.print("packets: INIT=");
+  Serial.print(stats->packets[GBP_STATUS_KIND_INIT]);
+  Serial.print(" PRNT=");
+  Serial.print(stats->packets[GBP_STATUS_KIND_PRINT]);
+  Serial.print(" DATA=");
+  Serial.print(stats->packets[GBP_STATUS_KIND_DATA] + stats->packets[GBP_STATUS_KIND_DATA_END]);
+  Serial.print(" BREK=");
+  Serial.print(stats->packets[GBP_STATUS_KIND_BREAK]);
+  Serial.print(" INQY=");
+  Serial.print(stats->packets[GBP_STATUS_KIND_INQUIRY]);
+  Serial.print(" ?=");
+  Serial.println(stats->packets[GBP_STATUS_KIND_OTHER]);
+  Serial.print("isr max: ");
+  Serial.print(stats->isrMax);
+  Serial.println(" " GBP_STATS_ISR_CLOCK_UNIT);
+  Serial.print("host out: ");
+  Serial.print(stats->hostOutUs);
+  Serial.print("us total, ");
+  Serial.print(packetTotal ? (stats->hostOutUs / packetTotal) : 0);
+  Serial.print("us per packet, ");
+  Serial.print(stats->hostOutMaxUs);
+  Serial.println("us max");
+}
+
+// Counters as a [END][TYPE][SEQ][packed gbp_serial_io_stats_t][END] frame (Decode with gbp_serial_io_stats_pack() layout)
+void gbp_stats_send(void)
+{
+  uint8_t packed[GBP_SERIAL_IO_STATS_PACKED_SIZE];
+  const uint8_t frameHeader[GBP_FRAME_HEADER_SIZE] = { GBP_FRAME_TYPE_STATS, 0 };
+  const size_t packedSize = gbp_serial_io_stats_pack(packed);
+  Serial.write((uint8_t)GBP_FRAME_SLIP_END);
+  gbp_frame_serial_write(frameHeader, sizeof(frameHeader));
+  gbp_frame_serial_write(packed, packedSize);
+  Serial.write((uint8_t)GBP_FRAME_SLIP_END);
+}
+#endif
+
+#ifdef GBP_FEATURE_PACKET_CAPTURE_SPOOL
+bool gbp_spool_sd_read(void *dev, uint32_t addr, uint8_t *data, size_t size)
+{
+  File *file = (File *)dev;
+  return file->seek(addr) && (file->read(data, size) == (int)size);
+}
+
+bool gbp_spool_sd_write(void *dev, uint32_t block, const uint8_t data[GBP_SPOOL_BLOCK_SIZE])
+{
+  File *file = (File *)dev;
+  return file->seek(block * GBP_SPOOL_BLOCK_SIZE) && (file->write(data, GBP_SPOOL_BLOCK_SIZE) == GBP_SPOOL_BLOCK_SIZE);
+}
+
+// Move everything captured so far into the spool, so capture is never held back by the host
+// (Without an SD card whatever does not fit in the ram block waits in the serial io buffer)
+inline void gbp_spool_fill_loop(void)
+{
+  const uint8_t *span = NULL;
+  size_t spanSize     = 0;
+  while ((spanSize = gbp_serial_io_dataBuff_getSpan(&span)) > 0)
+  {
+    const size_t written = gbp_spool_write(&gbp_spool, span, spanSize);
+    gbp_serial_io_dataBuff_consume(written);
+    if (written < spanSize)
+    {
+      break;
+    }
+  }
+}
+
+// Packet capture loops read from the spool instead of the serial io buffer
+#define gbp_capture_getSpan(SPAN)     gbp_spool_getSpan(&gbp_spool, SPAN)
+#define gbp_capture_consume(BYTECOUNT) gbp_spool_consume(&gbp_spool, BYTECOUNT)
+#else
+#define gbp_capture_getSpan(SPAN)     gbp_serial_io_dataBuff_getSpan(SPAN)
+#define gbp_capture_consume(BYTECOUNT) gbp_serial_io_dataBuff_consume(BYTECOUNT)
+#endif
+
+void gbp_completed_message(void)
+{
+  Serial.println("");
+  Serial.print("// Completed ");
+  Serial.print("(Memory Waterline: ");
+  Serial.print(gbp_serial_io_dataBuff_waterline(false));
+  Serial.print("B out of ");
+  Serial.print(gbp_serial_io_dataBuff_max());
+  Serial.println("B)");
+  Serial.flush();
+  digitalWrite(LED_STATUS_PIN, LOW);
+}
+
 const char *gbpCommand_toStr(int val)
 {
   switch (val)
@@ -142,12 +385,30 @@ const char *gbpCommand_toStr(int val)
   Interrupt Service Routine
 *******************************************************************************/
 
+#ifdef GBP_FEATURE_HARDWARE_SPI_SLAVE
+// SPI Serial Transfer Complete (The peripheral shifts the whole byte in and out)
+ISR(SPI_STC_vect)
+{
+  GBP_STATS_ISR_BEGIN();
+  SPDR = gpb_serial_io_OnByte_ISR(SPDR);  ///< Shifted out while the next byte is shifted in
+  GBP_STATS_ISR_END();
+}
+
+// (Re)start the SPI slave so that its bit counter is aligned to the start of the next packet
+void gbp_spi_slave_resync(void)
+{
+  SPCR = 0;
+  SPCR = _BV(SPE) | _BV(SPIE) | _BV(CPOL) | _BV(CPHA);  // Slave, MSB first, Mode 3 (Idle high, sample on rising edge)
+  SPDR = 0x00;
+}
+#else
 #ifdef ESP8266
 void ICACHE_RAM_ATTR serialClock_ISR(void)
 #else
 void serialClock_ISR(void)
 #endif
 {
+  GBP_STATS_ISR_BEGIN();
   // Serial Clock (1 = Rising Edge) (0 = Falling Edge); Master Output Slave Input (This device is slave)
 #ifdef GBP_FEATURE_USING_RISING_CLOCK_ONLY_ISR
   const bool txBit = gpb_serial_io_OnRising_ISR(digitalRead(GBP_SO_PIN));
@@ -155,7 +416,9 @@ void serialClock_ISR(void)
   const bool txBit = gpb_serial_io_OnChange_ISR(digitalRead(GBP_SC_PIN), digitalRead(GBP_SO_PIN));
 #endif
   digitalWrite(GBP_SI_PIN, txBit ? HIGH : LOW);
+  GBP_STATS_ISR_END();
 }
+#endif
 
 
 /*******************************************************************************
@@ -177,6 +440,9 @@ void setup(void)
   pinMode(GBP_SC_PIN, INPUT);
   pinMode(GBP_SO_PIN, INPUT);
   pinMode(GBP_SI_PIN, OUTPUT);
+#ifdef GBP_FEATURE_HARDWARE_SPI_SLAVE
+  pinMode(GBP_SS_PIN, INPUT);
+#endif
 
   /* Default link serial out pin state */
   digitalWrite(GBP_SI_PIN, LOW);
@@ -187,9 +453,14 @@ void setup(void)
 
   /* Setup */
   gpb_serial_io_init(sizeof(gbp_serialIO_raw_buffer), gbp_serialIO_raw_buffer);
+#if GBP_USE_ADAPTIVE_BUSY
+  gbp_serial_io_flow_config(GBP_FLOW_LOW_WATERMARK, GBP_FLOW_HIGH_WATERMARK);
+#endif
 
   /* Attach ISR */
-#ifdef GBP_FEATURE_USING_RISING_CLOCK_ONLY_ISR
+#ifdef GBP_FEATURE_HARDWARE_SPI_SLAVE
+  gbp_spi_slave_resync();
+#elif defined(GBP_FEATURE_USING_RISING_CLOCK_ONLY_ISR)
   attachInterrupt(digitalPinToInterrupt(GBP_SC_PIN), serialClock_ISR, RISING);  // attach interrupt handler
 #else
   attachInterrupt(digitalPinToInterrupt(GBP_SC_PIN), serialClock_ISR, CHANGE);  // attach interrupt handler
@@ -200,6 +471,23 @@ void setup(void)
   gbp_pkt_init(&gbp_pktState);
 #endif
 
+  /* Spool */
+#ifdef GBP_FEATURE_PACKET_CAPTURE_SPOOL
+  if (SD.begin(GBP_SPOOL_SD_CS_PIN))
+  {
+    SD.remove(GBP_SPOOL_FILE);
+    gbp_spoolFile = SD.open(GBP_SPOOL_FILE, GBP_SPOOL_FILE_MODE);
+  }
+  if (gbp_spoolFile)
+  {
+    gbp_spool_init(&gbp_spool, &gbp_spoolFile, GBP_SPOOL_BLOCK_COUNT, gbp_spool_sd_read, gbp_spool_sd_write);
+  }
+  else
+  {
+    gbp_spool_init(&gbp_spool, NULL, 0, NULL, NULL);
+  }
+#endif
+
 #define VERSION_STRING "V3.2.1 (Copyright (C) 2022 Brian Khuu)"
 
   /* Welcome Message */
@@ -208,6 +496,12 @@ void setup(void)
   Serial.println(F("// Note: Each byte is from each GBP packet is from the gameboy"));
   Serial.println(F("//       except for the last two bytes which is from the printer"));
   Serial.println(F("// JS Raw Packet Decoder: https://mofosyne.github.io/arduino-gameboy-printer-emulator/GameBoyPrinterDecoderJS/gameboy_printer_js_raw_decoder.html"));
+#ifdef GBP_FEATURE_PACKET_CAPTURE_BINARY_FRAMES
+  Serial.println(F("// Note: Packets are sent as SLIP framed binary. Decode with `gpbdecoder -b`"));
+#endif
+#ifdef GBP_FEATURE_PACKET_CAPTURE_SPOOL
+  Serial.println(gbp_spoolFile ? F("// Note: Packets are spooled to SD card (" GBP_SPOOL_FILE ")") : F("// Note: No SD card found, packets are only spooled in ram"));
+#endif
 #endif
 #ifdef GBP_FEATURE_PARSE_PACKET_MODE
   Serial.println(F("// GAMEBOY PRINTER Emulator " VERSION_STRING));
@@ -227,12 +521,39 @@ void loop()
 {
   static uint16_t sioWaterline = 0;
 
+#ifdef GBP_FEATURE_STATUS_PRECOMPUTE
+  // Prepare the status response of the next packet so the ISR does not have to
+  gbp_serial_io_status_service();
+#endif
+
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+  // Only time loops that had something to send, so idle passes do not dilute the average
+  const bool hostOutPending = (gbp_serial_io_dataBuff_getByteCount() > 0);
+  const uint32_t hostOutStart = micros();
+#endif
+#ifdef GBP_FEATURE_PACKET_CAPTURE_SPOOL
+  gbp_spool_fill_loop();
+#endif
 #ifdef GBP_FEATURE_PACKET_CAPTURE_MODE
   gbp_packet_capture_loop();
 #endif
 #ifdef GBP_FEATURE_PARSE_PACKET_MODE
   gbp_parse_packet_loop();
 #endif
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+  if (hostOutPending)
+  {
+    gbp_serial_io_stats_hostOut(&gbp_serial_io_default, micros() - hostOutStart);
+  }
+#endif
+#ifdef GBP_FEATURE_PACKET_CAPTURE_SPOOL
+  if (gbp_spoolCompletedPending && gbp_spool_isEmpty(&gbp_spool))
+  {
+    // Host has caught up with the spool
+    gbp_spoolCompletedPending = false;
+    gbp_completed_message();
+  }
+#endif
 
   // Trigger Timeout and reset the printer if byte stopped being received.
   static uint32_t last_millis = 0;
@@ -240,17 +561,21 @@ void loop()
   if (curr_millis > last_millis)
   {
     uint32_t elapsed_ms = curr_millis - last_millis;
+#if GBP_USE_ADAPTIVE_BUSY
+    gbp_serial_io_flow_service(elapsed_ms);
+#endif
     if (gbp_serial_io_timeout_handler(elapsed_ms))
     {
-      Serial.println("");
-      Serial.print("// Completed ");
-      Serial.print("(Memory Waterline: ");
-      Serial.print(gbp_serial_io_dataBuff_waterline(false));
-      Serial.print("B out of ");
-      Serial.print(gbp_serial_io_dataBuff_max());
-      Serial.println("B)");
-      Serial.flush();
-      digitalWrite(LED_STATUS_PIN, LOW);
+#ifdef GBP_FEATURE_HARDWARE_SPI_SLAVE
+      gbp_spi_slave_resync();
+#endif
+#ifdef GBP_FEATURE_PACKET_CAPTURE_SPOOL
+      // Spooled packets may still be on their way to the host, so report once they are sent
+      gbp_spool_packetReset(&gbp_spool);
+      gbp_spoolCompletedPending = true;
+#else
+      gbp_completed_message();
+#endif
 
 #ifdef GBP_FEATURE_PARSE_PACKET_MODE
       gbp_pkt_reset(&gbp_pktState);
@@ -268,15 +593,54 @@ void loop()
     switch (Serial.read())
     {
       case '?':
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+        Serial.println("d=debug, s=stats, S=stats frame, r=reset stats, ?=help");
+#else
         Serial.println("d=debug, ?=help");
+#endif
+        break;
+
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+      case 's':
+        gbp_stats_print();
+        break;
+
+      case 'S':
+        gbp_stats_send();
         break;
 
+      case 'r':
+        gbp_serial_io_stats_reset();
+        Serial.println("stats reset");
+        break;
+#endif
+
       case 'd':
         Serial.print("waterline: ");
         Serial.print(gbp_serial_io_dataBuff_waterline(false));
         Serial.print("B out of ");
         Serial.print(gbp_serial_io_dataBuff_max());
         Serial.println("B");
+#ifdef FEATURE_CHECKSUM_SUPPORTED
+        Serial.print("checksum errors (resent): ");
+        Serial.println(gbp_serial_io_default.pktIO.checksumErrorCount);
+#endif
+#if GBP_USE_ADAPTIVE_BUSY
+        Serial.print("host drain: ");
+        Serial.print(gbp_serial_io_default.pktIO.flow.drainRate);
+        Serial.print("B/s, busy held: ");
+        Serial.println(gbp_serial_io_default.pktIO.flow.holdCount);
+#endif
+#ifdef GBP_FEATURE_PACKET_CAPTURE_SPOOL
+        Serial.print("spool: ");
+        Serial.print(gbp_spool_blocksUsed(&gbp_spool));
+        Serial.print(" blocks out of ");
+        Serial.print(gbp_spool.blockCount);
+        Serial.print(", dropped: ");
+        Serial.print(gbp_spool.blocksDropped);
+        Serial.print(", errors: ");
+        Serial.println(gbp_spool.storageErrors);
+#endif
         break;
     }
   };
@@ -287,147 +651,268 @@ void loop()
 #ifdef GBP_FEATURE_PARSE_PACKET_MODE
 inline void gbp_parse_packet_loop(void)
 {
+  const uint8_t *span   = NULL;
+  const size_t spanSize = gbp_serial_io_dataBuff_getSpan(&span);
+  gbp_pkt_processBuffer(&gbp_pktState, span, spanSize, gbp_pktbuff, &gbp_pktbuffSize, sizeof(gbp_pktbuff), gbp_parse_packet_event, NULL);
+  gbp_serial_io_dataBuff_consume(spanSize);
+}
+
+// Called by gbp_pkt_processBuffer() on every packet event
+void gbp_parse_packet_event(gbp_pkt_t *_pkt, uint8_t buffer[], const uint8_t bufferSize, void *userData)
+{
+  // Dev Note: Packet parser state is in globals gbp_pktState, gbp_pktbuff and gbp_pktbuffSize
+  (void)_pkt;
+  (void)buffer;
+  (void)bufferSize;
+  (void)userData;
   const char nibbleToCharLUT[] = "0123456789ABCDEF";
-  for (int i = 0; i < gbp_serial_io_dataBuff_getByteCount(); i++)
+  if (gbp_pktState.received == GBP_REC_GOT_PACKET)
   {
-    if (gbp_pkt_processByte(&gbp_pktState, (const uint8_t)gbp_serial_io_dataBuff_getByte(), gbp_pktbuff, &gbp_pktbuffSize, sizeof(gbp_pktbuff)))
+    digitalWrite(LED_STATUS_PIN, HIGH);
+    Serial.print((char)'{');
+    Serial.print("\"command\":\"");
+    Serial.print(gbpCommand_toStr(gbp_pktState.command));
+    Serial.print("\"");
+    if (gbp_pktState.command == GBP_COMMAND_INQUIRY)
     {
-      if (gbp_pktState.received == GBP_REC_GOT_PACKET)
-      {
-        digitalWrite(LED_STATUS_PIN, HIGH);
-        Serial.print((char)'{');
-        Serial.print("\"command\":\"");
-        Serial.print(gbpCommand_toStr(gbp_pktState.command));
-        Serial.print("\"");
-        if (gbp_pktState.command == GBP_COMMAND_INQUIRY)
-        {
-          // !{"command":"INQY","status":{"lowbatt":0,"jam":0,"err":0,"pkterr":0,"unproc":1,"full":0,"bsy":0,"chk_err":0}}
-          Serial.print(", \"status\":{");
-          Serial.print("\"LowBat\":");
-          Serial.print(gpb_status_bit_getbit_low_battery(gbp_pktState.status) ? '1' : '0');
-          Serial.print(",\"ER2\":");
-          Serial.print(gpb_status_bit_getbit_other_error(gbp_pktState.status) ? '1' : '0');
-          Serial.print(",\"ER1\":");
-          Serial.print(gpb_status_bit_getbit_paper_jam(gbp_pktState.status) ? '1' : '0');
-          Serial.print(",\"ER0\":");
-          Serial.print(gpb_status_bit_getbit_packet_error(gbp_pktState.status) ? '1' : '0');
-          Serial.print(",\"Untran\":");
-          Serial.print(gpb_status_bit_getbit_unprocessed_data(gbp_pktState.status) ? '1' : '0');
-          Serial.print(",\"Full\":");
-          Serial.print(gpb_status_bit_getbit_print_buffer_full(gbp_pktState.status) ? '1' : '0');
-          Serial.print(",\"Busy\":");
-          Serial.print(gpb_status_bit_getbit_printer_busy(gbp_pktState.status) ? '1' : '0');
-          Serial.print(",\"Sum\":");
-          Serial.print(gpb_status_bit_getbit_checksum_error(gbp_pktState.status) ? '1' : '0');
-          Serial.print((char)'}');
-        }
-        if (gbp_pktState.command == GBP_COMMAND_PRINT)
-        {
-          //!{"command":"PRNT","sheets":1,"margin_upper":1,"margin_lower":3,"pallet":228,"density":64 }
-          Serial.print(", \"sheets\":");
-          Serial.print(gbp_pkt_printInstruction_num_of_sheets(gbp_pktbuff));
-          Serial.print(", \"margin_upper\":");
-          Serial.print(gbp_pkt_printInstruction_num_of_linefeed_before_print(gbp_pktbuff));
-          Serial.print(", \"margin_lower\":");
-          Serial.print(gbp_pkt_printInstruction_num_of_linefeed_after_print(gbp_pktbuff));
-          Serial.print(", \"pallet\":");
-          Serial.print(gbp_pkt_printInstruction_palette_value(gbp_pktbuff));
-          Serial.print(", \"density\":");
-          Serial.print(gbp_pkt_printInstruction_print_density(gbp_pktbuff));
-        }
-        if (gbp_pktState.command == GBP_COMMAND_DATA)
-        {
-          //!{"command":"DATA", "compressed":0, "more":0}
+      // !{"command":"INQY","status":{"lowbatt":0,"jam":0,"err":0,"pkterr":0,"unproc":1,"full":0,"bsy":0,"chk_err":0}}
+      Serial.print(", \"status\":{");
+      Serial.print("\"LowBat\":");
+      Serial.print(gpb_status_bit_getbit_low_battery(gbp_pktState.status) ? '1' : '0');
+      Serial.print(",\"ER2\":");
+      Serial.print(gpb_status_bit_getbit_other_error(gbp_pktState.status) ? '1' : '0');
+      Serial.print(",\"ER1\":");
+      Serial.print(gpb_status_bit_getbit_paper_jam(gbp_pktState.status) ? '1' : '0');
+      Serial.print(",\"ER0\":");
+      Serial.print(gpb_status_bit_getbit_packet_error(gbp_pktState.status) ? '1' : '0');
+      Serial.print(",\"Untran\":");
+      Serial.print(gpb_status_bit_getbit_unprocessed_data(gbp_pktState.status) ? '1' : '0');
+      Serial.print(",\"Full\":");
+      Serial.print(gpb_status_bit_getbit_print_buffer_full(gbp_pktState.status) ? '1' : '0');
+      Serial.print(",\"Busy\":");
+      Serial.print(gpb_status_bit_getbit_printer_busy(gbp_pktState.status) ? '1' : '0');
+      Serial.print(",\"Sum\":");
+      Serial.print(gpb_status_bit_getbit_checksum_error(gbp_pktState.status) ? '1' : '0');
+      Serial.print((char)'}');
+    }
+    if (gbp_pktState.command == GBP_COMMAND_PRINT)
+    {
+      //!{"command":"PRNT","sheets":1,"margin_upper":1,"margin_lower":3,"pallet":228,"density":64 }
+      Serial.print(", \"sheets\":");
+      Serial.print(gbp_pkt_printInstruction_num_of_sheets(gbp_pktbuff));
+      Serial.print(", \"margin_upper\":");
+      Serial.print(gbp_pkt_printInstruction_num_of_linefeed_before_print(gbp_pktbuff));
+      Serial.print(", \"margin_lower\":");
+      Serial.print(gbp_pkt_printInstruction_num_of_linefeed_after_print(gbp_pktbuff));
+      Serial.print(", \"pallet\":");
+      Serial.print(gbp_pkt_printInstruction_palette_value(gbp_pktbuff));
+      Serial.print(", \"density\":");
+      Serial.print(gbp_pkt_printInstruction_print_density(gbp_pktbuff));
+    }
+    if (gbp_pktState.command == GBP_COMMAND_DATA)
+    {
+      //!{"command":"DATA", "compressed":0, "more":0}
 #ifdef GBP_FEATURE_PARSE_PACKET_USE_DECOMPRESSOR
-          Serial.print(", \"compressed\":0");  // Already decompressed by us, so no need to do so
+      Serial.print(", \"compressed\":0");  // Already decompressed by us, so no need to do so
 #else
-          Serial.print(", \"compressed\":");
-          Serial.print(gbp_pktState.compression);
+      Serial.print(", \"compressed\":");
+      Serial.print(gbp_pktState.compression);
 #endif
-          Serial.print(", \"more\":");
-          Serial.print((gbp_pktState.dataLength != 0) ? '1' : '0');
-        }
-        Serial.println((char)'}');
-        Serial.flush();
+      Serial.print(", \"more\":");
+      Serial.print((gbp_pktState.dataLength != 0) ? '1' : '0');
+    }
+    Serial.println((char)'}');
+#ifdef GBP_FEATURE_PARSE_PACKET_RASTER_ROWS
+    if (gbp_pktState.command == GBP_COMMAND_PRINT)
+    {
+      // Rows so far belong to this print, next row starts a new image section
+      gbp_frame_serial_send(GBP_FRAME_TYPE_RASTER_PRINT, gbp_pktbuff, GBP_FRAME_RASTER_PRINT_SIZE);
+      gbp_tiles_rowRing_reset(&gbp_rowRing);
+    }
+#endif
+    Serial.flush();
+  }
+  else
+  {
+#ifdef GBP_FEATURE_PARSE_PACKET_RASTER_ROWS
+    // Decode tiles on device and stream out each row once complete
+    while (gbp_pkt_decompressor(&gbp_pktState, gbp_pktbuff, gbp_pktbuffSize, &tileBuff))
+    {
+      if (gbp_pkt_tileAccu_tileReadyCheck(&tileBuff))
+      {
+        gbp_tiles_rowRing_decoder(&gbp_rowRing, tileBuff.tile);
       }
-      else
+    }
+    uint16_t rowIndex = 0;
+    const uint8_t *row = NULL;
+    while ((row = gbp_tiles_rowRing_get(&gbp_rowRing, &rowIndex)) != NULL)
+    {
+      uint8_t frame[GBP_FRAME_RASTER_ROW_SIZE];
+      frame[0] = (uint8_t)(rowIndex & 0xFF);
+      memcpy(&frame[1], row, GBP_FRAME_RASTER_ROW_SIZE - 1);
+      gbp_frame_serial_send(GBP_FRAME_TYPE_RASTER_ROW, frame, sizeof(frame));
+      gbp_tiles_rowRing_release(&gbp_rowRing);
+      Serial.flush();
+    }
+#elif defined(GBP_FEATURE_PARSE_PACKET_USE_DECOMPRESSOR)
+    // Required for more complex games with compression support
+    while (gbp_pkt_decompressor(&gbp_pktState, gbp_pktbuff, gbp_pktbuffSize, &tileBuff))
+    {
+      if (gbp_pkt_tileAccu_tileReadyCheck(&tileBuff))
       {
-#ifdef GBP_FEATURE_PARSE_PACKET_USE_DECOMPRESSOR
-        // Required for more complex games with compression support
-        while (gbp_pkt_decompressor(&gbp_pktState, gbp_pktbuff, gbp_pktbuffSize, &tileBuff))
+        // Got Tile
+        for (int i = 0; i < GBP_TILE_SIZE_IN_BYTE; i++)
         {
-          if (gbp_pkt_tileAccu_tileReadyCheck(&tileBuff))
+          const uint8_t data_8bit = tileBuff.tile[i];
+          if (i == GBP_TILE_SIZE_IN_BYTE - 1)
           {
-            // Got Tile
-            for (int i = 0; i < GBP_TILE_SIZE_IN_BYTE; i++)
-            {
-              const uint8_t data_8bit = tileBuff.tile[i];
-              if (i == GBP_TILE_SIZE_IN_BYTE - 1)
-              {
-                Serial.print((char)nibbleToCharLUT[(data_8bit >> 4) & 0xF]);
-                Serial.println((char)nibbleToCharLUT[(data_8bit >> 0) & 0xF]);  // use println on last byte to reduce serial calls
-              }
-              else
-              {
-                Serial.print((char)nibbleToCharLUT[(data_8bit >> 4) & 0xF]);
-                Serial.print((char)nibbleToCharLUT[(data_8bit >> 0) & 0xF]);
-                Serial.print((char)' ');
-              }
-            }
-            Serial.flush();
+            Serial.print((char)nibbleToCharLUT[(data_8bit >> 4) & 0xF]);
+            Serial.println((char)nibbleToCharLUT[(data_8bit >> 0) & 0xF]);  // use println on last byte to reduce serial calls
+          }
+          else
+          {
+            Serial.print((char)nibbleToCharLUT[(data_8bit >> 4) & 0xF]);
+            Serial.print((char)nibbleToCharLUT[(data_8bit >> 0) & 0xF]);
+            Serial.print((char)' ');
           }
         }
+        Serial.flush();
+      }
+    }
 #else
-        // Simplified support for gameboy camera only application
-        // Dev Note: Good for checking if everything above decompressor is working
-        if (gbp_pktbuffSize > 0)
+    // Simplified support for gameboy camera only application
+    // Dev Note: Good for checking if everything above decompressor is working
+    if (gbp_pktbuffSize > 0)
+    {
+      // Got Tile
+      for (int i = 0; i < gbp_pktbuffSize; i++)
+      {
+        const uint8_t data_8bit = gbp_pktbuff[i];
+        if (i == gbp_pktbuffSize - 1)
         {
-          // Got Tile
-          for (int i = 0; i < gbp_pktbuffSize; i++)
-          {
-            const uint8_t data_8bit = gbp_pktbuff[i];
-            if (i == gbp_pktbuffSize - 1)
-            {
-              Serial.print((char)nibbleToCharLUT[(data_8bit >> 4) & 0xF]);
-              Serial.println((char)nibbleToCharLUT[(data_8bit >> 0) & 0xF]);  // use println on last byte to reduce serial calls
-            }
-            else
-            {
-              Serial.print((char)nibbleToCharLUT[(data_8bit >> 4) & 0xF]);
-              Serial.print((char)nibbleToCharLUT[(data_8bit >> 0) & 0xF]);
-              Serial.print((char)' ');
-            }
-          }
-          Serial.flush();
+          Serial.print((char)nibbleToCharLUT[(data_8bit >> 4) & 0xF]);
+          Serial.println((char)nibbleToCharLUT[(data_8bit >> 0) & 0xF]);  // use println on last byte to reduce serial calls
+        }
+        else
+        {
+          Serial.print((char)nibbleToCharLUT[(data_8bit >> 4) & 0xF]);
+          Serial.print((char)nibbleToCharLUT[(data_8bit >> 0) & 0xF]);
+          Serial.print((char)' ');
         }
-#endif
       }
+      Serial.flush();
     }
+#endif
   }
 }
 #endif
 
-#ifdef GBP_FEATURE_PACKET_CAPTURE_MODE
+#ifdef GBP_FEATURE_PACKET_CAPTURE_BINARY_FRAMES
+inline void gbp_packet_capture_loop()
+{
+  /* Raw packets as SLIP frames (See gbp_frame.h) */
+  // Dev Note: Bytes are written straight out of the circular buffer via
+  //           Serial.write() with only SLIP escape bytes written separately
+  static uint32_t pktTotalCount = 0;
+  static gbp_frame_pkt_t pkt    = {0, 0};
+#ifdef GBP_FEATURE_PACKET_CAPTURE_SPOOL
+  static uint32_t spoolDropped = 0;
+  if (spoolDropped != gbp_spool.blocksDropped)
+  {
+    // Spool skipped ahead to the next whole packet, so end the torn frame here
+    spoolDropped = gbp_spool.blocksDropped;
+    if (pkt.byteIndex != 0)
+    {
+      Serial.write((uint8_t)GBP_FRAME_SLIP_END);
+      gbp_frame_pkt_reset(&pkt);
+      pktTotalCount++;
+    }
+  }
+#endif
+  while (1)
+  {
+    const uint8_t *span = NULL;
+    size_t spanSize     = gbp_capture_getSpan(&span);
+    if (spanSize == 0)
+      break;
+
+#ifdef GBP_FEATURE_PACKET_CAPTURE_SPOOL
+    // Only send what the host can take right now, the rest waits in the spool
+    // Worst case is every byte escaped, plus an escaped frame header and both frame ends
+    const int txFree      = Serial.availableForWrite() - (1 + 2 * GBP_FRAME_HEADER_SIZE + 1);
+    const size_t txBudget = (txFree > 0) ? (txFree / 2) : 0;
+    if (txBudget == 0)
+      break;
+    spanSize = (spanSize < txBudget) ? spanSize : txBudget;
+#endif
+
+    // Start of a new packet
+    if (pkt.byteIndex == 0)
+    {
+      uint8_t frameHeader[1 + 2 * GBP_FRAME_HEADER_SIZE];
+      size_t frameHeaderSize         = 0;
+      frameHeader[frameHeaderSize++] = GBP_FRAME_SLIP_END;
+      frameHeaderSize += gbp_frame_slip_escape(&frameHeader[frameHeaderSize], GBP_FRAME_TYPE_RAW_PACKET);
+      frameHeaderSize += gbp_frame_slip_escape(&frameHeader[frameHeaderSize], (uint8_t)(pktTotalCount & 0xFF));
+      Serial.write(frameHeader, frameHeaderSize);
+      digitalWrite(LED_STATUS_PIN, HIGH);
+    }
+
+    // Send up to the end of this packet (Byte by byte until data length is known)
+    const size_t pktRemaining = gbp_frame_pkt_span(&pkt);
+    spanSize                  = (spanSize < pktRemaining) ? spanSize : pktRemaining;
+    const bool pktEnd         = gbp_frame_pkt_advance(&pkt, span, spanSize);
+    gbp_frame_serial_write(span, spanSize);
+    gbp_capture_consume(spanSize);
+
+    // End of packet
+    if (pktEnd)
+    {
+      Serial.write((uint8_t)GBP_FRAME_SLIP_END);
+      digitalWrite(LED_STATUS_PIN, LOW);
+      pktTotalCount++;
+    }
+  }
+}
+#elif defined(GBP_FEATURE_PACKET_CAPTURE_MODE)
 inline void gbp_packet_capture_loop()
 {
   /* tiles received */
   static uint32_t byteTotal     = 0;
   static uint32_t pktTotalCount = 0;
-  static uint32_t pktByteIndex  = 0;
-  static uint16_t pktDataLength = 0;
-  const size_t dataBuffCount    = gbp_serial_io_dataBuff_getByteCount();
-  if (
-    ((pktByteIndex != 0) && (dataBuffCount > 0)) || ((pktByteIndex == 0) && (dataBuffCount >= 6)))
+  static gbp_frame_pkt_t pkt    = {0, 0};
+#ifdef GBP_FEATURE_PACKET_CAPTURE_SPOOL
+  static uint32_t spoolDropped = 0;
+  if (spoolDropped != gbp_spool.blocksDropped)
+  {
+    // Spool skipped ahead to the next whole packet, so end the torn line here
+    spoolDropped = gbp_spool.blocksDropped;
+    if (pkt.byteIndex != 0)
+    {
+      Serial.println("");
+      gbp_frame_pkt_reset(&pkt);
+      pktTotalCount++;
+    }
+    Serial.println("// Spool full, oldest packets were dropped");
+  }
+#endif
+  const uint8_t *span = NULL;
+  size_t spanSize     = gbp_capture_getSpan(&span);
+#ifdef GBP_FEATURE_PACKET_CAPTURE_SPOOL
+  // Only send what the host can take right now, the rest waits in the spool
+  const size_t txBudget = Serial.availableForWrite() / 4;  // Up to 4 chars per byte ("XX " or "XX\r\n")
+  spanSize              = (spanSize < txBudget) ? spanSize : txBudget;
+#endif
+  if (spanSize > 0)
   {
     const char nibbleToCharLUT[] = "0123456789ABCDEF";
     uint8_t data_8bit            = 0;
-    for (int i = 0; i < dataBuffCount; i++)
+    for (size_t i = 0; i < spanSize; i++)
     {  // Display the data payload encoded in hex
+      data_8bit = span[i];
       // Start of a new packet
-      if (pktByteIndex == 0)
+      if (pkt.byteIndex == 0)
       {
-        pktDataLength = gbp_serial_io_dataBuff_getByte_Peek(4);
-        pktDataLength |= (gbp_serial_io_dataBuff_getByte_Peek(5) << 8) & 0xFF00;
 #if 0
         Serial.print("// ");
         Serial.print(pktTotalCount);
@@ -436,26 +921,27 @@ inline void gbp_packet_capture_loop()
 #endif
         digitalWrite(LED_STATUS_PIN, HIGH);
       }
+      const bool pktEnd = gbp_frame_pkt_advance(&pkt, &span[i], 1);
       // Print Hex Byte
-      data_8bit = gbp_serial_io_dataBuff_getByte();
       Serial.print((char)nibbleToCharLUT[(data_8bit >> 4) & 0xF]);
       Serial.print((char)nibbleToCharLUT[(data_8bit >> 0) & 0xF]);
       // Splitting packets for convenience
-      if ((pktByteIndex > 5) && (pktByteIndex >= (9 + pktDataLength)))
+      if (pktEnd)
       {
         digitalWrite(LED_STATUS_PIN, LOW);
         Serial.println("");
-        pktByteIndex = 0;
         pktTotalCount++;
       }
       else
       {
         Serial.print((char)' ');
-        pktByteIndex++;  // Byte hex split counter
-        byteTotal++;     // Byte total counter
+        byteTotal++;  // Byte total counter
       }
     }
+    gbp_capture_consume(spanSize);
+#ifndef GBP_FEATURE_PACKET_CAPTURE_SPOOL
     Serial.flush();
+#endif
   }
 }
 #endif
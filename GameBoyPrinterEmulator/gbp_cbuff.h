@@ -30,120 +30,209 @@
 // Author: Brian Khuu (July 2020) (briankhuu.com) (mofosyne@gmail.com)
 // This Gist (Pointer): https://gist.github.com/mofosyne/d7a4a8d6a567133561c18aaddfd82e6f
 // This Gist (Index): https://gist.github.com/mofosyne/82020d5c0e1e11af0eb9b05c73734956
+// Single Producer Single Consumer (SPSC) Notes:
+//   * `head` is only written by the producer (ISR) and `tail` only by the
+//     consumer (main loop), so there is no shared `count` read-modify-write.
+//   * Indexes run from 0 to 2*capacity-1 so that full and empty can be told
+//     apart without a count. Advancing an index is a compare and subtract,
+//     not a `%` (which is a software division on AVR).
+//   * If GBP_CBUFF_FIXED_CAPACITY is defined (power of two), index wrapping
+//     is a compile time mask instead.
 #include <stdint.h> // uint8_t
 #include <stddef.h> // size_t
 #include <stdbool.h> // bool
 
+#ifdef GBP_CBUFF_FIXED_CAPACITY
+#if (GBP_CBUFF_FIXED_CAPACITY & (GBP_CBUFF_FIXED_CAPACITY - 1)) != 0
+#error "GBP_CBUFF_FIXED_CAPACITY must be a power of two"
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define GPB_CBUFF_BARRIER() __asm__ __volatile__("" ::: "memory") ///< Keep buffer access ordered with index update
+#else
+#define GPB_CBUFF_BARRIER()
+#endif
+
 typedef struct gpb_cbuff_t
 {
-  size_t capacity; ///< Maximum number of items in the buffer
-  size_t count;    ///< Number of items in the buffer
-  uint8_t *buffer; ///< Data Buffer
-  size_t head;     ///< Head Index
-  size_t tail;     ///< Tail Index
+  size_t capacity;         ///< Maximum number of items in the buffer
+  uint8_t *buffer;         ///< Data Buffer
+  volatile size_t head;    ///< Head Index (Producer Only) (0 to 2*capacity-1)
+  volatile size_t tail;    ///< Tail Index (Consumer Only) (0 to 2*capacity-1)
 
 #ifdef FEATURE_CHECKSUM_SUPPORTED
   // Temp
-  size_t countTemp;    ///< Number of items in the buffer
-  size_t headTemp;     ///< Head Index
+  size_t headTemp;         ///< Uncommitted Head Index (Producer Only)
 #endif // FEATURE_CHECKSUM_SUPPORTED
 } gpb_cbuff_t;
 
+/* Index Arithmetic */
+#ifdef GBP_CBUFF_FIXED_CAPACITY
+static inline size_t gpb_cbuff_IndexAdvance(const gpb_cbuff_t *cb, size_t i, size_t n) { (void)cb; return (i + n) & (2 * GBP_CBUFF_FIXED_CAPACITY - 1);}
+static inline size_t gpb_cbuff_IndexToPos(const gpb_cbuff_t *cb, size_t i)             { (void)cb; return i & (GBP_CBUFF_FIXED_CAPACITY - 1);}
+static inline size_t gpb_cbuff_IndexDistance(const gpb_cbuff_t *cb, size_t h, size_t t) { (void)cb; return (h - t) & (2 * GBP_CBUFF_FIXED_CAPACITY - 1);}
+#else
+static inline size_t gpb_cbuff_IndexAdvance(const gpb_cbuff_t *cb, size_t i, size_t n)
+{
+  // n is never more than capacity, so a single subtraction is enough
+  i = i + n;
+  return (i >= (2 * cb->capacity)) ? (i - (2 * cb->capacity)) : i;
+}
+static inline size_t gpb_cbuff_IndexToPos(const gpb_cbuff_t *cb, size_t i)             { return (i >= cb->capacity) ? (i - cb->capacity) : i;}
+static inline size_t gpb_cbuff_IndexDistance(const gpb_cbuff_t *cb, size_t h, size_t t) { return (h >= t) ? (h - t) : (h + (2 * cb->capacity) - t);}
+#endif
+
+// Read the other side's index. On 8bit MCU a size_t read is not atomic,
+// so re-read until stable in case the ISR updated it halfway through.
+static inline size_t gpb_cbuff_LoadIndex(volatile size_t *index)
+{
+  size_t i;
+  do
+  {
+    i = *index;
+  } while (i != *index);
+  return i;
+}
+
 static inline bool gpb_cbuff_Init(gpb_cbuff_t *cb, size_t capacity, uint8_t *buffPtr)
 {
-  gpb_cbuff_t emptyCB = {0};
   if ((cb == NULL) || (buffPtr == NULL))
     return false; ///< Failed
+#ifdef GBP_CBUFF_FIXED_CAPACITY
+  if (capacity != GBP_CBUFF_FIXED_CAPACITY)
+    return false; ///< Failed
+#endif
   // Init Struct
-  *cb = emptyCB;
   cb->capacity = capacity;
   cb->buffer   = buffPtr;
-  cb->count    = 0;
   cb->head     = 0;
   cb->tail     = 0;
+#ifdef FEATURE_CHECKSUM_SUPPORTED
+  cb->headTemp = 0;
+#endif // FEATURE_CHECKSUM_SUPPORTED
   return true; ///< Successful
 }
 
 static inline bool gpb_cbuff_Reset(gpb_cbuff_t *cb)
 {
-  cb->count = 0;
   cb->head = 0;
   cb->tail = 0;
+#ifdef FEATURE_CHECKSUM_SUPPORTED
+  cb->headTemp = 0;
+#endif // FEATURE_CHECKSUM_SUPPORTED
   return true; ///< Successful
 }
 
+/* Producer */
 static inline bool gpb_cbuff_Enqueue(gpb_cbuff_t *cb, uint8_t b)
 {
+  const size_t head = cb->head;
   // Full
-  if (cb->count >= cb->capacity)
+  if (gpb_cbuff_IndexDistance(cb, head, gpb_cbuff_LoadIndex(&cb->tail)) >= cb->capacity)
     return false; ///< Failed
   // Push value
-  cb->buffer[cb->head] = b;
+  cb->buffer[gpb_cbuff_IndexToPos(cb, head)] = b;
+  GPB_CBUFF_BARRIER();
   // Increment head
-  cb->head = (cb->head + 1) % cb->capacity;
-  cb->count = cb->count + 1;
+  cb->head = gpb_cbuff_IndexAdvance(cb, head, 1);
   return true; ///< Successful
 }
 
+/* Consumer */
 static inline bool gpb_cbuff_Dequeue(gpb_cbuff_t *cb, uint8_t *b)
 {
+  const size_t tail = cb->tail;
   // Empty
-  if (cb->count == 0)
+  if (gpb_cbuff_LoadIndex(&cb->head) == tail)
     return false; ///< Failed
   // Pop value
-  *b = cb->buffer[cb->tail];
+  GPB_CBUFF_BARRIER();
+  *b = cb->buffer[gpb_cbuff_IndexToPos(cb, tail)];
+  GPB_CBUFF_BARRIER();
   // Increment tail
-  cb->tail = (cb->tail + 1) % cb->capacity;
-  cb->count = cb->count - 1;
+  cb->tail = gpb_cbuff_IndexAdvance(cb, tail, 1);
   return true; ///< Successful
 }
 
 static inline bool gpb_cbuff_Dequeue_Peek(gpb_cbuff_t *cb, uint8_t *b, uint32_t offset)
 {
+  const size_t tail  = cb->tail;
+  const size_t count = gpb_cbuff_IndexDistance(cb, gpb_cbuff_LoadIndex(&cb->head), tail);
   // Empty
-  if (cb->count == 0)
+  if (count == 0)
     return false; ///< Failed
-  if (cb->count < offset)
+  if (count <= offset)
     return false; ///< Failed
   // Pop value
-  *b = cb->buffer[(cb->tail + offset) % cb->capacity];
+  GPB_CBUFF_BARRIER();
+  *b = cb->buffer[gpb_cbuff_IndexToPos(cb, gpb_cbuff_IndexAdvance(cb, tail, offset))];
+  return true; ///< Successful
+}
+
+/* Contiguous Span Dequeue (Zero Copy) */
+// Get pointer and size of the largest contiguous readable region at the tail.
+// Bytes stay in the buffer until gpb_cbuff_Dequeue_Commit() releases them.
+static inline size_t gpb_cbuff_Dequeue_Span(gpb_cbuff_t *cb, const uint8_t **span)
+{
+  const size_t tail  = cb->tail;
+  const size_t count = gpb_cbuff_IndexDistance(cb, gpb_cbuff_LoadIndex(&cb->head), tail);
+  const size_t pos   = gpb_cbuff_IndexToPos(cb, tail);
+  const size_t toEnd = cb->capacity - pos;
+  GPB_CBUFF_BARRIER();
+  *span = &cb->buffer[pos];
+  return (count < toEnd) ? count : toEnd;
+}
+
+static inline bool gpb_cbuff_Dequeue_Commit(gpb_cbuff_t *cb, size_t n)
+{
+  const size_t tail = cb->tail;
+  if (n > gpb_cbuff_IndexDistance(cb, gpb_cbuff_LoadIndex(&cb->head), tail))
+    return false; ///< Failed
+  GPB_CBUFF_BARRIER();
+  // Increment tail
+  cb->tail = gpb_cbuff_IndexAdvance(cb, tail, n);
   return true; ///< Successful
 }
 
 static inline size_t gpb_cbuff_Capacity(gpb_cbuff_t *cb) { return cb->capacity;}
-static inline size_t gpb_cbuff_Count(gpb_cbuff_t *cb)   { return cb->count;}
-static inline bool gpb_cbuff_IsFull(gpb_cbuff_t *cb)    { return (cb->count >= cb->capacity);}
-static inline bool gpb_cbuff_IsEmpty(gpb_cbuff_t *cb)   { return (cb->count == 0);}
+static inline size_t gpb_cbuff_Count(gpb_cbuff_t *cb)   { return gpb_cbuff_IndexDistance(cb, gpb_cbuff_LoadIndex(&cb->head), gpb_cbuff_LoadIndex(&cb->tail));}
+static inline bool gpb_cbuff_IsFull(gpb_cbuff_t *cb)    { return (gpb_cbuff_Count(cb) >= cb->capacity);}
+static inline bool gpb_cbuff_IsEmpty(gpb_cbuff_t *cb)   { return (gpb_cbuff_Count(cb) == 0);}
 
 #ifdef FEATURE_CHECKSUM_SUPPORTED
-/* Temp Enqeue */
+/* Temp Enqueue (Transactional) */
+// Bytes are staged past the head with gpb_cbuff_EnqueueTemp() and stay invisible to the
+// consumer until gpb_cbuff_AcceptTemp() commits them, or gpb_cbuff_ResetTemp() throws them away.
+static inline size_t gpb_cbuff_CountTemp(gpb_cbuff_t *cb) { return gpb_cbuff_IndexDistance(cb, cb->headTemp, cb->head);}
+
 static inline bool gpb_cbuff_ResetTemp(gpb_cbuff_t *cb)
 {
-  cb->countTemp = 0;
-  cb->headTemp  = cb->head ;
+  cb->headTemp = cb->head;
+  return true; ///< Successful
 }
 
 static inline bool gpb_cbuff_AcceptTemp(gpb_cbuff_t *cb)
 {
-  cb->count += cb->countTemp;
-  cb->head  = cb->headTemp  ;
+  GPB_CBUFF_BARRIER();
+  cb->head = cb->headTemp;
   return true; ///< Successful
 }
 
 static inline bool gpb_cbuff_EnqueueTemp(gpb_cbuff_t *cb, uint8_t b)
 {
+  const size_t headTemp = cb->headTemp;
   // Full
-  if (cb->countTemp >= (cb->capacity - cb->count))
+  if (gpb_cbuff_IndexDistance(cb, headTemp, gpb_cbuff_LoadIndex(&cb->tail)) >= cb->capacity)
     return false; ///< Failed
   // Push value
-  cb->buffer[cb->headTemp] = b;
+  cb->buffer[gpb_cbuff_IndexToPos(cb, headTemp)] = b;
   // Increment headTemp
-  cb->headTemp = (cb->headTemp + 1) % cb->capacity;
-  cb->countTemp = cb->countTemp + 1;
+  cb->headTemp = gpb_cbuff_IndexAdvance(cb, headTemp, 1);
   return true; ///< Successful
 }
 #else
 #define gpb_cbuff_EnqueueTemp(CB, B) gpb_cbuff_Enqueue(CB, B)
 #endif // FEATURE_CHECKSUM_SUPPORTED
 
-#endif // GBP_CBUFF_H
\ No newline at end of file
+#endif // GBP_CBUFF_H
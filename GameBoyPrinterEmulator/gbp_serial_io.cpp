@@ -29,10 +29,10 @@
 
 #include <stdint.h>  // uint8_t
 #include <stddef.h>  // size_t
+#include <string.h>  // memset()
 
-#include "gameboy_printer_protocol.h"
+#include "src/gbp_core/gameboy_printer_protocol.h"
 #include "gbp_serial_io.h"
-#include "gbp_cbuff.h"
 
 /******************************************************************************/
 
@@ -42,149 +42,84 @@
 //#define TEST_CHECKSUM_FORCE_FAIL
 //#define TEST_PRETEND_BUFFER_FULL
 
-// Feature
-//#define FEATURE_CHECKSUM_SUPPORTED ///< WIP
+#define GBP_BUSY_PACKET_COUNT    20  // 68 Inquiry packets is generally approximately how long it takes for a real printer to print. This is not a real printer so can be shorter
+#define GBP_DATA_PACKET_COUNT    6   // Data packets after init before unprocessed data is cleared
+#define GBP_UNTRANS_PACKET_COUNT 3   // Inquiry packets after data before printing starts
 
-#define GBP_BUSY_PACKET_COUNT 20  // 68 Inquiry packets is generally approximately how long it takes for a real printer to print. This is not a real printer so can be shorter
-
-
-/******************************************************************************/
-
-typedef enum
-{
-  GBP_SIO_MODE_RESET,
-  GBP_SIO_MODE_8BITS,
-  GBP_SIO_MODE_16BITS_BIG_ENDIAN,
-  GBP_SIO_MODE_16BITS_LITTLE_ENDIAN,
-} gpb_sio_mode_t;
-
-// SIO Serial Input Output Psudo SPI
-static struct
-{
-  bool SINOutputPinState;  /// GPIO state of output
-  // Preamble Sync
-  bool syncronised;   ///< True When Preamble Found
-  uint16_t preamble;  ///< Scanning for Preamble
-  // Byte Tx/Rx
-  uint16_t bitMaskMap;  // gpb_sio_bitmaskmaps_t
-  gpb_sio_mode_t mode;
-  uint16_t rx_buff;
-  uint16_t tx_buff;
-} gpb_sio;
+// Stops the compiler from moving memory accesses across this point (ISR/main loop handover)
+#if defined(__GNUC__)
+#define GBP_SERIAL_IO_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+#define GBP_SERIAL_IO_BARRIER()
+#endif
 
 
-/******************************************************************************/
 /******************************************************************************/
 
-typedef enum gbp_pktIO_parse_state_t
-{
-  // Indicates the stage of the parsing processing (syncword is not parsed)
-  // [PREAMBLE][HEADER][DATA][CHECKSUM][DUMMY]
-  // [GBP_SYNC_WORD][GBP_COMMAND][DATA][CRC][GBP_STATUS]
-  GBP_PKT10_PARSE_HEADER_COMMAND_AND_COMPRESSION,
-  GBP_PKT10_PARSE_HEADER_DATA_LENGTH,
-  GBP_PKT10_PARSE_DATA_PAYLOAD,
-  GBP_PKT10_PARSE_CHECKSUM,
-  GBP_PKT10_PARSE_DUMMY
-} gbp_pktIO_parse_state_t;
-
-static struct
-{
-  // Initialized Command
-  bool initReceived;
-  uint32_t timeout_ms;
-
-  // Circular Buffer : To store raw packet stream for packet processor
-  gpb_cbuff_t dataBuffer;
-
-  // What packets was received for internal processing
-  bool printInstructionReceived;  ///< Print Instruction Command
-  bool dataPacketReceived;        ///< Data Packet Command
-  bool dataEndPacketReceived;     ///< Data End Packet Command (Data size of 0)
-  bool breakPacketReceived;       ///< Break Packet Command
-  bool nulPacketReceived;         ///< Inquiry Packet Command
-
-  // Packet Parsing
-  gbp_pktIO_parse_state_t packetState;
-  uint8_t command;
-  uint8_t compression;
-  uint16_t data_length;
-  uint16_t data_i;
-  uint16_t checksum;      ///< For data integrity check
-  uint16_t checksumCalc;  ///< For data integrity check
-  uint16_t statusBuffer;  ///< This is send on every packet in the dummy data region
-
-  // Status Packet Sequencing (For faking the printer for more advance games)
-  int busyPacketCountdown;
-  int untransPacketCountdown;
-  int dataPacketCountdown;
-
-  // Dev
-  uint16_t dataBufferWaterline;
-} gpb_pktIO;
+gbp_serial_io_ctx_t gbp_serial_io_default;
 
 
 /*******************************************************************************
  * Serial IO
 *******************************************************************************/
 
-static bool gpb_sio_next(const gpb_sio_mode_t mode, const uint16_t txdata)
+static bool gpb_sio_next(gbp_serial_io_ctx_t *ctx, const gpb_sio_mode_t mode, const uint16_t txdata)
 {
-  gpb_sio.rx_buff = 0;
-  gpb_sio.mode    = mode;
+  ctx->sio.rx_buff = 0;
+  ctx->sio.mode    = mode;
   switch (mode)
   {
     case GBP_SIO_MODE_RESET:
-      gpb_sio.bitMaskMap        = 0;
-      gpb_sio.SINOutputPinState = false;
-      gpb_sio.tx_buff           = 0xFFFF;
-      gpb_sio.syncronised       = false;
+      ctx->sio.bitMaskMap        = 0;
+      ctx->sio.SINOutputPinState = false;
+      ctx->sio.tx_buff           = 0xFFFF;
+      ctx->sio.syncronised       = false;
       break;
     case GBP_SIO_MODE_8BITS:
-      gpb_sio.bitMaskMap = (uint16_t)1 << (8 - 1);
-      gpb_sio.tx_buff    = txdata;
+      ctx->sio.bitMaskMap = (uint16_t)1 << (8 - 1);
+      ctx->sio.tx_buff    = txdata;
       break;
     case GBP_SIO_MODE_16BITS_BIG_ENDIAN:
-      gpb_sio.bitMaskMap = (uint16_t)1 << (16 - 1);
-      gpb_sio.tx_buff    = txdata;
+      ctx->sio.bitMaskMap = (uint16_t)1 << (16 - 1);
+      ctx->sio.tx_buff    = txdata;
       break;
     case GBP_SIO_MODE_16BITS_LITTLE_ENDIAN:
-      gpb_sio.bitMaskMap = (uint16_t)1 << (16 - 1);
-      gpb_sio.tx_buff    = 0;
-      gpb_sio.tx_buff |= ((txdata >> 8) & 0x00FF);
-      gpb_sio.tx_buff |= ((txdata << 8) & 0xFF00);
+      ctx->sio.bitMaskMap = (uint16_t)1 << (16 - 1);
+      ctx->sio.tx_buff    = 0;
+      ctx->sio.tx_buff |= ((txdata >> 8) & 0x00FF);
+      ctx->sio.tx_buff |= ((txdata << 8) & 0xFF00);
       break;
   }
   return true;
 }
 
-static uint16_t gpb_sio_getWord()
+static uint16_t gpb_sio_getWord(gbp_serial_io_ctx_t *ctx)
 {
   uint16_t temp = 0;
-  switch (gpb_sio.mode)
+  switch (ctx->sio.mode)
   {
     case GBP_SIO_MODE_RESET:
       break;
     case GBP_SIO_MODE_8BITS:
-      temp |= ((gpb_sio.rx_buff >> 0) & 0x00FF);
+      temp |= ((ctx->sio.rx_buff >> 0) & 0x00FF);
       break;
     case GBP_SIO_MODE_16BITS_BIG_ENDIAN:
-      temp |= ((gpb_sio.rx_buff >> 0) & 0xFFFF);
+      temp |= ((ctx->sio.rx_buff >> 0) & 0xFFFF);
       break;
     case GBP_SIO_MODE_16BITS_LITTLE_ENDIAN:
-      temp |= ((gpb_sio.rx_buff >> 8) & 0x00FF);
-      temp |= ((gpb_sio.rx_buff << 8) & 0xFF00);
+      temp |= ((ctx->sio.rx_buff >> 8) & 0x00FF);
+      temp |= ((ctx->sio.rx_buff << 8) & 0xFF00);
       break;
   }
   return temp;
 }
 
-static uint8_t gpb_sio_getByte(const int bytePos)
+static uint8_t gpb_sio_getByte(gbp_serial_io_ctx_t *ctx, const int bytePos)
 {
   switch (bytePos)
   {
-    case 0: return ((gpb_sio.rx_buff >> 0) & 0xFF);
-    case 1: return ((gpb_sio.rx_buff >> 8) & 0xFF);
+    case 0: return ((ctx->sio.rx_buff >> 0) & 0xFF);
+    case 1: return ((ctx->sio.rx_buff >> 8) & 0xFF);
     default: return 0;
   }
 }
@@ -192,225 +127,499 @@ static uint8_t gpb_sio_getByte(const int bytePos)
 
 /******************************************************************************/
 
-bool gbp_serial_io_timeout_handler(uint32_t elapsed_ms)
+bool gbp_serial_io_timeout_handler(gbp_serial_io_ctx_t *ctx, uint32_t elapsed_ms)
 {
 #if 0  // This redundancy causes an infinite loop in (Tsuri Seensei 2) GH-57
-  if (gpb_pktIO.breakPacketReceived)
+  if (ctx->pktIO.breakPacketReceived)
   {
-    gpb_serial_io_reset();
+    gpb_serial_io_reset(ctx);
     return true;
   }
 #endif
-  if (gpb_pktIO.timeout_ms > 0)
+  if (ctx->pktIO.timeout_ms > 0)
   {
-    gpb_pktIO.timeout_ms = (gpb_pktIO.timeout_ms > elapsed_ms) ? (gpb_pktIO.timeout_ms - elapsed_ms) : 0;
-    if (gpb_pktIO.timeout_ms == 0)
+    ctx->pktIO.timeout_ms = (ctx->pktIO.timeout_ms > elapsed_ms) ? (ctx->pktIO.timeout_ms - elapsed_ms) : 0;
+    if (ctx->pktIO.timeout_ms == 0)
     {
-      gpb_serial_io_reset();
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+      if (ctx->sio.syncronised)
+        ctx->pktIO.stats.preambleResyncs++;
+#endif
+      gpb_serial_io_reset(ctx);
       return true;
     }
   }
   return false;
 }
 
-size_t gbp_serial_io_dataBuff_getByteCount(void)
+size_t gbp_serial_io_dataBuff_getByteCount(gbp_serial_io_ctx_t *ctx)
 {
-  return gpb_cbuff_Count(&gpb_pktIO.dataBuffer);
+  return gpb_cbuff_Count(&ctx->pktIO.dataBuffer);
 }
 
-uint8_t gbp_serial_io_dataBuff_getByte(void)
+uint8_t gbp_serial_io_dataBuff_getByte(gbp_serial_io_ctx_t *ctx)
 {
   uint8_t b = 0;
 
-  if (!gpb_cbuff_Dequeue(&gpb_pktIO.dataBuffer, &b))
+  if (!gpb_cbuff_Dequeue(&ctx->pktIO.dataBuffer, &b))
     return 0;
 
   /* Packet Timeout Reset (Still Processing) */
-  gpb_pktIO.timeout_ms = GBP_PKT10_TIMEOUT_MS;
+  ctx->pktIO.timeout_ms = GBP_PKT10_TIMEOUT_MS;
+  ctx->pktIO.flow.drainedBytes++;
 
   return b;
 }
 
-uint8_t gbp_serial_io_dataBuff_getByte_Peek(uint32_t offset)
+uint8_t gbp_serial_io_dataBuff_getByte_Peek(gbp_serial_io_ctx_t *ctx, uint32_t offset)
 {
   uint8_t b = 0;
-  gpb_cbuff_Dequeue_Peek(&gpb_pktIO.dataBuffer, &b, offset);
+  gpb_cbuff_Dequeue_Peek(&ctx->pktIO.dataBuffer, &b, offset);
   return b;
 }
 
-uint16_t gbp_serial_io_dataBuff_waterline(bool resetWaterline)
+// Zero copy access to the largest contiguous readable region of the data buffer
+// Call gbp_serial_io_dataBuff_consume() once done with it
+size_t gbp_serial_io_dataBuff_getSpan(gbp_serial_io_ctx_t *ctx, const uint8_t **span)
+{
+  return gpb_cbuff_Dequeue_Span(&ctx->pktIO.dataBuffer, span);
+}
+
+bool gbp_serial_io_dataBuff_consume(gbp_serial_io_ctx_t *ctx, size_t byteCount)
+{
+  if (byteCount == 0)
+    return true;
+
+  if (!gpb_cbuff_Dequeue_Commit(&ctx->pktIO.dataBuffer, byteCount))
+    return false;
+
+  /* Packet Timeout Reset (Still Processing) */
+  ctx->pktIO.timeout_ms = GBP_PKT10_TIMEOUT_MS;
+  ctx->pktIO.flow.drainedBytes += byteCount;
+
+  return true;
+}
+
+uint16_t gbp_serial_io_dataBuff_waterline(gbp_serial_io_ctx_t *ctx, bool resetWaterline)
 {
-  uint16_t retval = gpb_pktIO.dataBufferWaterline;
+  uint16_t retval = ctx->pktIO.dataBufferWaterline;
   if (resetWaterline)
   {
-    gpb_pktIO.dataBufferWaterline = 0;
+    ctx->pktIO.dataBufferWaterline = 0;
   }
   return retval;
 }
 
-uint16_t gbp_serial_io_dataBuff_max(void)
+uint16_t gbp_serial_io_dataBuff_max(gbp_serial_io_ctx_t *ctx)
 {
-  return gpb_cbuff_Capacity(&gpb_pktIO.dataBuffer);
+  return gpb_cbuff_Capacity(&ctx->pktIO.dataBuffer);
 }
 
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+void gbp_serial_io_stats_reset(gbp_serial_io_ctx_t *ctx)
+{
+  memset(&ctx->pktIO.stats, 0, sizeof(ctx->pktIO.stats));
+}
+
+static size_t gbp_serial_io_stats_put(uint8_t *out, const uint32_t value, const size_t size)
+{
+  for (size_t i = 0; i < size; i++)
+  {
+    out[i] = (value >> (8 * i)) & 0xFF;
+  }
+  return size;
+}
+
+// Return: GBP_SERIAL_IO_STATS_PACKED_SIZE
+// Dev Note: Counters may change while being packed, so a single field can be one event out of date
+size_t gbp_serial_io_stats_pack(gbp_serial_io_ctx_t *ctx, uint8_t out[GBP_SERIAL_IO_STATS_PACKED_SIZE])
+{
+  const gbp_serial_io_stats_t *stats = &ctx->pktIO.stats;
+  size_t n = 0;
+  out[n++] = GBP_SERIAL_IO_STATS_VERSION;
+  n += gbp_serial_io_stats_put(&out[n], stats->bytesEnqueued, 4);
+  n += gbp_serial_io_stats_put(&out[n], stats->enqueueFailures, 4);
+  n += gbp_serial_io_stats_put(&out[n], stats->preambleResyncs, 2);
+  n += gbp_serial_io_stats_put(&out[n], stats->checksumFailures, 2);
+  for (int kind = 0; kind < GBP_STATUS_KIND_COUNT; kind++)
+  {
+    n += gbp_serial_io_stats_put(&out[n], stats->packets[kind], 2);
+  }
+  n += gbp_serial_io_stats_put(&out[n], stats->isrMax, 4);
+  n += gbp_serial_io_stats_put(&out[n], stats->hostOutUs, 4);
+  n += gbp_serial_io_stats_put(&out[n], stats->hostOutMaxUs, 4);
+  return n;
+}
+#endif
+
 
 /******************************************************************************/
 
-bool gpb_serial_io_reset(void)
+bool gpb_serial_io_reset(gbp_serial_io_ctx_t *ctx)
 {
-  gpb_sio.syncronised       = false;
-  gpb_sio.rx_buff           = 0;
-  gpb_sio.tx_buff           = 0;
-  gpb_sio.SINOutputPinState = false;
-  gpb_sio.bitMaskMap        = 0;
+  ctx->sio.syncronised       = false;
+  ctx->sio.rx_buff           = 0;
+  ctx->sio.tx_buff           = 0;
+  ctx->sio.SINOutputPinState = false;
+  ctx->sio.bitMaskMap        = 0;
 
   // Clear all device status bits
-  gpb_status_bit_update_low_battery(gpb_pktIO.statusBuffer, false);
-  gpb_status_bit_update_other_error(gpb_pktIO.statusBuffer, false);
-  gpb_status_bit_update_paper_jam(gpb_pktIO.statusBuffer, false);
-  gpb_status_bit_update_packet_error(gpb_pktIO.statusBuffer, false);
-  gpb_status_bit_update_unprocessed_data(gpb_pktIO.statusBuffer, false);
-  gpb_status_bit_update_print_buffer_full(gpb_pktIO.statusBuffer, false);
-  gpb_status_bit_update_printer_busy(gpb_pktIO.statusBuffer, false);
-  gpb_status_bit_update_checksum_error(gpb_pktIO.statusBuffer, false);
+  gpb_status_bit_update_low_battery(ctx->pktIO.status.statusBuffer, false);
+  gpb_status_bit_update_other_error(ctx->pktIO.status.statusBuffer, false);
+  gpb_status_bit_update_paper_jam(ctx->pktIO.status.statusBuffer, false);
+  gpb_status_bit_update_packet_error(ctx->pktIO.status.statusBuffer, false);
+  gpb_status_bit_update_unprocessed_data(ctx->pktIO.status.statusBuffer, false);
+  gpb_status_bit_update_print_buffer_full(ctx->pktIO.status.statusBuffer, false);
+  gpb_status_bit_update_printer_busy(ctx->pktIO.status.statusBuffer, false);
+  gpb_status_bit_update_checksum_error(ctx->pktIO.status.statusBuffer, false);
+  ctx->pktIO.statusSeq++;
 
   // Reset data buffer
-  gpb_cbuff_Reset(&gpb_pktIO.dataBuffer);
+  gpb_cbuff_Reset(&ctx->pktIO.dataBuffer);
 
 #ifdef FEATURE_CHECKSUM_SUPPORTED
   // Reset temp Buffer
-  gpb_cbuff_ResetTemp(&gpb_pktIO.dataBuffer);
+  gpb_cbuff_ResetTemp(&ctx->pktIO.dataBuffer);
+  ctx->pktIO.captureOverflow = false;
 #endif  // FEATURE_CHECKSUM_SUPPORTED
 
   return true;
 }
 
-bool gpb_serial_io_init(size_t buffSize, uint8_t *buffPtr)
+bool gpb_serial_io_init(gbp_serial_io_ctx_t *ctx, size_t buffSize, uint8_t *buffPtr)
 {
   // reset status data
-  gpb_pktIO.statusBuffer        = 0x0000;
-  gpb_pktIO.statusBuffer        = GBP_DEVICE_ID << 8;
-  gpb_pktIO.busyPacketCountdown = 0;
+  ctx->pktIO.status.statusBuffer           = 0x0000;
+  ctx->pktIO.status.statusBuffer           = GBP_DEVICE_ID << 8;
+  ctx->pktIO.status.busyPacketCountdown    = 0;
+  ctx->pktIO.status.untransPacketCountdown = 0;
+  ctx->pktIO.status.dataPacketCountdown    = 0;
+  ctx->pktIO.status.flowAdaptive           = false;
+  ctx->pktIO.status.flowHold               = false;
+  ctx->pktIO.statusSeq                     = 0;
+#ifdef GBP_FEATURE_STATUS_PRECOMPUTE
+  // Nothing precomputed yet
+  ctx->pktIO.statusSlot[0].seq = 0xFFFF;
+  ctx->pktIO.statusSlot[1].seq = 0xFFFF;
+  ctx->pktIO.statusSlotActive  = 0;
+  ctx->pktIO.statusSlotMiss    = 0;
+#endif
+#ifdef FEATURE_CHECKSUM_SUPPORTED
+  ctx->pktIO.checksumErrorCount = 0;
+#endif
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+  gbp_serial_io_stats_reset(ctx);
+#endif
+  // Fixed busy sequencing until gbp_serial_io_flow_config()
+  ctx->pktIO.flow.lowWatermark  = 0;
+  ctx->pktIO.flow.highWatermark = 0;
+  ctx->pktIO.flow.hold          = false;
+  ctx->pktIO.flow.drainedBytes  = 0;
+  ctx->pktIO.flow.windowMs      = 0;
+  ctx->pktIO.flow.drainRate     = 0;
+  ctx->pktIO.flow.holdCount     = 0;
 
   // print data buffer
-  gpb_cbuff_Init(&gpb_pktIO.dataBuffer, buffSize, buffPtr);
+  if (!gpb_cbuff_Init(&ctx->pktIO.dataBuffer, buffSize, buffPtr))
+    return false;
 
   // Packet Parsing Subsystem
-  gpb_serial_io_reset();
+  gpb_serial_io_reset(ctx);
 
   return true;
 }
 
 
-/******************************************************************************/
+/*******************************************************************************
+ * Status Sequencing
+*******************************************************************************/
 
-// Assumption: Only one gameboy printer connection required
-// Return: pin state of GBP_SIN
-#ifdef GBP_FEATURE_USING_RISING_CLOCK_ONLY_ISR
-bool gpb_serial_io_OnRising_ISR(const bool GBP_SOUT)
-#else
-bool gpb_serial_io_OnChange_ISR(const bool GBP_SCLK, const bool GBP_SOUT)
-#endif
+// Representative packet for each gbp_serial_io_status_kind_t
+static const uint8_t gbp_serial_io_status_kindCommand[GBP_STATUS_KIND_COUNT] =
 {
-  // Based on SIO Timing Chart. Page 30 of GameBoy PROGRAMMING MANUAL Version 1.0:
-  // * CPOL=1 : Clock Polarity 1. Idle on high.
-  // * CPHA=1 : Clock Phase 1. Change on falling. Check bit on rising edge.
+  GBP_COMMAND_INIT, GBP_COMMAND_PRINT, GBP_COMMAND_DATA, GBP_COMMAND_DATA, GBP_COMMAND_BREAK, GBP_COMMAND_INQUIRY, 0x00
+};
+static const uint16_t gbp_serial_io_status_kindLength[GBP_STATUS_KIND_COUNT] =
+{
+  0, 0, 1, 0, 0, 0, 0
+};
 
-  // # Pin input state
-  // * GBP_SCLK : Serial Clock (1 = Rising Edge) (0 = Falling Edge)
-  // * GBP_SOUT : Master Output Slave Input (This device is slave)
+static int gbp_serial_io_status_kind(const uint8_t command, const uint16_t data_length)
+{
+  switch (command)
+  {
+    case GBP_COMMAND_INIT:    return GBP_STATUS_KIND_INIT;
+    case GBP_COMMAND_PRINT:   return GBP_STATUS_KIND_PRINT;
+    case GBP_COMMAND_DATA:    return (data_length > 0) ? GBP_STATUS_KIND_DATA : GBP_STATUS_KIND_DATA_END;
+    case GBP_COMMAND_BREAK:   return GBP_STATUS_KIND_BREAK;
+    case GBP_COMMAND_INQUIRY: return GBP_STATUS_KIND_INQUIRY;
+    default:                  return GBP_STATUS_KIND_OTHER;
+  }
+}
 
-  // Scan for preamble
-  if (!gpb_sio.syncronised)
+// Advance the status state by one received packet
+// Return: Status word to send back in the dummy region of this packet
+// Dev Note: Only depends on its arguments, so it can run in the ISR or ahead of time in the main loop
+uint16_t gbp_serial_io_status_step(gbp_serial_io_status_t *status, const uint8_t command, const uint16_t data_length)
+{
+  // Packets only get stepped through here once they passed their checksum
+  gpb_status_bit_update_checksum_error(status->statusBuffer, false);
+
+  // Checksum phase : Update status data : Device Status
+  switch (command)
   {
-#ifndef GBP_FEATURE_USING_RISING_CLOCK_ONLY_ISR
-    // Expecting rising edge
-    if (!GBP_SCLK)
-      return false;
+    // INIT --> DATA --> ENDDATA --> PRINT
+    case GBP_COMMAND_INIT:
+      status->dataPacketCountdown    = GBP_DATA_PACKET_COUNT;
+      status->untransPacketCountdown = 0;
+      status->busyPacketCountdown    = 0;
+      gpb_status_bit_update_print_buffer_full(status->statusBuffer, false);
+      gpb_status_bit_update_printer_busy(status->statusBuffer, false);
+      break;
+    case GBP_COMMAND_PRINT:
+      status->busyPacketCountdown = status->flowAdaptive ? GBP_FLOW_BUSY_PACKET_COUNT_MIN : GBP_BUSY_PACKET_COUNT;
+      break;
+    case GBP_COMMAND_DATA:
+      status->untransPacketCountdown = GBP_UNTRANS_PACKET_COUNT;
+      break;
+    case GBP_COMMAND_BREAK:
+      gpb_status_bit_update_low_battery(status->statusBuffer, false);
+      gpb_status_bit_update_other_error(status->statusBuffer, false);
+      gpb_status_bit_update_paper_jam(status->statusBuffer, false);
+      gpb_status_bit_update_packet_error(status->statusBuffer, false);
+      gpb_status_bit_update_unprocessed_data(status->statusBuffer, false);
+      gpb_status_bit_update_print_buffer_full(status->statusBuffer, true);
+      gpb_status_bit_update_printer_busy(status->statusBuffer, true);
+      gpb_status_bit_update_checksum_error(status->statusBuffer, false);
+      break;
+    case GBP_COMMAND_INQUIRY:
+      if (status->untransPacketCountdown > 0)
+      {
+        status->untransPacketCountdown--;
+        if (status->untransPacketCountdown == 0)
+        {
+          gpb_status_bit_update_unprocessed_data(status->statusBuffer, false);
+          if (status->busyPacketCountdown > 0)
+          {
+            gpb_status_bit_update_printer_busy(status->statusBuffer, true);
+            gpb_status_bit_update_print_buffer_full(status->statusBuffer, true);
+          }
+        }
+      }
+      else if (status->busyPacketCountdown > 0)
+      {
+        // Last busy reply is held for as long as the host is behind
+        if ((status->busyPacketCountdown > 1) || !status->flowHold)
+          status->busyPacketCountdown--;
+        if (status->busyPacketCountdown == 0)
+        {
+          gpb_status_bit_update_printer_busy(status->statusBuffer, false);
+        }
+      }
+      break;
+    default:
+      break;
+  }
+
+  const uint16_t txStatus = status->statusBuffer;
+
+  // Dummy phase (after the status was sent) : Update status data : Device Status
+  switch (command)
+  {
+    // INIT --> DATA --> ENDDATA --> PRINT
+    case GBP_COMMAND_INIT:
+      break;
+    case GBP_COMMAND_PRINT:
+      break;
+    case GBP_COMMAND_DATA:
+      if (status->dataPacketCountdown > 0)
+      {
+        status->dataPacketCountdown--;
+        if (status->dataPacketCountdown == 0)
+        {
+          gpb_status_bit_update_unprocessed_data(status->statusBuffer, false);
+        }
+      }
+      gpb_status_bit_update_print_buffer_full(status->statusBuffer, false);
+      gpb_status_bit_update_unprocessed_data(status->statusBuffer, false);
+      if (data_length == 0)
+      {
+        gpb_status_bit_update_unprocessed_data(status->statusBuffer, false);
+        gpb_status_bit_update_print_buffer_full(status->statusBuffer, true);
+      }
+      break;
+    case GBP_COMMAND_BREAK:
+      break;
+    case GBP_COMMAND_INQUIRY:
+      gpb_status_bit_update_unprocessed_data(status->statusBuffer, false);
+      if ((status->untransPacketCountdown == 0) && (status->busyPacketCountdown == 0))
+      {
+        gpb_status_bit_update_print_buffer_full(status->statusBuffer, false);
+      }
+      break;
+    default:
+      break;
+  }
+
+  return txStatus;
+}
+
+#ifdef GBP_FEATURE_STATUS_PRECOMPUTE
+// Main loop stage: Work out the status response of the next packet for every
+// packet kind and publish it to the ISR through a double buffered slot, so the
+// ISR only has to pick one. If the main loop falls behind, the ISR works it out inline instead.
+// Return: true if a new slot was published
+bool gbp_serial_io_status_service(gbp_serial_io_ctx_t *ctx)
+{
+  const uint8_t active = ctx->pktIO.statusSlotActive;
+
+  // Already up to date?
+  const bool flowHold = ctx->pktIO.flow.hold;
+  if ((ctx->pktIO.statusSlot[active].seq == ctx->pktIO.statusSeq) && (ctx->pktIO.statusSlot[active].flowHold == flowHold))
+    return false;
+
+  // Stable snapshot of the status (ISR may advance it while we are copying)
+  uint16_t seq;
+  gbp_serial_io_status_t status;
+  do
+  {
+    seq = ctx->pktIO.statusSeq;
+    GBP_SERIAL_IO_BARRIER();
+    status = ctx->pktIO.status;
+    GBP_SERIAL_IO_BARRIER();
+  } while (seq != ctx->pktIO.statusSeq);
+  status.flowHold = flowHold;
+
+  // Fill in the slot the ISR is not reading from
+  gbp_serial_io_status_slot_t *slot = &ctx->pktIO.statusSlot[active ^ 1];
+  for (int kind = 0; kind < GBP_STATUS_KIND_COUNT; kind++)
+  {
+    slot->next[kind]     = status;
+    slot->txStatus[kind] = gbp_serial_io_status_step(&slot->next[kind], gbp_serial_io_status_kindCommand[kind], gbp_serial_io_status_kindLength[kind]);
+  }
+  slot->seq      = seq;
+  slot->flowHold = flowHold;
+
+  // Publish
+  GBP_SERIAL_IO_BARRIER();
+  ctx->pktIO.statusSlotActive = active ^ 1;
+  return true;
+}
 #endif
 
-    // Clocking bits on rising edge
-    gpb_sio.preamble |= GBP_SOUT ? 1 : 0;
 
-    // Sync Not Found? Keep scanning
-    if ((gpb_sio.preamble & 0xFFFF) != GBP_SYNC_WORD)
-    {
-      gpb_sio.preamble <<= 1;
-      return false;
-    }
+/*******************************************************************************
+ * Adaptive Flow Control
+*******************************************************************************/
 
-    // Preamble Found... Currently at rising edge
-    // Start reading the packet header
-    gpb_pktIO.packetState = GBP_PKT10_PARSE_HEADER_COMMAND_AND_COMPRESSION;
-    gpb_sio.preamble      = 0;
-    gpb_sio.syncronised   = true;
-    gpb_sio_next(GBP_SIO_MODE_16BITS_BIG_ENDIAN, 0);
+// Let the busy period after a print follow the host instead of GBP_BUSY_PACKET_COUNT.
+// Busy is held once highWatermark bytes are buffered, until the buffer is back down to
+// lowWatermark or the host is draining fast enough to empty it soon.
+// Call after gpb_serial_io_init() but before the ISR is attached. highWatermark of 0 disables it.
+bool gbp_serial_io_flow_config(gbp_serial_io_ctx_t *ctx, uint16_t lowWatermark, uint16_t highWatermark)
+{
+  if ((highWatermark > 0) && ((lowWatermark >= highWatermark) || (highWatermark > gpb_cbuff_Capacity(&ctx->pktIO.dataBuffer))))
     return false;
+
+  ctx->pktIO.flow.lowWatermark   = lowWatermark;
+  ctx->pktIO.flow.highWatermark  = highWatermark;
+  ctx->pktIO.flow.hold           = false;
+  ctx->pktIO.status.flowAdaptive = (highWatermark > 0);
+  ctx->pktIO.statusSeq++;
+  return true;
+}
+
+// Main loop stage: Measure how fast the host is taking bytes out and decide if the printer should look busy
+// Return: true if the host is behind (busy is being held)
+bool gbp_serial_io_flow_service(gbp_serial_io_ctx_t *ctx, uint32_t elapsed_ms)
+{
+  if (ctx->pktIO.flow.highWatermark == 0)
+    return false;
+
+  // Drain rate
+  ctx->pktIO.flow.windowMs += (elapsed_ms < GBP_FLOW_RATE_WINDOW_MS) ? elapsed_ms : GBP_FLOW_RATE_WINDOW_MS;
+  if (ctx->pktIO.flow.windowMs >= GBP_FLOW_RATE_WINDOW_MS)
+  {
+    const uint32_t rate = (ctx->pktIO.flow.drainedBytes * 1000) / ctx->pktIO.flow.windowMs;
+    ctx->pktIO.flow.drainRate    = (ctx->pktIO.flow.drainRate * 3 + rate) / 4;
+    ctx->pktIO.flow.drainedBytes = 0;
+    ctx->pktIO.flow.windowMs     = 0;
   }
 
-  /* Psudo SPI Engine */
-  // Basically I have one bit acting as a mask moving across a word sized buffer
-  if (gpb_sio.bitMaskMap > 0)
+  // Watermarks with hysteresis
+  const uint32_t count = gpb_cbuff_Count(&ctx->pktIO.dataBuffer);
+  if (!ctx->pktIO.flow.hold)
   {
-    // Serial Transaction Is Active
-#ifdef GBP_FEATURE_USING_RISING_CLOCK_ONLY_ISR
-    // Rising Edge Clock (Rx Bit)
-    gpb_sio.rx_buff |= GBP_SOUT ? (gpb_sio.bitMaskMap & 0xFFFF) : 0;  ///< Clocking bits on rising edge
-    gpb_sio.bitMaskMap >>= 1;                                         ///< One tx/rx bit cycle complete, next bit now
-    // Falling Edge Clock (Tx Bit) (Prep now for next rising edge)
-    gpb_sio.SINOutputPinState = (gpb_sio.bitMaskMap & gpb_sio.tx_buff) > 0;
-    if (gpb_sio.bitMaskMap > 0)
-      return gpb_sio.SINOutputPinState;
-#else
-    if (GBP_SCLK)
+    if (count >= ctx->pktIO.flow.highWatermark)
     {
-      // Rising Edge Clock (Rx Bit)
-      gpb_sio.rx_buff |= GBP_SOUT ? (gpb_sio.bitMaskMap & 0xFFFF) : 0;  ///< Clocking bits on rising edge
-      gpb_sio.bitMaskMap >>= 1;                                         ///< One tx/rx bit cycle complete, next bit now
-
-      if (gpb_sio.bitMaskMap > 0)
-        return gpb_sio.SINOutputPinState;
+      ctx->pktIO.flow.hold = true;
+      ctx->pktIO.flow.holdCount++;
     }
-    else
+  }
+  else
+  {
+    const bool drainingSoon = (ctx->pktIO.flow.drainRate > 0) && (((count * 1000) / ctx->pktIO.flow.drainRate) <= GBP_FLOW_DRAIN_HORIZON_MS);
+    if ((count <= ctx->pktIO.flow.lowWatermark) || drainingSoon)
     {
-      // Falling Edge Clock (Tx Bit)
-      gpb_sio.SINOutputPinState = (gpb_sio.bitMaskMap & gpb_sio.tx_buff) > 0;
-      return gpb_sio.SINOutputPinState;
+      ctx->pktIO.flow.hold = false;
     }
-#endif
   }
 
-  /****************************************************************************/
+  return ctx->pktIO.flow.hold;
+}
+
+
+/******************************************************************************/
 
+// Capture a byte of the current packet (Staged until the packet is accepted if checksums are supported)
+static inline void gpb_serial_io_capture(gbp_serial_io_ctx_t *ctx, const uint8_t b)
+{
+  const bool captured = gpb_cbuff_EnqueueTemp(&ctx->pktIO.dataBuffer, b);
+  (void)captured;
+#ifdef FEATURE_CHECKSUM_SUPPORTED
+  if (!captured)
+    ctx->pktIO.captureOverflow = true;
+#endif
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+  if (captured)
+    ctx->pktIO.stats.bytesEnqueued++;
+  else
+    ctx->pktIO.stats.enqueueFailures++;
+#endif
+}
+
+// A whole byte or word has been shifted in/out, process it and prep the next one
+static void gpb_serial_io_OnWord(gbp_serial_io_ctx_t *ctx)
+{
   /* There is uncaptured sync bytes so add it in */
-  if (gpb_pktIO.packetState == GBP_PKT10_PARSE_HEADER_COMMAND_AND_COMPRESSION)
+  if (ctx->pktIO.packetState == GBP_PKT10_PARSE_HEADER_COMMAND_AND_COMPRESSION)
   {
-    gpb_cbuff_EnqueueTemp(&gpb_pktIO.dataBuffer, GBP_SYNC_WORD_0);
-    gpb_cbuff_EnqueueTemp(&gpb_pktIO.dataBuffer, GBP_SYNC_WORD_1);
+    gpb_serial_io_capture(ctx, GBP_SYNC_WORD_0);
+    gpb_serial_io_capture(ctx, GBP_SYNC_WORD_1);
   }
 
   /* Byte captured so send it downstream to packet processor */
-  switch (gpb_sio.mode)
+  switch (ctx->sio.mode)
   {
     case GBP_SIO_MODE_8BITS:
-      gpb_cbuff_EnqueueTemp(&gpb_pktIO.dataBuffer, (uint8_t)((gpb_sio.rx_buff >> 0) & 0xFF));
+      gpb_serial_io_capture(ctx, (uint8_t)((ctx->sio.rx_buff >> 0) & 0xFF));
       break;
     case GBP_SIO_MODE_16BITS_BIG_ENDIAN:
     case GBP_SIO_MODE_16BITS_LITTLE_ENDIAN:
-      if (gpb_pktIO.packetState == GBP_PKT10_PARSE_DUMMY)
+      if (ctx->pktIO.packetState == GBP_PKT10_PARSE_DUMMY)
       {
         // Virtual Printer --> Gameboy
         // Dev Notes: This is for dumping status byte. This is only done during
         //            the dummy buffer byte phase so might as well use these
         //            bytes for documenting response of the status byte
-        gpb_cbuff_EnqueueTemp(&gpb_pktIO.dataBuffer, (uint8_t)((gpb_sio.tx_buff >> 8) & 0xFF));
-        gpb_cbuff_EnqueueTemp(&gpb_pktIO.dataBuffer, (uint8_t)((gpb_sio.tx_buff >> 0) & 0xFF));
+        gpb_serial_io_capture(ctx, (uint8_t)((ctx->sio.tx_buff >> 8) & 0xFF));
+        gpb_serial_io_capture(ctx, (uint8_t)((ctx->sio.tx_buff >> 0) & 0xFF));
       }
       else
       {
         // Gameboy --> Virtual Printer
-        gpb_cbuff_EnqueueTemp(&gpb_pktIO.dataBuffer, (uint8_t)((gpb_sio.rx_buff >> 8) & 0xFF));
-        gpb_cbuff_EnqueueTemp(&gpb_pktIO.dataBuffer, (uint8_t)((gpb_sio.rx_buff >> 0) & 0xFF));
+        gpb_serial_io_capture(ctx, (uint8_t)((ctx->sio.rx_buff >> 8) & 0xFF));
+        gpb_serial_io_capture(ctx, (uint8_t)((ctx->sio.rx_buff >> 0) & 0xFF));
       }
       break;
     default:
@@ -418,127 +627,137 @@ bool gpb_serial_io_OnChange_ISR(const bool GBP_SCLK, const bool GBP_SOUT)
   }
 
   // Track upper usage of buffer
-  uint16_t waterline = gpb_cbuff_Count(&gpb_pktIO.dataBuffer);
-  if (waterline > gpb_pktIO.dataBufferWaterline)
+#ifdef FEATURE_CHECKSUM_SUPPORTED
+  uint16_t waterline = gpb_cbuff_Count(&ctx->pktIO.dataBuffer) + gpb_cbuff_CountTemp(&ctx->pktIO.dataBuffer);
+#else
+  uint16_t waterline = gpb_cbuff_Count(&ctx->pktIO.dataBuffer);
+#endif
+  if (waterline > ctx->pktIO.dataBufferWaterline)
   {
-    gpb_pktIO.dataBufferWaterline = waterline;
+    ctx->pktIO.dataBufferWaterline = waterline;
   }
 
   /* Packet Timeout Reset */
-  gpb_pktIO.timeout_ms = GBP_PKT10_TIMEOUT_MS;
+  ctx->pktIO.timeout_ms = GBP_PKT10_TIMEOUT_MS;
 
   /****************************************************************************/
   /* Packet State */
-  switch (gpb_pktIO.packetState)
+  switch (ctx->pktIO.packetState)
   {
     case GBP_PKT10_PARSE_HEADER_COMMAND_AND_COMPRESSION:
       {
         // Parse
-        gpb_pktIO.command      = gpb_sio_getByte(1);
-        gpb_pktIO.compression  = gpb_sio_getByte(0);
-        gpb_pktIO.checksumCalc = 0;
+        ctx->pktIO.command      = gpb_sio_getByte(ctx, 1);
+        ctx->pktIO.compression  = gpb_sio_getByte(ctx, 0);
+        ctx->pktIO.checksumCalc = 0;
         // Next Header Segment
-        gpb_pktIO.packetState = GBP_PKT10_PARSE_HEADER_DATA_LENGTH;
-        gpb_sio_next(GBP_SIO_MODE_16BITS_LITTLE_ENDIAN, 0);
+        ctx->pktIO.packetState = GBP_PKT10_PARSE_HEADER_DATA_LENGTH;
+        gpb_sio_next(ctx, GBP_SIO_MODE_16BITS_LITTLE_ENDIAN, 0);
       }
       break;
     case GBP_PKT10_PARSE_HEADER_DATA_LENGTH:
       {
         // Parse
         // GBP Data Length and Checksum is sent in little-endian format
-        gpb_pktIO.data_length = gpb_sio_getWord();
+        ctx->pktIO.data_length = gpb_sio_getWord(ctx);
         // Dev Note: For robustness, we know only data and print have data payload
         // Prep data parsing
-        gpb_pktIO.data_i = 0;
-        switch (gpb_pktIO.command)
+        ctx->pktIO.data_i = 0;
+        switch (ctx->pktIO.command)
         {
           case GBP_COMMAND_DATA:
-            if (gpb_pktIO.data_length != 0)
+            if (ctx->pktIO.data_length != 0)
             {
-              gpb_pktIO.packetState = GBP_PKT10_PARSE_DATA_PAYLOAD;
-              gpb_sio_next(GBP_SIO_MODE_8BITS, 0);
+              ctx->pktIO.packetState = GBP_PKT10_PARSE_DATA_PAYLOAD;
+              gpb_sio_next(ctx, GBP_SIO_MODE_8BITS, 0);
             }
             else
             {
-              gpb_pktIO.packetState = GBP_PKT10_PARSE_CHECKSUM;
-              gpb_sio_next(GBP_SIO_MODE_16BITS_LITTLE_ENDIAN, 0);
+              ctx->pktIO.packetState = GBP_PKT10_PARSE_CHECKSUM;
+              gpb_sio_next(ctx, GBP_SIO_MODE_16BITS_LITTLE_ENDIAN, 0);
             }
             break;
           case GBP_COMMAND_PRINT:
-            gpb_pktIO.packetState = GBP_PKT10_PARSE_DATA_PAYLOAD;
-            gpb_sio_next(GBP_SIO_MODE_8BITS, 0);
+            ctx->pktIO.packetState = GBP_PKT10_PARSE_DATA_PAYLOAD;
+            gpb_sio_next(ctx, GBP_SIO_MODE_8BITS, 0);
             // Size limit guard
-            gpb_pktIO.data_length = gpb_pktIO.data_length > 4 ? 4 : gpb_pktIO.data_length;
+            ctx->pktIO.data_length = ctx->pktIO.data_length > 4 ? 4 : ctx->pktIO.data_length;
             break;
           default:
-            gpb_pktIO.packetState = GBP_PKT10_PARSE_CHECKSUM;
-            gpb_sio_next(GBP_SIO_MODE_16BITS_LITTLE_ENDIAN, 0);
+            ctx->pktIO.packetState = GBP_PKT10_PARSE_CHECKSUM;
+            gpb_sio_next(ctx, GBP_SIO_MODE_16BITS_LITTLE_ENDIAN, 0);
             break;
         }
       }
       break;
     case GBP_PKT10_PARSE_DATA_PAYLOAD:
       {
-        switch (gpb_pktIO.command)
+        switch (ctx->pktIO.command)
         {
           case GBP_COMMAND_DATA:
             // Dev Note: Previous naive approach was to capture byte here
-            // e.g. gpb_cbuff_EnqueueTemp(&gpb_pktIO.dataBuffer, (uint8_t)(gpb_sio.rx_buff & 0xFF));
+            // e.g. gpb_cbuff_EnqueueTemp(&ctx->pktIO.dataBuffer, (uint8_t)(ctx->sio.rx_buff & 0xFF));
             break;
           case GBP_COMMAND_PRINT:
             // Dev Note: But now we are doing packet processing later on...
             //           so now we are focusing only on capturing bytes in ISR
-            //gpb_pktIO.printInstructionBuffer[gpb_pktIO.data_i] = (uint8_t)(gpb_sio.rx_buff & 0xFF);
+            //ctx->pktIO.printInstructionBuffer[ctx->pktIO.data_i] = (uint8_t)(ctx->sio.rx_buff & 0xFF);
             break;
           default:
             break;
         }
 
-        gpb_pktIO.checksumCalc += (uint16_t)gpb_sio_getByte(0);
+        ctx->pktIO.checksumCalc += (uint16_t)gpb_sio_getByte(ctx, 0);
 
         // Increment to next byte position in the data field
-        gpb_pktIO.data_i++;
+        ctx->pktIO.data_i++;
 
         // Escape and move to next stage
-        if (gpb_pktIO.data_i >= gpb_pktIO.data_length)
+        if (ctx->pktIO.data_i >= ctx->pktIO.data_length)
         {
-          gpb_pktIO.packetState = GBP_PKT10_PARSE_CHECKSUM;
-          gpb_sio_next(GBP_SIO_MODE_16BITS_LITTLE_ENDIAN, 0);
+          ctx->pktIO.packetState = GBP_PKT10_PARSE_CHECKSUM;
+          gpb_sio_next(ctx, GBP_SIO_MODE_16BITS_LITTLE_ENDIAN, 0);
         }
         else
         {
-          gpb_pktIO.packetState = GBP_PKT10_PARSE_DATA_PAYLOAD;
-          gpb_sio_next(GBP_SIO_MODE_8BITS, 0);
+          ctx->pktIO.packetState = GBP_PKT10_PARSE_DATA_PAYLOAD;
+          gpb_sio_next(ctx, GBP_SIO_MODE_8BITS, 0);
         }
       }
       break;
     case GBP_PKT10_PARSE_CHECKSUM:
       {
         // GBP Data Length and Checksum is sent in little-endian format. Swap
-        gpb_pktIO.checksum = gpb_sio_getWord();
+        ctx->pktIO.checksum = gpb_sio_getWord(ctx);
 
         // Checksum
-        gpb_pktIO.checksumCalc += gpb_pktIO.command;
-        gpb_pktIO.checksumCalc += gpb_pktIO.compression;
-        gpb_pktIO.checksumCalc += (gpb_pktIO.data_length >> 8) & 0xFF;
-        gpb_pktIO.checksumCalc += (gpb_pktIO.data_length >> 0) & 0xFF;
+        ctx->pktIO.checksumCalc += ctx->pktIO.command;
+        ctx->pktIO.checksumCalc += ctx->pktIO.compression;
+        ctx->pktIO.checksumCalc += (ctx->pktIO.data_length >> 8) & 0xFF;
+        ctx->pktIO.checksumCalc += (ctx->pktIO.data_length >> 0) & 0xFF;
+
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+        if (ctx->pktIO.checksum != ctx->pktIO.checksumCalc)
+          ctx->pktIO.stats.checksumFailures++;
+#endif
+
+        bool statusInline = false;  ///< Status modified here, so a precomputed response would be wrong
+        (void)statusInline;
+        bool packetRejected = false;  ///< Game has to resend this packet
 
 #ifdef FEATURE_CHECKSUM_SUPPORTED
-        // Dev Note: Was used to confirm that packetizer was working
-        // This will cause the printer to retry sending this packet
-        if (gpb_pktIO.checksum != gpb_pktIO.checksumCalc)
-        {
-          gpb_status_bit_update_checksum_error(gpb_pktIO.statusBuffer, true);
-        }
+        // This will cause the game to resend this packet
+        // Dev Note: Also done if the packet did not fit, so the host gets a chance to catch up
+        packetRejected = (ctx->pktIO.checksum != ctx->pktIO.checksumCalc) || ctx->pktIO.captureOverflow;
 #endif  // FEATURE_CHECKSUM_SUPPORTED
 
 #ifdef TEST_CHECKSUM_FORCE_FAIL
-        // WIP investigation of checksum based flow control
+        // Checksum based flow control check (Every fourth packet is resent)
         static int checksumFailToggle = 0;
         if (checksumFailToggle > 2)
         {
           checksumFailToggle = 0;
-          gpb_status_bit_update_checksum_error(gpb_pktIO.statusBuffer, true);
+          packetRejected     = true;
         }
         checksumFailToggle++;
 #endif  // TEST_CHECKSUM_FORCE_FAIL
@@ -550,133 +769,80 @@ bool gpb_serial_io_OnChange_ISR(const bool GBP_SCLK, const bool GBP_SOUT)
         if (fakeFullToggle > 5)
         {
           fakeFullToggle = 0;
-          gpb_status_bit_update_print_buffer_full(gpb_pktIO.statusBuffer, true);
+          gpb_status_bit_update_print_buffer_full(ctx->pktIO.status.statusBuffer, true);
         }
         else
         {
-          gpb_status_bit_update_print_buffer_full(gpb_pktIO.statusBuffer, false);
+          gpb_status_bit_update_print_buffer_full(ctx->pktIO.status.statusBuffer, false);
         }
         fakeFullToggle++;
+        statusInline = true;
 #endif  // TEST_PRETEND_BUFFER_FULL
 
         // Update status data : Device Status
-        switch (gpb_pktIO.command)
+        uint16_t txStatus;
+        if (packetRejected)
         {
-          // INIT --> DATA --> ENDDATA --> PRINT
-          case GBP_COMMAND_INIT:
-            gpb_pktIO.dataPacketCountdown    = 6;
-            gpb_pktIO.untransPacketCountdown = 0;
-            gpb_pktIO.busyPacketCountdown    = 0;
-            gpb_status_bit_update_print_buffer_full(gpb_pktIO.statusBuffer, false);
-            gpb_status_bit_update_printer_busy(gpb_pktIO.statusBuffer, false);
-            break;
-          case GBP_COMMAND_PRINT:
-            gpb_pktIO.busyPacketCountdown = GBP_BUSY_PACKET_COUNT;
-            break;
-          case GBP_COMMAND_DATA:
-            gpb_pktIO.untransPacketCountdown = 3;
-            break;
-          case GBP_COMMAND_BREAK:
-            gpb_status_bit_update_low_battery(gpb_pktIO.statusBuffer, false);
-            gpb_status_bit_update_other_error(gpb_pktIO.statusBuffer, false);
-            gpb_status_bit_update_paper_jam(gpb_pktIO.statusBuffer, false);
-            gpb_status_bit_update_packet_error(gpb_pktIO.statusBuffer, false);
-            gpb_status_bit_update_unprocessed_data(gpb_pktIO.statusBuffer, false);
-            gpb_status_bit_update_print_buffer_full(gpb_pktIO.statusBuffer, true);
-            gpb_status_bit_update_printer_busy(gpb_pktIO.statusBuffer, true);
-            gpb_status_bit_update_checksum_error(gpb_pktIO.statusBuffer, false);
-            break;
-          case GBP_COMMAND_INQUIRY:
-            if (gpb_pktIO.untransPacketCountdown > 0)
-            {
-              gpb_pktIO.untransPacketCountdown--;
-              if (gpb_pktIO.untransPacketCountdown == 0)
-              {
-                gpb_status_bit_update_unprocessed_data(gpb_pktIO.statusBuffer, false);
-                if (gpb_pktIO.busyPacketCountdown > 0)
-                {
-                  gpb_status_bit_update_printer_busy(gpb_pktIO.statusBuffer, true);
-                  gpb_status_bit_update_print_buffer_full(gpb_pktIO.statusBuffer, true);
-                }
-              }
-            }
-            else if (gpb_pktIO.busyPacketCountdown > 0)
-            {
-              gpb_pktIO.busyPacketCountdown--;
-              if (gpb_pktIO.busyPacketCountdown == 0)
-              {
-                gpb_status_bit_update_printer_busy(gpb_pktIO.statusBuffer, false);
-              }
-            }
-            break;
-          default:
-            break;
+          // Status sequencing stays where it is until the packet is resent
+          gpb_status_bit_update_checksum_error(ctx->pktIO.status.statusBuffer, true);
+          txStatus = ctx->pktIO.status.statusBuffer;
+#ifdef FEATURE_CHECKSUM_SUPPORTED
+          ctx->pktIO.checksumErrorCount++;
+#endif
         }
+        else
+        {
+#ifdef GBP_FEATURE_STATUS_PRECOMPUTE
+          const gbp_serial_io_status_slot_t *slot = &ctx->pktIO.statusSlot[ctx->pktIO.statusSlotActive];
+          if (!statusInline && (slot->seq == ctx->pktIO.statusSeq) && (slot->flowHold == ctx->pktIO.flow.hold))
+          {
+            // Main loop has already worked out the response, so just pick it
+            const int kind    = gbp_serial_io_status_kind(ctx->pktIO.command, ctx->pktIO.data_length);
+            ctx->pktIO.status = slot->next[kind];
+            txStatus          = slot->txStatus[kind];
+          }
+          else
+          {
+            ctx->pktIO.statusSlotMiss++;
+            ctx->pktIO.status.flowHold = ctx->pktIO.flow.hold;
+            txStatus = gbp_serial_io_status_step(&ctx->pktIO.status, ctx->pktIO.command, ctx->pktIO.data_length);
+          }
+#else
+          ctx->pktIO.status.flowHold = ctx->pktIO.flow.hold;
+          txStatus = gbp_serial_io_status_step(&ctx->pktIO.status, ctx->pktIO.command, ctx->pktIO.data_length);
+#endif
+        }
+        ctx->pktIO.statusSeq++;
 
         // Start sending device id and status byte
-        gpb_pktIO.packetState = GBP_PKT10_PARSE_DUMMY;
-        gpb_sio_next(GBP_SIO_MODE_16BITS_BIG_ENDIAN, gpb_pktIO.statusBuffer);
+        ctx->pktIO.packetState = GBP_PKT10_PARSE_DUMMY;
+        gpb_sio_next(ctx, GBP_SIO_MODE_16BITS_BIG_ENDIAN, txStatus);
       }
       break;
     case GBP_PKT10_PARSE_DUMMY:
       {
-        // Update status data : Device Status
-        switch (gpb_pktIO.command)
-        {
-          // INIT --> DATA --> ENDDATA --> PRINT
-          case GBP_COMMAND_INIT:
-            break;
-          case GBP_COMMAND_PRINT:
-            break;
-          case GBP_COMMAND_DATA:
-            if (gpb_pktIO.dataPacketCountdown > 0)
-            {
-              gpb_pktIO.dataPacketCountdown--;
-              if (gpb_pktIO.dataPacketCountdown == 0)
-              {
-                gpb_status_bit_update_unprocessed_data(gpb_pktIO.statusBuffer, false);
-              }
-            }
-            gpb_status_bit_update_print_buffer_full(gpb_pktIO.statusBuffer, false);
-            gpb_status_bit_update_unprocessed_data(gpb_pktIO.statusBuffer, false);
-            if (gpb_pktIO.data_length == 0)
-            {
-              gpb_status_bit_update_unprocessed_data(gpb_pktIO.statusBuffer, false);
-              gpb_status_bit_update_print_buffer_full(gpb_pktIO.statusBuffer, true);
-            }
-            break;
-          case GBP_COMMAND_BREAK:
-            break;
-          case GBP_COMMAND_INQUIRY:
-            gpb_status_bit_update_unprocessed_data(gpb_pktIO.statusBuffer, false);
-            if ((gpb_pktIO.untransPacketCountdown == 0) && (gpb_pktIO.busyPacketCountdown == 0))
-            {
-              gpb_status_bit_update_print_buffer_full(gpb_pktIO.statusBuffer, false);
-            }
-            break;
-          default:
-            break;
-        }
-
-        switch (gpb_pktIO.command)
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+        ctx->pktIO.stats.packets[gbp_serial_io_status_kind(ctx->pktIO.command, ctx->pktIO.data_length)]++;
+#endif
+        switch (ctx->pktIO.command)
         {
           case GBP_COMMAND_INIT:
-            gpb_pktIO.initReceived = true;
+            ctx->pktIO.initReceived = true;
             break;
           case GBP_COMMAND_PRINT:
-            gpb_pktIO.printInstructionReceived = true;
+            ctx->pktIO.printInstructionReceived = true;
             break;
           case GBP_COMMAND_DATA:
-            if (gpb_pktIO.data_length > 0)
-              gpb_pktIO.dataPacketReceived = true;
+            if (ctx->pktIO.data_length > 0)
+              ctx->pktIO.dataPacketReceived = true;
             else
-              gpb_pktIO.dataEndPacketReceived = true;
+              ctx->pktIO.dataEndPacketReceived = true;
             break;
           case GBP_COMMAND_BREAK:
-            gpb_pktIO.breakPacketReceived = true;
+            ctx->pktIO.breakPacketReceived = true;
             break;
           case GBP_COMMAND_INQUIRY:
-            gpb_pktIO.nulPacketReceived = true;
+            ctx->pktIO.nulPacketReceived = true;
             break;
           default:
             break;
@@ -684,32 +850,114 @@ bool gpb_serial_io_OnChange_ISR(const bool GBP_SCLK, const bool GBP_SOUT)
 
 #ifdef FEATURE_CHECKSUM_SUPPORTED
         // temp buff handling
-        if (gpb_status_bit_getbit_checksum_error(gpb_pktIO.statusBuffer))
+        if (gpb_status_bit_getbit_checksum_error(ctx->pktIO.status.statusBuffer))
         {
-          // On checksum error, throw away old data. GBP will resend
-          gpb_cbuff_ResetTemp(&gpb_pktIO.dataBuffer);
+          // On checksum error, throw away this packet. GBP will resend
+          gpb_cbuff_ResetTemp(&ctx->pktIO.dataBuffer);
         }
         else
         {
-          // Checksum ok, keep the new data
-          gpb_cbuff_AcceptTemp(&gpb_pktIO.dataBuffer);
+          // Checksum ok, pass the whole packet (including status reply) on to the consumer
+          gpb_cbuff_AcceptTemp(&ctx->pktIO.dataBuffer);
         }
+        ctx->pktIO.captureOverflow = false;
 #endif  // FEATURE_CHECKSUM_SUPPORTED
 
         // Cleanup
-        gpb_pktIO.packetState = GBP_PKT10_PARSE_HEADER_COMMAND_AND_COMPRESSION;
-        gpb_sio_next(GBP_SIO_MODE_RESET, 0);
-        gpb_sio.SINOutputPinState = false;
+        ctx->pktIO.packetState = GBP_PKT10_PARSE_HEADER_COMMAND_AND_COMPRESSION;
+        gpb_sio_next(ctx, GBP_SIO_MODE_RESET, 0);
+        ctx->sio.SINOutputPinState = false;
       }
       break;
     default:
       {
         // ? Should not reach here
-        gpb_pktIO.packetState = GBP_PKT10_PARSE_HEADER_COMMAND_AND_COMPRESSION;
-        gpb_sio_next(GBP_SIO_MODE_RESET, 0);
-        gpb_sio.SINOutputPinState = false;
+        ctx->pktIO.packetState = GBP_PKT10_PARSE_HEADER_COMMAND_AND_COMPRESSION;
+        gpb_sio_next(ctx, GBP_SIO_MODE_RESET, 0);
+        ctx->sio.SINOutputPinState = false;
       }
   }
+}
+
+// Dev Note: Only touches the given ctx, so each printer port can have its own clock ISR
+// Return: pin state of GBP_SIN
+#ifdef GBP_FEATURE_USING_RISING_CLOCK_ONLY_ISR
+bool gpb_serial_io_OnRising_ISR(gbp_serial_io_ctx_t *ctx, const bool GBP_SOUT)
+#else
+bool gpb_serial_io_OnChange_ISR(gbp_serial_io_ctx_t *ctx, const bool GBP_SCLK, const bool GBP_SOUT)
+#endif
+{
+  // Based on SIO Timing Chart. Page 30 of GameBoy PROGRAMMING MANUAL Version 1.0:
+  // * CPOL=1 : Clock Polarity 1. Idle on high.
+  // * CPHA=1 : Clock Phase 1. Change on falling. Check bit on rising edge.
+
+  // # Pin input state
+  // * GBP_SCLK : Serial Clock (1 = Rising Edge) (0 = Falling Edge)
+  // * GBP_SOUT : Master Output Slave Input (This device is slave)
+
+  // Scan for preamble
+  if (!ctx->sio.syncronised)
+  {
+#ifndef GBP_FEATURE_USING_RISING_CLOCK_ONLY_ISR
+    // Expecting rising edge
+    if (!GBP_SCLK)
+      return false;
+#endif
+
+    // Clocking bits on rising edge
+    ctx->sio.preamble |= GBP_SOUT ? 1 : 0;
+
+    // Sync Not Found? Keep scanning
+    if ((ctx->sio.preamble & 0xFFFF) != GBP_SYNC_WORD)
+    {
+      ctx->sio.preamble <<= 1;
+      return false;
+    }
+
+    // Preamble Found... Currently at rising edge
+    // Start reading the packet header
+    ctx->pktIO.packetState = GBP_PKT10_PARSE_HEADER_COMMAND_AND_COMPRESSION;
+    ctx->sio.preamble      = 0;
+    ctx->sio.syncronised   = true;
+    gpb_sio_next(ctx, GBP_SIO_MODE_16BITS_BIG_ENDIAN, 0);
+    return false;
+  }
+
+  /* Psudo SPI Engine */
+  // Basically I have one bit acting as a mask moving across a word sized buffer
+  if (ctx->sio.bitMaskMap > 0)
+  {
+    // Serial Transaction Is Active
+#ifdef GBP_FEATURE_USING_RISING_CLOCK_ONLY_ISR
+    // Rising Edge Clock (Rx Bit)
+    ctx->sio.rx_buff |= GBP_SOUT ? (ctx->sio.bitMaskMap & 0xFFFF) : 0;  ///< Clocking bits on rising edge
+    ctx->sio.bitMaskMap >>= 1;                                         ///< One tx/rx bit cycle complete, next bit now
+    // Falling Edge Clock (Tx Bit) (Prep now for next rising edge)
+    ctx->sio.SINOutputPinState = (ctx->sio.bitMaskMap & ctx->sio.tx_buff) > 0;
+    if (ctx->sio.bitMaskMap > 0)
+      return ctx->sio.SINOutputPinState;
+#else
+    if (GBP_SCLK)
+    {
+      // Rising Edge Clock (Rx Bit)
+      ctx->sio.rx_buff |= GBP_SOUT ? (ctx->sio.bitMaskMap & 0xFFFF) : 0;  ///< Clocking bits on rising edge
+      ctx->sio.bitMaskMap >>= 1;                                         ///< One tx/rx bit cycle complete, next bit now
+
+      if (ctx->sio.bitMaskMap > 0)
+        return ctx->sio.SINOutputPinState;
+    }
+    else
+    {
+      // Falling Edge Clock (Tx Bit)
+      ctx->sio.SINOutputPinState = (ctx->sio.bitMaskMap & ctx->sio.tx_buff) > 0;
+      return ctx->sio.SINOutputPinState;
+    }
+#endif
+  }
+
+  /****************************************************************************/
+
+  gpb_serial_io_OnWord(ctx);
 
 #ifdef GBP_FEATURE_USING_RISING_CLOCK_ONLY_ISR
   /*
@@ -721,11 +969,152 @@ bool gpb_serial_io_OnChange_ISR(const bool GBP_SCLK, const bool GBP_SOUT)
     CLK:   |_| |_| |_| |_| |_| |_| |_| |_|           |_| |_| |_| |_| |_| |_| |_| |_|
     DAT: ___XXXXXXXXXXXXXXXXXXXXXXXXXXXXXX____________XXXXXXXXXXXXXXXXXXXXXXXXXXXXXX_
   */
-  gpb_sio.SINOutputPinState = (gpb_sio.bitMaskMap & gpb_sio.tx_buff) > 0;
+  ctx->sio.SINOutputPinState = (ctx->sio.bitMaskMap & ctx->sio.tx_buff) > 0;
 #endif
 
-  return gpb_sio.SINOutputPinState;
+  return ctx->sio.SINOutputPinState;
+}
+
+
+// Byte level entry point for hardware shift registers (e.g. SPI slave peripheral)
+// rxByte : Byte clocked in from the gameboy
+// Return : Byte to shift out to the gameboy on the next transfer
+// Dev Note: Preamble scanning is byte aligned here, so the peripheral bit counter
+//           must be resynchronised (e.g. SPI re-enabled) on each timeout reset
+uint8_t gpb_serial_io_OnByte_ISR(gbp_serial_io_ctx_t *ctx, const uint8_t rxByte)
+{
+  // Scan for preamble
+  if (!ctx->sio.syncronised)
+  {
+    ctx->sio.preamble = (uint16_t)((ctx->sio.preamble << 8) | rxByte);
+
+    // Sync Not Found? Keep scanning
+    if (ctx->sio.preamble != GBP_SYNC_WORD)
+      return 0x00;
+
+    // Preamble Found... Start reading the packet header
+    ctx->pktIO.packetState = GBP_PKT10_PARSE_HEADER_COMMAND_AND_COMPRESSION;
+    ctx->sio.preamble      = 0;
+    ctx->sio.syncronised   = true;
+    gpb_sio_next(ctx, GBP_SIO_MODE_16BITS_BIG_ENDIAN, 0);
+    return (uint8_t)((ctx->sio.tx_buff >> 8) & 0xFF);
+  }
+
+  // Upper byte of a 16bit word
+  if (ctx->sio.bitMaskMap > 0xFF)
+  {
+    ctx->sio.rx_buff |= (uint16_t)rxByte << 8;
+    ctx->sio.bitMaskMap >>= 8;
+    return (uint8_t)((ctx->sio.tx_buff >> 0) & 0xFF);
+  }
+
+  // Last byte of word
+  ctx->sio.rx_buff |= rxByte;
+  ctx->sio.bitMaskMap = 0;
+  gpb_serial_io_OnWord(ctx);
+
+  // First byte of next word
+  if (!ctx->sio.syncronised || (ctx->sio.bitMaskMap == 0))
+    return 0x00;
+  return (ctx->sio.bitMaskMap > 0xFF) ? (uint8_t)((ctx->sio.tx_buff >> 8) & 0xFF) : (uint8_t)((ctx->sio.tx_buff >> 0) & 0xFF);
 }
 
 
 /******************************************************************************/
+// Single printer port wrappers
+
+bool gpb_serial_io_init(size_t buffSize, uint8_t *buffPtr)
+{
+  return gpb_serial_io_init(&gbp_serial_io_default, buffSize, buffPtr);
+}
+
+bool gpb_serial_io_reset(void)
+{
+  return gpb_serial_io_reset(&gbp_serial_io_default);
+}
+
+#ifdef GBP_FEATURE_USING_RISING_CLOCK_ONLY_ISR
+bool gpb_serial_io_OnRising_ISR(const bool GBP_SOUT)
+{
+  return gpb_serial_io_OnRising_ISR(&gbp_serial_io_default, GBP_SOUT);
+}
+#else
+bool gpb_serial_io_OnChange_ISR(const bool GBP_SCLK, const bool GBP_SOUT)
+{
+  return gpb_serial_io_OnChange_ISR(&gbp_serial_io_default, GBP_SCLK, GBP_SOUT);
+}
+#endif
+
+uint8_t gpb_serial_io_OnByte_ISR(const uint8_t rxByte)
+{
+  return gpb_serial_io_OnByte_ISR(&gbp_serial_io_default, rxByte);
+}
+
+bool gbp_serial_io_timeout_handler(uint32_t elapsed_ms)
+{
+  return gbp_serial_io_timeout_handler(&gbp_serial_io_default, elapsed_ms);
+}
+
+#ifdef GBP_FEATURE_STATUS_PRECOMPUTE
+bool gbp_serial_io_status_service(void)
+{
+  return gbp_serial_io_status_service(&gbp_serial_io_default);
+}
+#endif
+
+bool gbp_serial_io_flow_config(uint16_t lowWatermark, uint16_t highWatermark)
+{
+  return gbp_serial_io_flow_config(&gbp_serial_io_default, lowWatermark, highWatermark);
+}
+
+bool gbp_serial_io_flow_service(uint32_t elapsed_ms)
+{
+  return gbp_serial_io_flow_service(&gbp_serial_io_default, elapsed_ms);
+}
+
+size_t gbp_serial_io_dataBuff_getByteCount(void)
+{
+  return gbp_serial_io_dataBuff_getByteCount(&gbp_serial_io_default);
+}
+
+uint8_t gbp_serial_io_dataBuff_getByte(void)
+{
+  return gbp_serial_io_dataBuff_getByte(&gbp_serial_io_default);
+}
+
+uint8_t gbp_serial_io_dataBuff_getByte_Peek(uint32_t offset)
+{
+  return gbp_serial_io_dataBuff_getByte_Peek(&gbp_serial_io_default, offset);
+}
+
+size_t gbp_serial_io_dataBuff_getSpan(const uint8_t **span)
+{
+  return gbp_serial_io_dataBuff_getSpan(&gbp_serial_io_default, span);
+}
+
+bool gbp_serial_io_dataBuff_consume(size_t byteCount)
+{
+  return gbp_serial_io_dataBuff_consume(&gbp_serial_io_default, byteCount);
+}
+
+uint16_t gbp_serial_io_dataBuff_waterline(bool resetWaterline)
+{
+  return gbp_serial_io_dataBuff_waterline(&gbp_serial_io_default, resetWaterline);
+}
+
+uint16_t gbp_serial_io_dataBuff_max(void)
+{
+  return gbp_serial_io_dataBuff_max(&gbp_serial_io_default);
+}
+
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+void gbp_serial_io_stats_reset(void)
+{
+  gbp_serial_io_stats_reset(&gbp_serial_io_default);
+}
+
+size_t gbp_serial_io_stats_pack(uint8_t out[GBP_SERIAL_IO_STATS_PACKED_SIZE])
+{
+  return gbp_serial_io_stats_pack(&gbp_serial_io_default, out);
+}
+#endif
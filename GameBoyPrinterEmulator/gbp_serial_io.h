@@ -28,9 +28,236 @@
 #include <stdbool.h>  // bool
 
 #define GBP_FEATURE_USING_RISING_CLOCK_ONLY_ISR  // Away from technical accuracy towards double speed mode compatibility
+//#define GBP_SERIAL_IO_BUFFER_SIZE_POW2 512     // Compile time power of two buffer size (ISR ring index wrap becomes a mask). gpb_serial_io_init() must be given exactly this size
+
+// Feature
+//#define FEATURE_CHECKSUM_SUPPORTED ///< Packets only reach the buffer once their checksum passes, otherwise the game is asked to resend. Buffer must fit a whole packet (raw packet mode)
+#define GBP_FEATURE_STATUS_PRECOMPUTE  ///< Status response for the next packet is prepared by gbp_serial_io_status_service() in the main loop
+//#define GBP_FEATURE_SERIAL_IO_STATS  ///< Hot path counters for diagnosing failed prints (See gbp_serial_io_stats_t). Compiled out when not defined
+
+// Adaptive flow control (Enabled at runtime by gbp_serial_io_flow_config())
+#define GBP_FLOW_BUSY_PACKET_COUNT_MIN 2    ///< Fewest busy inquiry replies after a print, even if the host keeps up
+#define GBP_FLOW_RATE_WINDOW_MS        100  ///< Host drain rate is measured over this period
+#define GBP_FLOW_DRAIN_HORIZON_MS      100  ///< Stop holding busy once the host is expected to empty the buffer within this time
+
+#ifdef GBP_SERIAL_IO_BUFFER_SIZE_POW2
+#define GBP_CBUFF_FIXED_CAPACITY GBP_SERIAL_IO_BUFFER_SIZE_POW2
+#endif
+#include "gbp_cbuff.h"
 
 /******************************************************************************/
 
+typedef enum
+{
+  GBP_SIO_MODE_RESET,
+  GBP_SIO_MODE_8BITS,
+  GBP_SIO_MODE_16BITS_BIG_ENDIAN,
+  GBP_SIO_MODE_16BITS_LITTLE_ENDIAN,
+} gpb_sio_mode_t;
+
+typedef enum gbp_pktIO_parse_state_t
+{
+  // Indicates the stage of the parsing processing (syncword is not parsed)
+  // [PREAMBLE][HEADER][DATA][CHECKSUM][DUMMY]
+  // [GBP_SYNC_WORD][GBP_COMMAND][DATA][CRC][GBP_STATUS]
+  GBP_PKT10_PARSE_HEADER_COMMAND_AND_COMPRESSION,
+  GBP_PKT10_PARSE_HEADER_DATA_LENGTH,
+  GBP_PKT10_PARSE_DATA_PAYLOAD,
+  GBP_PKT10_PARSE_CHECKSUM,
+  GBP_PKT10_PARSE_DUMMY
+} gbp_pktIO_parse_state_t;
+
+// Printer status sequencing state. Advanced once per packet by gbp_serial_io_status_step()
+typedef struct
+{
+  uint16_t statusBuffer;  ///< This is send on every packet in the dummy data region
+  // Status Packet Sequencing (For faking the printer for more advance games)
+  uint8_t busyPacketCountdown;
+  uint8_t untransPacketCountdown;
+  uint8_t dataPacketCountdown;
+  // Adaptive flow control
+  bool flowAdaptive;  ///< Busy period follows the host instead of a fixed packet count
+  bool flowHold;      ///< Host is behind, so keep reporting busy
+} gbp_serial_io_status_t;
+
+// Packet kinds that the status sequencing reacts differently to
+typedef enum
+{
+  GBP_STATUS_KIND_INIT,
+  GBP_STATUS_KIND_PRINT,
+  GBP_STATUS_KIND_DATA,
+  GBP_STATUS_KIND_DATA_END,
+  GBP_STATUS_KIND_BREAK,
+  GBP_STATUS_KIND_INQUIRY,
+  GBP_STATUS_KIND_OTHER,
+  GBP_STATUS_KIND_COUNT
+} gbp_serial_io_status_kind_t;
+
+#ifdef GBP_FEATURE_STATUS_PRECOMPUTE
+// Precomputed status response for every packet kind (One half of a double buffer)
+typedef struct
+{
+  uint16_t seq;                                         ///< statusSeq this slot was computed from
+  bool flowHold;                                        ///< flow.hold this slot was computed from
+  uint16_t txStatus[GBP_STATUS_KIND_COUNT];             ///< Status word to send back
+  gbp_serial_io_status_t next[GBP_STATUS_KIND_COUNT];  ///< Status state after the packet
+} gbp_serial_io_status_slot_t;
+#endif
+
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+// Diagnostics counters (Written by ISR, except hostOut which is written by main loop)
+typedef struct
+{
+  uint32_t bytesEnqueued;                     ///< Bytes captured into the ring buffer
+  uint32_t enqueueFailures;                   ///< Bytes lost as the ring buffer was full
+  uint16_t preambleResyncs;                   ///< Link timed out mid packet, so the preamble had to be found again
+  uint16_t checksumFailures;                  ///< Packets with a checksum mismatch
+  uint16_t packets[GBP_STATUS_KIND_COUNT];    ///< Completed packets by gbp_serial_io_status_kind_t
+  uint32_t isrMax;                            ///< Longest ISR call (Unit is up to the caller of gbp_serial_io_stats_isr())
+  uint32_t hostOutUs;                         ///< Time spent sending packets to the host
+  uint32_t hostOutMaxUs;                      ///< Longest single send
+} gbp_serial_io_stats_t;
+
+// Packed little endian for tooling: [VERSION][bytesEnqueued:4][enqueueFailures:4][preambleResyncs:2][checksumFailures:2][packets:2*7][isrMax:4][hostOutUs:4][hostOutMaxUs:4]
+#define GBP_SERIAL_IO_STATS_VERSION     1
+#define GBP_SERIAL_IO_STATS_PACKED_SIZE (1 + 4 + 4 + 2 + 2 + (2 * GBP_STATUS_KIND_COUNT) + 4 + 4 + 4)
+#endif
+
+// One emulated printer port. Each port has its own bit engine, packet state and ring buffer
+// so several Game Boys can be served at once (e.g. one ctx per clock pin interrupt)
+typedef struct
+{
+  // SIO Serial Input Output Psudo SPI
+  struct
+  {
+    bool SINOutputPinState;  /// GPIO state of output
+    // Preamble Sync
+    bool syncronised;   ///< True When Preamble Found
+    uint16_t preamble;  ///< Scanning for Preamble
+    // Byte Tx/Rx
+    uint16_t bitMaskMap;  // gpb_sio_bitmaskmaps_t
+    gpb_sio_mode_t mode;
+    uint16_t rx_buff;
+    uint16_t tx_buff;
+  } sio;
+
+  struct
+  {
+    // Initialized Command
+    bool initReceived;
+    uint32_t timeout_ms;
+
+    // Circular Buffer : To store raw packet stream for packet processor
+    gpb_cbuff_t dataBuffer;
+
+    // What packets was received for internal processing
+    bool printInstructionReceived;  ///< Print Instruction Command
+    bool dataPacketReceived;        ///< Data Packet Command
+    bool dataEndPacketReceived;     ///< Data End Packet Command (Data size of 0)
+    bool breakPacketReceived;       ///< Break Packet Command
+    bool nulPacketReceived;         ///< Inquiry Packet Command
+
+    // Packet Parsing
+    gbp_pktIO_parse_state_t packetState;
+    uint8_t command;
+    uint8_t compression;
+    uint16_t data_length;
+    uint16_t data_i;
+    uint16_t checksum;      ///< For data integrity check
+    uint16_t checksumCalc;  ///< For data integrity check
+#ifdef FEATURE_CHECKSUM_SUPPORTED
+    bool captureOverflow;         ///< Packet did not fit in the buffer, so it has to be resent too
+    uint16_t checksumErrorCount;  ///< Packets thrown away and resent
+#endif
+
+    // Status Packet Sequencing (For faking the printer for more advance games)
+    gbp_serial_io_status_t status;
+    volatile uint16_t statusSeq;  ///< Incremented on every change to status
+#ifdef GBP_FEATURE_STATUS_PRECOMPUTE
+    gbp_serial_io_status_slot_t statusSlot[2];  ///< Written by main loop, read by ISR
+    volatile uint8_t statusSlotActive;          ///< Slot the ISR reads from
+    uint16_t statusSlotMiss;                    ///< Packets where the slot was stale so status was computed in ISR
+#endif
+
+    // Adaptive flow control (Main loop only, except hold which is read by ISR)
+    struct
+    {
+      uint16_t lowWatermark;   ///< Release busy at or below this many buffered bytes
+      uint16_t highWatermark;  ///< Hold busy at or above this many buffered bytes (0 = disabled)
+      volatile bool hold;
+      uint32_t drainedBytes;  ///< Consumed in current rate window
+      uint16_t windowMs;
+      uint32_t drainRate;  ///< Bytes per second (smoothed)
+      uint16_t holdCount;  ///< Times the host fell behind
+    } flow;
+
+    // Dev
+    uint16_t dataBufferWaterline;
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+    gbp_serial_io_stats_t stats;
+#endif
+  } pktIO;
+} gbp_serial_io_ctx_t;
+
+/******************************************************************************/
+
+/* Init/Reset/ISR Functions */
+bool gpb_serial_io_init(gbp_serial_io_ctx_t *ctx, size_t buffSize, uint8_t *buffPtr);
+bool gpb_serial_io_reset(gbp_serial_io_ctx_t *ctx);
+#ifdef GBP_FEATURE_USING_RISING_CLOCK_ONLY_ISR
+bool gpb_serial_io_OnRising_ISR(gbp_serial_io_ctx_t *ctx, const bool GBP_SOUT);
+#else
+bool gpb_serial_io_OnChange_ISR(gbp_serial_io_ctx_t *ctx, const bool GBP_SCLK, const bool GBP_SOUT);
+#endif
+uint8_t gpb_serial_io_OnByte_ISR(gbp_serial_io_ctx_t *ctx, const uint8_t rxByte);  ///< Hardware shift register backend (One call per byte)
+
+/* Timeout */
+bool gbp_serial_io_timeout_handler(gbp_serial_io_ctx_t *ctx, uint32_t elapsed_ms);
+
+/* Status Sequencing */
+uint16_t gbp_serial_io_status_step(gbp_serial_io_status_t *status, const uint8_t command, const uint16_t data_length);
+#ifdef GBP_FEATURE_STATUS_PRECOMPUTE
+bool gbp_serial_io_status_service(gbp_serial_io_ctx_t *ctx);
+#endif
+
+/* Adaptive Flow Control */
+bool gbp_serial_io_flow_config(gbp_serial_io_ctx_t *ctx, uint16_t lowWatermark, uint16_t highWatermark);
+bool gbp_serial_io_flow_service(gbp_serial_io_ctx_t *ctx, uint32_t elapsed_ms);
+
+/* Output */
+size_t gbp_serial_io_dataBuff_getByteCount(gbp_serial_io_ctx_t *ctx);
+uint8_t gbp_serial_io_dataBuff_getByte(gbp_serial_io_ctx_t *ctx);
+uint8_t gbp_serial_io_dataBuff_getByte_Peek(gbp_serial_io_ctx_t *ctx, uint32_t offset);
+size_t gbp_serial_io_dataBuff_getSpan(gbp_serial_io_ctx_t *ctx, const uint8_t **span);
+bool gbp_serial_io_dataBuff_consume(gbp_serial_io_ctx_t *ctx, size_t byteCount);
+uint16_t gbp_serial_io_dataBuff_waterline(gbp_serial_io_ctx_t *ctx, bool resetWaterline);
+uint16_t gbp_serial_io_dataBuff_max(gbp_serial_io_ctx_t *ctx);
+
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+/* Diagnostics */
+void gbp_serial_io_stats_reset(gbp_serial_io_ctx_t *ctx);
+size_t gbp_serial_io_stats_pack(gbp_serial_io_ctx_t *ctx, uint8_t out[GBP_SERIAL_IO_STATS_PACKED_SIZE]);
+
+// Call from the clock ISR with how long it took
+static inline void gbp_serial_io_stats_isr(gbp_serial_io_ctx_t *ctx, uint32_t duration)
+{
+  if (duration > ctx->pktIO.stats.isrMax)
+    ctx->pktIO.stats.isrMax = duration;
+}
+
+// Call from main loop with how long sending captured data to the host took
+static inline void gbp_serial_io_stats_hostOut(gbp_serial_io_ctx_t *ctx, uint32_t duration_us)
+{
+  ctx->pktIO.stats.hostOutUs += duration_us;
+  if (duration_us > ctx->pktIO.stats.hostOutMaxUs)
+    ctx->pktIO.stats.hostOutMaxUs = duration_us;
+}
+#endif
+
+/******************************************************************************/
+// Single printer port wrappers (operate on gbp_serial_io_default)
+extern gbp_serial_io_ctx_t gbp_serial_io_default;
+
 /* Init/Reset/ISR Functions */
 bool gpb_serial_io_init(size_t buffSize, uint8_t *buffPtr);
 bool gpb_serial_io_reset(void);
@@ -39,16 +266,34 @@ bool gpb_serial_io_OnRising_ISR(const bool GBP_SOUT);
 #else
 bool gpb_serial_io_OnChange_ISR(const bool GBP_SCLK, const bool GBP_SOUT);
 #endif
+uint8_t gpb_serial_io_OnByte_ISR(const uint8_t rxByte);
 
 /* Timeout */
 bool gbp_serial_io_timeout_handler(uint32_t elapsed_ms);
 
+/* Status Sequencing */
+#ifdef GBP_FEATURE_STATUS_PRECOMPUTE
+bool gbp_serial_io_status_service(void);
+#endif
+
+/* Adaptive Flow Control */
+bool gbp_serial_io_flow_config(uint16_t lowWatermark, uint16_t highWatermark);
+bool gbp_serial_io_flow_service(uint32_t elapsed_ms);
+
 /* Output */
 size_t gbp_serial_io_dataBuff_getByteCount(void);
 uint8_t gbp_serial_io_dataBuff_getByte(void);
 uint8_t gbp_serial_io_dataBuff_getByte_Peek(uint32_t offset);
+size_t gbp_serial_io_dataBuff_getSpan(const uint8_t **span);
+bool gbp_serial_io_dataBuff_consume(size_t byteCount);
 uint16_t gbp_serial_io_dataBuff_waterline(bool resetWaterline);
 uint16_t gbp_serial_io_dataBuff_max(void);
 
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+/* Diagnostics */
+void gbp_serial_io_stats_reset(void);
+size_t gbp_serial_io_stats_pack(uint8_t out[GBP_SERIAL_IO_STATS_PACKED_SIZE]);
+#endif
+
 /******************************************************************************/
 #endif
@@ -0,0 +1,302 @@
+/*************************************************************************
+ *
+ * Gameboy Printer Spool
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ * Copyright (C) 2022 Brian Khuu
+ *
+ * PURPOSE: This module focus on storing captured raw packets on SD/flash so
+ *          capture can keep going while the host is slow or disconnected
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>  // uint8_t
+#include <stddef.h>  // size_t
+#include <string.h>  // memcpy(), memmove()
+
+#include "gbp_spool.h"
+
+// Records are whole raw packets, split with gbp_frame_pkt_t (See gbp_frame.h)
+
+/******************************************************************************/
+
+static void gbp_spool_pageReset(gbp_spool_t *spool)
+{
+  spool->page[0] = GBP_SPOOL_NO_PACKET_START & 0xFF;
+  spool->page[1] = (GBP_SPOOL_NO_PACKET_START >> 8) & 0xFF;
+  spool->pageFill = GBP_SPOOL_BLOCK_HEADER_SIZE;
+}
+
+static void gbp_spool_readerDropBlock(gbp_spool_t *spool)
+{
+  // Reader lost its block, so restart at next whole packet
+  spool->readBlock++;
+  spool->readPos = GBP_SPOOL_BLOCK_HEADER_SIZE;
+  spool->readFill = 0;
+  spool->chunkSize = 0;
+  spool->resync = true;
+  spool->blocksDropped++;
+}
+
+static void gbp_spool_pageCompact(gbp_spool_t *spool)
+{
+  // Ram block only: drop what the reader already has and keep the rest, so nothing unread is lost
+  const uint16_t readBytes = spool->readPos - GBP_SPOOL_BLOCK_HEADER_SIZE;
+  const uint16_t first = spool->page[0] | ((uint16_t)spool->page[1] << 8);
+  if (readBytes == 0)
+  {
+    return;
+  }
+  memmove(&spool->page[GBP_SPOOL_BLOCK_HEADER_SIZE], &spool->page[spool->readPos], spool->pageFill - spool->readPos);
+  spool->pageFill -= readBytes;
+  spool->readPos = GBP_SPOOL_BLOCK_HEADER_SIZE;
+  if ((first == GBP_SPOOL_NO_PACKET_START) || (first < (GBP_SPOOL_BLOCK_HEADER_SIZE + readBytes)))
+  {
+    // Packet start was in the part already read
+    spool->page[0] = GBP_SPOOL_NO_PACKET_START & 0xFF;
+    spool->page[1] = (GBP_SPOOL_NO_PACKET_START >> 8) & 0xFF;
+  }
+  else
+  {
+    spool->page[0] = (first - readBytes) & 0xFF;
+    spool->page[1] = ((first - readBytes) >> 8) & 0xFF;
+  }
+}
+
+static void gbp_spool_pageCommit(gbp_spool_t *spool)
+{
+  if (spool->blockCount == 0)
+  {
+    gbp_spool_pageCompact(spool);
+    return;
+  }
+
+  const uint32_t block = spool->writeBlock % spool->blockCount;
+
+  spool->page[2] = spool->pageFill & 0xFF;
+  spool->page[3] = (spool->pageFill >> 8) & 0xFF;
+
+  // Storage full? Then drop the oldest block so capture is never held back
+  if ((spool->writeBlock - spool->readBlock) >= spool->blockCount)
+  {
+    gbp_spool_readerDropBlock(spool);
+  }
+
+  if (!spool->write(spool->dev, block, spool->page))
+  {
+    // Nowhere to put this block
+    spool->storageErrors++;
+    if (spool->readBlock == spool->writeBlock)
+    {
+      // Reader was on the ram block which is about to be reused
+      spool->readPos = GBP_SPOOL_BLOCK_HEADER_SIZE;
+      spool->resync = true;
+      spool->blocksDropped++;
+    }
+    gbp_spool_pageReset(spool);
+    return;
+  }
+
+  if (spool->readBlock == spool->writeBlock)
+  {
+    // Reader was on the ram block, continue reading it from storage where we left off
+    spool->readFill = spool->pageFill;
+    spool->chunkSize = 0;
+  }
+
+  spool->writeBlock++;
+  gbp_spool_pageReset(spool);
+}
+
+bool gbp_spool_init(gbp_spool_t *spool, void *dev, uint32_t blockCount, gbp_spool_read_t read, gbp_spool_write_t write)
+{
+  if ((blockCount > 0) && (!read || !write))
+  {
+    return false;
+  }
+
+  memset(spool, 0, sizeof(*spool));
+  spool->dev = dev;
+  spool->read = read;
+  spool->write = write;
+  spool->blockCount = blockCount;
+  spool->readPos = GBP_SPOOL_BLOCK_HEADER_SIZE;
+  gbp_spool_pageReset(spool);
+  return true;
+}
+
+void gbp_spool_packetReset(gbp_spool_t *spool)
+{
+  // Next byte written is the start of a packet (e.g. link timed out mid packet)
+  gbp_frame_pkt_reset(&spool->pkt);
+}
+
+/*******************************************************************************
+ * Writer
+*******************************************************************************/
+
+size_t gbp_spool_write(gbp_spool_t *spool, const uint8_t *data, size_t size)
+{
+  size_t written = 0;
+  while (size > 0)
+  {
+    if (spool->pageFill >= GBP_SPOOL_BLOCK_SIZE)
+    {
+      gbp_spool_pageCommit(spool);
+      if (spool->pageFill >= GBP_SPOOL_BLOCK_SIZE)
+      {
+        // Ram block only and the reader has not taken any of it yet
+        break;
+      }
+    }
+
+    // Record packet start for resync
+    if ((spool->pkt.byteIndex == 0) && (spool->page[0] == (GBP_SPOOL_NO_PACKET_START & 0xFF)) && (spool->page[1] == ((GBP_SPOOL_NO_PACKET_START >> 8) & 0xFF)))
+    {
+      spool->page[0] = spool->pageFill & 0xFF;
+      spool->page[1] = (spool->pageFill >> 8) & 0xFF;
+    }
+
+    // Copy up to end of packet or page (Byte by byte until the data length is known)
+    size_t n = gbp_frame_pkt_span(&spool->pkt);
+    if (n > size)
+    {
+      n = size;
+    }
+    if (n > (size_t)(GBP_SPOOL_BLOCK_SIZE - spool->pageFill))
+    {
+      n = GBP_SPOOL_BLOCK_SIZE - spool->pageFill;
+    }
+
+    memcpy(&spool->page[spool->pageFill], data, n);
+    gbp_frame_pkt_advance(&spool->pkt, data, n);
+
+    spool->pageFill += n;
+    data += n;
+    size -= n;
+    written += n;
+  }
+  return written;
+}
+
+/*******************************************************************************
+ * Reader
+*******************************************************************************/
+
+size_t gbp_spool_getSpan(gbp_spool_t *spool, const uint8_t **span)
+{
+  while (1)
+  {
+    if (spool->readBlock == spool->writeBlock)
+    {
+      // Caught up, so read straight out of the ram block
+      if (spool->resync)
+      {
+        const uint16_t first = spool->page[0] | ((uint16_t)spool->page[1] << 8);
+        if (first == GBP_SPOOL_NO_PACKET_START)
+        {
+          return 0;
+        }
+        spool->readPos = first;
+        spool->resync = false;
+      }
+      *span = &spool->page[spool->readPos];
+      return (spool->pageFill > spool->readPos) ? (spool->pageFill - spool->readPos) : 0;
+    }
+
+    const uint32_t addr = (spool->readBlock % spool->blockCount) * GBP_SPOOL_BLOCK_SIZE;
+
+    if (spool->readFill == 0)
+    {
+      uint8_t header[GBP_SPOOL_BLOCK_HEADER_SIZE];
+      if (!spool->read(spool->dev, addr, header, sizeof(header)))
+      {
+        spool->storageErrors++;
+        return 0;
+      }
+      const uint16_t first = header[0] | ((uint16_t)header[1] << 8);
+      spool->readFill = header[2] | ((uint16_t)header[3] << 8);
+      spool->readPos = GBP_SPOOL_BLOCK_HEADER_SIZE;
+      if (spool->readFill > GBP_SPOOL_BLOCK_SIZE)
+      {
+        spool->readFill = GBP_SPOOL_BLOCK_SIZE;
+      }
+      if (spool->resync)
+      {
+        if (first == GBP_SPOOL_NO_PACKET_START)
+        {
+          // No packet starts in here, try next block
+          spool->readPos = spool->readFill;
+        }
+        else
+        {
+          spool->readPos = first;
+          spool->resync = false;
+        }
+      }
+    }
+
+    if (spool->readPos >= spool->readFill)
+    {
+      // Block fully read
+      spool->readBlock++;
+      spool->readPos = GBP_SPOOL_BLOCK_HEADER_SIZE;
+      spool->readFill = 0;
+      spool->chunkSize = 0;
+      continue;
+    }
+
+    if (spool->chunkPos >= spool->chunkSize)
+    {
+      uint16_t n = spool->readFill - spool->readPos;
+      if (n > GBP_SPOOL_READ_CHUNK_SIZE)
+      {
+        n = GBP_SPOOL_READ_CHUNK_SIZE;
+      }
+      if (!spool->read(spool->dev, addr + spool->readPos, spool->chunk, n))
+      {
+        spool->storageErrors++;
+        return 0;
+      }
+      spool->chunkPos = 0;
+      spool->chunkSize = n;
+    }
+
+    *span = &spool->chunk[spool->chunkPos];
+    return spool->chunkSize - spool->chunkPos;
+  }
+}
+
+bool gbp_spool_consume(gbp_spool_t *spool, size_t byteCount)
+{
+  // byteCount must not be more than the last span
+  spool->readPos += byteCount;
+  if (spool->readBlock != spool->writeBlock)
+  {
+    spool->chunkPos += byteCount;
+  }
+  return true;
+}
+
+bool gbp_spool_isEmpty(gbp_spool_t *spool)
+{
+  return (spool->readBlock == spool->writeBlock) && (spool->resync || (spool->readPos >= spool->pageFill));
+}
+
+uint32_t gbp_spool_blocksUsed(gbp_spool_t *spool)
+{
+  return spool->writeBlock - spool->readBlock;
+}
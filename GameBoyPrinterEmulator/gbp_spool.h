@@ -0,0 +1,97 @@
+/*************************************************************************
+ *
+ * Gameboy Printer Spool
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ * Copyright (C) 2022 Brian Khuu
+ *
+ * PURPOSE: This module focus on storing captured raw packets on SD/flash so
+ *          capture can keep going while the host is slow or disconnected
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef GBP_SPOOL_H
+#define GBP_SPOOL_H
+/******************************************************************************/
+// # Spool Format
+// The raw packet stream is stored as a ring of page sized blocks. Each block
+// records where the first packet starting in it is, so that the reader can
+// skip to a whole packet if the oldest blocks had to be dropped (storage full).
+//
+//   [FIRST0][FIRST1][FILL0][FILL1][RAW PACKET STREAM...]
+//
+// * FIRST : Offset of first packet start in block (GBP_SPOOL_NO_PACKET_START if none)
+// * FILL  : Bytes used in block (including this header)
+#include <stdint.h>   // uint8_t
+#include <stddef.h>   // size_t
+#include <stdbool.h>  // bool
+
+#include "src/gbp_core/gbp_frame.h"  // gbp_frame_pkt_t
+
+#define GBP_SPOOL_BLOCK_SIZE        512
+#define GBP_SPOOL_BLOCK_HEADER_SIZE 4
+#define GBP_SPOOL_NO_PACKET_START   0xFFFF
+
+#ifndef GBP_SPOOL_READ_CHUNK_SIZE
+#define GBP_SPOOL_READ_CHUNK_SIZE 64  ///< Reader does not need a whole block in ram
+#endif
+
+// Storage access. Blocks are only ever written whole, but may be read from at any byte address
+typedef bool (*gbp_spool_read_t)(void *dev, uint32_t addr, uint8_t *data, size_t size);
+typedef bool (*gbp_spool_write_t)(void *dev, uint32_t block, const uint8_t data[GBP_SPOOL_BLOCK_SIZE]);
+
+typedef struct
+{
+  // Storage
+  void *dev;
+  gbp_spool_read_t read;
+  gbp_spool_write_t write;
+  uint32_t blockCount;  ///< Storage size in blocks (0 = ram block only)
+
+  // Block being filled (Not in storage yet)
+  uint8_t page[GBP_SPOOL_BLOCK_SIZE];
+  uint16_t pageFill;
+  uint32_t writeBlock;  ///< Blocks committed since init
+
+  // Reader
+  uint32_t readBlock;  ///< Block being read (readBlock == writeBlock means the ram block)
+  uint16_t readPos;    ///< Byte position in block
+  uint16_t readFill;   ///< Fill of block being read from storage (0 = header not read yet)
+  bool resync;         ///< Skip to next packet start (after blocks were dropped)
+  uint8_t chunk[GBP_SPOOL_READ_CHUNK_SIZE];
+  uint16_t chunkPos;
+  uint16_t chunkSize;
+
+  // Packet boundary tracking of raw packet stream being written
+  gbp_frame_pkt_t pkt;
+
+  // Dev
+  uint32_t blocksDropped;  ///< Oldest blocks overwritten before they were read
+  uint32_t storageErrors;
+} gbp_spool_t;
+
+bool gbp_spool_init(gbp_spool_t *spool, void *dev, uint32_t blockCount, gbp_spool_read_t read, gbp_spool_write_t write);
+void gbp_spool_packetReset(gbp_spool_t *spool);
+
+/* Writer (Never blocks on the reader, drops oldest blocks instead. Ram block only: returns less than size once full) */
+size_t gbp_spool_write(gbp_spool_t *spool, const uint8_t *data, size_t size);
+
+/* Reader */
+size_t gbp_spool_getSpan(gbp_spool_t *spool, const uint8_t **span);
+bool gbp_spool_consume(gbp_spool_t *spool, size_t byteCount);
+bool gbp_spool_isEmpty(gbp_spool_t *spool);
+uint32_t gbp_spool_blocksUsed(gbp_spool_t *spool);
+
+#endif  // GBP_SPOOL_H
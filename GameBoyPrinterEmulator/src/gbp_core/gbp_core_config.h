@@ -0,0 +1,54 @@
+/*************************************************************************
+ *
+ * Gameboy Printer Core Configuration
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ * Copyright (C) 2020 Brian Khuu
+ *
+ * PURPOSE: Compile time switches of the shared decoder core (gbp_pkt, gbp_tiles) for embedded and host builds
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GBP_CORE_CONFIG_H
+#define GBP_CORE_CONFIG_H
+
+/*
+  The core in src/gbp_core is compiled by the Arduino sketch (everything under src/ is built with it)
+  and as libgbpcore.a by the host Makefiles (GameBoyPrinterEmulator tests, GameBoyPrinterDecoderC).
+  Every switch can be overridden with -D, e.g. `-DGBP_CORE_EMBEDDED=1` to test the embedded build on a host.
+*/
+
+// Embedded build (Small RAM, no host libraries). Defaults to on for Arduino builds
+#ifndef GBP_CORE_EMBEDDED
+#ifdef ARDUINO
+#define GBP_CORE_EMBEDDED 1
+#else
+#define GBP_CORE_EMBEDDED 0
+#endif
+#endif
+
+// Tile bitplane decoding with a 512 byte lookup table, else with a bit loop
+// Off on embedded, as const tables are copied into RAM on AVR (2KiB on an Uno)
+#ifndef GBP_CORE_TILE_LUT
+#define GBP_CORE_TILE_LUT (!GBP_CORE_EMBEDDED)
+#endif
+
+// gbp_pkt_processBuffer_full(), which takes whole payloads into a 640 byte buffer instead of streaming them
+#ifndef GBP_CORE_FULL_PAYLOAD
+#define GBP_CORE_FULL_PAYLOAD (!GBP_CORE_EMBEDDED)
+#endif
+
+#endif  // GBP_CORE_CONFIG_H
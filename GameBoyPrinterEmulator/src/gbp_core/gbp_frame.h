@@ -0,0 +1,223 @@
+/*************************************************************************
+ *
+ * GAMEBOY PRINTER EMULATION PROJECT V3 (Arduino)
+ * Copyright (C) 2020 Brian Khuu
+ *
+ * PURPOSE: SLIP framing for binary raw packet output
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef GBP_FRAME_H
+#define GBP_FRAME_H
+/******************************************************************************/
+// # Binary Frame Format
+// Each raw packet is wrapped as a SLIP (RFC 1055) frame so that it can be
+// sent as plain bytes instead of hex text (one byte on the wire per byte
+// instead of three). Text comments (e.g. `// Completed`) may still appear
+// between frames, these are rejected by the frame header check.
+//
+//   [END][TYPE][SEQ][88][33][COMM][COMP][LEN0][LEN1][DATA...][CSUM0][CSUM1][ID][STATUS][END]
+//
+// * TYPE : Frame type (GBP_FRAME_TYPE_RAW_PACKET)
+// * SEQ  : Packet counter (lower 8 bits), for detecting dropped frames
+//
+// Parse mode with GBP_OUTPUT_RASTER_ROWS instead sends the decoded image one
+// 8 pixel high row at a time, followed by the print instruction once printed.
+//
+//   [END][TYPE][SEQ][ROW][8 scanlines of 40 bytes][END]
+//   [END][TYPE][SEQ][SHEETS][LINEFEED][PALETTE][DENSITY][END]
+//
+// * ROW       : Row index since the last print instruction (lower 8 bits)
+// * Scanlines : 2bits per pixel, 4 pixels per byte with the leftmost pixel in
+//               the lowest bits (same as gbp_tile_t). Tones are not yet palette mapped
+//
+// The emulator diagnostics console can also dump its counters as a frame
+// (Layout is in gbp_serial_io.h, see gbp_serial_io_stats_pack())
+//
+//   [END][TYPE][SEQ][VERSION][COUNTERS...][END]
+#include <stdint.h>   // uint8_t
+#include <stddef.h>   // size_t
+#include <stdbool.h>  // bool
+
+#define GBP_FRAME_SLIP_END     0xC0
+#define GBP_FRAME_SLIP_ESC     0xDB
+#define GBP_FRAME_SLIP_ESC_END 0xDC
+#define GBP_FRAME_SLIP_ESC_ESC 0xDD
+
+#define GBP_FRAME_TYPE_RAW_PACKET   0xA1
+#define GBP_FRAME_TYPE_RASTER_ROW   0xA2
+#define GBP_FRAME_TYPE_RASTER_PRINT 0xA3
+#define GBP_FRAME_TYPE_STATS        0xA4
+
+#define GBP_FRAME_HEADER_SIZE 2                                  // [TYPE][SEQ]
+#define GBP_FRAME_MAX_SIZE    (GBP_FRAME_HEADER_SIZE + 10 + 640)  // Largest raw packet (DATA packet with 640 byte payload)
+
+#define GBP_FRAME_RASTER_ROW_SIZE   (1 + 8 * 40)  // [ROW][8 scanlines of 160 2bit pixels]
+#define GBP_FRAME_RASTER_PRINT_SIZE 4             // Print instruction
+
+typedef struct
+{
+  uint8_t buffer[GBP_FRAME_MAX_SIZE];  ///< Unescaped frame content
+  size_t size;                         ///< Number of bytes in buffer
+  bool escape;                         ///< Last byte was an escape byte
+  bool overflow;                       ///< Frame is too large, discard until next END
+  bool complete;                       ///< Frame was returned to caller, clear on next byte
+} gbp_frame_rx_t;
+
+// Escape a byte into `out[]` (must have space for 2 bytes). Returns bytes written.
+static inline size_t gbp_frame_slip_escape(uint8_t *out, const uint8_t b)
+{
+  switch (b)
+  {
+    case GBP_FRAME_SLIP_END:
+      out[0] = GBP_FRAME_SLIP_ESC;
+      out[1] = GBP_FRAME_SLIP_ESC_END;
+      return 2;
+    case GBP_FRAME_SLIP_ESC:
+      out[0] = GBP_FRAME_SLIP_ESC;
+      out[1] = GBP_FRAME_SLIP_ESC_ESC;
+      return 2;
+    default:
+      out[0] = b;
+      return 1;
+  }
+}
+
+static inline void gbp_frame_rx_reset(gbp_frame_rx_t *rx)
+{
+  rx->size     = 0;
+  rx->escape   = false;
+  rx->overflow = false;
+  rx->complete = false;
+}
+
+// Returns true if a complete frame is now in rx->buffer (valid until next call)
+static inline bool gbp_frame_rx_byte(gbp_frame_rx_t *rx, const uint8_t b)
+{
+  if (rx->complete)
+    gbp_frame_rx_reset(rx);
+
+  if (b == GBP_FRAME_SLIP_END)
+  {
+    if ((rx->size == 0) || rx->overflow)
+    {
+      // Empty or discarded frame
+      gbp_frame_rx_reset(rx);
+      return false;
+    }
+    rx->complete = true;
+    return true;
+  }
+
+  uint8_t data = b;
+  if (rx->escape)
+  {
+    rx->escape = false;
+    switch (b)
+    {
+      case GBP_FRAME_SLIP_ESC_END: data = GBP_FRAME_SLIP_END; break;
+      case GBP_FRAME_SLIP_ESC_ESC: data = GBP_FRAME_SLIP_ESC; break;
+      default: rx->overflow = true; break;  ///< Protocol violation, discard frame
+    }
+  }
+  else if (b == GBP_FRAME_SLIP_ESC)
+  {
+    rx->escape = true;
+    return false;
+  }
+
+  if (rx->size >= sizeof(rx->buffer))
+  {
+    rx->overflow = true;
+    return false;
+  }
+
+  rx->buffer[rx->size++] = data;
+  return false;
+}
+
+// Check if received frame looks like a raw packet (Rejects text between frames)
+static inline bool gbp_frame_rx_isRawPacket(const gbp_frame_rx_t *rx)
+{
+  if (rx->size < (GBP_FRAME_HEADER_SIZE + 10))
+    return false;
+  if (rx->buffer[0] != GBP_FRAME_TYPE_RAW_PACKET)
+    return false;
+  return (rx->buffer[GBP_FRAME_HEADER_SIZE + 0] == 0x88) && (rx->buffer[GBP_FRAME_HEADER_SIZE + 1] == 0x33);
+}
+
+// Check if received frame is a decoded row (ROW byte at buffer[GBP_FRAME_HEADER_SIZE], scanlines after it)
+static inline bool gbp_frame_rx_isRasterRow(const gbp_frame_rx_t *rx)
+{
+  return (rx->size == (GBP_FRAME_HEADER_SIZE + GBP_FRAME_RASTER_ROW_SIZE)) && (rx->buffer[0] == GBP_FRAME_TYPE_RASTER_ROW);
+}
+
+// Check if received frame is a print instruction of a row stream (Instruction at buffer[GBP_FRAME_HEADER_SIZE])
+static inline bool gbp_frame_rx_isRasterPrint(const gbp_frame_rx_t *rx)
+{
+  return (rx->size == (GBP_FRAME_HEADER_SIZE + GBP_FRAME_RASTER_PRINT_SIZE)) && (rx->buffer[0] == GBP_FRAME_TYPE_RASTER_PRINT);
+}
+
+/******************************************************************************/
+// # Raw Packet Boundaries
+// Finds where each raw packet ends in the captured byte stream, so it can be
+// split into frames, hex lines or spool records without parsing the packet
+//
+//   [88][33][COMM][COMP][LEN0][LEN1][DATA...][CSUM0][CSUM1][ID][STATUS]
+
+#define GBP_FRAME_PKT_HEADER_SIZE    6  // Up to and including the data length
+#define GBP_FRAME_PKT_TRAILER_SIZE   4
+#define GBP_FRAME_PKT_SIZE(dataLength) (GBP_FRAME_PKT_HEADER_SIZE + (dataLength) + GBP_FRAME_PKT_TRAILER_SIZE)
+
+typedef struct
+{
+  uint16_t byteIndex;   ///< Position in the current packet (0 = next byte starts a packet)
+  uint16_t dataLength;  ///< Data length of the current packet (Once past the header)
+} gbp_frame_pkt_t;
+
+static inline void gbp_frame_pkt_reset(gbp_frame_pkt_t *pkt)
+{
+  pkt->byteIndex  = 0;
+  pkt->dataLength = 0;
+}
+
+// Most bytes that can be taken at once without going past the end of the packet (1 until the data length is known)
+static inline size_t gbp_frame_pkt_span(const gbp_frame_pkt_t *pkt)
+{
+  return (pkt->byteIndex < GBP_FRAME_PKT_HEADER_SIZE) ? 1 : (GBP_FRAME_PKT_SIZE(pkt->dataLength) - pkt->byteIndex);
+}
+
+// Next `size` bytes of the stream at `data[]` (No more than gbp_frame_pkt_span()). Returns true if they end the packet
+static inline bool gbp_frame_pkt_advance(gbp_frame_pkt_t *pkt, const uint8_t *data, const size_t size)
+{
+  // Data length is little endian at byte 4 and 5 of the packet
+  if (pkt->byteIndex == 4)
+    pkt->dataLength = data[0];
+  else if (pkt->byteIndex == 5)
+    pkt->dataLength |= ((uint16_t)data[0] << 8) & 0xFF00;
+
+  pkt->byteIndex += size;
+  if ((pkt->byteIndex >= GBP_FRAME_PKT_HEADER_SIZE) && (pkt->byteIndex >= GBP_FRAME_PKT_SIZE(pkt->dataLength)))
+  {
+    gbp_frame_pkt_reset(pkt);
+    return true;
+  }
+  return false;
+}
+
+#endif  // GBP_FRAME_H
@@ -24,9 +24,9 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>  // memcpy
 
 #include "gameboy_printer_protocol.h"
-#include "gbp_serial_io.h"
 #include "gbp_pkt.h"
 
 bool gbp_pkt_init(gbp_pkt_t *_pkt)
@@ -43,19 +43,29 @@ bool gbp_pkt_reset(gbp_pkt_t *_pkt)
   return true;
 }
 
+/*
+  Parser specialisations
+  BUFF_MAX is the payload buffer size, or 0 if it is only known at runtime (bufferMax).
+  With a constant size the buffer position and fit checks are resolved at compile time.
+  A buffer of GBP_PKT_FULL_PAYLOAD_BUFF_SIZE_IN_BYTE or more takes every valid payload, including
+  one that fills it exactly, so only malformed packets are ever streamed.
+*/
+template <size_t BUFF_MAX>
+static inline bool gbp_pkt_payloadFits(const uint16_t dataLength, const size_t bufferMax)
+{
+  return (BUFF_MAX >= GBP_PKT_FULL_PAYLOAD_BUFF_SIZE_IN_BYTE) ? (dataLength <= bufferMax) : (dataLength < bufferMax);
+}
+
+// Header and trailer byte parser (Payload bytes are handled by gbp_pkt_parse())
 // returns true if packet is received
-bool gbp_pkt_processByte(gbp_pkt_t *_pkt, const uint8_t _byte, uint8_t buffer[], uint8_t *bufferSize, const size_t bufferMax)
+template <size_t BUFF_MAX, typename size_type>
+static inline bool gbp_pkt_processHeaderByte(gbp_pkt_t *_pkt, const uint8_t _byte, size_type *bufferSize, const size_t bufferMax)
 {
   /*
     [ 00 ][ 01 ][ 02 ][ 03 ][ 04 ][ 05 ][ 5+X ][5+X+1][5+X+2][5+X+3][5+X+4]
     [SYNC][SYNC][COMM][COMP][LEN0][LEN1][DATAX][CSUM0][CSUM1][DUMMY][DUMMY]
   */
 
-  // Dev Note: Minimum required size of 4 bytes for printer instruction packet
-  //  data payload can be streamed so doesn't have to fit full size
-  if (bufferMax < 4)
-    return false;
-
   _pkt->received = GBP_REC_NONE;
 
   // Parsing fixed packet header
@@ -97,7 +107,7 @@ bool gbp_pkt_processByte(gbp_pkt_t *_pkt, const uint8_t _byte, uint8_t buffer[],
     // Data packets are streamed
     if (_pkt->pktByteIndex == 6)
     {
-      if (bufferMax > _pkt->dataLength)
+      if (gbp_pkt_payloadFits<BUFF_MAX>(_pkt->dataLength, bufferMax))
       {
         // Payload fits into buffer
         return false;
@@ -113,27 +123,9 @@ bool gbp_pkt_processByte(gbp_pkt_t *_pkt, const uint8_t _byte, uint8_t buffer[],
     return false;
   }
 
-  // Capture Bytes to buffer if needed
-  if ((6 <= _pkt->pktByteIndex) && (_pkt->pktByteIndex < (6 + _pkt->dataLength)))
-  {
-    // Byte is from payload... add to buffer
-    const uint16_t payloadIndex = _pkt->pktByteIndex - 6;
-    //const uint16_t offset       = (payloadIndex/bufferMax) * bufferMax;
-    const uint16_t bufferUsage = payloadIndex % bufferMax + 1;
-    buffer[bufferUsage - 1]    = _byte;
-    *bufferSize                = bufferUsage;
-    if (bufferUsage == _pkt->dataLength)
-    {
-      // Fits fully in buffer
-    }
-    else if (bufferUsage == bufferMax)
-    {
-      _pkt->received = GBP_REC_GOT_PAYLOAD_PARTAL;
-    }
-  }
-  else if (_pkt->pktByteIndex == (6 + _pkt->dataLength))
+  if (_pkt->pktByteIndex == (6 + _pkt->dataLength))
   {
-    *bufferSize = _pkt->dataLength % bufferMax;
+    *bufferSize = (size_type)(gbp_pkt_payloadFits<BUFF_MAX>(_pkt->dataLength, bufferMax) ? _pkt->dataLength : (_pkt->dataLength % bufferMax));
   }
 
   // Increment
@@ -147,7 +139,7 @@ bool gbp_pkt_processByte(gbp_pkt_t *_pkt, const uint8_t _byte, uint8_t buffer[],
     _pkt->status       = _byte;
     _pkt->pktByteIndex = 0;
     // Indicate received packet
-    if (bufferMax > _pkt->dataLength)
+    if (gbp_pkt_payloadFits<BUFF_MAX>(_pkt->dataLength, bufferMax))
     {
       // Payload fits into buffer
       _pkt->received = GBP_REC_GOT_PACKET;
@@ -165,6 +157,88 @@ bool gbp_pkt_processByte(gbp_pkt_t *_pkt, const uint8_t _byte, uint8_t buffer[],
   return _pkt->received != GBP_REC_NONE;
 }
 
+template <size_t BUFF_MAX, typename size_type, typename callback_type>
+static size_t gbp_pkt_parse(gbp_pkt_t *_pkt, const uint8_t data[], const size_t dataSize, uint8_t buffer[], size_type *bufferSize, const size_t runtimeBufferMax, callback_type callback, void *userData)
+{
+  const size_t bufferMax = BUFF_MAX ? BUFF_MAX : runtimeBufferMax;
+
+  size_t events = 0;
+  size_t i      = 0;
+  while (i < dataSize)
+  {
+    const uint16_t payloadEnd = 6 + _pkt->dataLength;
+    if ((6 <= _pkt->pktByteIndex) && (_pkt->pktByteIndex < payloadEnd))
+    {
+      // Bytes are from payload... copy as much as possible to buffer in one go
+      const uint16_t payloadIndex = _pkt->pktByteIndex - 6;
+      const size_t bufferPos      = payloadIndex % bufferMax;
+      size_t chunkSize            = bufferMax - bufferPos;
+      chunkSize                   = (chunkSize < (size_t)(payloadEnd - _pkt->pktByteIndex)) ? chunkSize : (size_t)(payloadEnd - _pkt->pktByteIndex);
+      chunkSize                   = (chunkSize < (dataSize - i)) ? chunkSize : (dataSize - i);
+      memcpy(&buffer[bufferPos], &data[i], chunkSize);
+      i += chunkSize;
+      _pkt->pktByteIndex += chunkSize;
+
+      const size_t bufferUsage = bufferPos + chunkSize;
+      *bufferSize              = (size_type)bufferUsage;
+      _pkt->received           = GBP_REC_NONE;
+      if (bufferUsage == _pkt->dataLength)
+      {
+        // Fits fully in buffer
+      }
+      else if (bufferUsage == bufferMax)
+      {
+        _pkt->received = GBP_REC_GOT_PAYLOAD_PARTAL;
+      }
+    }
+    else if (!gbp_pkt_processHeaderByte<BUFF_MAX>(_pkt, data[i++], bufferSize, bufferMax))
+    {
+      continue;
+    }
+
+    if (_pkt->received != GBP_REC_NONE)
+    {
+      events++;
+      if (callback)
+      {
+        callback(_pkt, buffer, *bufferSize, userData);
+      }
+    }
+  }
+  return events;
+}
+
+// Parse a block of bytes. Payload bytes are copied to buffer in chunks rather than byte by byte.
+// `callback` (optional) is called for every packet event, with the same state gbp_pkt_processByte() would have returned true on.
+// returns number of packet events
+size_t gbp_pkt_processBuffer(gbp_pkt_t *_pkt, const uint8_t data[], const size_t dataSize, uint8_t buffer[], uint8_t *bufferSize, const size_t bufferMax, gbp_pkt_callback_t callback, void *userData)
+{
+  // Dev Note: Minimum required size of 4 bytes for printer instruction packet
+  //  data payload can be streamed so doesn't have to fit full size
+  if (bufferMax < 4)
+    return 0;
+
+  // Dev Note: bufferSize is 8bit, so only the first 255 bytes of a larger buffer are used (See gbp_pkt_processBuffer_full())
+  if (bufferMax == GBP_PKT_PAYLOAD_BUFF_SIZE_IN_BYTE)
+    return gbp_pkt_parse<GBP_PKT_PAYLOAD_BUFF_SIZE_IN_BYTE>(_pkt, data, dataSize, buffer, bufferSize, bufferMax, callback, userData);
+  return gbp_pkt_parse<0>(_pkt, data, dataSize, buffer, bufferSize, (bufferMax < UINT8_MAX) ? bufferMax : UINT8_MAX, callback, userData);
+}
+
+// returns true if packet is received
+bool gbp_pkt_processByte(gbp_pkt_t *_pkt, const uint8_t _byte, uint8_t buffer[], uint8_t *bufferSize, const size_t bufferMax)
+{
+  return gbp_pkt_processBuffer(_pkt, &_byte, 1, buffer, bufferSize, bufferMax, NULL, NULL) > 0;
+}
+
+#if GBP_CORE_FULL_PAYLOAD
+// Same as gbp_pkt_processBuffer() but with a buffer of GBP_PKT_FULL_PAYLOAD_BUFF_SIZE_IN_BYTE
+// Every valid packet is a single GBP_REC_GOT_PACKET event with its whole payload (e.g. all 40 tiles of a DATA packet)
+size_t gbp_pkt_processBuffer_full(gbp_pkt_t *_pkt, const uint8_t data[], const size_t dataSize, uint8_t buffer[GBP_PKT_FULL_PAYLOAD_BUFF_SIZE_IN_BYTE], uint16_t *bufferSize, gbp_pkt_full_callback_t callback, void *userData)
+{
+  return gbp_pkt_parse<GBP_PKT_FULL_PAYLOAD_BUFF_SIZE_IN_BYTE>(_pkt, data, dataSize, buffer, bufferSize, GBP_PKT_FULL_PAYLOAD_BUFF_SIZE_IN_BYTE, callback, userData);
+}
+#endif
+
 
 /*******************************************************************************
   Tile Accumulator
@@ -195,6 +269,9 @@ bool gbp_pkt_tileAccu_tileReadyCheck(gbp_pkt_tileAcc_t *tileBuff)
 
 bool gbp_pkt_decompressor(gbp_pkt_t *_pkt, const uint8_t buff[], const size_t buffSize, gbp_pkt_tileAcc_t *tileBuff)
 {
+  // Dev Note: Bytes are moved into the tile accumulator a run at a time (memcpy/memset)
+  //           but always stop at the tile boundary so each tile can be taken
+  //           before the rest of the run is expanded on the next call.
   if (!_pkt->compression)
   {
     // Uncompressed payload // e.g. Gameboy Camera
@@ -203,7 +280,17 @@ bool gbp_pkt_decompressor(gbp_pkt_t *_pkt, const uint8_t buff[], const size_t bu
       // for (buffIndex = 0; buffIndex < buffSize ; buffIndex++)
       if (_pkt->buffIndex < buffSize)
       {
-        if (gbp_pkt_tileAccu_insertByte(tileBuff, buff[_pkt->buffIndex++]))
+        if (tileBuff->count >= GBP_TILE_SIZE_IN_BYTE)
+        {
+          return true;  // Tile still waiting to be taken
+        }
+        const size_t tileSpace = GBP_TILE_SIZE_IN_BYTE - tileBuff->count;
+        const size_t remaining = buffSize - _pkt->buffIndex;
+        const size_t n         = (remaining < tileSpace) ? remaining : tileSpace;
+        memcpy(&tileBuff->tile[tileBuff->count], &buff[_pkt->buffIndex], n);
+        tileBuff->count += n;
+        _pkt->buffIndex += n;
+        if (tileBuff->count == GBP_TILE_SIZE_IN_BYTE)
         {
           return true;  // Got tile
         }
@@ -252,9 +339,27 @@ bool gbp_pkt_decompressor(gbp_pkt_t *_pkt, const uint8_t buff[], const size_t bu
         }
         else
         {
-          const uint8_t b = (_pkt->compressedRun) ? _pkt->repeatByte : buff[_pkt->buffIndex++];
-          _pkt->loopRunLength--;
-          if (gbp_pkt_tileAccu_insertByte(tileBuff, b))
+          // Expand as much of the run as fits in the current tile
+          if (tileBuff->count >= GBP_TILE_SIZE_IN_BYTE)
+          {
+            return true;  // Tile still waiting to be taken
+          }
+          size_t n = GBP_TILE_SIZE_IN_BYTE - tileBuff->count;
+          n        = (_pkt->loopRunLength < n) ? _pkt->loopRunLength : n;
+          if (_pkt->compressedRun)
+          {
+            memset(&tileBuff->tile[tileBuff->count], _pkt->repeatByte, n);
+          }
+          else
+          {
+            const size_t remaining = buffSize - _pkt->buffIndex;
+            n                      = (remaining < n) ? remaining : n;
+            memcpy(&tileBuff->tile[tileBuff->count], &buff[_pkt->buffIndex], n);
+            _pkt->buffIndex += n;
+          }
+          _pkt->loopRunLength -= n;
+          tileBuff->count += n;
+          if (tileBuff->count == GBP_TILE_SIZE_IN_BYTE)
           {
             return true;  // Got tile
           }
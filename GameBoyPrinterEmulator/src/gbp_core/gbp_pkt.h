@@ -26,8 +26,10 @@
 #include <stddef.h>   // size_t
 #include <stdbool.h>  // bool
 #include "gameboy_printer_protocol.h"
+#include "gbp_core_config.h"
 
 #define GBP_PKT_PAYLOAD_BUFF_SIZE_IN_BYTE GBP_TILE_SIZE_IN_BYTE
+#define GBP_PKT_FULL_PAYLOAD_BUFF_SIZE_IN_BYTE (40 * GBP_TILE_SIZE_IN_BYTE) ///< Largest payload (DATA packet of 640 bytes)
 
 typedef enum
 {
@@ -66,13 +68,27 @@ typedef struct
   unsigned char tile[GBP_TILE_SIZE_IN_BYTE];
 } gbp_pkt_tileAcc_t;
 
+// Packet event callback for gbp_pkt_processBuffer() (same conditions gbp_pkt_processByte() returns true on)
+typedef void (*gbp_pkt_callback_t)(gbp_pkt_t *_pkt, uint8_t buffer[], const uint8_t bufferSize, void *userData);
+typedef void (*gbp_pkt_full_callback_t)(gbp_pkt_t *_pkt, uint8_t buffer[], const uint16_t bufferSize, void *userData);
+
 
 bool gbp_pkt_init(gbp_pkt_t *_pkt);
 bool gbp_pkt_reset(gbp_pkt_t *_pkt);
 bool gbp_pkt_processByte(gbp_pkt_t *_pkt, const uint8_t _byte, uint8_t buffer[], uint8_t *bufferSize, const size_t bufferMax);
+size_t gbp_pkt_processBuffer(gbp_pkt_t *_pkt, const uint8_t data[], const size_t dataSize, uint8_t buffer[], uint8_t *bufferSize, const size_t bufferMax, gbp_pkt_callback_t callback, void *userData);
+#if GBP_CORE_FULL_PAYLOAD
+size_t gbp_pkt_processBuffer_full(gbp_pkt_t *_pkt, const uint8_t data[], const size_t dataSize, uint8_t buffer[GBP_PKT_FULL_PAYLOAD_BUFF_SIZE_IN_BYTE], uint16_t *bufferSize, gbp_pkt_full_callback_t callback, void *userData);
+#endif
 bool gbp_pkt_decompressor(gbp_pkt_t *_pkt, const uint8_t buff[], const size_t buffSize, gbp_pkt_tileAcc_t *tileBuff);
 bool gbp_pkt_tileAccu_tileReadyCheck(gbp_pkt_tileAcc_t *tileBuff);
 
+// On a GBP_REC_GOT_PACKET event: true if the payload did not fit and follows in GBP_REC_GOT_PAYLOAD_PARTAL and GBP_REC_GOT_PACKET_END events
+static inline bool gbp_pkt_payloadStreamed(const gbp_pkt_t *_pkt)
+{
+  return _pkt->pktByteIndex != 0;
+}
+
 /*******************************************************************************
  * Print Instruction
 *******************************************************************************/
@@ -0,0 +1,457 @@
+/*************************************************************************
+ *
+ * Gameboy Printer Tile Decoder
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ * Copyright (C) 2020 Brian Khuu
+ *
+ * PURPOSE: This module focus on decoder gameboy printer tiles to bmp
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>   // uint8_t
+#include <stddef.h>   // size_t
+#include <stdbool.h>  // bool
+#include <string.h>   // memcpy
+#include "gameboy_printer_protocol.h"
+#include "gbp_tiles.h"
+#include "gbp_core_config.h"
+
+/*
+  Bitplane spread lookup table
+  Moves bit (7-i) of a tile bitplane byte to bit (2*i), which is the lo bit
+  of pixel i when packed as per GBP_TILE_2BIT_LINEPACK_INDEX() and GBP_TILE_2BIT_LINEPACK_BITOFFSET().
+  The hi bitplane uses the same table shifted left by one.
+*/
+#if GBP_CORE_TILE_LUT
+static const uint16_t gbp_tiles_bitplaneSpread[256] =
+{
+  0x0000, 0x4000, 0x1000, 0x5000, 0x0400, 0x4400, 0x1400, 0x5400,
+  0x0100, 0x4100, 0x1100, 0x5100, 0x0500, 0x4500, 0x1500, 0x5500,
+  0x0040, 0x4040, 0x1040, 0x5040, 0x0440, 0x4440, 0x1440, 0x5440,
+  0x0140, 0x4140, 0x1140, 0x5140, 0x0540, 0x4540, 0x1540, 0x5540,
+  0x0010, 0x4010, 0x1010, 0x5010, 0x0410, 0x4410, 0x1410, 0x5410,
+  0x0110, 0x4110, 0x1110, 0x5110, 0x0510, 0x4510, 0x1510, 0x5510,
+  0x0050, 0x4050, 0x1050, 0x5050, 0x0450, 0x4450, 0x1450, 0x5450,
+  0x0150, 0x4150, 0x1150, 0x5150, 0x0550, 0x4550, 0x1550, 0x5550,
+  0x0004, 0x4004, 0x1004, 0x5004, 0x0404, 0x4404, 0x1404, 0x5404,
+  0x0104, 0x4104, 0x1104, 0x5104, 0x0504, 0x4504, 0x1504, 0x5504,
+  0x0044, 0x4044, 0x1044, 0x5044, 0x0444, 0x4444, 0x1444, 0x5444,
+  0x0144, 0x4144, 0x1144, 0x5144, 0x0544, 0x4544, 0x1544, 0x5544,
+  0x0014, 0x4014, 0x1014, 0x5014, 0x0414, 0x4414, 0x1414, 0x5414,
+  0x0114, 0x4114, 0x1114, 0x5114, 0x0514, 0x4514, 0x1514, 0x5514,
+  0x0054, 0x4054, 0x1054, 0x5054, 0x0454, 0x4454, 0x1454, 0x5454,
+  0x0154, 0x4154, 0x1154, 0x5154, 0x0554, 0x4554, 0x1554, 0x5554,
+  0x0001, 0x4001, 0x1001, 0x5001, 0x0401, 0x4401, 0x1401, 0x5401,
+  0x0101, 0x4101, 0x1101, 0x5101, 0x0501, 0x4501, 0x1501, 0x5501,
+  0x0041, 0x4041, 0x1041, 0x5041, 0x0441, 0x4441, 0x1441, 0x5441,
+  0x0141, 0x4141, 0x1141, 0x5141, 0x0541, 0x4541, 0x1541, 0x5541,
+  0x0011, 0x4011, 0x1011, 0x5011, 0x0411, 0x4411, 0x1411, 0x5411,
+  0x0111, 0x4111, 0x1111, 0x5111, 0x0511, 0x4511, 0x1511, 0x5511,
+  0x0051, 0x4051, 0x1051, 0x5051, 0x0451, 0x4451, 0x1451, 0x5451,
+  0x0151, 0x4151, 0x1151, 0x5151, 0x0551, 0x4551, 0x1551, 0x5551,
+  0x0005, 0x4005, 0x1005, 0x5005, 0x0405, 0x4405, 0x1405, 0x5405,
+  0x0105, 0x4105, 0x1105, 0x5105, 0x0505, 0x4505, 0x1505, 0x5505,
+  0x0045, 0x4045, 0x1045, 0x5045, 0x0445, 0x4445, 0x1445, 0x5445,
+  0x0145, 0x4145, 0x1145, 0x5145, 0x0545, 0x4545, 0x1545, 0x5545,
+  0x0015, 0x4015, 0x1015, 0x5015, 0x0415, 0x4415, 0x1415, 0x5415,
+  0x0115, 0x4115, 0x1115, 0x5115, 0x0515, 0x4515, 0x1515, 0x5515,
+  0x0055, 0x4055, 0x1055, 0x5055, 0x0455, 0x4455, 0x1455, 0x5455,
+  0x0155, 0x4155, 0x1155, 0x5155, 0x0555, 0x4555, 0x1555, 0x5555,
+};
+#endif
+
+static inline uint16_t gbp_tiles_bitplaneSpreadOf(const uint8_t bitplane)
+{
+#if GBP_CORE_TILE_LUT
+  return gbp_tiles_bitplaneSpread[bitplane];
+#else
+  uint16_t value = 0;
+  for (int i = 0; i < GBP_TILE_PIXEL_WIDTH; i++)
+  {
+    if (bitplane & (0x80 >> i))
+      value |= (uint16_t)(1 << (2 * i));
+  }
+  return value;
+#endif
+}
+
+static void gbp_tiles_toBuff(
+            uint8_t *buff,
+            const int buffSize,
+            const int buffTileCount,
+            const int tileLineOffset,
+            const int tileRowOffset,
+            const uint8_t tileBuff[GBP_TILE_SIZE_IN_BYTE])
+{
+  // This converts tile data to a bitmap buffer
+  // The bitmap buffer has enough space to contain multiple decoded tiles
+  // And each area is written to by x tile offset
+
+  // Guard
+  if (buffSize < (buffTileCount * GBP_TILE_PIXEL_HEIGHT * GBP_TILE_2BIT_LINEPACK_ROWSIZE_B(GBP_TILE_PIXEL_WIDTH)))
+    return;
+
+  const int lineWidthSize = GBP_TILE_2BIT_LINEPACK_ROWSIZE_B(buffTileCount * GBP_TILE_PIXEL_WIDTH);
+  const int rowHeightSize = lineWidthSize * GBP_TILE_PIXEL_HEIGHT;
+
+  // Tile Decoder
+  // Each tile line is a pair of bit planes (lo byte then hi byte) which expands to two packed 2bit bytes
+  const int offset = tileLineOffset * GBP_TILE_2BIT_LINEPACK_ROWSIZE_B(GBP_TILE_PIXEL_WIDTH);
+  uint8_t *out = &buff[(tileRowOffset * rowHeightSize) + offset];
+  for (int j = 0; j < GBP_TILE_PIXEL_HEIGHT; j++)
+  {
+    const uint16_t value = (uint16_t)(gbp_tiles_bitplaneSpreadOf(tileBuff[j*2]) | (gbp_tiles_bitplaneSpreadOf(tileBuff[j*2 + 1]) << 1));
+    out[0] = (uint8_t)(value & 0xFF);  // Pixel 0-3
+    out[1] = (uint8_t)(value >> 8);    // Pixel 4-7
+    out += lineWidthSize;
+  }
+}
+
+// Same as gbp_tiles_toBuff() but for a tile already decoded with gbp_tiles_tile_decode()
+static void gbp_tiles_decodedToBuff(
+            uint8_t *buff,
+            const int buffSize,
+            const int buffTileCount,
+            const int tileLineOffset,
+            const int tileRowOffset,
+            const uint8_t decoded[GBP_TILE_DECODED_SIZE_B])
+{
+  // Guard
+  if (buffSize < (buffTileCount * GBP_TILE_DECODED_SIZE_B))
+    return;
+
+  const int lineWidthSize = GBP_TILE_2BIT_LINEPACK_ROWSIZE_B(buffTileCount * GBP_TILE_PIXEL_WIDTH);
+  const int rowHeightSize = lineWidthSize * GBP_TILE_PIXEL_HEIGHT;
+
+  const int offset = tileLineOffset * GBP_TILE_2BIT_LINEPACK_ROWSIZE_B(GBP_TILE_PIXEL_WIDTH);
+  uint8_t *out = &buff[(tileRowOffset * rowHeightSize) + offset];
+  for (int j = 0; j < GBP_TILE_PIXEL_HEIGHT; j++)
+  {
+    out[0] = decoded[j*2];      // Pixel 0-3
+    out[1] = decoded[j*2 + 1];  // Pixel 4-7
+    out += lineWidthSize;
+  }
+}
+
+// Decode one tile on its own into GBP_TILE_PIXEL_HEIGHT packed 2bit lines (e.g. to be cached)
+void gbp_tiles_tile_decode(const uint8_t tileBuff[GBP_TILE_SIZE_IN_BYTE], uint8_t decoded[GBP_TILE_DECODED_SIZE_B])
+{
+  gbp_tiles_toBuff(decoded, GBP_TILE_DECODED_SIZE_B, 1, 0, 0, tileBuff);
+}
+
+// Build the packed byte lookup that remaps all four 2bit pixels to the print palette
+// Returns false if the palette maps every tone to itself, so there is nothing to do (harmonisedPack is left as is)
+bool gbp_tiles_harmoniseLut(uint8_t pallet, uint8_t harmonisedPack[256])
+{
+  // Ref: https://github.com/Raphael-Boichot/The-Arduino-SD-Game-Boy-Printer#some-technical-facts
+  // Palette 0x00 has the same effect than palette 0xE4 (the mainly encountered palette in games)
+  uint8_t tonePallet[GBP_TILE_MAX_TONES] = {0};
+  pallet = (pallet == 0x00) ? 0xE4 : pallet;
+  if (pallet == 0xE4)
+    return false;
+  tonePallet[0] = ((pallet >> 0) & 0b11);
+  tonePallet[1] = ((pallet >> 2) & 0b11);
+  tonePallet[2] = ((pallet >> 4) & 0b11);
+  tonePallet[3] = ((pallet >> 6) & 0b11);
+  for (int b = 0; b < 256; b++)
+  {
+    harmonisedPack[b] = (uint8_t)((tonePallet[(b >> 0) & 0b11] << 0) |
+                   (tonePallet[(b >> 2) & 0b11] << 2) |
+                   (tonePallet[(b >> 4) & 0b11] << 4) |
+                   (tonePallet[(b >> 6) & 0b11] << 6));
+  }
+  return true;
+}
+
+static bool gbp_tiles_line_advance(gbp_tile_t *gbp_tiles)
+{
+  gbp_tiles->tileLineOffset++;
+  if (gbp_tiles->tileLineOffset >= GBP_TILES_PER_LINE)
+  {
+    // Enough tiles decoded to output a fully decoded line
+    gbp_tiles->tileLineOffset = 0;
+    gbp_tiles->tileRowOffset++;
+    return true;
+  }
+
+  // Tile Decoded, but not enough to make a line
+  return false;
+}
+
+bool gbp_tiles_line_decoder(gbp_tile_t *gbp_tiles, const uint8_t tileBuff[GBP_TILE_SIZE_IN_BYTE])
+{
+  // Buffer full, rows beyond GBP_TILES_PER_ROW before a print are dropped
+  if (gbp_tiles->tileRowOffset >= GBP_TILES_PER_ROW)
+    return false;
+
+  gbp_tiles_toBuff(
+            (uint8_t *)gbp_tiles->bmpLineBuffer,
+            GBP_TILE_PIXEL_HEIGHT * GBP_TILE_PIXEL_WIDTH * GBP_TILES_PER_LINE,
+            GBP_TILES_PER_LINE,
+            gbp_tiles->tileLineOffset,
+            gbp_tiles->tileRowOffset,
+            tileBuff);
+  return gbp_tiles_line_advance(gbp_tiles);
+}
+
+// Same as gbp_tiles_line_decoder() but for a tile already decoded with gbp_tiles_tile_decode()
+bool gbp_tiles_line_addDecoded(gbp_tile_t *gbp_tiles, const uint8_t decoded[GBP_TILE_DECODED_SIZE_B])
+{
+  if (gbp_tiles->tileRowOffset >= GBP_TILES_PER_ROW)
+    return false;
+
+  gbp_tiles_decodedToBuff(
+            (uint8_t *)gbp_tiles->bmpLineBuffer,
+            GBP_TILE_PIXEL_HEIGHT * GBP_TILE_PIXEL_WIDTH * GBP_TILES_PER_LINE,
+            GBP_TILES_PER_LINE,
+            gbp_tiles->tileLineOffset,
+            gbp_tiles->tileRowOffset,
+            decoded);
+  return gbp_tiles_line_advance(gbp_tiles);
+}
+
+/*****************************************************************************/
+
+void gbp_tiles_rowRing_reset(gbp_tiles_rowRing_t *ring)
+{
+  ring->tileLineOffset = 0;
+  ring->rowWrite       = 0;
+  ring->rowRead        = 0;
+  ring->rowDropped     = 0;
+}
+
+// Returns true when a row has been completed (Fetch it with gbp_tiles_rowRing_get())
+bool gbp_tiles_rowRing_decoder(gbp_tiles_rowRing_t *ring, const uint8_t tileBuff[GBP_TILE_SIZE_IN_BYTE])
+{
+  // Starting a new row while the ring is full, so overwrite the oldest unread row
+  if ((ring->tileLineOffset == 0) && ((uint16_t)(ring->rowWrite - ring->rowRead) >= GBP_TILES_ROW_RING_COUNT))
+  {
+    ring->rowRead++;
+    ring->rowDropped++;
+  }
+
+  gbp_tiles_toBuff(
+            (uint8_t *)ring->rowBuffer[ring->rowWrite % GBP_TILES_ROW_RING_COUNT],
+            sizeof(ring->rowBuffer[0]),
+            GBP_TILES_PER_LINE,
+            ring->tileLineOffset,
+            0,
+            tileBuff);
+  ring->tileLineOffset++;
+  if (ring->tileLineOffset >= GBP_TILES_PER_LINE)
+  {
+    ring->tileLineOffset = 0;
+    ring->rowWrite++;
+    return true;
+  }
+
+  return false;
+}
+
+// Oldest completed row (GBP_TILE_PIXEL_HEIGHT lines of GBP_TILES_ROW_SIZE_B bytes) or NULL if none
+// Call gbp_tiles_rowRing_release() once done with it
+const uint8_t *gbp_tiles_rowRing_get(gbp_tiles_rowRing_t *ring, uint16_t *rowIndex)
+{
+  if (ring->rowRead == ring->rowWrite)
+    return NULL;
+  if (rowIndex)
+        *rowIndex = ring->rowRead;
+  return (const uint8_t *)ring->rowBuffer[ring->rowRead % GBP_TILES_ROW_RING_COUNT];
+}
+
+void gbp_tiles_rowRing_release(gbp_tiles_rowRing_t *ring)
+{
+  if (ring->rowRead != ring->rowWrite)
+    ring->rowRead++;
+}
+
+/*****************************************************************************/
+
+// `rows[]` is the ring, with `rowCount` entries (At least 1). Rows held back are `rowCount - 1`
+void gbp_tiles_stream_init(gbp_tiles_stream_t *stream, gbp_tiles_streamRow_t rows[], uint16_t rowCount)
+{
+  stream->rows             = rows;
+  stream->rowCount         = rowCount;
+  stream->holdRows         = rowCount - 1;
+  stream->rowDropped       = 0;
+  stream->rowsPredicted    = 0;
+  stream->rowsMispredicted = 0;
+  gbp_tiles_stream_reset(stream);
+}
+
+// Drop every row in the ring and start over (e.g. the input restarted). Counters are kept
+void gbp_tiles_stream_reset(gbp_tiles_stream_t *stream)
+{
+  stream->tileLineOffset   = 0;
+  stream->rowWrite         = 0;
+  stream->rowTagged        = 0;
+  stream->rowRead          = 0;
+  stream->predictedPallet  = 0xE4;
+  stream->segmentPredicted = 0;
+}
+
+// Dev Note: Rows are only tagged with their palette here, like gbp_tile_t.rowPallet. The pixels are
+//           remapped on the way out, so streamed and whole print rows go through the same output path
+static void gbp_tiles_stream_tag(gbp_tiles_stream_t *stream, uint32_t rowEnd, uint8_t pallet)
+{
+  for ( ; stream->rowTagged != rowEnd; stream->rowTagged++)
+  {
+    stream->rows[stream->rowTagged % stream->rowCount].pallet = pallet;
+  }
+}
+
+// Ring slot for the next row, overwriting the oldest unread row if the ring is full
+static uint8_t *gbp_tiles_stream_nextRow(gbp_tiles_stream_t *stream)
+{
+  if ((stream->rowWrite - stream->rowRead) >= stream->rowCount)
+  {
+    if (stream->rowTagged == stream->rowRead)
+      gbp_tiles_stream_tag(stream, stream->rowRead + 1, stream->predictedPallet);
+    stream->rowRead++;
+    stream->rowDropped++;
+  }
+  return (uint8_t *) stream->rows[stream->rowWrite % stream->rowCount].row;
+}
+
+static void gbp_tiles_stream_rowComplete(gbp_tiles_stream_t *stream)
+{
+  stream->rows[stream->rowWrite % stream->rowCount].pallet = GBP_TILES_STREAM_PALLET_PENDING;
+  stream->rowWrite++;
+
+  // Too many rows waiting for their print, so release the oldest with the palette of the previous print
+  if ((stream->rowWrite - stream->rowTagged) > stream->holdRows)
+  {
+    gbp_tiles_stream_tag(stream, stream->rowWrite - stream->holdRows, stream->predictedPallet);
+    stream->segmentPredicted++;
+    stream->rowsPredicted++;
+  }
+}
+
+static bool gbp_tiles_stream_advance(gbp_tiles_stream_t *stream)
+{
+  stream->tileLineOffset++;
+  if (stream->tileLineOffset >= GBP_TILES_PER_LINE)
+  {
+    stream->tileLineOffset = 0;
+    gbp_tiles_stream_rowComplete(stream);
+    return true;
+  }
+
+  return false;
+}
+
+// Returns true when a row has been completed (Fetch tagged rows with gbp_tiles_stream_get())
+bool gbp_tiles_stream_decoder(gbp_tiles_stream_t *stream, const uint8_t tileBuff[GBP_TILE_SIZE_IN_BYTE])
+{
+  uint8_t *row = (stream->tileLineOffset == 0) ? gbp_tiles_stream_nextRow(stream) : (uint8_t *) stream->rows[stream->rowWrite % stream->rowCount].row;
+  gbp_tiles_toBuff(
+            row,
+            sizeof(stream->rows[0].row),
+            GBP_TILES_PER_LINE,
+            stream->tileLineOffset,
+            0,
+            tileBuff);
+  return gbp_tiles_stream_advance(stream);
+}
+
+// Same as gbp_tiles_stream_decoder() but for a tile already decoded with gbp_tiles_tile_decode()
+bool gbp_tiles_stream_addDecoded(gbp_tiles_stream_t *stream, const uint8_t decoded[GBP_TILE_DECODED_SIZE_B])
+{
+  uint8_t *row = (stream->tileLineOffset == 0) ? gbp_tiles_stream_nextRow(stream) : (uint8_t *) stream->rows[stream->rowWrite % stream->rowCount].row;
+  gbp_tiles_decodedToBuff(
+            row,
+            sizeof(stream->rows[0].row),
+            GBP_TILES_PER_LINE,
+            stream->tileLineOffset,
+            0,
+            decoded);
+  return gbp_tiles_stream_advance(stream);
+}
+
+// Row that was already decoded into tones (e.g. GBP_OUTPUT_RASTER_ROWS from the emulator)
+bool gbp_tiles_stream_addRow(gbp_tiles_stream_t *stream, const uint8_t row[GBP_TILE_PIXEL_HEIGHT * GBP_TILES_ROW_SIZE_B])
+{
+  memcpy(gbp_tiles_stream_nextRow(stream), row, sizeof(stream->rows[0].row));
+  stream->tileLineOffset = 0;
+  gbp_tiles_stream_rowComplete(stream);
+  return true;
+}
+
+// Print received, so every row still waiting gets its palette
+void gbp_tiles_stream_print(gbp_tiles_stream_t *stream, uint8_t pallet)
+{
+  const uint8_t harmonisedPallet = (pallet == 0x00) ? 0xE4 : pallet;
+  const uint8_t harmonisedPredicted = (stream->predictedPallet == 0x00) ? 0xE4 : stream->predictedPallet;
+  if (harmonisedPallet != harmonisedPredicted)
+    stream->rowsMispredicted += stream->segmentPredicted;
+  gbp_tiles_stream_tag(stream, stream->rowWrite, pallet);
+  stream->predictedPallet  = pallet;
+  stream->segmentPredicted = 0;
+}
+
+// Oldest tagged row (GBP_TILE_PIXEL_HEIGHT lines of GBP_TILES_ROW_SIZE_B bytes) or NULL if none
+// Its tones are as decoded, `*pallet` is the print palette to apply (See gbp_tiles_harmoniseLut())
+// Call gbp_tiles_stream_release() once done with it
+const uint8_t *gbp_tiles_stream_get(gbp_tiles_stream_t *stream, uint8_t *pallet)
+{
+  if (stream->rowRead == stream->rowTagged)
+    return NULL;
+  const gbp_tiles_streamRow_t *slot = &stream->rows[stream->rowRead % stream->rowCount];
+  if (pallet)
+    *pallet = (uint8_t) slot->pallet;
+  return (const uint8_t *) slot->row;
+}
+
+void gbp_tiles_stream_release(gbp_tiles_stream_t *stream)
+{
+  if (stream->rowRead != stream->rowTagged)
+    stream->rowRead++;
+}
+
+/*****************************************************************************/
+
+void gbp_tiles_reset(gbp_tile_t *gbp_tiles)
+{
+  (void)gbp_tiles;
+  gbp_tiles->tileLineOffset = 0;
+  gbp_tiles->tileRowOffset  = 0;
+  gbp_tiles->tileRowOffsetHarmonised =0;
+  gbp_tiles->printSheets     = 0;
+  gbp_tiles->printFeedBefore = 0;
+  gbp_tiles->printFeedAfter  = 0;
+}
+
+void gbp_tiles_print(gbp_tile_t *gbp_tiles, uint8_t sheet, uint8_t linefeed, uint8_t pallet, uint8_t density)
+{
+  (void)density;
+
+  gbp_tiles->printSheets     = sheet;
+  gbp_tiles->printFeedBefore = (linefeed >> 4) & 0xF;
+  gbp_tiles->printFeedAfter  = linefeed & 0xF;
+
+  /* Harmonise Pallete */
+  // Dev Note: Only the palette of each row since the last print is recorded here. The pixels are
+  //           remapped on the way out, where they are looked up per packed byte anyway
+  for (int j = gbp_tiles->tileRowOffsetHarmonised; j < gbp_tiles->tileRowOffset; j++)
+  {
+    gbp_tiles->rowPallet[j] = pallet;
+  }
+  if (gbp_tiles->tileRowOffsetHarmonised < gbp_tiles->tileRowOffset)
+    gbp_tiles->tileRowOffsetHarmonised = gbp_tiles->tileRowOffset;
+}
+
+
@@ -0,0 +1,143 @@
+/*************************************************************************
+ *
+ * Gameboy Printer Tile Decoder
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ * Copyright (C) 2020 Brian Khuu
+ *
+ * PURPOSE: This module focus on decoder gameboy printer tiles to bmp
+ * LICENCE:
+ *   This file is part of Arduino Gameboy Printer Emulator.
+ *
+ *   Arduino Gameboy Printer Emulator is free software:
+ *   you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation,
+ *   either version 3 of the License, or (at your option) any later version.
+ *
+ *   Arduino Gameboy Printer Emulator is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Arduino Gameboy Printer Emulator.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>   // uint8_t
+#include <stddef.h>   // size_t
+#include <stdbool.h>  // bool
+#include "gameboy_printer_protocol.h"
+
+/*
+  Dev Note: From https://gbdev.io/pandocs/Gameboy_Printer.html
+  GBP has about 8 KiB of RAM to buffer incoming graphics data.
+  Those 8 KiB allow a maximum bitmap area of 160*200 (8192/160*4) pixels between prints.
+
+  ```
+  buffSize = 8*1024;
+  bitsPerPixel = 2;
+  linePixelCount = 8*20;
+  linebitcount = bitsPerPixel * linePixelCount;
+  bytesPerLine = linebitcount / 8;
+  maxRows = buffSize / (bytesPerLine * 8)
+    maxRows = 25.6
+  ```
+*/
+
+// IMAGE DEFINITION
+#define GBP_TILE_PIXEL_WIDTH  8
+#define GBP_TILE_PIXEL_HEIGHT 8
+#define GBP_TILES_PER_LINE    20
+#define GBP_TILES_PER_ROW     26  // Number of supported lines between print commands (26 tile row height is based on the 8KiB of a real gbp printer)
+#define GBP_TILE_MAX_TONES    4   // 2bits per pixel
+
+// 2B per pixel packing
+#define GBP_TILE_2BIT_LINEPACK_INDEX(x) (x/4)
+#define GBP_TILE_2BIT_LINEPACK_BITOFFSET(x) (2*(x%4))
+#define GBP_TILE_2BIT_LINEPACK_IN_BYTE_COUNT (4) ///< 4 2bit pixel in 8bit byte
+#define GBP_TILE_2BIT_LINEPACK_ROWSIZE_B(byteCount) (byteCount/4) ///< Row sized when 2bit packed is reduced by factor of 4
+#define GBP_TILE_DECODED_SIZE_B (GBP_TILE_PIXEL_HEIGHT * GBP_TILE_2BIT_LINEPACK_ROWSIZE_B(GBP_TILE_PIXEL_WIDTH)) ///< One tile as 8 packed 2bit lines of 2 bytes
+
+typedef struct
+{
+  // This is the tile to bmp decoder
+  uint16_t tileLineOffset;
+  uint16_t tileRowOffset;
+  uint16_t tileRowOffsetHarmonised; ///< Rows that have their palette in rowPallet
+
+  // Last print instruction, kept by gbp_tiles_print() for whoever writes the rows out
+  uint8_t printSheets;     ///< Copies of the rows (0 is a paper feed only)
+  uint8_t printFeedBefore; ///< Feeds of blank paper before the rows
+  uint8_t printFeedAfter;  ///< Feeds of blank paper after the rows (Non zero cuts the paper)
+
+  // Print palette of each row. Rows are kept as decoded, so the palette is applied when they are
+  // written out (See gbp_tiles_harmoniseLut()) instead of rewriting every pixel on each print
+  uint8_t rowPallet[GBP_TILES_PER_ROW];
+
+  // Each array entry represents a decoded 2bit pixel (Before the row palette)
+  uint8_t bmpLineBuffer[GBP_TILE_PIXEL_HEIGHT * GBP_TILES_PER_ROW][GBP_TILE_2BIT_LINEPACK_ROWSIZE_B(GBP_TILE_PIXEL_WIDTH * GBP_TILES_PER_LINE)];
+} gbp_tile_t;
+
+// Row ring : Same tile decoding but only keeping a few 8 pixel high rows, so each
+// row can be streamed out as soon as it is complete (e.g. on the emulator itself)
+#define GBP_TILES_ROW_SIZE_B GBP_TILE_2BIT_LINEPACK_ROWSIZE_B(GBP_TILE_PIXEL_WIDTH * GBP_TILES_PER_LINE) ///< 40 bytes per scanline
+#ifndef GBP_TILES_ROW_RING_COUNT
+#define GBP_TILES_ROW_RING_COUNT 2
+#endif
+
+typedef struct
+{
+  uint16_t tileLineOffset; ///< Tile position in the row being decoded
+  uint16_t rowWrite;       ///< Rows completed since reset
+  uint16_t rowRead;        ///< Rows released since reset
+  uint16_t rowDropped;     ///< Rows overwritten before being released
+  uint8_t rowBuffer[GBP_TILES_ROW_RING_COUNT][GBP_TILE_PIXEL_HEIGHT][GBP_TILES_ROW_SIZE_B];
+} gbp_tiles_rowRing_t;
+
+// Row stream : Rows wait in a ring for the print that gives their palette, so a print of any
+// length is rendered with constant memory. Once more than `holdRows` rows are waiting, the oldest is
+// tagged with the palette of the previous print instead (Games rarely change palette between prints)
+// Dev Note: The ring is given by the caller, `holdRows + 1` entries (GBP_TILES_STREAM_ROWS())
+#define GBP_TILES_STREAM_HOLD_MAX GBP_TILES_PER_ROW ///< Enough to hold back a whole print
+#define GBP_TILES_STREAM_ROWS(holdRows) ((holdRows) + 1) ///< Ring entries for `holdRows` plus the row being decoded
+#define GBP_TILES_STREAM_PALLET_PENDING 0xFFFF ///< Row palette tag until its print (or prediction) arrives
+
+typedef struct
+{
+  uint16_t pallet; ///< Palette tag of the row
+  uint8_t row[GBP_TILE_PIXEL_HEIGHT][GBP_TILES_ROW_SIZE_B];
+} gbp_tiles_streamRow_t;
+
+typedef struct
+{
+  uint16_t tileLineOffset; ///< Tile position in the row being decoded
+  uint32_t rowWrite;       ///< Rows completed since reset (32bit, as the ring size may not divide 2^16)
+  uint32_t rowTagged;      ///< Rows given their palette since reset (Ready to be fetched)
+  uint32_t rowRead;        ///< Rows released since reset
+  uint16_t rowDropped;     ///< Rows overwritten before being released
+  uint16_t holdRows;       ///< Rows held back for their print (rowCount - 1)
+  uint8_t predictedPallet; ///< Palette of the last print
+  uint16_t segmentPredicted; ///< Rows since the last print that were tagged with predictedPallet
+  uint32_t rowsPredicted;    ///< Rows tagged before their print arrived
+  uint32_t rowsMispredicted; ///< Predicted rows whose print then asked for another palette
+  uint16_t rowCount;            ///< Ring entries
+  gbp_tiles_streamRow_t *rows;  ///< Ring, given to gbp_tiles_stream_init()
+} gbp_tiles_stream_t;
+
+bool gbp_tiles_harmoniseLut(uint8_t pallet, uint8_t harmonisedPack[256]);
+void gbp_tiles_tile_decode(const uint8_t tileBuff[GBP_TILE_SIZE_IN_BYTE], uint8_t decoded[GBP_TILE_DECODED_SIZE_B]);
+bool gbp_tiles_line_decoder(gbp_tile_t *gbp_tiles, const uint8_t tileBuff[GBP_TILE_SIZE_IN_BYTE]);
+bool gbp_tiles_line_addDecoded(gbp_tile_t *gbp_tiles, const uint8_t decoded[GBP_TILE_DECODED_SIZE_B]);
+void gbp_tiles_rowRing_reset(gbp_tiles_rowRing_t *ring);
+bool gbp_tiles_rowRing_decoder(gbp_tiles_rowRing_t *ring, const uint8_t tileBuff[GBP_TILE_SIZE_IN_BYTE]);
+const uint8_t *gbp_tiles_rowRing_get(gbp_tiles_rowRing_t *ring, uint16_t *rowIndex);
+void gbp_tiles_rowRing_release(gbp_tiles_rowRing_t *ring);
+void gbp_tiles_stream_init(gbp_tiles_stream_t *stream, gbp_tiles_streamRow_t rows[], uint16_t rowCount);
+void gbp_tiles_stream_reset(gbp_tiles_stream_t *stream);
+bool gbp_tiles_stream_decoder(gbp_tiles_stream_t *stream, const uint8_t tileBuff[GBP_TILE_SIZE_IN_BYTE]);
+bool gbp_tiles_stream_addDecoded(gbp_tiles_stream_t *stream, const uint8_t decoded[GBP_TILE_DECODED_SIZE_B]);
+bool gbp_tiles_stream_addRow(gbp_tiles_stream_t *stream, const uint8_t row[GBP_TILE_PIXEL_HEIGHT * GBP_TILES_ROW_SIZE_B]);
+void gbp_tiles_stream_print(gbp_tiles_stream_t *stream, uint8_t pallet);
+const uint8_t *gbp_tiles_stream_get(gbp_tiles_stream_t *stream, uint8_t *pallet);
+void gbp_tiles_stream_release(gbp_tiles_stream_t *stream);
+void gbp_tiles_reset(gbp_tile_t *gbp_tiles);
+void gbp_tiles_print(gbp_tile_t *gbp_tiles, uint8_t sheet, uint8_t linefeed, uint8_t pallet, uint8_t density);
\ No newline at end of file
@@ -0,0 +1,438 @@
+/*************************************************************************
+ *
+ * Gameboy Printer Link Simulator
+ * Part of GAMEBOY PRINTER EMULATION PROJECT V2 (Arduino)
+ *
+ * PURPOSE: Replay packet capture files through the serial io ISR one clock
+ *          edge at a time at a given link rate, with a simulated main loop
+ *          draining the ring buffer, to see how the buffer copes.
+ *
+ * Usage: gpb_sim [options] capture.txt...
+ *   -r RATE   Link clock in Hz, k suffix is x1024 (default 8k, GBC fast mode is 256k or 512k)
+ *   -d RATE   Main loop drain in bytes/s (default 3840, hex mode at 115200 baud)
+ *   -l US     Main loop period in microseconds (default 1000)
+ *   -b SIZE   Ring buffer size in bytes (default 650, same as GBP_BUFFER_SIZE)
+ *   -g US     Gap between bytes in microseconds (default 0)
+ *   -G US     Gap between packets in microseconds (default 0)
+ *   -a        Adaptive busy (Same watermarks as the sketch)
+ *   -v        Report latency of every packet
+ *
+ * Capture files are the C array captures (0x88, 0x33, ...) or plain hex dumps (88 33 ...)
+ * found in test/ and research/Captures. Comments are skipped.
+ *
+ * Note: ISR cost is host time, so only compare it against other runs on the same machine
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <chrono>
+#include <vector>
+
+#include "src/gbp_core/gameboy_printer_protocol.h"
+#include "gbp_serial_io.h"
+
+// Raw packet is [SYNC0][SYNC1][CMD][COMPRESS][LEN0][LEN1][DATA...][CSUM0][CSUM1][ACK][STATUS]
+#define SIM_PKT_SIZE(LEN) (6 + (LEN) + 4)
+
+#define SIM_ISR_BENCH_MIN_NS 50000000  ///< Repeat ISR timing run until at least this long
+
+typedef struct
+{
+  uint32_t linkRate;    ///< Hz
+  uint32_t drainRate;   ///< Bytes per second
+  uint32_t loopUs;
+  size_t bufferSize;
+  uint32_t byteGapUs;
+  uint32_t packetGapUs;
+  bool adaptive;
+  bool verbose;
+} sim_config_t;
+
+typedef struct
+{
+  size_t start;     ///< Offset in capture
+  size_t size;      ///< Bytes in capture (Also bytes captured into ring buffer)
+  uint8_t command;
+  uint64_t endNs;   ///< Time last bit was clocked in
+} sim_packet_t;
+
+/*******************************************************************************
+ * Capture Loader
+*******************************************************************************/
+
+static bool sim_isHexToken(const char *s, size_t n)
+{
+  for (size_t i = 0 ; i < n ; i++)
+  {
+    if (!isxdigit((unsigned char)s[i]))
+      return false;
+  }
+  return true;
+}
+
+// Every `0xNN` or bare `NN` token outside of comments is a byte
+static bool sim_loadCapture(const char *path, std::vector<uint8_t> &bytes)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+  {
+    return false;
+  }
+
+  std::vector<char> text;
+  char chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+  {
+    text.insert(text.end(), chunk, chunk + n);
+  }
+  fclose(f);
+  text.push_back('\0');
+
+  const char *p = text.data();
+  while (*p)
+  {
+    if ((p[0] == '/') && (p[1] == '*'))
+    {
+      const char *end = strstr(p + 2, "*/");
+      p = end ? (end + 2) : (p + strlen(p));
+      continue;
+    }
+    if ((p[0] == '/') && (p[1] == '/'))
+    {
+      while (*p && (*p != '\n'))
+        p++;
+      continue;
+    }
+    if (!isalnum((unsigned char)*p))
+    {
+      p++;
+      continue;
+    }
+
+    const char *tok = p;
+    while (isalnum((unsigned char)*p))
+      p++;
+    const size_t tokSize = p - tok;
+
+    if ((tokSize == 4) && (tok[0] == '0') && ((tok[1] == 'x') || (tok[1] == 'X')) && sim_isHexToken(tok + 2, 2))
+    {
+      bytes.push_back((uint8_t)strtoul(tok + 2, NULL, 16));
+    }
+    else if ((tokSize == 2) && sim_isHexToken(tok, 2))
+    {
+      bytes.push_back((uint8_t)strtoul(tok, NULL, 16));
+    }
+  }
+  return true;
+}
+
+// Find whole packets (Bytes in between, e.g. a torn capture start, are still clocked in)
+static void sim_findPackets(const std::vector<uint8_t> &bytes, std::vector<sim_packet_t> &packets)
+{
+  size_t i = 0;
+  while ((i + SIM_PKT_SIZE(0)) <= bytes.size())
+  {
+    if ((bytes[i] != GBP_SYNC_WORD_0) || (bytes[i + 1] != GBP_SYNC_WORD_1))
+    {
+      i++;
+      continue;
+    }
+    const uint16_t len = bytes[i + 4] | ((uint16_t)bytes[i + 5] << 8);
+    if ((i + SIM_PKT_SIZE(len)) > bytes.size())
+    {
+      break;
+    }
+    sim_packet_t pkt = {};
+    pkt.start = i;
+    pkt.size = SIM_PKT_SIZE(len);
+    pkt.command = bytes[i + 2];
+    packets.push_back(pkt);
+    i += pkt.size;
+  }
+}
+
+/*******************************************************************************
+ * Link
+*******************************************************************************/
+
+static inline void sim_clockByte(gbp_serial_io_ctx_t *ctx, const uint8_t byte)
+{
+  for (int bi = 7 ; bi >= 0 ; bi--)
+  {
+    const bool bit = (byte >> bi) & 0x01;
+#ifdef GBP_FEATURE_USING_RISING_CLOCK_ONLY_ISR
+    gpb_serial_io_OnRising_ISR(ctx, bit);
+#else
+    gpb_serial_io_OnChange_ISR(ctx, false, bit);
+    gpb_serial_io_OnChange_ISR(ctx, true, bit);
+#endif
+  }
+}
+
+// Host time spent in the ISR for the whole capture, per byte
+static double sim_isrCost(const std::vector<uint8_t> &bytes)
+{
+  static gbp_serial_io_ctx_t ctx;
+  std::vector<uint8_t> buffer(bytes.size() + 100);
+  uint64_t totalNs = 0;
+  uint64_t totalBytes = 0;
+
+  while ((totalNs < SIM_ISR_BENCH_MIN_NS) && (bytes.size() > 0))
+  {
+#ifdef GBP_SERIAL_IO_BUFFER_SIZE_POW2
+    buffer.resize(GBP_SERIAL_IO_BUFFER_SIZE_POW2);
+#endif
+    gpb_serial_io_init(&ctx, buffer.size(), buffer.data());
+    const auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0 ; i < bytes.size() ; i++)
+    {
+#ifdef GBP_SERIAL_IO_BUFFER_SIZE_POW2
+      // Buffer cannot fit the whole capture, so keep it from filling up
+      if (gbp_serial_io_dataBuff_getByteCount(&ctx) > (GBP_SERIAL_IO_BUFFER_SIZE_POW2 / 2))
+        gbp_serial_io_dataBuff_consume(&ctx, gbp_serial_io_dataBuff_getByteCount(&ctx) / 2);
+#endif
+      sim_clockByte(&ctx, bytes[i]);
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+    totalNs += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    totalBytes += bytes.size();
+  }
+
+  return totalBytes ? ((double)totalNs / totalBytes) : 0;
+}
+
+/*******************************************************************************
+ * Simulation
+*******************************************************************************/
+
+typedef struct
+{
+  uint64_t nowNs;
+  uint64_t nextLoopNs;
+  uint32_t elapsedUs;      ///< Not yet passed on to the millisecond handlers
+  double drainBudget;      ///< Bytes the host link can take right now
+  uint64_t consumed;       ///< Bytes drained by main loop
+  size_t packetDrained;    ///< Packets fully drained so far
+  uint64_t latencyMinNs;
+  uint64_t latencyMaxNs;
+  uint64_t latencySumNs;
+} sim_state_t;
+
+static void sim_mainLoop(gbp_serial_io_ctx_t *ctx, const sim_config_t *cfg, sim_state_t *s, std::vector<sim_packet_t> &packets, std::vector<uint64_t> &packetEndOffset)
+{
+  const uint64_t loopNs = (uint64_t)cfg->loopUs * 1000;
+
+  while (s->nextLoopNs <= s->nowNs)
+  {
+    s->nextLoopNs += loopNs;
+
+#ifdef GBP_FEATURE_STATUS_PRECOMPUTE
+    gbp_serial_io_status_service(ctx);
+#endif
+
+    // Host link bandwidth is not saved up while there is nothing to send
+    s->drainBudget += (double)cfg->drainRate * cfg->loopUs / 1000000;
+    while (s->drainBudget >= 1)
+    {
+      const uint8_t *span = NULL;
+      size_t spanSize = gbp_serial_io_dataBuff_getSpan(ctx, &span);
+      if (spanSize == 0)
+      {
+        s->drainBudget = 0;
+        break;
+      }
+      if (spanSize > (size_t)s->drainBudget)
+      {
+        spanSize = (size_t)s->drainBudget;
+      }
+      gbp_serial_io_dataBuff_consume(ctx, spanSize);
+      s->drainBudget -= spanSize;
+      s->consumed += spanSize;
+    }
+
+    while ((s->packetDrained < packets.size()) && (s->consumed >= packetEndOffset[s->packetDrained]) && (packets[s->packetDrained].endNs > 0))
+    {
+      const uint64_t latency = s->nowNs - packets[s->packetDrained].endNs;
+      s->latencyMinNs = (latency < s->latencyMinNs) ? latency : s->latencyMinNs;
+      s->latencyMaxNs = (latency > s->latencyMaxNs) ? latency : s->latencyMaxNs;
+      s->latencySumNs += latency;
+      if (cfg->verbose)
+      {
+        printf("/*   packet %lu (0x%02X, %lu B) : latency %.3f ms */\r\n", (unsigned long)s->packetDrained, packets[s->packetDrained].command, (unsigned long)packets[s->packetDrained].size, latency / 1e6);
+      }
+      s->packetDrained++;
+    }
+
+    s->elapsedUs += cfg->loopUs;
+    if (s->elapsedUs >= 1000)
+    {
+      gbp_serial_io_flow_service(ctx, s->elapsedUs / 1000);
+      gbp_serial_io_timeout_handler(ctx, s->elapsedUs / 1000);
+      s->elapsedUs %= 1000;
+    }
+  }
+}
+
+static bool sim_run(const char *path, const sim_config_t *cfg)
+{
+  std::vector<uint8_t> bytes;
+  std::vector<sim_packet_t> packets;
+  if (!sim_loadCapture(path, bytes))
+  {
+    printf("/* gpb_sim : cannot open %s */\r\n", path);
+    return false;
+  }
+  sim_findPackets(bytes, packets);
+
+  // Bytes the ring buffer has taken in by the end of each packet
+  std::vector<uint64_t> packetEndOffset(packets.size());
+  uint64_t expected = 0;
+  for (size_t k = 0 ; k < packets.size() ; k++)
+  {
+    expected += packets[k].size;
+    packetEndOffset[k] = expected;
+  }
+
+  static gbp_serial_io_ctx_t ctx;
+  std::vector<uint8_t> buffer(cfg->bufferSize);
+  gpb_serial_io_init(&ctx, buffer.size(), buffer.data());
+  gbp_serial_io_dataBuff_waterline(&ctx, true);
+  if (cfg->adaptive)
+  {
+    gbp_serial_io_flow_config(&ctx, cfg->bufferSize / 4, (cfg->bufferSize * 3) / 4);
+  }
+
+  sim_state_t s = {};
+  s.latencyMinNs = UINT64_MAX;
+  const uint64_t bitNs = 1000000000ULL / cfg->linkRate;
+  size_t k = 0;
+
+  for (size_t i = 0 ; i < bytes.size() ; i++)
+  {
+    if ((k < packets.size()) && (i == packets[k].start) && (i > 0))
+    {
+      s.nowNs += (uint64_t)cfg->packetGapUs * 1000;
+    }
+    else if (i > 0)
+    {
+      s.nowNs += (uint64_t)cfg->byteGapUs * 1000;
+    }
+
+    // Main loop only runs in between clock edges here (ISR preempts it on hardware)
+    for (int bi = 7 ; bi >= 0 ; bi--)
+    {
+      sim_mainLoop(&ctx, cfg, &s, packets, packetEndOffset);
+      const bool bit = (bytes[i] >> bi) & 0x01;
+#ifdef GBP_FEATURE_USING_RISING_CLOCK_ONLY_ISR
+      gpb_serial_io_OnRising_ISR(&ctx, bit);
+#else
+      gpb_serial_io_OnChange_ISR(&ctx, false, bit);
+      gpb_serial_io_OnChange_ISR(&ctx, true, bit);
+#endif
+      s.nowNs += bitNs;
+    }
+
+    if ((k < packets.size()) && (i == (packets[k].start + packets[k].size - 1)))
+    {
+      packets[k].endNs = s.nowNs;
+      k++;
+    }
+  }
+  const uint64_t linkNs = s.nowNs;
+
+  // Let the host catch up
+  const uint64_t drainTimeoutNs = s.nowNs + 60ULL * 1000000000ULL;
+  while ((gbp_serial_io_dataBuff_getByteCount(&ctx) > 0) && (s.nowNs < drainTimeoutNs))
+  {
+    s.nowNs = (s.nextLoopNs > s.nowNs) ? s.nextLoopNs : s.nowNs;
+    sim_mainLoop(&ctx, cfg, &s, packets, packetEndOffset);
+  }
+
+  const double isrNsPerByte = sim_isrCost(bytes);
+  const long dropped = (long)expected - (long)s.consumed - (long)gbp_serial_io_dataBuff_getByteCount(&ctx);
+  const char *name = strrchr(path, '/') ? (strrchr(path, '/') + 1) : path;
+
+  printf("/* gpb_sim : %s */\r\n", name);
+  printf("/*   link %lu Hz, drain %lu B/s, loop %lu us, buffer %lu B%s */\r\n", (unsigned long)cfg->linkRate, (unsigned long)cfg->drainRate, (unsigned long)cfg->loopUs, (unsigned long)cfg->bufferSize, cfg->adaptive ? ", adaptive busy" : "");
+  printf("/*   bytes %lu, packets %lu, link time %.1f ms, drained at %.1f ms */\r\n", (unsigned long)bytes.size(), (unsigned long)packets.size(), linkNs / 1e6, s.nowNs / 1e6);
+  printf("/*   isr %.1f ns/byte (host) */\r\n", isrNsPerByte);
+  printf("/*   waterline %u / %u B */\r\n", gbp_serial_io_dataBuff_waterline(&ctx, false), gbp_serial_io_dataBuff_max(&ctx));
+  printf("/*   dropped %ld B */\r\n", dropped);
+  if (s.packetDrained > 0)
+  {
+    printf("/*   latency min %.3f, avg %.3f, max %.3f ms (%lu packets)%s */\r\n", s.latencyMinNs / 1e6, (s.latencySumNs / 1e6) / s.packetDrained, s.latencyMaxNs / 1e6, (unsigned long)s.packetDrained, (dropped != 0) ? " (skewed by dropped bytes)" : "");
+  }
+  return true;
+}
+
+/*******************************************************************************
+ * Main
+*******************************************************************************/
+
+static uint32_t sim_parseRate(const char *s)
+{
+  char *end = NULL;
+  uint32_t v = strtoul(s, &end, 10);
+  if (end && ((*end == 'k') || (*end == 'K')))
+  {
+    v *= 1024;
+  }
+  return v;
+}
+
+int main(int argc, char *argv[])
+{
+  sim_config_t cfg = {};
+  cfg.linkRate = 8192;
+  cfg.drainRate = 3840;
+  cfg.loopUs = 1000;
+  cfg.bufferSize = 650;
+#ifdef GBP_SERIAL_IO_BUFFER_SIZE_POW2
+  cfg.bufferSize = GBP_SERIAL_IO_BUFFER_SIZE_POW2;
+#endif
+
+  int files = 0;
+  int failures = 0;
+  for (int i = 1 ; i < argc ; i++)
+  {
+    const char *arg = argv[i];
+    const char *val = (i + 1 < argc) ? argv[i + 1] : "0";
+    if      (strcmp(arg, "-r") == 0) { cfg.linkRate = sim_parseRate(val); i++; }
+    else if (strcmp(arg, "-d") == 0) { cfg.drainRate = sim_parseRate(val); i++; }
+    else if (strcmp(arg, "-l") == 0) { cfg.loopUs = strtoul(val, NULL, 10); i++; }
+    else if (strcmp(arg, "-b") == 0) { cfg.bufferSize = strtoul(val, NULL, 10); i++; }
+    else if (strcmp(arg, "-g") == 0) { cfg.byteGapUs = strtoul(val, NULL, 10); i++; }
+    else if (strcmp(arg, "-G") == 0) { cfg.packetGapUs = strtoul(val, NULL, 10); i++; }
+    else if (strcmp(arg, "-a") == 0) { cfg.adaptive = true; }
+    else if (strcmp(arg, "-v") == 0) { cfg.verbose = true; }
+    else
+    {
+      if ((cfg.linkRate == 0) || (cfg.loopUs == 0) || (cfg.bufferSize == 0))
+      {
+        printf("/* gpb_sim : bad options */\r\n");
+        return 1;
+      }
+#ifdef GBP_SERIAL_IO_BUFFER_SIZE_POW2
+      if (cfg.bufferSize != GBP_SERIAL_IO_BUFFER_SIZE_POW2)
+      {
+        printf("/* gpb_sim : buffer must be GBP_SERIAL_IO_BUFFER_SIZE_POW2 */\r\n");
+        return 1;
+      }
+#endif
+      failures += sim_run(arg, &cfg) ? 0 : 1;
+      files++;
+    }
+  }
+
+  if (files == 0)
+  {
+    printf("/* Usage: gpb_sim [-r link_hz] [-d drain_bytes_per_s] [-l loop_us] [-b buffer] [-g byte_gap_us] [-G packet_gap_us] [-a] [-v] capture.txt... */\r\n");
+    return 1;
+  }
+  return failures ? 1 : 0;
+}
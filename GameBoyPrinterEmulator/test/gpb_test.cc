@@ -1,13 +1,29 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
-#include "gameboy_printer_protocol.h"
+#include "src/gbp_core/gameboy_printer_protocol.h"
 #include "gbp_serial_io.h"
-#include "gbp_pkt.h"
+#include "src/gbp_core/gbp_pkt.h"
+#include "src/gbp_core/gbp_tiles.h"
+#include "gbp_spool.h"
 
 //#define FEATURE_PACKET_SERIAL_IO
 #define FEATURE_PACKET_TEST_PARSE
+#define FEATURE_PACKET_TEST_PARSE_BUFFER
+#define FEATURE_PACKET_TEST_SERIAL_IO_CTX
+#define FEATURE_PACKET_TEST_SERIAL_IO_BYTE
+#define FEATURE_PACKET_TEST_SERIAL_IO_STATUS
+#define FEATURE_PACKET_TEST_SERIAL_IO_FLOW
+#ifdef FEATURE_CHECKSUM_SUPPORTED
+#define FEATURE_PACKET_TEST_SERIAL_IO_CHECKSUM  // Built as gpb_test_checksum
+#endif
+#ifdef GBP_FEATURE_SERIAL_IO_STATS
+#define FEATURE_PACKET_TEST_SERIAL_IO_STATS
+#endif
+#define FEATURE_PACKET_TEST_RASTER_ROWS
+#define FEATURE_PACKET_TEST_SPOOL
 
 
 /*******************************************************************************
@@ -95,11 +111,275 @@ void dummy_ISR(const bool GBP_SCLK, const bool GBP_SOUT)
 }
 
 
+#ifdef FEATURE_PACKET_TEST_PARSE_BUFFER
+// Digest of all packet events, to check that gbp_pkt_processBuffer() matches gbp_pkt_processByte()
+typedef struct
+{
+  size_t events;
+  uint32_t digest;
+} parseDigest_t;
+
+static void parseDigest_add(parseDigest_t *d, const gbp_pkt_t *pkt, const uint8_t buffer[], const uint8_t bufferSize)
+{
+  d->events++;
+  d->digest = d->digest * 31 + pkt->received;
+  d->digest = d->digest * 31 + pkt->command;
+  d->digest = d->digest * 31 + pkt->status;
+  d->digest = d->digest * 31 + bufferSize;
+  for (int i = 0 ; i < bufferSize ; i++)
+  {
+    d->digest = d->digest * 31 + buffer[i];
+  }
+}
+
+static void parseDigest_callback(gbp_pkt_t *_pkt, uint8_t buffer[], const uint8_t bufferSize, void *userData)
+{
+  parseDigest_add((parseDigest_t *) userData, _pkt, buffer, bufferSize);
+}
+
+// Digest of all tiles of the DATA packets, to check gbp_pkt_processBuffer_full() against the streamed payload
+typedef struct
+{
+  gbp_pkt_tileAcc_t tileBuff;
+  size_t tiles;
+  size_t streamedEvents;
+  uint32_t digest;
+} tileDigest_t;
+
+static void tileDigest_add(tileDigest_t *d, gbp_pkt_t *pkt, const uint8_t buffer[], const size_t bufferSize)
+{
+  if (pkt->received == GBP_REC_GOT_PACKET && ((pkt->command != GBP_COMMAND_DATA) || gbp_pkt_payloadStreamed(pkt)))
+    return;
+  while (gbp_pkt_decompressor(pkt, buffer, bufferSize, &d->tileBuff))
+  {
+    if (!gbp_pkt_tileAccu_tileReadyCheck(&d->tileBuff))
+      continue;
+    d->tiles++;
+    for (int i = 0 ; i < GBP_TILE_SIZE_IN_BYTE ; i++)
+    {
+      d->digest = d->digest * 31 + d->tileBuff.tile[i];
+    }
+  }
+}
+
+#if GBP_CORE_FULL_PAYLOAD
+static void tileDigest_fullCallback(gbp_pkt_t *_pkt, uint8_t buffer[], const uint16_t bufferSize, void *userData)
+{
+  tileDigest_t *d = (tileDigest_t *) userData;
+  d->streamedEvents += (_pkt->received != GBP_REC_GOT_PACKET) ? 1 : 0;
+  tileDigest_add(d, _pkt, buffer, bufferSize);
+}
+#endif
+#endif // FEATURE_PACKET_TEST_PARSE_BUFFER
+
+
+#ifdef FEATURE_PACKET_TEST_SERIAL_IO_CTX
+// Extra printer ports, to check that each gbp_serial_io_ctx_t instance is independent
+#define TEST_PORT_COUNT 2
+gbp_serial_io_ctx_t testPort[TEST_PORT_COUNT];
+uint8_t testPortBuffer[TEST_PORT_COUNT][sizeof(testVector)+100] = {{0}};
+uint8_t testPortResponse[TEST_PORT_COUNT][sizeof(testVector)+100] = {{0}};
+
+void testPort_ISR(const int port, const size_t byteCount, const uint8_t byteMask, const bool GBP_SCLK, const bool GBP_SOUT)
+{
+  static bool txBit[TEST_PORT_COUNT] = {false};
+
+  if (GBP_SCLK)
+  {
+    // Gameboy will read printer's bit on rise
+    testPortResponse[port][byteCount] |= (txBit[port] ? 0xFF : 0x00) & byteMask;
+  }
+
+#ifdef GBP_FEATURE_USING_RISING_CLOCK_ONLY_ISR
+  if (GBP_SCLK)
+  {
+    txBit[port] = gpb_serial_io_OnRising_ISR(&testPort[port], GBP_SOUT);
+  }
+#else
+  txBit[port] = gpb_serial_io_OnChange_ISR(&testPort[port], GBP_SCLK, GBP_SOUT);
+#endif
+}
+#endif // FEATURE_PACKET_TEST_SERIAL_IO_CTX
+
+#ifdef FEATURE_PACKET_TEST_SERIAL_IO_BYTE
+// Port driven by a whole byte per call (As an SPI slave peripheral would)
+gbp_serial_io_ctx_t testBytePort;
+uint8_t testBytePortBuffer[sizeof(testVector)+100] = {0};
+uint8_t testBytePortResponse[sizeof(testVector)+100] = {0};
+#endif // FEATURE_PACKET_TEST_SERIAL_IO_BYTE
+
+#ifdef FEATURE_PACKET_TEST_SERIAL_IO_STATUS
+// Status sequencing test, from the point of view of the sequence of packets received
+typedef struct
+{
+  uint8_t command;
+  uint16_t dataLength;
+  int repeat;
+  uint8_t statusExpected;
+} statusScript_t;
+
+const statusScript_t testStatusScript[] = {
+  {GBP_COMMAND_INIT,    0,   1,  0x00},
+  {GBP_COMMAND_DATA,    640, 1,  0x00},
+  {GBP_COMMAND_DATA,    0,   1,  0x00},
+  {GBP_COMMAND_PRINT,   4,   1,  GBP_STATUS_MASK_FULL},
+  {GBP_COMMAND_INQUIRY, 0,   2,  GBP_STATUS_MASK_FULL},                         // Unprocessed data countdown
+  {GBP_COMMAND_INQUIRY, 0,   20, GBP_STATUS_MASK_FULL | GBP_STATUS_MASK_BUSY},  // Printing
+  {GBP_COMMAND_INQUIRY, 0,   1,  GBP_STATUS_MASK_FULL},
+  {GBP_COMMAND_INQUIRY, 0,   1,  0x00},
+  {GBP_COMMAND_BREAK,   0,   1,  GBP_STATUS_MASK_FULL | GBP_STATUS_MASK_BUSY},
+};
+
+// Port that has its status response precomputed in between bytes (As the main loop would)
+gbp_serial_io_ctx_t testStatusPort;
+uint8_t testStatusPortBuffer[sizeof(testVector)+100] = {0};
+uint8_t testStatusPortResponse[sizeof(testVector)+100] = {0};
+#endif // FEATURE_PACKET_TEST_SERIAL_IO_STATUS
+
+#ifdef FEATURE_PACKET_TEST_SERIAL_IO_FLOW
+// Adaptive busy: only as long as the host is behind (Host behind for 10 inquiries here)
+const statusScript_t testFlowScript[] = {
+  {GBP_COMMAND_INIT,    0,   1,  0x00},
+  {GBP_COMMAND_DATA,    640, 1,  0x00},
+  {GBP_COMMAND_DATA,    0,   1,  0x00},
+  {GBP_COMMAND_PRINT,   4,   1,  GBP_STATUS_MASK_FULL},
+  {GBP_COMMAND_INQUIRY, 0,   2,  GBP_STATUS_MASK_FULL},                         // Unprocessed data countdown
+  {GBP_COMMAND_INQUIRY, 0,   2,  GBP_STATUS_MASK_FULL | GBP_STATUS_MASK_BUSY},  // Printing (GBP_FLOW_BUSY_PACKET_COUNT_MIN)
+  {GBP_COMMAND_INQUIRY, 0,   10, GBP_STATUS_MASK_FULL | GBP_STATUS_MASK_BUSY},  // Held while host is behind
+  {GBP_COMMAND_INQUIRY, 0,   1,  GBP_STATUS_MASK_FULL},
+  {GBP_COMMAND_INQUIRY, 0,   1,  0x00},
+};
+#define TEST_FLOW_HOLD_START 8
+#define TEST_FLOW_HOLD_END   18
+
+gbp_serial_io_ctx_t testFlowPort;
+uint8_t testFlowPortBuffer[sizeof(testVector)+100] = {0};
+#endif // FEATURE_PACKET_TEST_SERIAL_IO_FLOW
+
+#ifdef FEATURE_PACKET_TEST_SERIAL_IO_STATS
+gbp_serial_io_ctx_t testStatsPort;
+uint8_t testStatsPortBuffer[sizeof(testVector)+100] = {0};
+uint8_t testStatsSmallBuffer[64] = {0};
+#endif // FEATURE_PACKET_TEST_SERIAL_IO_STATS
+
+#ifdef FEATURE_PACKET_TEST_SERIAL_IO_CHECKSUM
+// Port fed by a game that resends any packet the printer reports a checksum error on
+gbp_serial_io_ctx_t testChecksumPort;
+uint8_t testChecksumPortBuffer[sizeof(testVector)+100] = {0};
+uint8_t testChecksumSmallBuffer[64] = {0};
+
+// Send one packet, flipping a bit at errorPos (if not 0)
+// Return: status byte replied by the printer
+uint8_t testChecksum_sendPacket(gbp_serial_io_ctx_t *ctx, const uint8_t *packet, size_t packetSize, size_t errorPos)
+{
+  uint8_t status = 0;
+  for (size_t i = 0 ; i < packetSize ; i++)
+  {
+    const uint8_t b = (errorPos && (i == errorPos)) ? (packet[i] ^ (1 << (i % 8))) : packet[i];
+    const uint8_t reply = gpb_serial_io_OnByte_ISR(ctx, b);
+    if (i == (packetSize - 2))
+      status = reply;  // Shifted out while the last byte is shifted in
+  }
+  return status;
+}
+#endif // FEATURE_PACKET_TEST_SERIAL_IO_CHECKSUM
+
+#ifdef FEATURE_PACKET_TEST_SPOOL
+// Ram block storage standing in for the SD card
+#define TEST_SPOOL_BLOCK_COUNT_MAX 32
+uint8_t testSpoolStorage[TEST_SPOOL_BLOCK_COUNT_MAX * GBP_SPOOL_BLOCK_SIZE] = {0};
+uint8_t testSpoolOutput[sizeof(testVector)] = {0};
+
+bool testSpool_read(void *dev, uint32_t addr, uint8_t *data, size_t size)
+{
+  (void)dev;
+  memcpy(data, &testSpoolStorage[addr], size);
+  return true;
+}
+
+bool testSpool_write(void *dev, uint32_t block, const uint8_t data[GBP_SPOOL_BLOCK_SIZE])
+{
+  (void)dev;
+  memcpy(&testSpoolStorage[block * GBP_SPOOL_BLOCK_SIZE], data, GBP_SPOOL_BLOCK_SIZE);
+  return true;
+}
+
+// Write test vector in writeChunk sized pieces, reading at most readChunk bytes in between (0 = only at the end)
+// Pieces the spool did not take are offered again, like the serial io buffer does
+size_t testSpool_run(gbp_spool_t *spool, uint32_t blockCount, size_t writeChunk, size_t readChunk)
+{
+  size_t outSize = 0;
+  gbp_spool_init(spool, NULL, blockCount, testSpool_read, testSpool_write);
+  for (size_t i = 0 ; i < sizeof(testVector) ; )
+  {
+    const size_t n = ((sizeof(testVector) - i) < writeChunk) ? (sizeof(testVector) - i) : writeChunk;
+    const size_t written = gbp_spool_write(spool, &testVector[i], n);
+    i += written;
+    if ((written == 0) && (readChunk == 0))
+      break;
+    size_t budget = readChunk;
+    while (budget > 0)
+    {
+      const uint8_t *span = NULL;
+      size_t spanSize = gbp_spool_getSpan(spool, &span);
+      spanSize = (spanSize < budget) ? spanSize : budget;
+      if (spanSize == 0)
+        break;
+      memcpy(&testSpoolOutput[outSize], span, spanSize);
+      gbp_spool_consume(spool, spanSize);
+      outSize += spanSize;
+      budget -= spanSize;
+    }
+  }
+  while (1)
+  {
+    const uint8_t *span = NULL;
+    const size_t spanSize = gbp_spool_getSpan(spool, &span);
+    if (spanSize == 0)
+      break;
+    memcpy(&testSpoolOutput[outSize], span, spanSize);
+    gbp_spool_consume(spool, spanSize);
+    outSize += spanSize;
+  }
+  return outSize;
+}
+#endif // FEATURE_PACKET_TEST_SPOOL
+
+#ifdef FEATURE_PACKET_TEST_RASTER_ROWS
+// Rows only get their print palette on the way out (gbp_tile_t.rowPallet, gbp_tiles_stream_get())
+void testRowPallet(uint8_t row[GBP_TILE_PIXEL_HEIGHT * GBP_TILES_ROW_SIZE_B], uint8_t pallet)
+{
+  uint8_t harmonisedPack[256];
+  if (!gbp_tiles_harmoniseLut(pallet, harmonisedPack))
+    return;
+  for (size_t k = 0; k < (GBP_TILE_PIXEL_HEIGHT * GBP_TILES_ROW_SIZE_B); k++)
+    row[k] = harmonisedPack[row[k]];
+}
+
+// Fetch every tagged row of a stream, as soon as it is tagged (The ring may only hold the row being decoded)
+void testStreamDrain(gbp_tiles_stream_t *stream, uint8_t out[][GBP_TILE_PIXEL_HEIGHT * GBP_TILES_ROW_SIZE_B], int outMax, int *outRows)
+{
+  const uint8_t *row = NULL;
+  uint8_t pallet = 0;
+  while ((row = gbp_tiles_stream_get(stream, &pallet)) != NULL)
+  {
+    if (*outRows < outMax)
+    {
+      memcpy(out[*outRows], row, GBP_TILE_PIXEL_HEIGHT * GBP_TILES_ROW_SIZE_B);
+      testRowPallet(out[(*outRows)++], pallet);
+    }
+    gbp_tiles_stream_release(stream);
+  }
+}
+#endif // FEATURE_PACKET_TEST_RASTER_ROWS
+
+
 /*******************************************************************************
  * Main Test Routine
 *******************************************************************************/
 int main(void)
 {
+  int testFailures = 0;
   printf("/* GBP Testing (Test Vector Size: %lu) */", (long unsigned) sizeof(testVector));
   // Prep
   gpb_serial_io_init(sizeof(gbp_buffer), gbp_buffer);
@@ -116,6 +396,278 @@ int main(void)
     }
   }
 
+#ifdef FEATURE_PACKET_TEST_SERIAL_IO_CTX
+  {
+    // Clock every port in lockstep, one bit at a time, so their state is interleaved
+    for (int p = 0 ; p < TEST_PORT_COUNT ; p++)
+    {
+      gpb_serial_io_init(&testPort[p], sizeof(testPortBuffer[p]), testPortBuffer[p]);
+    }
+    for (size_t i = 0 ; i < sizeof(testVector) ; i++)
+    {
+      const uint8_t byte = testVector[i];
+      for (int bi = 7 ; bi >= 0 ; bi--)
+      {
+        for (int p = 0 ; p < TEST_PORT_COUNT ; p++)
+        {
+          testPort_ISR(p, i, 1 << bi, 0, (byte >> bi) & 0x01);
+          testPort_ISR(p, i, 1 << bi, 1, (byte >> bi) & 0x01);
+        }
+      }
+    }
+    // Each port should capture and reply exactly like the single port (default instance)
+    const size_t byteCount = gbp_serial_io_dataBuff_getByteCount();
+    for (int p = 0 ; p < TEST_PORT_COUNT ; p++)
+    {
+      bool pass = (gbp_serial_io_dataBuff_getByteCount(&testPort[p]) == byteCount);
+      for (size_t i = 0 ; pass && (i < byteCount) ; i++)
+      {
+        pass = (gbp_serial_io_dataBuff_getByte_Peek(&testPort[p], i) == gbp_serial_io_dataBuff_getByte_Peek(i));
+      }
+      pass = pass && (memcmp(testPortResponse[p], testResponse, sizeof(testResponse)) == 0);
+      printf("\r\n/* serial_io ctx (port: %d, bytes: %lu) : %s */", p, (unsigned long) byteCount, pass ? "OK" : "MISMATCH");
+      testFailures += pass ? 0 : 1;
+    }
+  }
+#endif // FEATURE_PACKET_TEST_SERIAL_IO_CTX
+
+#ifdef FEATURE_PACKET_TEST_SERIAL_IO_BYTE
+  {
+    // The returned byte is shifted out while the next byte is shifted in
+    gpb_serial_io_init(&testBytePort, sizeof(testBytePortBuffer), testBytePortBuffer);
+    for (size_t i = 0 ; i < sizeof(testVector) ; i++)
+    {
+      testBytePortResponse[i + 1] = gpb_serial_io_OnByte_ISR(&testBytePort, testVector[i]);
+    }
+    // Should capture and reply exactly like the bit level engine
+    const size_t byteCount = gbp_serial_io_dataBuff_getByteCount();
+    bool pass = (gbp_serial_io_dataBuff_getByteCount(&testBytePort) == byteCount);
+    for (size_t i = 0 ; pass && (i < byteCount) ; i++)
+    {
+      pass = (gbp_serial_io_dataBuff_getByte_Peek(&testBytePort, i) == gbp_serial_io_dataBuff_getByte_Peek(i));
+    }
+    pass = pass && (memcmp(testBytePortResponse, testResponse, sizeof(testVector)) == 0);
+    printf("\r\n/* serial_io byte (bytes: %lu) : %s */", (unsigned long) byteCount, pass ? "OK" : "MISMATCH");
+    testFailures += pass ? 0 : 1;
+  }
+#endif // FEATURE_PACKET_TEST_SERIAL_IO_BYTE
+
+#ifdef FEATURE_PACKET_TEST_SERIAL_IO_STATUS
+  {
+    // Status sequencing on its own (No serial io involved)
+    gbp_serial_io_status_t status = {(uint16_t)(GBP_DEVICE_ID << 8), 0, 0, 0, false, false};
+    int packets = 0;
+    bool pass = true;
+    for (size_t i = 0 ; i < sizeof(testStatusScript)/sizeof(testStatusScript[0]) ; i++)
+    {
+      const statusScript_t *t = &testStatusScript[i];
+      for (int r = 0 ; r < t->repeat ; r++)
+      {
+        const uint16_t txStatus = gbp_serial_io_status_step(&status, t->command, t->dataLength);
+        if (txStatus != (uint16_t)((GBP_DEVICE_ID << 8) | t->statusExpected))
+        {
+          printf("\r\n/* status step %d (%s) : got 0x%04X expected 0x%04X */", packets, gbpCommand_toStr(t->command), txStatus, (GBP_DEVICE_ID << 8) | t->statusExpected);
+          pass = false;
+        }
+        packets++;
+      }
+    }
+    printf("\r\n/* serial_io status step (packets: %d) : %s */", packets, pass ? "OK" : "MISMATCH");
+    testFailures += pass ? 0 : 1;
+  }
+#ifdef GBP_FEATURE_STATUS_PRECOMPUTE
+  {
+    // Precomputed status responses should reply exactly like the inline status computation
+    gpb_serial_io_init(&testStatusPort, sizeof(testStatusPortBuffer), testStatusPortBuffer);
+    for (size_t i = 0 ; i < sizeof(testVector) ; i++)
+    {
+      gbp_serial_io_status_service(&testStatusPort);
+      testStatusPortResponse[i + 1] = gpb_serial_io_OnByte_ISR(&testStatusPort, testVector[i]);
+    }
+    const size_t byteCount = gbp_serial_io_dataBuff_getByteCount();
+    bool pass = (gbp_serial_io_dataBuff_getByteCount(&testStatusPort) == byteCount);
+    for (size_t i = 0 ; pass && (i < byteCount) ; i++)
+    {
+      pass = (gbp_serial_io_dataBuff_getByte_Peek(&testStatusPort, i) == gbp_serial_io_dataBuff_getByte_Peek(i));
+    }
+    pass = pass && (memcmp(testStatusPortResponse, testResponse, sizeof(testVector)) == 0);
+    pass = pass && (testStatusPort.pktIO.statusSlotMiss == 0);
+    printf("\r\n/* serial_io status precompute (misses: %u) : %s */", (unsigned) testStatusPort.pktIO.statusSlotMiss, pass ? "OK" : "MISMATCH");
+    testFailures += pass ? 0 : 1;
+  }
+#endif // GBP_FEATURE_STATUS_PRECOMPUTE
+#endif // FEATURE_PACKET_TEST_SERIAL_IO_STATUS
+
+#ifdef FEATURE_PACKET_TEST_SERIAL_IO_FLOW
+  {
+    // Adaptive status sequencing on its own
+    gbp_serial_io_status_t status = {(uint16_t)(GBP_DEVICE_ID << 8), 0, 0, 0, true, false};
+    int packets = 0;
+    bool pass = true;
+    for (size_t i = 0 ; i < sizeof(testFlowScript)/sizeof(testFlowScript[0]) ; i++)
+    {
+      const statusScript_t *t = &testFlowScript[i];
+      for (int r = 0 ; r < t->repeat ; r++)
+      {
+        status.flowHold = (packets >= TEST_FLOW_HOLD_START) && (packets < TEST_FLOW_HOLD_END);
+        const uint16_t txStatus = gbp_serial_io_status_step(&status, t->command, t->dataLength);
+        if (txStatus != (uint16_t)((GBP_DEVICE_ID << 8) | t->statusExpected))
+        {
+          printf("\r\n/* flow step %d (%s) : got 0x%04X expected 0x%04X */", packets, gbpCommand_toStr(t->command), txStatus, (GBP_DEVICE_ID << 8) | t->statusExpected);
+          pass = false;
+        }
+        packets++;
+      }
+    }
+    printf("\r\n/* serial_io flow step (packets: %d) : %s */", packets, pass ? "OK" : "MISMATCH");
+    testFailures += pass ? 0 : 1;
+  }
+  {
+    // Busy is held once the buffer reaches the high watermark, and released as the host catches up
+    const uint16_t low = 100;
+    const uint16_t high = 400;
+    gpb_serial_io_init(&testFlowPort, sizeof(testFlowPortBuffer), testFlowPortBuffer);
+    bool pass = !gbp_serial_io_flow_config(&testFlowPort, high, low) && gbp_serial_io_flow_config(&testFlowPort, low, high);
+    size_t i = 0;
+    while ((i < sizeof(testVector)) && !gbp_serial_io_flow_service(&testFlowPort, 1))
+    {
+      gpb_serial_io_OnByte_ISR(&testFlowPort, testVector[i++]);
+    }
+    const size_t holdCount = gbp_serial_io_dataBuff_getByteCount(&testFlowPort);
+    pass = pass && testFlowPort.pktIO.flow.hold && (holdCount >= high);
+    int ms = 0;
+    while (gbp_serial_io_flow_service(&testFlowPort, 10) && (ms < 10000))
+    {
+      // Host takes 20 bytes every 10ms
+      const uint8_t *span = NULL;
+      size_t spanSize = gbp_serial_io_dataBuff_getSpan(&testFlowPort, &span);
+      spanSize = (spanSize < 20) ? spanSize : 20;
+      gbp_serial_io_dataBuff_consume(&testFlowPort, spanSize);
+      ms += 10;
+    }
+    const size_t releaseCount = gbp_serial_io_dataBuff_getByteCount(&testFlowPort);
+    pass = pass && !testFlowPort.pktIO.flow.hold && (testFlowPort.pktIO.flow.holdCount == 1) && (testFlowPort.pktIO.flow.drainRate > 0);
+    printf("\r\n/* serial_io flow (hold at: %luB, release at: %luB, %dms, %luB/s) : %s */", (unsigned long) holdCount, (unsigned long) releaseCount, ms, (unsigned long) testFlowPort.pktIO.flow.drainRate, pass ? "OK" : "MISMATCH");
+    testFailures += pass ? 0 : 1;
+  }
+#endif // FEATURE_PACKET_TEST_SERIAL_IO_FLOW
+
+#ifdef FEATURE_PACKET_TEST_SERIAL_IO_CHECKSUM
+  {
+    // Bit errors in every third packet: NAKed, resent, and only the good copy reaches the buffer
+    gpb_serial_io_init(&testChecksumPort, sizeof(testChecksumPortBuffer), testChecksumPortBuffer);
+    int packets = 0;
+    int injected = 0;
+    int resent = 0;
+    for (size_t p = 0 ; (p + 10) <= sizeof(testVector) ; packets++)
+    {
+      const uint16_t dataLength = testVector[p + 4] | (testVector[p + 5] << 8);
+      const size_t packetSize = 10 + dataLength;
+      // Corrupt payload if any, else the checksum
+      const size_t errorPos = (packets % 3 == 0) ? ((dataLength > 0) ? (6 + (packets % dataLength)) : 6) : 0;
+      injected += errorPos ? 1 : 0;
+      if (gpb_getBit(testChecksum_sendPacket(&testChecksumPort, &testVector[p], packetSize, errorPos), GBP_STATUS_BIT_SUM))
+      {
+        resent++;
+        testChecksum_sendPacket(&testChecksumPort, &testVector[p], packetSize, 0);
+      }
+      p += packetSize;
+    }
+    // Should end up with exactly what the clean capture got
+    const size_t byteCount = gbp_serial_io_dataBuff_getByteCount();
+    bool pass = (injected > 0) && (resent == injected) && (testChecksumPort.pktIO.checksumErrorCount == injected);
+    pass = pass && (gbp_serial_io_dataBuff_getByteCount(&testChecksumPort) == byteCount);
+    for (size_t i = 0 ; pass && (i < byteCount) ; i++)
+    {
+      pass = (gbp_serial_io_dataBuff_getByte_Peek(&testChecksumPort, i) == gbp_serial_io_dataBuff_getByte_Peek(i));
+    }
+    printf("\r\n/* serial_io checksum (packets: %d, bit errors: %d, resent: %d) : %s */", packets, injected, resent, pass ? "OK" : "MISMATCH");
+    testFailures += pass ? 0 : 1;
+  }
+  {
+    // Packet too big for the buffer is NAKed as well, with none of it reaching the buffer
+    gpb_serial_io_init(&testChecksumPort, sizeof(testChecksumSmallBuffer), testChecksumSmallBuffer);
+    bool pass = true;
+    int naks = 0;
+    for (size_t p = 0 ; (p + 10) <= sizeof(testVector) ; )
+    {
+      const uint16_t dataLength = testVector[p + 4] | (testVector[p + 5] << 8);
+      const size_t packetSize = 10 + dataLength;
+      const size_t countBefore = gbp_serial_io_dataBuff_getByteCount(&testChecksumPort);
+      const bool nak = gpb_getBit(testChecksum_sendPacket(&testChecksumPort, &testVector[p], packetSize, 0), GBP_STATUS_BIT_SUM);
+      const size_t countAfter = gbp_serial_io_dataBuff_getByteCount(&testChecksumPort);
+      const bool fits = (packetSize <= sizeof(testChecksumSmallBuffer));
+      naks += nak ? 1 : 0;
+      pass = pass && (nak == !fits);
+      pass = pass && (countAfter == (fits ? (countBefore + packetSize) : countBefore));
+      // Host keeps up
+      const uint8_t *span = NULL;
+      size_t spanSize = 0;
+      while ((spanSize = gbp_serial_io_dataBuff_getSpan(&testChecksumPort, &span)) > 0)
+      {
+        gbp_serial_io_dataBuff_consume(&testChecksumPort, spanSize);
+      }
+      p += packetSize;
+    }
+    pass = pass && (naks > 0);
+    printf("\r\n/* serial_io checksum overflow (naks: %d) : %s */", naks, pass ? "OK" : "MISMATCH");
+    testFailures += pass ? 0 : 1;
+  }
+#endif // FEATURE_PACKET_TEST_SERIAL_IO_CHECKSUM
+
+#ifdef FEATURE_PACKET_TEST_SERIAL_IO_STATS
+  {
+    // Every byte and packet of the capture is counted
+    gpb_serial_io_init(&testStatsPort, sizeof(testStatsPortBuffer), testStatsPortBuffer);
+    int packets = 0;
+    for (size_t p = 0 ; (p + 10) <= sizeof(testVector) ; packets++)
+    {
+      p += 10 + (testVector[p + 4] | (testVector[p + 5] << 8));
+    }
+    for (size_t i = 0 ; i < sizeof(testVector) ; i++)
+    {
+      gpb_serial_io_OnByte_ISR(&testStatsPort, testVector[i]);
+    }
+    const gbp_serial_io_stats_t *stats = &testStatsPort.pktIO.stats;
+    int packetTotal = 0;
+    for (int kind = 0 ; kind < GBP_STATUS_KIND_COUNT ; kind++)
+    {
+      packetTotal += stats->packets[kind];
+    }
+    bool pass = (stats->bytesEnqueued == sizeof(testVector)) && (stats->enqueueFailures == 0) && (stats->checksumFailures == 0);
+    pass = pass && (packetTotal == packets) && (stats->packets[GBP_STATUS_KIND_DATA] > 0) && (stats->packets[GBP_STATUS_KIND_PRINT] > 0);
+    const uint32_t bytes = stats->bytesEnqueued;
+    // Link times out half way through a packet
+    for (size_t i = 0 ; i < 15 ; i++)
+    {
+      gpb_serial_io_OnByte_ISR(&testStatsPort, testVector[i]);
+    }
+    while (!gbp_serial_io_timeout_handler(&testStatsPort, 100))
+      ;
+    pass = pass && (stats->preambleResyncs == 1);
+    printf("\r\n/* serial_io stats (packets: %d, bytes: %lu) : %s */", packetTotal, (unsigned long) bytes, pass ? "OK" : "MISMATCH");
+    testFailures += pass ? 0 : 1;
+  }
+  {
+    // Host never takes anything, so bytes are lost once the buffer is full
+    gpb_serial_io_init(&testStatsPort, sizeof(testStatsSmallBuffer), testStatsSmallBuffer);
+    for (size_t i = 0 ; i < sizeof(testVector) ; i++)
+    {
+      gpb_serial_io_OnByte_ISR(&testStatsPort, testVector[i]);
+    }
+    const gbp_serial_io_stats_t *stats = &testStatsPort.pktIO.stats;
+    uint8_t packed[GBP_SERIAL_IO_STATS_PACKED_SIZE] = {0};
+    const size_t packedSize = gbp_serial_io_stats_pack(&testStatsPort, packed);
+    const uint32_t packedFailures = packed[5] | (packed[6] << 8) | (packed[7] << 16) | ((uint32_t)packed[8] << 24);
+    bool pass = (stats->enqueueFailures > 0) && ((stats->bytesEnqueued + stats->enqueueFailures) == sizeof(testVector));
+    pass = pass && (packedSize == sizeof(packed)) && (packed[0] == GBP_SERIAL_IO_STATS_VERSION) && (packedFailures == stats->enqueueFailures);
+    gbp_serial_io_stats_reset(&testStatsPort);
+    pass = pass && (stats->bytesEnqueued == 0) && (stats->enqueueFailures == 0);
+    printf("\r\n/* serial_io stats overflow (lost: %lu) : %s */", (unsigned long) packedFailures, pass ? "OK" : "MISMATCH");
+    testFailures += pass ? 0 : 1;
+  }
+#endif // FEATURE_PACKET_TEST_SERIAL_IO_STATS
+
   // Display
 #ifdef FEATURE_PACKET_SERIAL_IO
   while (gbp_serial_io_dataBuff_getByteCount() > 0)
@@ -337,5 +889,258 @@ int main(void)
   }
 #endif //FEATURE_PACKET_TEST_PARSE
 
+#ifdef FEATURE_PACKET_TEST_PARSE_BUFFER
+  {
+    // Reference: Per byte parsing
+    parseDigest_t expected = {0, 0};
+    gbp_pkt_t pktState = {GBP_REC_NONE, 0};
+    uint8_t pktBuff[GBP_PKT_PAYLOAD_BUFF_SIZE_IN_BYTE] = {0};
+    uint8_t pktBuffSize = 0;
+    gbp_pkt_init(&pktState);
+    for (size_t i = 0 ; i < sizeof(testVector) ; i++)
+    {
+      if (gbp_pkt_processByte(&pktState, testVector[i], pktBuff, &pktBuffSize, sizeof(pktBuff)))
+      {
+        parseDigest_add(&expected, &pktState, pktBuff, pktBuffSize);
+      }
+    }
+    // Block parsing should give the same events regardless of how the stream is split up
+    const size_t chunkSizes[] = {1, 7, 16, 650, sizeof(testVector)};
+    for (size_t c = 0 ; c < (sizeof(chunkSizes)/sizeof(chunkSizes[0])) ; c++)
+    {
+      parseDigest_t result = {0, 0};
+      gbp_pkt_init(&pktState);
+      for (size_t i = 0 ; i < sizeof(testVector) ; i += chunkSizes[c])
+      {
+        const size_t remaining = sizeof(testVector) - i;
+        const size_t n = (remaining < chunkSizes[c]) ? remaining : chunkSizes[c];
+        gbp_pkt_processBuffer(&pktState, &testVector[i], n, pktBuff, &pktBuffSize, sizeof(pktBuff), parseDigest_callback, &result);
+      }
+      const bool pass = (result.events == expected.events) && (result.digest == expected.digest);
+      printf("/* processBuffer (chunk: %4lu, events: %lu) : %s */\r\n", (unsigned long) chunkSizes[c], (unsigned long) result.events, pass ? "OK" : "MISMATCH");
+      testFailures += pass ? 0 : 1;
+    }
+  }
+#if GBP_CORE_FULL_PAYLOAD
+  {
+    // Full payload parsing should give the same tiles as the streamed payload, without any streaming events
+    static tileDigest_t expected;
+    static tileDigest_t result;
+    gbp_pkt_t pktState = {GBP_REC_NONE, 0};
+    uint8_t pktBuff[GBP_PKT_PAYLOAD_BUFF_SIZE_IN_BYTE] = {0};
+    uint8_t pktBuffSize = 0;
+    static uint8_t fullBuff[GBP_PKT_FULL_PAYLOAD_BUFF_SIZE_IN_BYTE];
+    uint16_t fullBuffSize = 0;
+    gbp_pkt_init(&pktState);
+    for (size_t i = 0 ; i < sizeof(testVector) ; i++)
+    {
+      if (gbp_pkt_processByte(&pktState, testVector[i], pktBuff, &pktBuffSize, sizeof(pktBuff)))
+      {
+        tileDigest_add(&expected, &pktState, pktBuff, pktBuffSize);
+      }
+    }
+    gbp_pkt_init(&pktState);
+    const size_t events = gbp_pkt_processBuffer_full(&pktState, testVector, sizeof(testVector), fullBuff, &fullBuffSize, tileDigest_fullCallback, &result);
+    const bool pass = (expected.tiles > 0) && (result.tiles == expected.tiles) && (result.digest == expected.digest) && (result.streamedEvents == 0);
+    printf("/* processBuffer full (events: %lu, tiles: %lu) : %s */\r\n", (unsigned long) events, (unsigned long) result.tiles, pass ? "OK" : "MISMATCH");
+    testFailures += pass ? 0 : 1;
+  }
+#endif
+#endif // FEATURE_PACKET_TEST_PARSE_BUFFER
+
+#ifdef FEATURE_PACKET_TEST_RASTER_ROWS
+  {
+    // Row ring should hand out the same rows as the full tile buffer decoder
+    static gbp_tile_t tiles;
+    static gbp_tiles_rowRing_t ring;
+    gbp_pkt_t pktState = {GBP_REC_NONE, 0};
+    uint8_t pktBuff[GBP_PKT_PAYLOAD_BUFF_SIZE_IN_BYTE] = {0};
+    uint8_t pktBuffSize = 0;
+    gbp_pkt_tileAcc_t tileBuff = {0};
+    int rows = 0;
+    bool pass = true;
+    gbp_pkt_init(&pktState);
+    gbp_tiles_reset(&tiles);
+    gbp_tiles_rowRing_reset(&ring);
+    for (size_t i = 0 ; i < sizeof(testVector) ; i++)
+    {
+      if (!gbp_pkt_processByte(&pktState, testVector[i], pktBuff, &pktBuffSize, sizeof(pktBuff)))
+        continue;
+      if (pktState.received == GBP_REC_GOT_PACKET)
+      {
+        if (pktState.command == GBP_COMMAND_PRINT)
+        {
+          gbp_tiles_reset(&tiles);
+          gbp_tiles_rowRing_reset(&ring);
+        }
+        continue;
+      }
+      while (gbp_pkt_decompressor(&pktState, pktBuff, pktBuffSize, &tileBuff))
+      {
+        if (!gbp_pkt_tileAccu_tileReadyCheck(&tileBuff))
+          continue;
+        if (tiles.tileRowOffset >= GBP_TILES_PER_ROW)
+        {
+          pass = false;  // Test vector has more rows between prints than a real printer can buffer
+          continue;
+        }
+        const bool lineDone = gbp_tiles_line_decoder(&tiles, tileBuff.tile);
+        const bool rowDone = gbp_tiles_rowRing_decoder(&ring, tileBuff.tile);
+        pass = pass && (lineDone == rowDone);
+        uint16_t rowIndex = 0;
+        const uint8_t *row = gbp_tiles_rowRing_get(&ring, &rowIndex);
+        if (rowDone && row)
+        {
+          pass = pass && (rowIndex == (tiles.tileRowOffset - 1));
+          pass = pass && (memcmp(row, tiles.bmpLineBuffer[GBP_TILE_PIXEL_HEIGHT * rowIndex], GBP_TILE_PIXEL_HEIGHT * GBP_TILES_ROW_SIZE_B) == 0);
+          gbp_tiles_rowRing_release(&ring);
+          rows++;
+        }
+      }
+    }
+    pass = pass && (rows > 0) && (ring.rowDropped == 0);
+    printf("/* raster rows (rows: %d) : %s */\r\n", rows, pass ? "OK" : "MISMATCH");
+    testFailures += pass ? 0 : 1;
+  }
+  for (int holdRows = GBP_TILES_STREAM_HOLD_MAX; holdRows >= 0; holdRows -= GBP_TILES_STREAM_HOLD_MAX)
+  {
+    // Row stream should hand out the same rows and palettes as the full tile buffer decoder, whether rows wait for their print or not
+    static gbp_tile_t tiles;
+    static gbp_tiles_stream_t stream;
+    static gbp_tiles_streamRow_t streamRing[GBP_TILES_STREAM_ROWS(GBP_TILES_STREAM_HOLD_MAX)];
+    static uint8_t tilesOut[64][GBP_TILE_PIXEL_HEIGHT * GBP_TILES_ROW_SIZE_B];
+    static uint8_t streamOut[64][GBP_TILE_PIXEL_HEIGHT * GBP_TILES_ROW_SIZE_B];
+    gbp_pkt_t pktState = {GBP_REC_NONE, 0};
+    uint8_t pktBuff[GBP_PKT_PAYLOAD_BUFF_SIZE_IN_BYTE] = {0};
+    uint8_t pktBuffSize = 0;
+    gbp_pkt_tileAcc_t tileBuff = {0};
+    int tilesRows = 0;
+    int streamRows = 0;
+    gbp_pkt_init(&pktState);
+    gbp_tiles_reset(&tiles);
+    gbp_tiles_stream_init(&stream, streamRing, GBP_TILES_STREAM_ROWS(holdRows));
+    for (size_t i = 0 ; i < sizeof(testVector) ; i++)
+    {
+      if (!gbp_pkt_processByte(&pktState, testVector[i], pktBuff, &pktBuffSize, sizeof(pktBuff)))
+        continue;
+      if (pktState.received == GBP_REC_GOT_PACKET)
+      {
+        if (pktState.command == GBP_COMMAND_PRINT)
+        {
+          gbp_tiles_print(&tiles, pktBuff[GBP_PRINT_INSTRUCT_INDEX_NUM_OF_SHEETS], pktBuff[GBP_PRINT_INSTRUCT_INDEX_NUM_OF_LINEFEED], pktBuff[GBP_PRINT_INSTRUCT_INDEX_PALETTE_VALUE], pktBuff[GBP_PRINT_INSTRUCT_INDEX_PRINT_DENSITY]);
+          for (int j = 0; (j < tiles.tileRowOffset) && (tilesRows < 64); j++)
+          {
+            memcpy(tilesOut[tilesRows], tiles.bmpLineBuffer[GBP_TILE_PIXEL_HEIGHT * j], sizeof(tilesOut[0]));
+            testRowPallet(tilesOut[tilesRows], tiles.rowPallet[j]);
+            tilesRows++;
+          }
+          gbp_tiles_reset(&tiles);
+          gbp_tiles_stream_print(&stream, pktBuff[GBP_PRINT_INSTRUCT_INDEX_PALETTE_VALUE]);
+          testStreamDrain(&stream, streamOut, 64, &streamRows);
+        }
+      }
+      else
+      {
+        while (gbp_pkt_decompressor(&pktState, pktBuff, pktBuffSize, &tileBuff))
+        {
+          if (!gbp_pkt_tileAccu_tileReadyCheck(&tileBuff))
+            continue;
+          gbp_tiles_line_decoder(&tiles, tileBuff.tile);
+          if (gbp_tiles_stream_decoder(&stream, tileBuff.tile))
+            testStreamDrain(&stream, streamOut, 64, &streamRows);
+        }
+      }
+    }
+    bool pass = (tilesRows > 0) && (tilesRows == streamRows) && (memcmp(tilesOut, streamOut, tilesRows * sizeof(tilesOut[0])) == 0);
+    pass = pass && (stream.rowDropped == 0) && (stream.rowsMispredicted == 0);
+    pass = pass && ((holdRows == 0) ? (stream.rowsPredicted == (uint32_t) streamRows) : (stream.rowsPredicted == 0));
+    printf("/* row stream (hold: %d, rows: %d, predicted: %u) : %s */\r\n", holdRows, streamRows, (unsigned) stream.rowsPredicted, pass ? "OK" : "MISMATCH");
+    testFailures += pass ? 0 : 1;
+  }
+  {
+    // Tiles decoded on their own (e.g. by a tile cache) then added should give the same rows as the tile buffer decoder
+    static gbp_tile_t tiles;
+    static gbp_tile_t tilesDecoded;
+    gbp_pkt_t pktState = {GBP_REC_NONE, 0};
+    uint8_t pktBuff[GBP_PKT_PAYLOAD_BUFF_SIZE_IN_BYTE] = {0};
+    uint8_t pktBuffSize = 0;
+    gbp_pkt_tileAcc_t tileBuff = {0};
+    int rows = 0;
+    bool pass = true;
+    gbp_pkt_init(&pktState);
+    gbp_tiles_reset(&tiles);
+    gbp_tiles_reset(&tilesDecoded);
+    for (size_t i = 0 ; i < sizeof(testVector) ; i++)
+    {
+      if (!gbp_pkt_processByte(&pktState, testVector[i], pktBuff, &pktBuffSize, sizeof(pktBuff)))
+        continue;
+      if (pktState.received == GBP_REC_GOT_PACKET)
+      {
+        if (pktState.command == GBP_COMMAND_PRINT)
+        {
+          pass = pass && (tiles.tileRowOffset == tilesDecoded.tileRowOffset);
+          pass = pass && (memcmp(tiles.bmpLineBuffer, tilesDecoded.bmpLineBuffer, GBP_TILE_PIXEL_HEIGHT * GBP_TILES_ROW_SIZE_B * tiles.tileRowOffset) == 0);
+          gbp_tiles_reset(&tiles);
+          gbp_tiles_reset(&tilesDecoded);
+        }
+        continue;
+      }
+      while (gbp_pkt_decompressor(&pktState, pktBuff, pktBuffSize, &tileBuff))
+      {
+        if (!gbp_pkt_tileAccu_tileReadyCheck(&tileBuff))
+          continue;
+        uint8_t decoded[GBP_TILE_DECODED_SIZE_B];
+        gbp_tiles_tile_decode(tileBuff.tile, decoded);
+        const bool lineDone = gbp_tiles_line_decoder(&tiles, tileBuff.tile);
+        pass = pass && (lineDone == gbp_tiles_line_addDecoded(&tilesDecoded, decoded));
+        rows += lineDone ? 1 : 0;
+      }
+    }
+    pass = pass && (rows > 0);
+    printf("/* decoded tiles (rows: %d) : %s */\r\n", rows, pass ? "OK" : "MISMATCH");
+    testFailures += pass ? 0 : 1;
+  }
+#endif // FEATURE_PACKET_TEST_RASTER_ROWS
+
+#ifdef FEATURE_PACKET_TEST_SPOOL
+  {
+    // Reader slower than writer, but storage is large enough: everything comes out in order
+    static gbp_spool_t spool;
+    const size_t blockCount = (sizeof(testVector) / (GBP_SPOOL_BLOCK_SIZE - GBP_SPOOL_BLOCK_HEADER_SIZE)) + 2;
+    const size_t outSize = testSpool_run(&spool, blockCount, 7, 3);
+    bool pass = (blockCount <= TEST_SPOOL_BLOCK_COUNT_MAX) && (outSize == sizeof(testVector));
+    pass = pass && (memcmp(testSpoolOutput, testVector, sizeof(testVector)) == 0);
+    pass = pass && (spool.blocksDropped == 0) && gbp_spool_isEmpty(&spool);
+    printf("/* spool (blocks: %lu) : %s */\r\n", (unsigned long) spool.writeBlock, pass ? "OK" : "MISMATCH");
+    testFailures += pass ? 0 : 1;
+  }
+  {
+    // No storage: the ram block holds what the reader has not taken yet, nothing is lost
+    static gbp_spool_t spool;
+    const size_t outSize = testSpool_run(&spool, 0, 7, 3);
+    bool pass = (outSize == sizeof(testVector)) && (memcmp(testSpoolOutput, testVector, sizeof(testVector)) == 0);
+    pass = pass && (spool.blocksDropped == 0) && gbp_spool_isEmpty(&spool);
+    printf("/* spool ram only (bytes: %lu) : %s */\r\n", (unsigned long) outSize, pass ? "OK" : "MISMATCH");
+    testFailures += pass ? 0 : 1;
+  }
+  {
+    // Disconnected host: oldest blocks are dropped and the reader resumes at a whole packet
+    static gbp_spool_t spool;
+    const size_t outSize = testSpool_run(&spool, 2, 64, 0);
+    const size_t outStart = sizeof(testVector) - outSize;
+    bool pass = (spool.blocksDropped > 0) && (outSize > 0) && (outSize < sizeof(testVector));
+    pass = pass && (memcmp(testSpoolOutput, &testVector[outStart], outSize) == 0);
+    pass = pass && (testSpoolOutput[0] == GBP_SYNC_WORD_0) && (testSpoolOutput[1] == GBP_SYNC_WORD_1);
+    printf("/* spool overflow (dropped: %lu) : %s */\r\n", (unsigned long) spool.blocksDropped, pass ? "OK" : "MISMATCH");
+    testFailures += pass ? 0 : 1;
+  }
+#endif // FEATURE_PACKET_TEST_SPOOL
+
+  if (testFailures)
+  {
+    printf("/* FAILED */\r\n");
+    return 1;
+  }
+
   printf("/* Done */\r\n");
 }
\ No newline at end of file